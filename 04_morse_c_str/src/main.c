@@ -41,11 +41,17 @@ static SwTimerHandle_t morse_delay_timer;
 static bool_t was_encoding;
 static const char * const MESSAGE = "Dave's not here.";
 
+/* Part of the last major cycle spent asleep, in 1/1000ths. Updated once a
+   major cycle, meant to be watched with the debugger. */
+#define USEC_PER_MSEC       (1000u)
+static volatile u32_t sleep_permille;
+
 static void primary_context(void);
 static void background_context(void);
 static void initialize_scheduler(void);
 static void scheduler_isr(void);
 static void morse_executive(void);
+static void idle_sample(void);
 
 /**
  * @brief Morse C-string
@@ -66,15 +72,15 @@ int main(void)
        bsp_error_trap();
     }
 
-    /* Scheduler loop */
+    /* Scheduler loop. Once the BACKGROUND context has nothing left to do,
+       sleep until the scheduler ISR wakes the core. */
     while (1) {
-        sw_timer_task();
-
         /* Execute the context as specified by the scheduler */
         if (E_CONTEXT_PRIMARY == curr_context) {
             primary_context();
         } else {
             background_context();
+            bsp_idle();
         }
     }
 
@@ -104,7 +110,7 @@ static void primary_context(void)
        NOTE: The number of cases is application specific and will shrink and
              grow based on scheduler configuration (NUM_MINOR_CYCLES). */
     switch (curr_minor_cycle) {
-        case 0:     break;
+        case 0:     idle_sample(); break;
         case 1:     break;
         case 2:     break;
         case 3:     break;
@@ -250,4 +256,24 @@ static void morse_executive(void)
     was_encoding = is_encoding;
 
     morse_task();
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Sleep ratio sample.
+ *
+ * Computes the part of the time since the last sample that the core spent
+ * asleep in bsp_idle. The elapsed time is divided down to milliseconds first,
+ * so the math stays in 32 bits.
+ */
+static void idle_sample(void)
+{
+    BspIdleStats_t stats;
+    u32_t          elapsed_msec;
+
+    if (E_TRUE == bsp_idle_take_stats(&stats)) {
+        elapsed_msec = stats.elapsed_us / USEC_PER_MSEC;
+        if (0u != elapsed_msec) {
+            sleep_permille = stats.asleep_us / elapsed_msec;
+        }
+    }
+}
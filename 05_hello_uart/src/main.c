@@ -29,8 +29,6 @@ int main(void)
 
     /* Scheduler loop */
     while (1) {
-        sw_timer_task();
-
         /* Print the message once we hit the timeout value. */
         if (MESSAGE_DELAY_SEC <= sw_timer_sec(delay_timer)) {
             say_hello();
@@ -17,6 +17,7 @@
 #   INC_FLAGS
 #   SRC_FILES
 #   LDSCRIPT
+#   EXERCISE_FLAGS
 
 # executable binary name #
 BINARY_NAME := 06_uart_echo
@@ -45,4 +46,13 @@ SRC_FILES += $(foreach dir, $(_SRC_DIRS), $(shell find $(dir) -type f -name '*.c
 SRC_FILES += $(foreach dir, $(_SRC_DIRS), $(shell find $(dir) -type f -name '*.s'))
 
 # application linker script #
-LDSCRIPT := common/linker/STM32F103C8TX_FLASH.ld
\ No newline at end of file
+LDSCRIPT := common/linker/STM32F103C8TX_FLASH.ld
+
+# Serial port rate. The throughput test (see scripts/uart_throughput.py) runs
+# at the highest rate the 72 MHz USART1 clock supports:
+#
+#   make KATA=6 ECHO_BAUD=4500000 clean flash
+#   make KATA=6 ECHO_BAUD=4500000 PORT=/dev/ttyUSB0 throughput
+ECHO_BAUD ?= 115200
+
+EXERCISE_FLAGS := -DECHO_BAUD=$(ECHO_BAUD)u
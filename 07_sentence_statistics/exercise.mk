@@ -17,6 +17,7 @@
 #   INC_FLAGS
 #   SRC_FILES
 #   LDSCRIPT
+#   EXERCISE_FLAGS
 
 # executable binary name #
 BINARY_NAME := 07_sentence_statistics
@@ -45,4 +46,17 @@ SRC_FILES += $(foreach dir, $(_SRC_DIRS), $(shell find $(dir) -type f -name '*.c
 SRC_FILES += $(foreach dir, $(_SRC_DIRS), $(shell find $(dir) -type f -name '*.s'))
 
 # application linker script #
-LDSCRIPT := common/linker/STM32F103C8TX_FLASH.ld
\ No newline at end of file
+LDSCRIPT := common/linker/STM32F103C8TX_FLASH.ld
+
+# With STATS_LATENCY=1, each report is followed by a line with the time from
+# the new line arriving to the report being queued, and its distribution so
+# far. The serial driver then stamps received bytes (see uart_config.h), which
+# needs the per byte receive interrupt instead of the receive DMA. Off by
+# default, so the exercise keeps its plain output and the receive DMA.
+#
+#   make KATA=7 STATS_LATENCY=1 clean flash
+STATS_LATENCY ?= 0
+
+ifeq ($(STATS_LATENCY),1)
+EXERCISE_FLAGS := -DSTATISTICS_LATENCY_ENABLE=1 -DUART_RX_TIMESTAMP_ENABLE=1
+endif
@@ -1,10 +1,12 @@
 #include "statistics.h"
 #include "bsp/bsp.h"
-#include "bsp/sw_timers.h"
+#include "timer/timer.h"
 #include "types.h"
 
 #define TOGGLE_PERIOD_MSEC (500U)
 
+static void toggle_led(TimerHandle_t t, void *p_arg);
+
 /**
  * @brief Sentence statistics
  *
@@ -18,31 +20,33 @@
  */
 int main(void)
 {
-    SwTimerHandle_t delay_timer;
+    TimerHandle_t led_timer;
 
     /* Initialize the hardware and software modules */
     bsp_init();         /* board support (e.g. the LED) */
+    timer_init();       /* timer service */
     statistics_init();  /* initialize the statistics module */
 
     /* enable interrupts */
     bsp_enable_interrupts();
 
-    /* initialize data for the delay timer */
-    delay_timer = sw_timer_acquire();
-    if (SW_TIMER_NO_TIMER == delay_timer) {
+    /* The LED toggles from the timer's callback, so the main loop only has
+       the UART to look after. */
+    led_timer = timer_alloc(toggle_led, NULL_PTR);
+    if (E_FALSE == timer_start(led_timer, TOGGLE_PERIOD_MSEC, TOGGLE_PERIOD_MSEC)) {
         bsp_error_trap();
     }
 
     /* Scheduler loop */
     while (1) {
-        /* Print the message once we hit the timeout value. */
-        if (TOGGLE_PERIOD_MSEC == sw_timer_msec(delay_timer)) {
-            bsp_toggle_builtin_led();
-            sw_timer_reset(delay_timer);
-        }
-
         statistics_task();
     }
 
     return 0; /* Satisfy compiler. Should never get here */
 }
+
+/* LED timer callback */
+static void toggle_led(TimerHandle_t t, void *p_arg)
+{
+    bsp_toggle_builtin_led();
+}
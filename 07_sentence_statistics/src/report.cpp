@@ -0,0 +1,51 @@
+#include "report.h"
+
+#include "utils/fmt.h"
+#include "types.h"
+
+/* An element prints as its count, with the clamp marker if it clamped */
+template <>
+struct FmtArg<Element_t>
+{
+    static constexpr size_t max_len(char type, u32_t prec)
+    {
+        return 4u;
+    }
+
+    static char* put(char *p_dst, const FmtSpec &spec, const Element_t &elem)
+    {
+        p_dst = FmtArg<u8_t>::put(p_dst, spec, elem.count);
+        if (E_FALSE != elem.clamped) {
+            *p_dst++ = '+';
+        }
+
+        return p_dst;
+    }
+};
+
+#define REPORT_ARGS(p_ctx)                                                      \
+    "\n=================\n"                                                    \
+    "Letters    : {}\n"                                                         \
+    "Vowels     : {}\n"                                                         \
+    "Digits     : {}\n"                                                         \
+    "Whitespace : {}\n"                                                         \
+    "Punctuation: {}\n\n",                                                      \
+    (p_ctx)->letters, (p_ctx)->vowels, (p_ctx)->digits,                         \
+    (p_ctx)->whitespace, (p_ctx)->punctuation
+
+static_assert(FMT_MAX_LEN(REPORT_ARGS(static_cast<const Context_t*>(NULL_PTR))) <= REPORT_MAX_LEN,
+              "REPORT_MAX_LEN is too small for the report");
+
+extern "C" {
+
+bool_t report_output(const Context_t *p_ctx)
+{
+    return FMT_TX(REPORT_ARGS(p_ctx));
+}
+
+char* report_format(char *p_dst, const Context_t *p_ctx)
+{
+    return FMT_TO(p_dst, REPORT_ARGS(p_ctx));
+}
+
+}
@@ -0,0 +1,67 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Upper bound on the length of a report. The header plus 5 lines of a label,
+   3 digits, the clamp marker, and a new line plus the closing new line. */
+#define REPORT_MAX_LEN (128u)
+
+/**
+ * @brief A statistics meseaurement element.
+ */
+typedef struct element
+{
+    u8_t   count;
+    bool_t clamped;
+} Element_t;
+
+/**
+ * @brief Statistics Module Context
+ *
+ * The module context is made up of measurement elements of all the required
+ * measurements listed in the exercise.md.
+ */
+typedef struct context
+{
+    Element_t letters;
+    Element_t vowels;
+    Element_t digits;
+    Element_t whitespace;
+    Element_t punctuation;
+} Context_t;
+
+/**
+ * @brief Format the report for a context straight into the serial transmit
+ * buffer.
+ *
+ * The report is either queued as a whole or not at all.
+ *
+ * @param[in] p_ctx context to report
+ *
+ * @return E_TRUE if the report was queued, E_FALSE if the transmit buffer had
+ * no room for it.
+ */
+bool_t report_output(const Context_t *p_ctx);
+
+/**
+ * @brief Format the report for a context into a buffer.
+ *
+ * Same output as report_output. No null terminator is written.
+ *
+ * @param[out] p_dst buffer of at least REPORT_MAX_LEN bytes
+ * @param[in]  p_ctx context to report
+ *
+ * @return end of the report in p_dst
+ */
+char* report_format(char *p_dst, const Context_t *p_ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPORT_H */
@@ -1,56 +1,98 @@
 #include "statistics.h"
 
 #include "bsp/bsp.h"
+#include "report.h"
 #include "utils/ascii_char.h"
 #include "utils/bytes.h"
+#include "utils/histogram.h"
 #include "types.h"
 
-/**
- * @brief A statistics meseaurement element.
- */
-typedef struct element
-{
-    u8_t   count;
-    bool_t clamped;
-} Element_t;
-
-/**
- * @brief Statistics Module Context
- *
- * The module context is made up of measurement elements of all the required
- * measurements listed in the exercise.md.
- */
-typedef struct context
-{
-    Element_t letters;
-    Element_t vowels;
-    Element_t digits;
-    Element_t whitespace;
-    Element_t punctuation;
-} Context_t;
+/* Number of received bytes handled per call of the task */
+#define RX_CHUNK_SIZE (16u)
+
+/* With 1, a line with the report's latency (see output_latency) follows each
+   report. Set by make KATA=7 STATS_LATENCY=1, which also has the serial
+   driver stamp received bytes (see exercise.mk). */
+#ifndef STATISTICS_LATENCY_ENABLE
+    #define STATISTICS_LATENCY_ENABLE (0)
+#endif
+
+#if STATISTICS_LATENCY_ENABLE
+/* Report latency histogram (time from the new line arriving to the report
+   being queued) in microseconds. 32 bins of 16 us, anything past 496 us
+   lands in the last bin. */
+#define LATENCY_NUM_BINS    (32u)
+#define LATENCY_BIN_SHIFT   (4u)
+
+/* Upper bound on the length of the latency line. The label, four 10 digit
+   numbers with their labels, and two new lines. */
+#define LATENCY_MAX_LEN     (80u)
+
+/* The line is reserved in one piece (see bsp_serial_port_tx_reserve) */
+static_assert(LATENCY_MAX_LEN <= BSP_SERIAL_TX_RESERVE_MAX, "latency line too long to reserve");
+#endif
 
 static void reset_context(Context_t *p_ctx);
 static void process_char(Context_t*p_ctx, char byte);
 static void saturate_increment(Element_t *p_elem);
 static void output_context(Context_t *p_ctx);
-static void output_element(Element_t *p_elem);
-static void num_to_c_str(u8_t num, char * c_str);
-static void write_c_str(const char * const c_str);
-
-static Context_t ctx;
+#if STATISTICS_LATENCY_ENABLE
+static void output_latency(u32_t newline_stamp);
+static char* append_c_str(char *p_dst, const char * const c_str);
+static char* append_u32(char *p_dst, u32_t num);
+#endif
+
+static Context_t   ctx;
+#if STATISTICS_LATENCY_ENABLE
+static u32_t       latency_bins[LATENCY_NUM_BINS];
+static Histogram_t latency;
+#endif
 
 void statistics_init(void)
 {
     reset_context(&ctx);
+#if STATISTICS_LATENCY_ENABLE
+    histogram_init(&latency, latency_bins, LATENCY_NUM_BINS, LATENCY_BIN_SHIFT);
+#endif
 }
 
 void statistics_task(void)
 {
-    u8_t byte;
+    u8_t   bytes[RX_CHUNK_SIZE];
+#if STATISTICS_LATENCY_ENABLE
+    u32_t  stamps[RX_CHUNK_SIZE];
+#endif
+    size_t len;
+    size_t echo_start;
+    size_t i;
+
+#if STATISTICS_LATENCY_ENABLE
+    len        = bsp_serial_read_stamped(bytes, stamps, RX_CHUNK_SIZE);
+#else
+    len        = bsp_serial_read_buf(bytes, sizeof(bytes));
+#endif
+    echo_start = 0;
+
+    for (i = 0; i < len; i += 1) {
+        /* Echo for easier typing. The echo is flushed ahead of a new line so
+           it shows up before the statistics. */
+        if ('\n' == bytes[i]) {
+            (void)bsp_serial_write_buf(&bytes[echo_start], (i + 1) - echo_start);
+            echo_start = i + 1;
+        }
+
+        process_char(&ctx, (char)bytes[i]);
+
+#if STATISTICS_LATENCY_ENABLE
+        /* The report for the line is queued by now. */
+        if ('\n' == bytes[i]) {
+            output_latency(stamps[i]);
+        }
+#endif
+    }
 
-    if (E_TRUE == bsp_serial_read(&byte)) {
-        bsp_serial_write(byte); /* Echo for easier typing */
-        process_char(&ctx, (char)byte);
+    if (echo_start < len) {
+        (void)bsp_serial_write_buf(&bytes[echo_start], len - echo_start);
     }
 }
 
@@ -97,100 +139,83 @@ static void saturate_increment(Element_t *p_elem)
 
 static void output_context(Context_t *p_ctx)
 {
-    write_c_str("\n=================\n");
-    write_c_str("Letters    : ");
-    output_element(&p_ctx->letters);
-    write_c_str("\n");
-
-    write_c_str("Vowels     : ");
-    output_element(&p_ctx->vowels);
-    write_c_str("\n");
-
-    write_c_str("Digits     : ");
-    output_element(&p_ctx->digits);
-    write_c_str("\n");
-
-    write_c_str("Whitespace : ");
-    output_element(&p_ctx->whitespace);
-    write_c_str("\n");
-
-    write_c_str("Punctuation: ");
-    output_element(&p_ctx->punctuation);
-    write_c_str("\n\n");
+    /* The report is formatted straight into the serial driver's transmit
+       buffer, and is either sent as a whole or not at all. */
+    if (E_FALSE == report_output(p_ctx)) {
+        bsp_error_trap();
+    }
 }
 
-static void output_element(Element_t *p_elem)
+#if STATISTICS_LATENCY_ENABLE
+/*
+ * Record the latency of the report that was just queued for the line ending
+ * at newline_stamp and output it with the latency distribution so far. The
+ * line is skipped if the transmit buffer has no room for it.
+ */
+static void output_latency(u32_t newline_stamp)
 {
-    static const char * const clamp_str = "+";
-
-    /* Since the count is clamped to 255, we only need to handle 4 characters of
-       data (1 for each digit plus NULL) */
-    char c_str_buffer[4] = { 0 };
-
-    /* convert from integer to c string */
-    num_to_c_str(p_elem->count, c_str_buffer);
-
-    /* Output the numerical data */
-    write_c_str(c_str_buffer);
-    if (p_elem->clamped) {
-        write_c_str(clamp_str);
+    const u32_t usec = (bsp_cycles_now() - newline_stamp) / BSP_CYCLES_PER_USEC;
+    char *p_line;
+    char *p_end;
+
+    histogram_add(&latency, usec);
+
+    p_line = (char*)bsp_serial_tx_reserve(LATENCY_MAX_LEN);
+    if (NULL_PTR != p_line) {
+        p_end = p_line;
+        p_end = append_c_str(p_end, "Latency us : ");
+        p_end = append_u32(p_end, usec);
+        p_end = append_c_str(p_end, " p50 ");
+        p_end = append_u32(p_end, histogram_percentile(&latency, 50u));
+        p_end = append_c_str(p_end, " p99 ");
+        p_end = append_u32(p_end, histogram_percentile(&latency, 99u));
+        p_end = append_c_str(p_end, " max ");
+        p_end = append_u32(p_end, latency.max);
+        p_end = append_c_str(p_end, "\n\n");
+
+        bsp_serial_tx_commit((size_t)(p_end - p_line));
     }
 }
 
-static void num_to_c_str(u8_t num, char * c_str)
+/*
+ * Append the decimal digits of num at p_dst. Returns the end of the appended
+ * text. No null terminator is written.
+ */
+static char* append_u32(char *p_dst, u32_t num)
 {
+    char   digits[10];
     size_t len;
-    size_t i;
-    u8_t   n;
-    u8_t   digit;
-    char   temp;
-
-    /* Exit early if the number is 0. */
-    if (0 == num) {
-        c_str[0] = '0';
-        c_str[1] = '\0';
-    } else {
-        /* This is a little inefficient since we go through two loops, but since the
-           number is limited to 3 digits, this is ok... for now.
-
-           This first loop parses the digits of num into characters and also
-           computes the length (number of digits) of the string. The parsing
-           puts the character representation of the digits in reverse order.
-
-           NOTE: The len variable is a little overloaded in this context. It is
-                 used as the index into the c_str and the length of the c_str.*/
-        n   = num;
-        len = 0;
-        while(n != 0) {
-            digit = n % 10;
-            c_str[len] = ascii_char_digit_to_ascii(digit);
-            len++;
-            n /= 10;
-        }
-
-        /* Reverse the characters in the C string so the digits display
-           correctly.
 
-           NOTE: Only need to traverse half the array for reversal. */
-        for (i = 0; i < len/2; i += 1) {
-            temp = c_str[len - (i + 1)];
-            c_str[len - (i + 1)] = c_str[i];
-            c_str[i]             = temp;
-
-        }
-
-        /* Null terminate the string */
-        c_str[len] = '\0';
+    /* Digits come out least significant first. */
+    len = 0;
+    do {
+        digits[len] = ascii_char_digit_to_ascii((u8_t)(num % 10u));
+        len += 1;
+        num /= 10u;
+    } while (0 != num);
+
+    while (0 != len) {
+        len -= 1;
+        *p_dst = digits[len];
+        p_dst += 1;
     }
+
+    return p_dst;
 }
 
-static void write_c_str(const char * const c_str)
+/*
+ * Copy c_str (without its null terminator) to p_dst. Returns the end of the
+ * copied text.
+ */
+static char* append_c_str(char *p_dst, const char * const c_str)
 {
     const char *curr;
 
     for (curr = c_str; *curr != '\0'; curr += 1) {
-        if (E_FALSE == bsp_serial_write(*curr)) {
-            bsp_error_trap();
-        }
+        *p_dst = *curr;
+        p_dst += 1;
     }
-}
\ No newline at end of file
+
+    return p_dst;
+}
+#endif
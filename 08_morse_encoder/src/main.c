@@ -15,6 +15,7 @@
 int main(void)
 {
     SwTimerHandle_t morse_interval_timer;
+    bool_t          busy;
 
     /* Initialize the hardware and software modules */
     bsp_init();             /* board support (e.g. the LED) */
@@ -31,18 +32,26 @@ int main(void)
         bsp_error_trap();
     }
 
-    /* Scheduler loop */
+    /* Scheduler loop. Sleep after a pass that found nothing to do. The next
+       morse task deadline (set by sw_timer_expired) or received data wakes
+       the core. */
     while (1) {
 
-        /* Constantly spin the string encoder process, so we don't miss any
-           bytes. */
-        string_encoder_process();
+        /* Spin the string encoder process until the receive buffer is empty,
+           so we don't miss any bytes. */
+        busy = string_encoder_process();
 
         /* Call the morse code task at the appropriate rate for morse code
-           output. */
-        if (MORSE_TASK_INTERVAL_MSEC == sw_timer_msec(morse_interval_timer)) {
+           output. The reset drops the timer's deadline, so go around once
+           more to set the next one before sleeping. */
+        if (E_TRUE == sw_timer_expired(morse_interval_timer, MORSE_TASK_INTERVAL_MSEC)) {
             morse_task();
             sw_timer_reset(morse_interval_timer);
+            busy = E_TRUE;
+        }
+
+        if (E_FALSE == busy) {
+            bsp_idle();
         }
     }
 
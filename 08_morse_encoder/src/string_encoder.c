@@ -5,6 +5,7 @@
 #include "utils/bytes.h"
 
 #define MAX_STRING_LEN 41 /* +1 to handle null terminator */
+#define RX_CHUNK_SIZE  16 /* received bytes handled per process call */
 
 static const char* ERROR_STRING = "\n\rERROR: Encoding already in progress!\n\r";
 
@@ -13,7 +14,7 @@ static u8_t   the_string[MAX_STRING_LEN];
 
 static void module_reset(void);
 static void handle_newline(void);
-static void handle_morse_byte(u8_t byte);
+static bool_t handle_morse_byte(u8_t byte);
 
 /**
  * @brief Initialize the string encoder and its internal data.
@@ -28,12 +29,25 @@ void string_encoder_init(void)
  * 
  * NOTE: This function should be called as often as possible to prevent serial
  *       port data loss.
+ *
+ * @retval E_TRUE  - a full chunk was handled, more bytes may be waiting
+ * @retval E_FALSE - the receive buffer was emptied
  */
-void string_encoder_process(void)
+bool_t string_encoder_process(void)
 {
-    u8_t rx_char;
+    u8_t   rx_bytes[RX_CHUNK_SIZE];
+    u8_t   echo[RX_CHUNK_SIZE];
+    size_t rx_len;
+    size_t echo_len;
+    size_t i;
+    u8_t   rx_char;
+
+    rx_len   = bsp_serial_read_buf(rx_bytes, sizeof(rx_bytes));
+    echo_len = 0;
+
+    for (i = 0; i < rx_len; i += 1) {
+        rx_char = rx_bytes[i];
 
-    if (E_TRUE == bsp_serial_read(&rx_char)) {
         switch(rx_char)
         {
             case '\0' :
@@ -67,10 +81,25 @@ void string_encoder_process(void)
             case '/'  :
             case '\r' : /* DO NOTHING*/             break; /* Ignore these characters */
 
-            case '\n': handle_newline();            break; /* Sentence terminator */
-            default:   handle_morse_byte(rx_char);  break; /* Characters we can encode. */
+            case '\n': /* Sentence terminator. Echo what came before it first. */
+                (void)bsp_serial_write_buf(echo, echo_len);
+                echo_len = 0;
+                handle_newline();
+                break;
+
+            default: /* Characters we can encode. */
+                if (E_TRUE == handle_morse_byte(rx_char)) {
+                    echo[echo_len] = rx_char;
+                    echo_len += 1;
+                }
+                break;
         }
     }
+
+    /* Echo the accepted characters in one write */
+    (void)bsp_serial_write_buf(echo, echo_len);
+
+    return (RX_CHUNK_SIZE == rx_len) ? E_TRUE : E_FALSE;
 }
 
 /**
@@ -86,14 +115,21 @@ static void module_reset(void)
  * @brief Enqueue a byte that is morse encode-able into the string buffer.
  * 
  * @param[in] byte morse encode-able byte
+ *
+ * @retval E_TRUE  - byte added to the string (the caller echoes it)
+ * @retval E_FALSE - string buffer is full, byte dropped
  */
-static void handle_morse_byte(u8_t byte)
+static bool_t handle_morse_byte(u8_t byte)
 {
+    bool_t accepted = E_FALSE;
+
     if (the_string_idx < (MAX_STRING_LEN-1)) {
-        bsp_serial_write(byte);             /* echo */
         the_string[the_string_idx] = byte;  /* add to our string */
         the_string_idx += 1;                /* move to the next element */
+        accepted = E_TRUE;
     }
+
+    return accepted;
 }
 
 /**
@@ -118,7 +154,8 @@ static void handle_newline(void)
        
        Remember to NULL terminate the string for the morse code task!! */
     if (E_TRUE == morse_task_is_encoding()) {
-        bsp_serial_write_c_str(ERROR_STRING);
+        /* The error jumps ahead of any echo still queued. */
+        bsp_serial_write_urgent_c_str(ERROR_STRING);
     } else {
         morse_task_encode((char*)the_string, E_FALSE);
     }
@@ -0,0 +1,384 @@
+#include "boot.h"
+
+#include "flash_stream.h"
+#include "bsp/bsp.h"
+#include "packet/crc32.h"
+#include "packet/packet.h"
+#include "types.h"
+
+/* Message lengths (command byte included) */
+#define START_LEN           (9u)
+#define DATA_HEADER_LEN     (5u)
+#define FINISH_LEN          (1u)
+#define RUN_LEN             (1u)
+#define RESPONSE_LEN        (6u)
+
+/* Longest message the bootloader takes */
+#define FRAME_MAX           (DATA_HEADER_LEN + BOOT_DATA_MAX)
+
+/* Bytes of an oversized received frame thrown away per packet_receive call */
+#define RX_DISCARD_LEN      (16u)
+
+/* Start of RAM. An application's initial stack pointer must be in RAM. */
+#define RAM_START           (0x20000000UL)
+
+/* Application flash (see STM32F103C8TX_BOOT.ld) and the end of RAM */
+extern u32_t ld__app_start;
+extern u32_t ld__app_end;
+extern u32_t ld__estack;
+
+typedef enum boot_state
+{
+    STATE_IDLE,         /* no upload in progress                     */
+    STATE_RECEIVING,    /* taking image bytes                        */
+    STATE_FINISHING,    /* image checked, waiting for the last pages */
+} BootState_t;
+
+static bool_t rx_ready(void);
+static void receive(void);
+static void handle(void);
+static void handle_start(void);
+static void handle_data(void);
+static void handle_finish(void);
+static void handle_run(void);
+static void finish_task(void);
+static void respond(u8_t cmd, BootStatus_t status);
+static u32_t get_le32(const u8_t * const p_bytes);
+
+static u8_t        rx_frame[FRAME_MAX];
+static size_t      rx_len;
+static bool_t      rx_overflow;
+static BootState_t state;
+static bool_t      host_seen;   /* a host has sent a good message          */
+static bool_t      image_ok;    /* the last upload finished and checked out */
+static bool_t      nak_sent;    /* the current gap has been reported       */
+static u32_t       expected;    /* image bytes received so far             */
+static u32_t       image_size;
+static u32_t       image_crc;
+static Crc32_t     crc;
+
+/**
+ * @brief Reset the bootloader protocol
+ *
+ * Call after bsp_init and packet_init.
+ */
+void boot_init(void)
+{
+    rx_len      = 0;
+    rx_overflow = E_FALSE;
+    state       = STATE_IDLE;
+    host_seen   = E_FALSE;
+    image_ok    = E_FALSE;
+
+    /* Polled before the restart into the application */
+    (void)bsp_serial_set_events(BSP_SERIAL_EVENT_TX_DRAINED, NULL_PTR);
+}
+
+/**
+ * @brief Run the bootloader
+ *
+ * Advances the flash programming and handles at most one received message.
+ * Call it from the main loop.
+ */
+void boot_task(void)
+{
+    flash_stream_task();
+
+    if (STATE_FINISHING == state) {
+        finish_task();
+    }
+
+    if (E_TRUE == rx_ready()) {
+        receive();
+    }
+}
+
+/**
+ * @brief Whether a host has talked to the bootloader since reset
+ *
+ * Once one has, the bootloader stays put until told to run the application.
+ */
+bool_t boot_host_seen(void)
+{
+    return host_seen;
+}
+
+/**
+ * @brief Whether the application flash holds a startable image
+ *
+ * The vector table must have an initial stack pointer in RAM and a thumb reset
+ * handler inside the application flash. The vector table is the last thing an
+ * upload writes (see flash_stream.h), so a partial upload fails this check.
+ */
+bool_t boot_app_is_valid(void)
+{
+    const u32_t app_start     = (u32_t)&ld__app_start;
+    const u32_t app_end       = (u32_t)&ld__app_end;
+    const u32_t * const p_vec = (const u32_t*)app_start;
+    const u32_t sp            = p_vec[0];
+    const u32_t pc            = p_vec[1];
+
+    return ((0u == (sp & 0x3u)) && (sp > RAM_START) && (sp <= (u32_t)&ld__estack)
+        && (0u != (pc & 0x1u)) && (pc >= app_start) && (pc < app_end)) ? E_TRUE : E_FALSE;
+}
+
+/**
+ * @brief Restart into the application
+ *
+ * The restart is a software reset, which bsp_early_startup below turns into a
+ * jump to the application before any hardware is set up. The application
+ * starts with the hardware in its reset state, as it would at power on.
+ */
+void boot_start_app(void)
+{
+    bsp_reset();
+}
+
+/**
+ * @brief Start the application after a software reset
+ *
+ * Runs before bsp_init (see crt0.c). Any other reset (power on, the reset pin,
+ * a watchdog) stays in the bootloader for BOOT_WAIT_MSEC so a host can take
+ * over. An application that resets itself with bsp_reset restarts directly.
+ */
+void bsp_early_startup(void)
+{
+    if ((BSP_RESET_SOFTWARE == bsp_reset_cause()) && (E_TRUE == boot_app_is_valid())) {
+        bsp_start_image((u32_t)&ld__app_start);
+    }
+}
+
+/* Whether to take the next message. While receiving, a DATA message is only
+   read once the flash stream can take all of it, so a message is never half
+   accepted. Until then the bytes wait in the serial receive buffer. */
+static bool_t rx_ready(void)
+{
+    const u32_t remaining = image_size - expected;
+    const size_t needed   = (remaining < BOOT_DATA_MAX) ? (size_t)remaining : BOOT_DATA_MAX;
+    bool_t ready = E_TRUE;
+
+    if ((STATE_RECEIVING == state) && (FLASH_STREAM_ERROR != flash_stream_state())) {
+        ready = (flash_stream_space() >= needed) ? E_TRUE : E_FALSE;
+    }
+
+    return ready;
+}
+
+/* Read (the rest of) a message and handle it once its CRC checks out */
+static void receive(void)
+{
+    u8_t       discard[RX_DISCARD_LEN];
+    PacketRx_t result;
+    size_t     len;
+
+    do {
+        if (rx_len < sizeof(rx_frame)) {
+            result  = packet_receive(&rx_frame[rx_len], sizeof(rx_frame) - rx_len, &len);
+            rx_len += len;
+        } else {
+            /* Longer than any message. Read it out to find its end. */
+            result = packet_receive(discard, RX_DISCARD_LEN, &len);
+            if (0u != len) {
+                rx_overflow = E_TRUE;
+            }
+        }
+
+        switch (result) {
+            case PACKET_RX_FRAME_OK:
+                if (0u != rx_len) {
+                    if (E_FALSE == rx_overflow) {
+                        handle();
+                    } else {
+                        respond(rx_frame[0], BOOT_STATUS_COMMAND);
+                    }
+                }
+                rx_len      = 0;
+                rx_overflow = E_FALSE;
+                break;
+            case PACKET_RX_FRAME_BAD:
+                /* Dropped. A lost DATA message shows up as a gap. */
+                rx_len      = 0;
+                rx_overflow = E_FALSE;
+                break;
+            case PACKET_RX_NONE:
+            case PACKET_RX_DATA:
+            default:
+                break;
+        }
+    } while (PACKET_RX_DATA == result);
+}
+
+static void handle(void)
+{
+    host_seen = E_TRUE;
+    bsp_toggle_builtin_led();
+
+    switch (rx_frame[0]) {
+        case BOOT_CMD_START:
+            handle_start();
+            break;
+        case BOOT_CMD_DATA:
+            handle_data();
+            break;
+        case BOOT_CMD_FINISH:
+            handle_finish();
+            break;
+        case BOOT_CMD_RUN:
+            handle_run();
+            break;
+        default:
+            respond(rx_frame[0], BOOT_STATUS_COMMAND);
+            break;
+    }
+}
+
+static void handle_start(void)
+{
+    const u32_t app_size = (u32_t)&ld__app_end - (u32_t)&ld__app_start;
+    u32_t size;
+
+    if (START_LEN != rx_len) {
+        respond(BOOT_CMD_START, BOOT_STATUS_COMMAND);
+    } else {
+        size = get_le32(&rx_frame[1]);
+        if ((0u == size) || (size > app_size)) {
+            respond(BOOT_CMD_START, BOOT_STATUS_SIZE);
+        } else if (E_FALSE == flash_stream_start((u32_t)&ld__app_start, size)) {
+            respond(BOOT_CMD_START, BOOT_STATUS_BUSY);
+        } else {
+            state      = STATE_RECEIVING;
+            image_ok   = E_FALSE;
+            image_size = size;
+            image_crc  = get_le32(&rx_frame[5]);
+            expected   = 0;
+            nak_sent   = E_FALSE;
+            crc32_init(&crc);
+
+            respond(BOOT_CMD_START, BOOT_STATUS_OK);
+        }
+    }
+}
+
+static void handle_data(void)
+{
+    u32_t  offset;
+    size_t len;
+
+    if (DATA_HEADER_LEN > rx_len) {
+        respond(BOOT_CMD_DATA, BOOT_STATUS_COMMAND);
+    } else if (STATE_RECEIVING != state) {
+        respond(BOOT_CMD_DATA, BOOT_STATUS_STATE);
+    } else if (FLASH_STREAM_ERROR == flash_stream_state()) {
+        respond(BOOT_CMD_DATA, BOOT_STATUS_FLASH);
+    } else {
+        offset = get_le32(&rx_frame[1]);
+        len    = rx_len - DATA_HEADER_LEN;
+
+        if (offset == expected) {
+            if (len == flash_stream_write(&rx_frame[DATA_HEADER_LEN], len)) {
+                crc32_update(&crc, &rx_frame[DATA_HEADER_LEN], len);
+                expected += len;
+                nak_sent  = E_FALSE;
+                respond(BOOT_CMD_DATA, BOOT_STATUS_OK);
+            } else {
+                /* rx_ready made room, so only an image longer than START
+                   said ends up here */
+                respond(BOOT_CMD_DATA, BOOT_STATUS_SIZE);
+            }
+        } else if (offset < expected) {
+            /* Sent again (e.g. after a host timeout). Already have it. */
+            respond(BOOT_CMD_DATA, BOOT_STATUS_OK);
+        } else if (E_FALSE == nak_sent) {
+            nak_sent = E_TRUE;
+            respond(BOOT_CMD_DATA, BOOT_STATUS_SEQUENCE);
+        } else {
+            /* Gap already reported. Drop until the host goes back. */
+        }
+    }
+}
+
+static void handle_finish(void)
+{
+    if (FINISH_LEN != rx_len) {
+        respond(BOOT_CMD_FINISH, BOOT_STATUS_COMMAND);
+    } else if (STATE_FINISHING == state) {
+        /* Repeated while the last pages are written. The response follows
+           when they are done. */
+    } else if (STATE_RECEIVING != state) {
+        respond(BOOT_CMD_FINISH, (E_FALSE != image_ok) ? BOOT_STATUS_OK : BOOT_STATUS_STATE);
+    } else if (E_FALSE == flash_stream_flush()) {
+        respond(BOOT_CMD_FINISH, (FLASH_STREAM_ERROR == flash_stream_state()) ?
+            BOOT_STATUS_FLASH : BOOT_STATUS_SIZE);
+    } else if (crc32_final(&crc) != image_crc) {
+        /* The first page is left erased, so the image never runs */
+        state = STATE_IDLE;
+        respond(BOOT_CMD_FINISH, BOOT_STATUS_CRC);
+    } else if (E_FALSE == flash_stream_commit()) {
+        state = STATE_IDLE;
+        respond(BOOT_CMD_FINISH, BOOT_STATUS_FLASH);
+    } else {
+        state = STATE_FINISHING;
+    }
+}
+
+static void handle_run(void)
+{
+    if (RUN_LEN != rx_len) {
+        respond(BOOT_CMD_RUN, BOOT_STATUS_COMMAND);
+    } else if ((STATE_FINISHING == state) || (E_FALSE == boot_app_is_valid())) {
+        respond(BOOT_CMD_RUN, BOOT_STATUS_NO_APP);
+    } else {
+        (void)bsp_serial_take_events();
+        respond(BOOT_CMD_RUN, BOOT_STATUS_OK);
+
+        /* Let the response go out first. The drained event comes when the
+           last byte is handed to the USART, and the spin covers sending it. */
+        while (0u == (bsp_serial_take_events() & BSP_SERIAL_EVENT_TX_DRAINED)) { }
+        bsp_spin_delay(1u);
+
+        boot_start_app();
+    }
+}
+
+/* Respond to FINISH once the last pages, the first page included, are in */
+static void finish_task(void)
+{
+    switch (flash_stream_state()) {
+        case FLASH_STREAM_IDLE:
+            state    = STATE_IDLE;
+            image_ok = E_TRUE;
+            respond(BOOT_CMD_FINISH, BOOT_STATUS_OK);
+            break;
+        case FLASH_STREAM_ERROR:
+            state = STATE_IDLE;
+            respond(BOOT_CMD_FINISH, BOOT_STATUS_FLASH);
+            break;
+        case FLASH_STREAM_BUSY:
+        default:
+            break;
+    }
+}
+
+static void respond(u8_t cmd, BootStatus_t status)
+{
+    u8_t msg[RESPONSE_LEN];
+
+    msg[0] = cmd;
+    msg[1] = (u8_t)status;
+    msg[2] = (u8_t)(expected);
+    msg[3] = (u8_t)(expected >> 8);
+    msg[4] = (u8_t)(expected >> 16);
+    msg[5] = (u8_t)(expected >> 24);
+
+    packet_send_begin();
+    packet_send(msg, sizeof(msg));
+    packet_send_end();
+}
+
+static u32_t get_le32(const u8_t * const p_bytes)
+{
+    return (u32_t)p_bytes[0]
+        | ((u32_t)p_bytes[1] << 8)
+        | ((u32_t)p_bytes[2] << 16)
+        | ((u32_t)p_bytes[3] << 24);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file boot.h
+ * @brief UART bootloader protocol
+ *
+ * Every message is one packet on USART1 (see packet/packet.h). The first byte
+ * is the command and multi-byte fields are little endian:
+ *
+ *      host -> bootloader
+ *          BOOT_CMD_START   u32 size, u32 crc   start an upload
+ *          BOOT_CMD_DATA    u32 offset, bytes   next bytes of the image
+ *          BOOT_CMD_FINISH                      check the CRC, write page 0
+ *          BOOT_CMD_RUN                         start the application
+ *
+ *      bootloader -> host (one response per command)
+ *          u8 command, u8 status, u32 offset
+ *
+ * The offset in a response is the number of image bytes received so far. The
+ * host keeps up to BOOT_WINDOW image bytes in flight past the last offset it
+ * was told, so the link stays busy while pages are erased and programmed. A
+ * DATA message that does not start at the expected offset (one before it was
+ * lost) gets a single BOOT_STATUS_SEQUENCE response and is dropped, as is
+ * everything after it, until the host goes back to the expected offset.
+ * Repeated DATA is acknowledged again and otherwise ignored.
+ *
+ * The crc is the CRC-32 of the image as computed by packet/crc32.h.
+ */
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Serial rate used by the bootloader */
+#define BOOT_BAUD           (460800u)
+
+/* Time to wait for a host after reset before starting the application */
+#define BOOT_WAIT_MSEC      (500u)
+
+/* Most image bytes in one BOOT_CMD_DATA message */
+#define BOOT_DATA_MAX       (256u)
+
+/* Image bytes the host may send past the last acknowledged offset. Must fit
+   in the USART1 receive buffer with the framing overhead, since the CPU
+   stalls while the flash is busy and only DMA keeps receiving. */
+#define BOOT_WINDOW         (1024u)
+
+typedef enum boot_cmd
+{
+    BOOT_CMD_START  = 0x01,
+    BOOT_CMD_DATA   = 0x02,
+    BOOT_CMD_FINISH = 0x03,
+    BOOT_CMD_RUN    = 0x04,
+} BootCmd_t;
+
+typedef enum boot_status
+{
+    BOOT_STATUS_OK = 0,     /* done                                     */
+    BOOT_STATUS_SEQUENCE,   /* DATA not at the expected offset          */
+    BOOT_STATUS_SIZE,       /* image too big, or incomplete at FINISH   */
+    BOOT_STATUS_CRC,        /* image CRC mismatch                       */
+    BOOT_STATUS_FLASH,      /* erase or program failed                  */
+    BOOT_STATUS_STATE,      /* command not valid right now              */
+    BOOT_STATUS_COMMAND,    /* unknown or malformed command             */
+    BOOT_STATUS_NO_APP,     /* no valid application to run              */
+    BOOT_STATUS_BUSY,       /* previous image still being written       */
+} BootStatus_t;
+
+void boot_init(void);
+void boot_task(void);
+bool_t boot_host_seen(void);
+bool_t boot_app_is_valid(void);
+void boot_start_app(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_H */
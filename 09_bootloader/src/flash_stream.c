@@ -0,0 +1,376 @@
+#include "flash_stream.h"
+
+#include "bsp/bsp.h"
+#include "utils/bytes.h"
+#include "types.h"
+
+#define PAGE_SIZE       (BSP_FLASH_PAGE_SIZE)
+#define PAGE_MASK       (PAGE_SIZE - 1u)
+#define HALVES_PER_PAGE (PAGE_SIZE / 2u)
+
+/* Page buffers. One holds the first page until commit and the other two take
+   turns being filled and written. */
+#define NUM_PAGES       (3u)
+
+/* A job for every page buffer plus the erase of the first page */
+#define NUM_JOBS        (NUM_PAGES + 1u)
+
+/* Job operations */
+#define JOB_ERASE       (0x1u)
+#define JOB_PROGRAM     (0x2u)
+
+/* Progress through the current job */
+typedef enum step
+{
+    STEP_START,         /* nothing started yet              */
+    STEP_ERASING,       /* page erase running               */
+    STEP_PROGRAMMING,   /* programming a burst at a time    */
+} Step_t;
+
+/* A page of flash to erase and/or program */
+typedef struct job
+{
+    u32_t addr;     /* start of the flash page                  */
+    u8_t  page;     /* page buffer to program it from           */
+    u8_t  ops;      /* JOB_ERASE and/or JOB_PROGRAM             */
+} Job_t;
+
+static bool_t claim_page(void);
+static void page_full(void);
+static void queue_job(u32_t addr, u8_t page, u8_t ops);
+static void job_done(void);
+static void fail(void);
+
+static u16_t  pages[NUM_PAGES][HALVES_PER_PAGE];
+static bool_t page_busy[NUM_PAGES];     /* queued, held or being written */
+
+static Job_t  jobs[NUM_JOBS];           /* FIFO of pages to write         */
+static size_t job_head;                 /* current job                    */
+static size_t job_count;                /* jobs queued (current included) */
+static Step_t step;                     /* progress through current job   */
+static size_t program_pos;              /* next half-word of its page     */
+
+static u32_t  image_addr;               /* flash address of the image     */
+static u32_t  image_size;               /* image length in bytes          */
+static u32_t  written;                  /* image bytes taken so far       */
+static u8_t   fill_page;                /* page buffer being filled       */
+static bool_t fill_valid;               /* whether fill_page is assigned  */
+static bool_t flushed;                  /* no more bytes will be taken    */
+static bool_t failed;                   /* a job failed                   */
+
+/**
+ * @brief Start streaming a new image
+ *
+ * Queues the erase of the image's first page.
+ *
+ * @param[in] addr page aligned flash address of the image
+ * @param[in] size image length in bytes
+ *
+ * @return E_FALSE if the previous image is still being written or the
+ * arguments are not usable.
+ */
+bool_t flash_stream_start(u32_t addr, u32_t size)
+{
+    bool_t result = E_FALSE;
+    size_t i;
+
+    if ((0u == job_count) && (0u == (addr & PAGE_MASK)) && (0u != size)) {
+        for (i = 0; i < NUM_PAGES; i += 1) {
+            page_busy[i] = E_FALSE;
+        }
+
+        job_head    = 0;
+        step        = STEP_START;
+        image_addr  = addr;
+        image_size  = size;
+        written     = 0;
+        fill_valid  = E_FALSE;
+        flushed     = E_FALSE;
+        failed      = E_FALSE;
+
+        queue_job(addr, 0u, JOB_ERASE);
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Number of bytes flash_stream_write takes right now
+ *
+ * The room left in the page being filled plus any free page buffers, up to
+ * the end of the image.
+ */
+size_t flash_stream_space(void)
+{
+    size_t space = 0;
+    size_t i;
+
+    if ((E_FALSE == failed) && (E_FALSE == flushed)) {
+        if (E_FALSE != fill_valid) {
+            space = PAGE_SIZE - (written & PAGE_MASK);
+        }
+
+        for (i = 0; i < NUM_PAGES; i += 1) {
+            if ((E_FALSE == page_busy[i]) && ((E_FALSE == fill_valid) || (fill_page != i))) {
+                space += PAGE_SIZE;
+            }
+        }
+
+        if (space > (image_size - written)) {
+            space = image_size - written;
+        }
+    }
+
+    return space;
+}
+
+/**
+ * @brief Add the next bytes of the image
+ *
+ * @param[in] p_bytes next bytes of the image
+ * @param[in] len     number of bytes
+ *
+ * @return Number of bytes taken (see flash_stream_space).
+ */
+size_t flash_stream_write(const u8_t * const p_bytes, size_t len)
+{
+    size_t taken = 0;
+    size_t offset;
+    size_t n;
+    size_t i;
+    u8_t  *p_page;
+
+    if ((E_FALSE != failed) || (E_FALSE != flushed)) {
+        len = 0;
+    } else if (len > (image_size - written)) {
+        len = image_size - written;
+    } else {
+        /* all of it fits in the image */
+    }
+
+    while ((taken < len) && ((E_FALSE != fill_valid) || (E_FALSE != claim_page()))) {
+        offset = written & PAGE_MASK;
+        n      = PAGE_SIZE - offset;
+        if (n > (len - taken)) {
+            n = len - taken;
+        }
+
+        /* The page buffers are half-words in flash byte order */
+        p_page = (u8_t*)pages[fill_page];
+        for (i = 0; i < n; i += 1) {
+            p_page[offset + i] = p_bytes[taken + i];
+        }
+
+        written += n;
+        taken   += n;
+
+        if (0u == (written & PAGE_MASK)) {
+            page_full();
+        }
+    }
+
+    return taken;
+}
+
+/**
+ * @brief Queue the image's last partial page
+ *
+ * The rest of the page is left erased (0xFF).
+ *
+ * @return E_FALSE if the whole image has not been written yet or a page
+ * failed.
+ */
+bool_t flash_stream_flush(void)
+{
+    bool_t result = E_FALSE;
+    size_t offset;
+
+    if ((E_FALSE == failed) && (written == image_size)) {
+        if (E_FALSE == flushed) {
+            offset = written & PAGE_MASK;
+            if ((E_FALSE != fill_valid) && (0u != offset)) {
+                bytes_set(&((u8_t*)pages[fill_page])[offset], PAGE_SIZE - offset, 0xFFu);
+                page_full();
+            }
+
+            flushed = E_TRUE;
+        }
+
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Queue the image's first page
+ *
+ * Only for an image that checked out: once the first page is written, the
+ * image's vector table is in place. The first page goes in after all the
+ * others, so the image is complete when flash_stream_state is back to
+ * FLASH_STREAM_IDLE.
+ *
+ * @return E_FALSE if the image was not flushed or a page failed.
+ */
+bool_t flash_stream_commit(void)
+{
+    bool_t result = E_FALSE;
+
+    if ((E_FALSE == failed) && (E_FALSE != flushed)) {
+        /* The first page was erased by the job flash_stream_start queued */
+        queue_job(image_addr, 0u, JOB_PROGRAM);
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Take the next step of erasing and programming
+ *
+ * Checks on a running erase or programs one burst of the current page. Call
+ * it from the main loop.
+ */
+void flash_stream_task(void)
+{
+    const Job_t * const p_job = &jobs[job_head];
+    BspFlashStatus_t status;
+    size_t n;
+
+    if ((0u != job_count) && (E_FALSE == failed)) {
+        switch (step) {
+            case STEP_START:
+                bsp_flash_unlock();
+                if (0u == (p_job->ops & JOB_ERASE)) {
+                    program_pos = 0;
+                    step        = STEP_PROGRAMMING;
+                } else if (E_TRUE == bsp_flash_erase_start(p_job->addr)) {
+                    step = STEP_ERASING;
+                } else {
+                    fail();
+                }
+                break;
+
+            case STEP_ERASING:
+                status = bsp_flash_status();
+                if (BSP_FLASH_ERROR == status) {
+                    fail();
+                } else if (BSP_FLASH_OK == status) {
+                    if (0u != (p_job->ops & JOB_PROGRAM)) {
+                        program_pos = 0;
+                        step        = STEP_PROGRAMMING;
+                    } else {
+                        job_done();
+                    }
+                } else {
+                    /* still erasing */
+                }
+                break;
+
+            case STEP_PROGRAMMING:
+                n = HALVES_PER_PAGE - program_pos;
+                if (n > FLASH_STREAM_BURST) {
+                    n = FLASH_STREAM_BURST;
+                }
+
+                status = bsp_flash_program(p_job->addr + (2u * program_pos),
+                    &pages[p_job->page][program_pos], n);
+                if (BSP_FLASH_OK == status) {
+                    program_pos += n;
+                    if (HALVES_PER_PAGE == program_pos) {
+                        job_done();
+                    }
+                } else {
+                    fail();
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Whether the queued pages are written
+ */
+FlashStreamState_t flash_stream_state(void)
+{
+    FlashStreamState_t state = FLASH_STREAM_IDLE;
+
+    if (E_FALSE != failed) {
+        state = FLASH_STREAM_ERROR;
+    } else if (0u != job_count) {
+        state = FLASH_STREAM_BUSY;
+    }
+
+    return state;
+}
+
+/* Pick a free page buffer to fill. The first one picked (buffer 0, for the
+   image's first page) stays held until commit. */
+static bool_t claim_page(void)
+{
+    size_t i;
+
+    for (i = 0; (i < NUM_PAGES) && (E_FALSE == fill_valid); i += 1) {
+        if (E_FALSE == page_busy[i]) {
+            fill_page  = (u8_t)i;
+            fill_valid = E_TRUE;
+        }
+    }
+
+    return fill_valid;
+}
+
+/* The page being filled is complete. Every page but the first is queued for
+   writing right away. */
+static void page_full(void)
+{
+    const u32_t page_addr = image_addr + ((written - 1u) & ~(u32_t)PAGE_MASK);
+
+    page_busy[fill_page] = E_TRUE;
+    fill_valid           = E_FALSE;
+
+    if (page_addr != image_addr) {
+        queue_job(page_addr, fill_page, JOB_ERASE | JOB_PROGRAM);
+    }
+}
+
+static void queue_job(u32_t addr, u8_t page, u8_t ops)
+{
+    Job_t * const p_job = &jobs[(job_head + job_count) % NUM_JOBS];
+
+    p_job->addr  = addr;
+    p_job->page  = page;
+    p_job->ops   = ops;
+    job_count   += 1u;
+}
+
+/* Hand the current job's page buffer back and move on to the next job */
+static void job_done(void)
+{
+    const Job_t * const p_job = &jobs[job_head];
+
+    if (0u != (p_job->ops & JOB_PROGRAM)) {
+        page_busy[p_job->page] = E_FALSE;
+    }
+
+    job_head   = (job_head + 1u) % NUM_JOBS;
+    job_count -= 1u;
+    step       = STEP_START;
+
+    if (0u == job_count) {
+        bsp_flash_lock();
+    }
+}
+
+/* Give up on the image. The flash is left locked and nothing more is
+   written until the next flash_stream_start. */
+static void fail(void)
+{
+    failed    = E_TRUE;
+    job_count = 0;
+    bsp_flash_lock();
+}
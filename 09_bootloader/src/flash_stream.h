@@ -0,0 +1,49 @@
+/**
+ * @file flash_stream.h
+ * @brief Stream an image into flash while it is still arriving
+ *
+ * Bytes are collected a page at a time in RAM. Each full page is queued, and
+ * flash_stream_task erases and programs it in small steps (one erase status
+ * check or one burst of FLASH_STREAM_BURST half-words per call) while the next
+ * page fills. The caller interleaves the task with its receiver, so erasing
+ * and programming overlap with reception.
+ *
+ * The image's first page (its vector table) is erased at the start and held
+ * in RAM until flash_stream_commit. An upload that never gets that far leaves
+ * no vector table behind, so a half written image is never started.
+ *
+ * The only hardware used is the BSP flash interface (bsp_flash_*), so the
+ * module also runs on a host against a simulated flash controller.
+ */
+#ifndef FLASH_STREAM_H
+#define FLASH_STREAM_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Half-words programmed per flash_stream_task call (~50 us each) */
+#define FLASH_STREAM_BURST  (32u)
+
+typedef enum flash_stream_state
+{
+    FLASH_STREAM_IDLE,      /* nothing queued                       */
+    FLASH_STREAM_BUSY,      /* pages queued or being written        */
+    FLASH_STREAM_ERROR,     /* a page failed to erase or program    */
+} FlashStreamState_t;
+
+bool_t flash_stream_start(u32_t addr, u32_t size);
+size_t flash_stream_space(void);
+size_t flash_stream_write(const u8_t * const p_bytes, size_t len);
+bool_t flash_stream_flush(void);
+bool_t flash_stream_commit(void);
+void flash_stream_task(void);
+FlashStreamState_t flash_stream_state(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_STREAM_H */
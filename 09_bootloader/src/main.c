@@ -0,0 +1,50 @@
+#include "boot.h"
+#include "bsp/bsp.h"
+#include "bsp/sw_timers.h"
+#include "packet/packet.h"
+#include "types.h"
+
+/**
+ * @brief UART bootloader
+ *
+ * Wait BOOT_WAIT_MSEC for a host on USART1. If none shows up and there is a
+ * valid application, start it. Otherwise take uploads (see boot.h) until the
+ * host says to run the application.
+ */
+int main(void)
+{
+    SwTimerHandle_t wait_timer;
+
+    /* Initialize the hardware and software modules */
+    bsp_init();             /* board support (e.g. the LED) */
+    packet_init();          /* framing on USART1 */
+    boot_init();            /* bootloader protocol */
+
+    if (E_FALSE == bsp_serial_set_baud(BOOT_BAUD, NULL_PTR, NULL_PTR)) {
+        bsp_error_trap();
+    }
+
+    /* enable interrupts */
+    bsp_enable_interrupts();
+
+    wait_timer = sw_timer_acquire();
+    if (SW_TIMER_NO_TIMER == wait_timer) {
+        bsp_error_trap();
+    }
+
+    /* The LED stays on while waiting for a host and blinks with traffic */
+    bsp_set_builtin_led(E_ON);
+
+    /* Scheduler loop */
+    while (1) {
+        boot_task();
+
+        if ((E_FALSE == boot_host_seen())
+            && (E_TRUE == sw_timer_expired(wait_timer, BOOT_WAIT_MSEC))
+            && (E_TRUE == boot_app_is_valid())) {
+            boot_start_app();
+        }
+    }
+
+    return 0; /* Satisfy compiler. Should never get here */
+}
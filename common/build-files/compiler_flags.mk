@@ -9,6 +9,7 @@
 #
 # Inputs:
 #   INC_FLAGS
+#   EXERCISE_FLAGS (optional exercise specific compiler flags)
 #   BINARY_DIR
 #   BINARY_NAME
 #
@@ -58,6 +59,9 @@ _COMPILE_FLAGS += -DSTM32F103xB
 # header path includes flags #
 _COMPILE_FLAGS += $(INC_FLAGS)
 
+# exercise specific flags (e.g. driver configuration overrides) #
+_COMPILE_FLAGS += $(EXERCISE_FLAGS)
+
 # C compiler flags #
 CFLAGS := $(_COMPILE_FLAGS)
 CFLAGS += -Wimplicit-function-declaration
@@ -80,6 +84,7 @@ ASFLAGS := $(_COMPILE_FLAGS)
 # linker flags #
 LDFLAGS := $(_COMMON_FLAGS)
 LDFLAGS += -T$(LDSCRIPT)
+LDFLAGS += -Lcommon/linker
 LDFLAGS += -Wl,-Map="$(BINARY_DIR)/$(BINARY_NAME).map"
 LDFLAGS += -Wl,-print-memory-usage
 LDFLAGS += -static
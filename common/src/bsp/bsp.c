@@ -3,9 +3,16 @@
 #include "stm32f1xx.h"
 
 #include "bsp/sw_timers.h"
+#include "bsp/private/crc/crc.h"
+#include "bsp/private/cycles/cycles.h"
+#include "bsp/private/deferred/deferred.h"
+#include "bsp/private/flash/flash.h"
 #include "bsp/private/gpio/gpio.h"
 #include "bsp/private/sys_tick/sys_tick.h"
+#include "bsp/private/tickless/tickless.h"
+#include "bsp/private/timebase/timebase.h"
 #include "bsp/private/uart/uart.h"
+#include "bsp/private/uart/uart_config.h"
 
 /* TODO come up with table driven scheme for GPIO */
 
@@ -17,19 +24,60 @@
 #define LED_ON_BIT      (E_BIT_0)
 #define LED_OFF_BIT     (E_BIT_1)
 
-/* Serial port definitions. */
-#define SERIAL_DEV          (USART1)
-
-/* GPIO definitions for USART 1 */
-#define SERIAL_PORT         (GPIOA)
-#define SERIAL_TX_PIN       (GPIO_PIN_9)
+/* GPIO definitions shared by the serial ports */
 #define SERIAL_TX_PIN_MODE  (GPIO_MODE_OUTPUT_50MHZ)
 #define SERIAL_TX_PIN_CONF  (GPIO_CONF_OUT_ALT_PUSH_PULL)
-#define SERIAL_RX_PIN       (GPIO_PIN_10)
 #define SERIAL_RX_PIN_MODE  (GPIO_MODE_INPUT)
 #define SERIAL_RX_PIN_CONF  (GPIO_CONF_IN_PUP_PUD)
+#define SERIAL_CTS_PIN_MODE (GPIO_MODE_INPUT)
+#define SERIAL_CTS_PIN_CONF (GPIO_CONF_IN_PUP_PUD)
+#define SERIAL_RTS_PIN_MODE (GPIO_MODE_OUTPUT_50MHZ)
+#define SERIAL_RTS_PIN_CONF (GPIO_CONF_OUT_GENERAL_PUSH_PULL)
+
+/* Port used by the bsp_serial_* functions without a port argument */
+#define SERIAL_DEFAULT_PORT (BSP_SERIAL_1)
+
+/**
+ * @brief Serial port hardware (default pin mapping, no remap)
+ */
+typedef struct serial_port_def
+{
+    USART_TypeDef *p_uart;
+    GPIO_TypeDef  *p_gpio;
+    GpioPin_t      tx_pin;
+    GpioPin_t      rx_pin;
+    GpioPin_t      cts_pin; /* only used with flow control */
+    GpioPin_t      rts_pin; /* only used with flow control */
+} SerialPortDef_t;
+
+static const SerialPortDef_t serial_ports[BSP_SERIAL_NUM_PORTS] =
+{
+    [BSP_SERIAL_1] = { USART1, GPIOA, GPIO_PIN_9,  GPIO_PIN_10, GPIO_PIN_11, GPIO_PIN_12 },
+    [BSP_SERIAL_2] = { USART2, GPIOA, GPIO_PIN_2,  GPIO_PIN_3,  GPIO_PIN_0,  GPIO_PIN_1  },
+    [BSP_SERIAL_3] = { USART3, GPIOB, GPIO_PIN_10, GPIO_PIN_11, GPIO_PIN_13, GPIO_PIN_14 },
+};
 
+/* The serial event flags are the UART driver's flags */
+static_assert(BSP_SERIAL_EVENT_RX_DATA    == UART_EVENT_RX_DATA,    "serial event mismatch");
+static_assert(BSP_SERIAL_EVENT_RX_LINE    == UART_EVENT_RX_LINE,    "serial event mismatch");
+static_assert(BSP_SERIAL_EVENT_TX_DRAINED == UART_EVENT_TX_DRAINED, "serial event mismatch");
+static_assert(BSP_SERIAL_TX_RESERVE_MAX   == UART_TX_RESERVE_MAX,   "serial reserve limit mismatch");
 
+/* The flash status is the flash driver's status */
+static_assert((int)BSP_FLASH_OK    == (int)FLASH_STATUS_OK,    "flash status mismatch");
+static_assert((int)BSP_FLASH_BUSY  == (int)FLASH_STATUS_BUSY,  "flash status mismatch");
+static_assert((int)BSP_FLASH_ERROR == (int)FLASH_STATUS_ERROR, "flash status mismatch");
+static_assert(BSP_FLASH_PAGE_SIZE  == FLASH_PAGE_SIZE,         "flash page size mismatch");
+
+/* Application event callback of each serial port */
+static volatile BspSerialEventCallback_t serial_event_cbs[BSP_SERIAL_NUM_PORTS];
+
+/* Application alarm callback and the deferred work item that runs it */
+static volatile IsrCallback_t alarm_cb;
+static DeferredWork_t         alarm_work;
+
+/* Application system tick callback */
+static volatile IsrCallback_t sys_tick_cb;
 
 /* Conversions for sys_tick configuration */
 #define SEC_PER_SEC     (1U)
@@ -37,6 +85,12 @@
 #define USEC_PER_SEC    (1000000U)
 
 static bool_t update_sys_tick_period(u32_t duration, u32_t conversion_factor);
+static USART_TypeDef* serial_dev(BspSerialPort_t port);
+static void serial_event_callback(u32_t id, u32_t events);
+static bool_t serial_data_pending(void);
+static void alarm_isr(void);
+static void alarm_deferred(void);
+static void sys_tick_isr(void);
 
 /**
  * @brief BSP initialization
@@ -54,20 +108,57 @@ void bsp_init(void)
         LED_PIN_CONF);
     bsp_set_builtin_led(E_OFF);
 
-    /* Configure the USART1 (serial port) GPIO. Enable the pull-up on the USART
-       RX pin. */
-    gpio_init(SERIAL_PORT);
-    gpio_set_mode(SERIAL_PORT, SERIAL_TX_PIN, SERIAL_TX_PIN_MODE,
-        SERIAL_TX_PIN_CONF);
-    gpio_set_mode(SERIAL_PORT, SERIAL_RX_PIN, SERIAL_RX_PIN_MODE,
-        SERIAL_RX_PIN_CONF);
-    gpio_write_pin(SERIAL_PORT, SERIAL_RX_PIN, E_BIT_1);
-    
-    /* Initialize the UART hardware. */
-    uart_init(SERIAL_DEV);
+    /* Deferred work must be ready before the drivers that post it */
+    deferred_init();
+
+    /* Start the cycle counter (see bsp_cycles_now) */
+    cycles_init();
+
+    /* Clock the CRC unit (see bsp_crc32_update) */
+    crc_init();
+
+    /* Configure the GPIO of each serial port the UART driver was built with
+       and initialize the UART hardware. Enable the pull-up on the USART RX
+       pin. */
+    for (size_t i = 0; i < BSP_SERIAL_NUM_PORTS; i += 1) {
+        const SerialPortDef_t * const p_def = &serial_ports[i];
+
+        if (E_TRUE == uart_is_enabled(p_def->p_uart)) {
+            gpio_init(p_def->p_gpio);
+            gpio_set_mode(p_def->p_gpio, p_def->tx_pin, SERIAL_TX_PIN_MODE,
+                SERIAL_TX_PIN_CONF);
+            gpio_set_mode(p_def->p_gpio, p_def->rx_pin, SERIAL_RX_PIN_MODE,
+                SERIAL_RX_PIN_CONF);
+            gpio_write_pin(p_def->p_gpio, p_def->rx_pin, E_BIT_1);
+
+            /* With flow control, CTS is an input (pulled up, so a missing
+               far end reads as "stop") and RTS starts out deasserted (high).
+               The UART driver asserts RTS when it is ready. */
+            if (E_TRUE == uart_has_flow_control(p_def->p_uart)) {
+                gpio_set_mode(p_def->p_gpio, p_def->cts_pin, SERIAL_CTS_PIN_MODE,
+                    SERIAL_CTS_PIN_CONF);
+                gpio_write_pin(p_def->p_gpio, p_def->cts_pin, E_BIT_1);
+                gpio_write_pin(p_def->p_gpio, p_def->rts_pin, E_BIT_1);
+                gpio_set_mode(p_def->p_gpio, p_def->rts_pin, SERIAL_RTS_PIN_MODE,
+                    SERIAL_RTS_PIN_CONF);
+            }
+
+            uart_init(p_def->p_uart);
+        }
+    }
 
     /* Initialize the system tick hardware */
     sys_tick_init();
+    sys_tick_cb = NULL_PTR;
+    sys_tick_set_callback(sys_tick_isr);
+
+    /* Start the microsecond clock (see bsp_time_us) before the software
+       timers that run on it. Its compare is shared by the alarm, the
+       emulated system tick and bsp_idle (see tickless.h). */
+    timebase_init();
+    alarm_cb   = NULL_PTR;
+    alarm_work = deferred_register(alarm_deferred);
+    tickless_init(alarm_isr, sys_tick_isr);
 
     /* Initialize the software timer facility */
     sw_timer_init();
@@ -84,6 +175,36 @@ void bsp_enable_interrupts(void)
     /* NOP for ARM processors */
 }
 
+/**
+ * @brief Mask interrupts (PRIMASK) and return the previous mask
+ *
+ * For short critical sections shared with interrupt handlers. Pairs nest, as
+ * each restore puts back the mask its save found:
+ *
+ *      const u32_t state = bsp_irq_save();
+ *      ...
+ *      bsp_irq_restore(state);
+ *
+ * @return State to pass to bsp_irq_restore.
+ */
+u32_t bsp_irq_save(void)
+{
+    const u32_t state = __get_PRIMASK();
+
+    __disable_irq();
+    return state;
+}
+
+/**
+ * @brief End a critical section started with bsp_irq_save
+ *
+ * @param[in] state value bsp_irq_save returned
+ */
+void bsp_irq_restore(u32_t state)
+{
+    __set_PRIMASK(state);
+}
+
 /**
  * @brief Toggle the board's builtin LED.
  */
@@ -108,21 +229,44 @@ void bsp_set_builtin_led(on_off_t led_state)
     gpio_write_pin(LED_PORT, LED_PIN, led_bit_state);
 }
 
+/**
+ * @brief Change the serial port's baud rate
+ *
+ * Bytes already queued for transmission are sent at the old rate first. A rate
+ * that can not be generated within the driver's error threshold is rejected
+ * and the old rate is kept. At the 72 MHz USART clock the fastest rate is
+ * 4.5 Mbaud, and rates that divide 72 MHz evenly (e.g. 1, 2, 3, 4 Mbaud) are
+ * exact.
+ *
+ * @param[in]  port        serial port
+ * @param[in]  baud        requested baud rate
+ * @param[out] p_actual    achieved baud rate (may be NULL)
+ * @param[out] p_error_ppm error of the achieved rate in parts per million
+ *                         (may be NULL)
+ *
+ * @retval E_TRUE  - baud rate changed
+ * @retval E_FALSE - baud rate rejected
+ */
+bool_t bsp_serial_port_set_baud(BspSerialPort_t port, u32_t baud, u32_t * const p_actual, s32_t * const p_error_ppm)
+{
+    return uart_set_baud(serial_dev(port), baud, p_actual, p_error_ppm);
+}
+
 /**
  * @brief Read a byte from the serial driver
  *
+ * @param[in]  port serial port
  * @param[out] byte output read from serial port
  *
  * @retval E_TRUE  - successfully read byte
  * @retval E_FALSE - unable to read byte
  */
-bool_t bsp_serial_read(u8_t * const byte)
+bool_t bsp_serial_port_read(BspSerialPort_t port, u8_t * const byte)
 {
     bool_t result;
 
     result = E_FALSE;
-    if ((NULL_PTR != byte) && (E_TRUE == uart_data_available(SERIAL_DEV))) {
-        *byte = uart_read(SERIAL_DEV);
+    if ((NULL_PTR != byte) && (1u == uart_read_buf(serial_dev(port), byte, 1u))) {
         result = E_TRUE;
     }
 
@@ -132,53 +276,602 @@ bool_t bsp_serial_read(u8_t * const byte)
 /**
  * @brief Write a byte to the serial driver
  *
+ * @param[in] port serial port
  * @param[in] byte input to write to UART
  *
  * @retval E_TRUE  - successfully write byte
  * @retval E_FALSE - unable to write byte
  */
-bool_t bsp_serial_write(u8_t byte)
+bool_t bsp_serial_port_write(BspSerialPort_t port, u8_t byte)
 {
-    return uart_write(SERIAL_DEV, byte);
+    return uart_write(serial_dev(port), byte);
 }
 
 /**
  * @brief Write a C-style string out the serial port.
  *
+ * @param[in] port serial port
  * @param[in] c_str null terminated string to output over serial
  *
  * @retval E_TRUE  - successfully wrote string to serial driver
  * @retval E_FALSE - serial driver encountered an error during write
  */
-bool_t bsp_serial_write_c_str(const char* c_str)
+bool_t bsp_serial_port_write_c_str(BspSerialPort_t port, const char* c_str)
+{
+    size_t len;
+    size_t written;
+
+    /* Find the string length up front, so the whole string can be handed to
+       the driver as a single buffer. */
+    len = 0;
+    while ('\0' != c_str[len]) {
+        len += 1;
+    }
+
+    /* If the driver could not take all of it, the rest of the string is not
+       sent. */
+    written = bsp_serial_port_write_buf(port, (const u8_t*)c_str, len);
+
+    return (written == len) ? E_TRUE : E_FALSE;
+}
+
+/**
+ * @brief Read up to len bytes from the serial driver
+ *
+ * @param[in]  port    serial port
+ * @param[out] p_bytes destination for the received bytes
+ * @param[in]  len     size of p_bytes
+ *
+ * @return The number of bytes read (0 if none are available).
+ */
+size_t bsp_serial_port_read_buf(BspSerialPort_t port, u8_t * const p_bytes, size_t len)
 {
-    const char *p_c;
-    bool_t      result;
+    size_t result;
+
+    result = 0;
+    if (NULL_PTR != p_bytes) {
+        result = uart_read_buf(serial_dev(port), p_bytes, len);
+    }
 
-    p_c    = c_str;
-    result = E_TRUE;
+    return result;
+}
 
-    while('\0' != *p_c) {
-        result = bsp_serial_write(*p_c);
-        p_c += 1;
+/**
+ * @brief Read up to len bytes and their arrival times from the serial driver
+ *
+ * Each byte comes with a stamp in the units of bsp_cycles_now, so
+ * (bsp_cycles_now() - stamp) is how long ago the byte arrived. Stamps have a
+ * resolution of 256 cycles and wrap with the cycle counter.
+ *
+ * Arrival times are only recorded when the UART driver is built with
+ * UART_RX_TIMESTAMP_ENABLE. Otherwise every byte is stamped with the time of
+ * the read, and the time spent in the receive buffer is not measured.
+ *
+ * @param[in]  port     serial port
+ * @param[out] p_bytes  destination for the received bytes
+ * @param[out] p_stamps destination for the stamp of each byte (same index)
+ * @param[in]  len      size of p_bytes and p_stamps
+ *
+ * @return The number of bytes read (0 if none are available).
+ */
+size_t bsp_serial_port_read_stamped(BspSerialPort_t port, u8_t * const p_bytes, u32_t * const p_stamps, size_t len)
+{
+    size_t result;
+
+    result = 0;
+    if ((NULL_PTR != p_bytes) && (NULL_PTR != p_stamps)) {
+        result = uart_read_stamped(serial_dev(port), p_bytes, p_stamps, len);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Write up to len bytes to the serial driver
+ *
+ * @param[in] port    serial port
+ * @param[in] p_bytes bytes to write to the UART
+ * @param[in] len     number of bytes in p_bytes
+ *
+ * @return The number of bytes queued. Bytes past that did not fit in the
+ * driver's transmit buffer and were not sent.
+ */
+size_t bsp_serial_port_write_buf(BspSerialPort_t port, const u8_t * const p_bytes, size_t len)
+{
+    size_t result;
+
+    result = 0;
+    if (NULL_PTR != p_bytes) {
+        result = uart_write_buf(serial_dev(port), p_bytes, len);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Write all len bytes to the serial driver or none of them
+ *
+ * @param[in] port    serial port
+ * @param[in] p_bytes bytes to write to the UART
+ * @param[in] len     number of bytes in p_bytes
+ *
+ * @retval E_TRUE  - all bytes queued
+ * @retval E_FALSE - bytes did not fit in the driver's transmit buffer (nothing
+ *                   was queued) or p_bytes is NULL
+ */
+bool_t bsp_serial_port_write_buf_all(BspSerialPort_t port, const u8_t * const p_bytes, size_t len)
+{
+    bool_t result;
+
+    result = E_FALSE;
+    if (NULL_PTR != p_bytes) {
+        result = uart_write_buf_all(serial_dev(port), p_bytes, len);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Room in the serial driver's transmit buffer
+ *
+ * A write of up to this many bytes made right after the call is queued in
+ * full.
+ *
+ * @param[in] port serial port
+ *
+ * @return Number of bytes that can be written (0 for a port that is not set
+ * up).
+ */
+size_t bsp_serial_port_tx_space(BspSerialPort_t port)
+{
+    return uart_tx_space(serial_dev(port));
+}
+
+/**
+ * @brief Reserve space in the serial driver's transmit buffer
+ *
+ * The caller formats its output directly into the returned region and then
+ * hands it to the transmitter with bsp_serial_port_tx_commit. A reservation is
+ * either granted in full or not at all, so a message is never half sent.
+ *
+ * @param[in] port serial port
+ * @param[in] len number of bytes to reserve
+ *
+ * @return Writable region of len bytes or NULL_PTR if the transmit buffer does
+ * not have room.
+ */
+u8_t* bsp_serial_port_tx_reserve(BspSerialPort_t port, size_t len)
+{
+    return uart_tx_reserve(serial_dev(port), len);
+}
+
+/**
+ * @brief Transmit the first n bytes of the last reservation
+ *
+ * @param[in] port serial port
+ * @param[in] n number of bytes written into the reservation
+ */
+void bsp_serial_port_tx_commit(BspSerialPort_t port, size_t n)
+{
+    uart_tx_commit(serial_dev(port), n);
+}
+
+/**
+ * @brief Write a short message ahead of all other queued output
+ *
+ * Urgent messages (e.g. errors) have their own transmit buffer and are sent
+ * as soon as the message currently on the line is finished, even while a long
+ * report is still queued. They are never mixed into the middle of another
+ * message. A message is queued as a whole or not at all.
+ *
+ * @param[in] port    serial port
+ * @param[in] p_bytes message bytes
+ * @param[in] len     number of bytes in p_bytes
+ *
+ * @retval E_TRUE  - message queued
+ * @retval E_FALSE - the urgent buffer had no room (nothing queued) or p_bytes
+ *                   is NULL
+ */
+bool_t bsp_serial_port_write_urgent(BspSerialPort_t port, const u8_t * const p_bytes, size_t len)
+{
+    bool_t result;
 
-        /* If an error occurs, don't bother sending the rest of the string. */
-        if (E_FALSE == result) {
+    result = E_FALSE;
+    if (NULL_PTR != p_bytes) {
+        result = uart_write_urgent(serial_dev(port), p_bytes, len);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Write a C-style string as an urgent message
+ *
+ * See bsp_serial_port_write_urgent.
+ *
+ * @param[in] port  serial port
+ * @param[in] c_str null terminated message
+ *
+ * @retval E_TRUE  - message queued
+ * @retval E_FALSE - the urgent buffer had no room (nothing queued)
+ */
+bool_t bsp_serial_port_write_urgent_c_str(BspSerialPort_t port, const char* c_str)
+{
+    size_t len;
+
+    len = 0;
+    while ('\0' != c_str[len]) {
+        len += 1;
+    }
+
+    return bsp_serial_port_write_urgent(port, (const u8_t*)c_str, len);
+}
+
+/**
+ * @brief Read the serial driver's buffer statistics.
+ *
+ * The receive statistics count bytes dropped by the receive interrupt
+ * (push_rejects) and the transmit statistics count bytes refused by
+ * bsp_serial_port_write and friends. The high-water marks are meant for sizing the
+ * driver's buffers. The transmit interrupt counters show the CPU cost of the
+ * transmit path.
+ *
+ * @param[in]  port    serial port
+ * @param[out] p_stats receive and transmit statistics
+ *
+ * @retval E_TRUE  - statistics copied out
+ * @retval E_FALSE - statistics are compiled out or p_stats is NULL
+ */
+bool_t bsp_serial_port_get_stats(BspSerialPort_t port, BspSerialStats_t * const p_stats)
+{
+    bool_t result;
+
+    result = E_FALSE;
+    if (NULL_PTR != p_stats) {
+        result = uart_get_stats(serial_dev(port), &p_stats->rx, &p_stats->tx);
+    }
+
+    if (E_TRUE == result) {
+        result = uart_get_irq_stats(serial_dev(port), &p_stats->tx_irqs,
+            &p_stats->tx_irq_cycles);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Read the serial port's receive error counters.
+ *
+ * Bytes counted here were lost or damaged on the way in. With flow control
+ * enabled, the dropped count should stay at 0.
+ *
+ * @param[in]  port     serial port
+ * @param[out] p_errors counts per error type since bsp_init
+ *
+ * @retval E_TRUE  - counters copied out
+ * @retval E_FALSE - the port is not set up or p_errors is NULL
+ */
+bool_t bsp_serial_port_get_errors(BspSerialPort_t port, BspSerialErrors_t * const p_errors)
+{
+    bool_t       result;
+    UartErrors_t errors;
+
+    result = E_FALSE;
+    if (NULL_PTR != p_errors) {
+        result = uart_get_errors(serial_dev(port), &errors);
+    }
+
+    if (E_TRUE == result) {
+        p_errors->overrun = errors.overrun;
+        p_errors->framing = errors.framing;
+        p_errors->noise   = errors.noise;
+        p_errors->dropped = errors.dropped;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Select the serial port events to raise and how to deliver them
+ *
+ * With a callback, cb runs from the deferred work handler (the lowest
+ * interrupt priority by default, see DEFERRED_IRQ_PRIO) each time one or more
+ * of the selected events were raised. It never runs inside the USART or DMA
+ * interrupts, but it does preempt the main loop.
+ *
+ * Without a callback (cb NULL), events collect until they are taken with
+ * bsp_serial_port_take_events or bsp_serial_port_wait_events. This lets the
+ * main loop sleep until the port has something for it.
+ *
+ * @param[in] port serial port
+ * @param[in] mask BSP_SERIAL_EVENT_* flags to raise (0 turns events off)
+ * @param[in] cb   event callback or NULL to poll
+ *
+ * @retval E_TRUE  - events configured
+ * @retval E_FALSE - the port is not set up
+ */
+bool_t bsp_serial_port_set_events(BspSerialPort_t port, u32_t mask, BspSerialEventCallback_t cb)
+{
+    bool_t result = E_FALSE;
+
+    if (BSP_SERIAL_NUM_PORTS > (u32_t)port) {
+        /* Turn the port's events off (which also discards any that are
+           pending) before the table entry changes, so the trampoline never
+           hands an event selected for the old callback to the new one. The
+           new mask goes on last. */
+        (void)uart_set_events(serial_dev(port), 0, NULL_PTR, (u32_t)port);
+        serial_event_cbs[port] = cb;
+        result = uart_set_events(serial_dev(port), mask,
+            (NULL_PTR != cb) ? serial_event_callback : NULL_PTR, (u32_t)port);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Take the serial port events raised since the last call
+ *
+ * @param[in] port serial port
+ *
+ * @return BSP_SERIAL_EVENT_* flags (0 if there are none).
+ */
+u32_t bsp_serial_port_take_events(BspSerialPort_t port)
+{
+    return uart_take_events(serial_dev(port));
+}
+
+/**
+ * @brief Sleep until a serial port event is raised
+ *
+ * The CPU waits for interrupts (WFI) until one of the events selected with
+ * bsp_serial_port_set_events is raised, then returns the raised events. Only
+ * for ports without an event callback, and at least one event must be
+ * selected or this never returns.
+ *
+ * @param[in] port serial port
+ *
+ * @return BSP_SERIAL_EVENT_* flags (never 0).
+ */
+u32_t bsp_serial_port_wait_events(BspSerialPort_t port)
+{
+    u32_t events;
+
+    /* With interrupts masked, an event raised between the check and the WFI
+       still wakes the core (a pending interrupt ends WFI even when masked).
+       The interrupt then runs when the mask is lifted. */
+    __disable_irq();
+    events = uart_take_events(serial_dev(port));
+    while (0 == events) {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+        events = uart_take_events(serial_dev(port));
+    }
+    __enable_irq();
+
+    return events;
+}
+
+/**
+ * @brief Turn the serial port's hardware loopback echo on or off
+ *
+ * While on, everything the port receives is sent straight back by DMA without
+ * passing through the CPU or the driver's buffers, and the read functions
+ * return no data. Needs a UART driver built with receive and transmit DMA
+ * (the default).
+ *
+ * @param[in] port   serial port
+ * @param[in] enable E_TRUE to echo, E_FALSE to stop echoing
+ *
+ * @retval E_TRUE  - echo turned on or off
+ * @retval E_FALSE - echo is not available on the port
+ */
+bool_t bsp_serial_port_set_echo(BspSerialPort_t port, bool_t enable)
+{
+    return uart_set_echo(serial_dev(port), enable);
+}
+
+/**
+ * @brief Bytes echoed by the serial port's loopback echo
+ *
+ * The count is free running and wraps, so sample it periodically and take
+ * the difference (e.g. once a second for the echo throughput).
+ *
+ * @param[in] port serial port
+ *
+ * @return Number of bytes echoed since bsp_init.
+ */
+u32_t bsp_serial_port_echo_count(BspSerialPort_t port)
+{
+    return uart_echo_count(serial_dev(port));
+}
+
+/**
+ * @brief Detect the serial port's baud rate from the far end
+ *
+ * Anything queued for transmission is sent first, then the receiver is turned
+ * off until the far end sends the sync character 0x80. The rate is measured
+ * from the character's low pulse (start bit plus 7 data bits) and the port is
+ * switched to it, or to the standard rate it is close to. The sync character
+ * is not received. Nothing may be written to the port until the detection
+ * has finished. Above about 2 Mbaud, the far end must pause for a character
+ * time after the sync character (see uart_autobaud_start).
+ *
+ * Only USART1 supports this, and only when the UART driver is built with
+ * UART1_AUTOBAUD_ENABLE.
+ *
+ * @param[in] port serial port
+ *
+ * @retval E_TRUE  - waiting for the sync character
+ * @retval E_FALSE - autobaud is not available on the port
+ */
+bool_t bsp_serial_port_autobaud_start(BspSerialPort_t port)
+{
+    return uart_autobaud_start(serial_dev(port));
+}
+
+/**
+ * @brief Check on the serial port's baud rate detection
+ *
+ * @param[in]  port        serial port
+ * @param[out] p_detected  baud rate measured on the line (may be NULL)
+ * @param[out] p_actual    baud rate the port now runs at (may be NULL)
+ * @param[out] p_error_ppm error of the port's rate relative to the measured
+ *                         rate in parts per million (may be NULL)
+ *
+ * @return Detection state. The rates are 0 until the state is
+ * BSP_SERIAL_AUTOBAUD_LOCKED or BSP_SERIAL_AUTOBAUD_FAILED.
+ */
+BspSerialAutobaud_t bsp_serial_port_autobaud_status(BspSerialPort_t port, u32_t * const p_detected, u32_t * const p_actual, s32_t * const p_error_ppm)
+{
+    BspSerialAutobaud_t result;
+
+    switch (uart_autobaud_status(serial_dev(port), p_detected, p_actual, p_error_ppm)) {
+        case UART_AUTOBAUD_WAITING:
+            result = BSP_SERIAL_AUTOBAUD_WAITING;
+            break;
+        case UART_AUTOBAUD_LOCKED:
+            result = BSP_SERIAL_AUTOBAUD_LOCKED;
+            break;
+        case UART_AUTOBAUD_FAILED:
+            result = BSP_SERIAL_AUTOBAUD_FAILED;
+            break;
+        case UART_AUTOBAUD_OFF:
+        default:
+            result = BSP_SERIAL_AUTOBAUD_OFF;
             break;
-        }
     }
 
     return result;
 }
 
+/*
+ * Default port versions of the serial functions. These operate on
+ * SERIAL_DEFAULT_PORT (USART1). See the bsp_serial_port_* functions for
+ * details.
+ */
+bool_t bsp_serial_set_baud(u32_t baud, u32_t * const p_actual, s32_t * const p_error_ppm)
+{
+    return bsp_serial_port_set_baud(SERIAL_DEFAULT_PORT, baud, p_actual, p_error_ppm);
+}
+
+bool_t bsp_serial_read(u8_t * const byte)
+{
+    return bsp_serial_port_read(SERIAL_DEFAULT_PORT, byte);
+}
+
+bool_t bsp_serial_write(u8_t byte)
+{
+    return bsp_serial_port_write(SERIAL_DEFAULT_PORT, byte);
+}
+
+bool_t bsp_serial_write_c_str(const char* c_str)
+{
+    return bsp_serial_port_write_c_str(SERIAL_DEFAULT_PORT, c_str);
+}
+
+size_t bsp_serial_read_buf(u8_t * const p_bytes, size_t len)
+{
+    return bsp_serial_port_read_buf(SERIAL_DEFAULT_PORT, p_bytes, len);
+}
+
+size_t bsp_serial_read_stamped(u8_t * const p_bytes, u32_t * const p_stamps, size_t len)
+{
+    return bsp_serial_port_read_stamped(SERIAL_DEFAULT_PORT, p_bytes, p_stamps, len);
+}
+
+size_t bsp_serial_write_buf(const u8_t * const p_bytes, size_t len)
+{
+    return bsp_serial_port_write_buf(SERIAL_DEFAULT_PORT, p_bytes, len);
+}
+
+bool_t bsp_serial_write_buf_all(const u8_t * const p_bytes, size_t len)
+{
+    return bsp_serial_port_write_buf_all(SERIAL_DEFAULT_PORT, p_bytes, len);
+}
+
+size_t bsp_serial_tx_space(void)
+{
+    return bsp_serial_port_tx_space(SERIAL_DEFAULT_PORT);
+}
+
+u8_t* bsp_serial_tx_reserve(size_t len)
+{
+    return bsp_serial_port_tx_reserve(SERIAL_DEFAULT_PORT, len);
+}
+
+void bsp_serial_tx_commit(size_t n)
+{
+    bsp_serial_port_tx_commit(SERIAL_DEFAULT_PORT, n);
+}
+
+bool_t bsp_serial_write_urgent(const u8_t * const p_bytes, size_t len)
+{
+    return bsp_serial_port_write_urgent(SERIAL_DEFAULT_PORT, p_bytes, len);
+}
+
+bool_t bsp_serial_write_urgent_c_str(const char* c_str)
+{
+    return bsp_serial_port_write_urgent_c_str(SERIAL_DEFAULT_PORT, c_str);
+}
+
+bool_t bsp_serial_get_stats(BspSerialStats_t * const p_stats)
+{
+    return bsp_serial_port_get_stats(SERIAL_DEFAULT_PORT, p_stats);
+}
+
+bool_t bsp_serial_get_errors(BspSerialErrors_t * const p_errors)
+{
+    return bsp_serial_port_get_errors(SERIAL_DEFAULT_PORT, p_errors);
+}
+
+bool_t bsp_serial_set_events(u32_t mask, BspSerialEventCallback_t cb)
+{
+    return bsp_serial_port_set_events(SERIAL_DEFAULT_PORT, mask, cb);
+}
+
+u32_t bsp_serial_take_events(void)
+{
+    return bsp_serial_port_take_events(SERIAL_DEFAULT_PORT);
+}
+
+u32_t bsp_serial_wait_events(void)
+{
+    return bsp_serial_port_wait_events(SERIAL_DEFAULT_PORT);
+}
+
+bool_t bsp_serial_set_echo(bool_t enable)
+{
+    return bsp_serial_port_set_echo(SERIAL_DEFAULT_PORT, enable);
+}
+
+u32_t bsp_serial_echo_count(void)
+{
+    return bsp_serial_port_echo_count(SERIAL_DEFAULT_PORT);
+}
+
+bool_t bsp_serial_autobaud_start(void)
+{
+    return bsp_serial_port_autobaud_start(SERIAL_DEFAULT_PORT);
+}
+
+BspSerialAutobaud_t bsp_serial_autobaud_status(u32_t * const p_detected, u32_t * const p_actual, s32_t * const p_error_ppm)
+{
+    return bsp_serial_port_autobaud_status(SERIAL_DEFAULT_PORT, p_detected, p_actual, p_error_ppm);
+}
+
 /**
  * @brief Set the BSP's system tick interrupt callback.
  *
+ * With TICKLESS_SYS_TICK (the default), the tick is emulated on the
+ * microsecond clock's compare and cb runs in the TIM2 interrupt. Otherwise it
+ * runs in the SysTick interrupt. Both are the lowest priority.
+ *
  * @param[in] cb user supplied callback to handle BSP system tick interrupts.
  */
 void bsp_register_sys_tick_callback(IsrCallback_t cb)
 {
-    sys_tick_set_callback(cb);
+    sys_tick_cb = cb;
 }
 
 /**
@@ -220,6 +913,247 @@ bool_t bsp_set_sys_tick_period_sec(u32_t sec)
     return update_sys_tick_period(sec, SEC_PER_SEC);
 }
 
+/**
+ * @brief Current value of the free running CPU cycle counter
+ *
+ * Counts at F_CPU_HZ (BSP_CYCLES_PER_USEC per microsecond) and wraps every
+ * 2^32 cycles (~59 seconds at 72MHz). Differences of readings less than a
+ * wrap apart are exact with unsigned math.
+ */
+u32_t bsp_cycles_now(void)
+{
+    return cycles_now();
+}
+
+/**
+ * @brief Microseconds since bsp_init
+ *
+ * The system's clock for measuring time, also used by the software timers.
+ * Wraps every 2^32 microseconds (~71.6 minutes). Differences of readings less
+ * than a wrap apart are exact with unsigned math. Safe to call from interrupt
+ * handlers. Use bsp_cycles_now for CPU cycle counts.
+ *
+ * @return The low 32 bits of bsp_time_us64.
+ */
+u32_t bsp_time_us(void)
+{
+    return timebase_now();
+}
+
+/**
+ * @brief Microseconds since bsp_init, without wrapping
+ *
+ * Same clock as bsp_time_us, extended to 64 bits. Costs a short critical
+ * section. Safe to call from interrupt handlers and with interrupts masked.
+ */
+u64_t bsp_time_us64(void)
+{
+    return timebase_now64();
+}
+
+/**
+ * @brief Set the function to call when the alarm goes off
+ *
+ * cb runs from the deferred work handler (the lowest interrupt priority by
+ * default, see DEFERRED_IRQ_PRIO), never inside the timer interrupt. It does
+ * preempt the main loop.
+ *
+ * @param[in] cb alarm callback
+ */
+void bsp_register_alarm_callback(IsrCallback_t cb)
+{
+    alarm_cb = cb;
+}
+
+/**
+ * @brief Set the alarm to go off at a time, replacing any earlier setting
+ *
+ * There is one alarm for the whole system. It shares the compare on the
+ * microsecond clock with the system tick and bsp_idle (see tickless.h). It
+ * goes off once. A time that has already passed goes off right away.
+ *
+ * @param[in] at_us bsp_time_us value to go off at, less than 2^31 us ahead
+ */
+void bsp_set_alarm(u32_t at_us)
+{
+    tickless_set_alarm(at_us);
+}
+
+/**
+ * @brief Disarm the alarm.
+ */
+void bsp_cancel_alarm(void)
+{
+    tickless_cancel_alarm();
+}
+
+/**
+ * @brief Sleep until there is something to do
+ *
+ * Meant to be called once per pass of the main loop, after the loop has done
+ * all the work it found. The core sleeps (WFI) until the next interrupt. The
+ * one compare on the microsecond clock is set for the earliest of the system
+ * tick, the alarm and the deadlines the software timers are being checked
+ * against (see sw_timer_expired), so the core is woken when one of them is
+ * due and not in between.
+ *
+ * Does not sleep if a BSP callback (system tick, alarm or serial event) ran
+ * since the previous call, or if a serial port has received data the loop has
+ * not read yet, since either may have left work for the loop. Other
+ * interrupts end the sleep, but one that runs just before this call does not
+ * stop it.
+ */
+void bsp_idle(void)
+{
+    u64_t  at = 0u;
+    u64_t  now;
+    u64_t  wait;
+    bool_t has_deadline;
+    u32_t  state;
+
+    /* The compare takes a 32 bit time less than 2^31 us ahead. A deadline
+       further out wakes the core early and the loop goes around once more. */
+    has_deadline = sw_timer_next_deadline(&at);
+    if (E_TRUE == has_deadline) {
+        now  = timebase_now64();
+        wait = (at > now) ? (at - now) : 0u;
+        if (TICKLESS_MAX_WAIT_US < wait) {
+            wait = TICKLESS_MAX_WAIT_US;
+        }
+        at = now + wait;
+    }
+
+    /* Data that arrives after the check raises an interrupt, which is left
+       pending and ends the sleep. */
+    state = bsp_irq_save();
+    if (E_FALSE == serial_data_pending()) {
+        tickless_idle(has_deadline, (u32_t)at);
+    }
+    bsp_irq_restore(state);
+}
+
+/**
+ * @brief Read and restart the bsp_idle statistics
+ *
+ * The counts cover the time since the previous call (or bsp_init). Take them
+ * at least once every 2^32 us (~71.6 minutes) for elapsed_us to be right.
+ *
+ * @param[out] p_stats statistics
+ *
+ * @retval E_TRUE  - statistics read
+ * @retval E_FALSE - p_stats is NULL
+ */
+bool_t bsp_idle_take_stats(BspIdleStats_t * const p_stats)
+{
+    bool_t          result = E_FALSE;
+    TicklessStats_t stats;
+
+    if (NULL_PTR != p_stats) {
+        tickless_take_stats(&stats);
+        p_stats->elapsed_us = stats.elapsed_us;
+        p_stats->asleep_us  = stats.asleep_us;
+        p_stats->sleeps     = stats.sleeps;
+        p_stats->wakeups    = stats.wakeups;
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Set the running value of the CRC unit
+ *
+ * The CRC unit has a single running value. Code that interleaves several CRC
+ * streams saves the value bsp_crc32_update returned for each stream and loads
+ * it back before continuing that stream. Loading 0xFFFFFFFF starts a new one.
+ *
+ * @param[in] crc running value to continue from
+ */
+void bsp_crc32_load(u32_t crc)
+{
+    crc_load(crc);
+}
+
+/**
+ * @brief Feed one word to the CRC unit
+ *
+ * CRC-32 with polynomial 0x04C11DB7, most significant bit first, with no
+ * reflection and no final XOR.
+ *
+ * @param[in] word next 32 bits of the stream
+ *
+ * @return The running CRC including word.
+ */
+u32_t bsp_crc32_update(u32_t word)
+{
+    return crc_update(word);
+}
+
+/**
+ * @brief Unlock the flash for erasing and programming
+ *
+ * Leave it locked whenever it is not being written, so a stray write cannot
+ * change it.
+ */
+void bsp_flash_unlock(void)
+{
+    flash_unlock();
+}
+
+/**
+ * @brief Lock the flash against erasing and programming.
+ */
+void bsp_flash_lock(void)
+{
+    flash_lock();
+}
+
+/**
+ * @brief State of the last flash erase or program operation
+ *
+ * A failure is reported once.
+ *
+ * @return BSP_FLASH_BUSY while the operation runs, then BSP_FLASH_OK or
+ * BSP_FLASH_ERROR.
+ */
+BspFlashStatus_t bsp_flash_status(void)
+{
+    return (BspFlashStatus_t)flash_status();
+}
+
+/**
+ * @brief Start erasing a flash page
+ *
+ * The erase runs on its own (tens of milliseconds). Poll bsp_flash_status for
+ * the result. Code running from flash stalls while it runs, but DMA carries on.
+ *
+ * @param[in] addr any address in the page
+ *
+ * @return E_FALSE if the flash is busy or addr is not in flash.
+ */
+bool_t bsp_flash_erase_start(u32_t addr)
+{
+    return flash_erase_start(addr);
+}
+
+/**
+ * @brief Program a burst of half-words into erased flash
+ *
+ * Blocks for the burst (tens of microseconds per half-word). Every half-word
+ * is read back. Erased (0xFFFF) half-words are skipped.
+ *
+ * @param[in] addr   half-word aligned address of the first half-word
+ * @param[in] p_half half-words to program
+ * @param[in] n      number of half-words
+ *
+ * @return BSP_FLASH_OK if all n half-words were programmed, BSP_FLASH_BUSY if
+ * an erase is still running, otherwise BSP_FLASH_ERROR.
+ */
+BspFlashStatus_t bsp_flash_program(u32_t addr, const u16_t * const p_half, size_t n)
+{
+    return (BspFlashStatus_t)flash_program(addr, p_half, n);
+}
+
 /**
  * @brief Busy loop (blocking) delay
  *
@@ -236,6 +1170,75 @@ void bsp_spin_delay(size_t iter)
     }
 }
 
+/**
+ * @brief Reset the processor
+ *
+ * A software reset. The reset cause (RCC_CSR) tells it apart from a power on
+ * or pin reset.
+ */
+void bsp_reset(void)
+{
+    NVIC_SystemReset();
+}
+
+/**
+ * @brief Cause of the last reset
+ *
+ * Reads and clears the reset flags, so it answers once per reset. When several
+ * flags are set (a power on reset also sets the pin flag), the most specific
+ * one wins.
+ *
+ * Only touches the reset flags, so it can be called from bsp_early_startup.
+ *
+ * @return Cause of the last reset.
+ */
+BspResetCause_t bsp_reset_cause(void)
+{
+    BspResetCause_t cause = BSP_RESET_PIN;
+    u32_t csr;
+
+    csr = RCC->CSR;
+    RCC->CSR |= RCC_CSR_RMVF;
+
+    if (0u != (csr & RCC_CSR_SFTRSTF)) {
+        cause = BSP_RESET_SOFTWARE;
+    } else if (0u != (csr & (RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF))) {
+        cause = BSP_RESET_WATCHDOG;
+    } else if (0u != (csr & (RCC_CSR_PORRSTF | RCC_CSR_LPWRRSTF))) {
+        cause = BSP_RESET_POWER;
+    }
+
+    return cause;
+}
+
+/**
+ * @brief Start another image through its vector table
+ *
+ * Points VTOR at the image's vector table, loads the image's initial stack
+ * pointer and branches to its reset handler. Does not return.
+ *
+ * The image's startup code expects the hardware in its reset state, so this
+ * is meant to be called from bsp_early_startup, before bsp_init.
+ *
+ * @param[in] addr address of the image's vector table
+ */
+void bsp_start_image(u32_t addr)
+{
+    const u32_t * const p_vectors = (const u32_t*)addr;
+
+    SCB->VTOR = addr;
+
+    /* Both values are in registers before the stack moves */
+    __asm volatile (
+        "msr msp, %0\n"
+        "bx  %1\n"
+        :
+        : "r" (p_vectors[0]), "r" (p_vectors[1])
+        : "memory");
+
+    while (1) { }
+}
+
 /**
  * @brief Fatal error trap
  *
@@ -262,8 +1265,28 @@ static bool_t update_sys_tick_period(u32_t duration, u32_t conversion_factor)
 {
     bool_t result;
     u32_t  conversion;
+#if 0 == TICKLESS_SYS_TICK
     u32_t  ticks;
+#endif
+
+#if 0 != TICKLESS_SYS_TICK
+    /* The emulated tick counts microseconds. A duration of 0, a conversion
+       factor of 0 or above USEC_PER_SEC and a period the compare cannot reach
+       fail and leave the tick alone. */
+    if (0 == conversion_factor) {
+        conversion = 0;
+    } else {
+        conversion = USEC_PER_SEC / conversion_factor;
+    }
 
+    if ((0 == duration) || (0 == conversion)) {
+        result = E_FALSE;
+    } else if ((TICKLESS_MAX_WAIT_US / conversion) >= duration) {
+        result = tickless_set_tick_period(duration * conversion);
+    } else {
+        result = E_FALSE;
+    }
+#else
     /* Compute the conversion from CPU frequency to ticks for the provided
        conversion factor. To prevent a divide by 0 error, that case forces the
        conversion to evaluate to 0, so later logic can terminate gracefully. */
@@ -299,5 +1322,80 @@ static bool_t update_sys_tick_period(u32_t duration, u32_t conversion_factor)
     /* Even if the period update failed, re-enable the system tick. If the it is
        already running, this will do nothing. */
     sys_tick_enable(E_ENABLE);
+#endif
+
     return result;
-}
\ No newline at end of file
+}
+
+/*
+ * Map a serial port to its USART. An invalid port maps to NULL_PTR, which the
+ * UART driver treats as a port that is not compiled in.
+ */
+static USART_TypeDef* serial_dev(BspSerialPort_t port)
+{
+    return (BSP_SERIAL_NUM_PORTS > (u32_t)port) ? serial_ports[port].p_uart : NULL_PTR;
+}
+
+/*
+ * UART driver event callback shared by all ports. The driver passes the port
+ * back as the id given to uart_set_events.
+ */
+static void serial_event_callback(u32_t id, u32_t events)
+{
+    const BspSerialEventCallback_t cb = serial_event_cbs[id];
+
+    if (NULL_PTR != cb) {
+        cb((BspSerialPort_t)id, events);
+    }
+
+    tickless_wake();
+}
+
+/*
+ * E_TRUE if any serial port has received data that has not been read.
+ */
+static bool_t serial_data_pending(void)
+{
+    bool_t pending = E_FALSE;
+
+    for (size_t i = 0; (i < BSP_SERIAL_NUM_PORTS) && (E_FALSE == pending); i += 1) {
+        pending = uart_data_available(serial_ports[i].p_uart);
+    }
+
+    return pending;
+}
+
+/*
+ * The alarm interrupt hands the callback to the deferred work handler.
+ */
+static void alarm_isr(void)
+{
+    deferred_post(alarm_work);
+}
+
+static void alarm_deferred(void)
+{
+    const IsrCallback_t cb = alarm_cb;
+
+    if (NULL_PTR != cb) {
+        cb();
+    }
+
+    tickless_wake();
+}
+
+/*
+ * System tick, from the SysTick interrupt or the emulated tick (see
+ * TICKLESS_SYS_TICK). Either way the main loop gets to look at what the
+ * callback did before bsp_idle sleeps again.
+ */
+static void sys_tick_isr(void)
+{
+    const IsrCallback_t cb = sys_tick_cb;
+
+    if (NULL_PTR != cb) {
+        cb();
+    }
+
+    tickless_wake();
+}
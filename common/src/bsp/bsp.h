@@ -6,22 +6,190 @@ extern "C" {
 #endif
 
 #include "types.h"
+#include "utils/ring_stats.h"
 
+/*
+ * Serial ports. BSP_SERIAL_n is USARTn on its default pins:
+ *
+ *  port 1: TX PA9,  RX PA10
+ *  port 2: TX PA2,  RX PA3
+ *  port 3: TX PB10, RX PB11
+ *
+ * Only ports with buffers in the UART driver's configuration are set up by
+ * bsp_init. Calls on the other ports fail.
+ */
+typedef enum bsp_serial_port
+{
+    BSP_SERIAL_1 = 0,
+    BSP_SERIAL_2,
+    BSP_SERIAL_3,
+    BSP_SERIAL_NUM_PORTS,
+} BspSerialPort_t;
+
+/*
+ * Serial driver buffer statistics. Only populated when the ring statistics are
+ * compiled in (see utils/ring_stats.h).
+ */
+typedef struct bsp_serial_stats
+{
+    RingStats_t rx;             /* receive ring                              */
+    RingStats_t tx;             /* transmit ring                             */
+    u32_t       tx_irqs;        /* interrupts serviced for the transmitter   */
+    u32_t       tx_irq_cycles;  /* CPU cycles spent in those interrupts      */
+} BspSerialStats_t;
+
+/*
+ * Serial receive error counters.
+ */
+typedef struct bsp_serial_errors
+{
+    u32_t overrun;  /* bytes lost in the USART before they were read      */
+    u32_t framing;  /* bytes with a missing stop bit (baud rate mismatch) */
+    u32_t noise;    /* bytes received with noise on the line              */
+    u32_t dropped;  /* bytes lost because the receive buffer was full     */
+} BspSerialErrors_t;
+
+/*
+ * Serial port events (see bsp_serial_port_set_events).
+ */
+#define BSP_SERIAL_EVENT_RX_DATA    (0x1UL) /* received bytes are ready to read */
+#define BSP_SERIAL_EVENT_RX_LINE    (0x2UL) /* a '\n' was received              */
+#define BSP_SERIAL_EVENT_TX_DRAINED (0x4UL) /* everything queued has been sent  */
+
+typedef void (*BspSerialEventCallback_t)(BspSerialPort_t port, u32_t events);
+
+/* Longest transmit reservation (see bsp_serial_port_tx_reserve) that is
+   granted whenever the transmit buffer has room for it. A longer one is only
+   granted while the room does not wrap around the end of the buffer. */
+#define BSP_SERIAL_TX_RESERVE_MAX   (128u)
+
+/*
+ * Time spent asleep in bsp_idle (see bsp_idle_take_stats).
+ */
+typedef struct bsp_idle_stats
+{
+    u32_t elapsed_us;   /* time covered by the statistics               */
+    u32_t asleep_us;    /* part of it spent asleep in bsp_idle          */
+    u32_t sleeps;       /* bsp_idle calls that went to sleep            */
+    u32_t wakeups;      /* timer compare interrupts (deadlines reached) */
+} BspIdleStats_t;
+
+/*
+ * Serial autobaud state (see bsp_serial_port_autobaud_start).
+ */
+typedef enum bsp_serial_autobaud
+{
+    BSP_SERIAL_AUTOBAUD_OFF = 0,    /* not started or not supported         */
+    BSP_SERIAL_AUTOBAUD_WAITING,    /* waiting for the 0x80 sync character  */
+    BSP_SERIAL_AUTOBAUD_LOCKED,     /* detected rate in use                 */
+    BSP_SERIAL_AUTOBAUD_FAILED,     /* detected rate not usable, rate kept  */
+} BspSerialAutobaud_t;
+
+/*
+ * Flash programming (see bsp_flash_erase_start). Addresses are absolute and
+ * erasing works on whole pages.
+ */
+#define BSP_FLASH_PAGE_SIZE (1024u)
+
+typedef enum bsp_flash_status
+{
+    BSP_FLASH_OK = 0,   /* idle, last operation succeeded               */
+    BSP_FLASH_BUSY,     /* erase or program in progress                 */
+    BSP_FLASH_ERROR,    /* last operation failed (e.g. not erased)      */
+} BspFlashStatus_t;
+
+/*
+ * Cause of the last reset (see bsp_reset_cause).
+ */
+typedef enum bsp_reset_cause
+{
+    BSP_RESET_PIN = 0,      /* NRST pin                     */
+    BSP_RESET_POWER,        /* power on or low power reset  */
+    BSP_RESET_WATCHDOG,     /* independent or window watchdog */
+    BSP_RESET_SOFTWARE,     /* bsp_reset                    */
+} BspResetCause_t;
+
+/* Rate of the cycle counter (see bsp_cycles_now) */
+#define BSP_CYCLES_PER_USEC (F_CPU_HZ / 1000000u)
+
+void bsp_early_startup(void);
 void bsp_init(void);
 void bsp_enable_interrupts(void);
+u32_t bsp_irq_save(void);
+void bsp_irq_restore(u32_t state);
 void bsp_toggle_builtin_led(void);
 void bsp_set_builtin_led(on_off_t led_state);
 
+bool_t bsp_serial_set_baud(u32_t baud, u32_t * const p_actual, s32_t * const p_error_ppm);
 bool_t bsp_serial_read(u8_t * const byte);
 bool_t bsp_serial_write(u8_t byte);
 bool_t bsp_serial_write_c_str(const char* c_str);
+size_t bsp_serial_read_buf(u8_t * const p_bytes, size_t len);
+size_t bsp_serial_read_stamped(u8_t * const p_bytes, u32_t * const p_stamps, size_t len);
+size_t bsp_serial_write_buf(const u8_t * const p_bytes, size_t len);
+bool_t bsp_serial_write_buf_all(const u8_t * const p_bytes, size_t len);
+size_t bsp_serial_tx_space(void);
+u8_t* bsp_serial_tx_reserve(size_t len);
+void bsp_serial_tx_commit(size_t n);
+bool_t bsp_serial_write_urgent(const u8_t * const p_bytes, size_t len);
+bool_t bsp_serial_write_urgent_c_str(const char* c_str);
+bool_t bsp_serial_get_stats(BspSerialStats_t * const p_stats);
+bool_t bsp_serial_get_errors(BspSerialErrors_t * const p_errors);
+bool_t bsp_serial_set_events(u32_t mask, BspSerialEventCallback_t cb);
+u32_t bsp_serial_take_events(void);
+u32_t bsp_serial_wait_events(void);
+bool_t bsp_serial_set_echo(bool_t enable);
+u32_t bsp_serial_echo_count(void);
+bool_t bsp_serial_autobaud_start(void);
+BspSerialAutobaud_t bsp_serial_autobaud_status(u32_t * const p_detected, u32_t * const p_actual, s32_t * const p_error_ppm);
+
+bool_t bsp_serial_port_set_baud(BspSerialPort_t port, u32_t baud, u32_t * const p_actual, s32_t * const p_error_ppm);
+bool_t bsp_serial_port_read(BspSerialPort_t port, u8_t * const byte);
+bool_t bsp_serial_port_write(BspSerialPort_t port, u8_t byte);
+bool_t bsp_serial_port_write_c_str(BspSerialPort_t port, const char* c_str);
+size_t bsp_serial_port_read_buf(BspSerialPort_t port, u8_t * const p_bytes, size_t len);
+size_t bsp_serial_port_read_stamped(BspSerialPort_t port, u8_t * const p_bytes, u32_t * const p_stamps, size_t len);
+size_t bsp_serial_port_write_buf(BspSerialPort_t port, const u8_t * const p_bytes, size_t len);
+bool_t bsp_serial_port_write_buf_all(BspSerialPort_t port, const u8_t * const p_bytes, size_t len);
+size_t bsp_serial_port_tx_space(BspSerialPort_t port);
+u8_t* bsp_serial_port_tx_reserve(BspSerialPort_t port, size_t len);
+void bsp_serial_port_tx_commit(BspSerialPort_t port, size_t n);
+bool_t bsp_serial_port_write_urgent(BspSerialPort_t port, const u8_t * const p_bytes, size_t len);
+bool_t bsp_serial_port_write_urgent_c_str(BspSerialPort_t port, const char* c_str);
+bool_t bsp_serial_port_get_stats(BspSerialPort_t port, BspSerialStats_t * const p_stats);
+bool_t bsp_serial_port_get_errors(BspSerialPort_t port, BspSerialErrors_t * const p_errors);
+bool_t bsp_serial_port_set_events(BspSerialPort_t port, u32_t mask, BspSerialEventCallback_t cb);
+u32_t bsp_serial_port_take_events(BspSerialPort_t port);
+u32_t bsp_serial_port_wait_events(BspSerialPort_t port);
+bool_t bsp_serial_port_set_echo(BspSerialPort_t port, bool_t enable);
+u32_t bsp_serial_port_echo_count(BspSerialPort_t port);
+bool_t bsp_serial_port_autobaud_start(BspSerialPort_t port);
+BspSerialAutobaud_t bsp_serial_port_autobaud_status(BspSerialPort_t port, u32_t * const p_detected, u32_t * const p_actual, s32_t * const p_error_ppm);
 
 void bsp_register_sys_tick_callback(IsrCallback_t cb);
 bool_t bsp_set_sys_tick_period_uses(u32_t usec);
 bool_t bsp_set_sys_tick_period_msec(u32_t msec);
 bool_t bsp_set_sys_tick_period_sec(u32_t sec);
 
+u32_t bsp_cycles_now(void);
+u32_t bsp_time_us(void);
+u64_t bsp_time_us64(void);
+void bsp_register_alarm_callback(IsrCallback_t cb);
+void bsp_set_alarm(u32_t at_us);
+void bsp_cancel_alarm(void);
+void bsp_idle(void);
+bool_t bsp_idle_take_stats(BspIdleStats_t * const p_stats);
+void bsp_crc32_load(u32_t crc);
+u32_t bsp_crc32_update(u32_t word);
+void bsp_flash_unlock(void);
+void bsp_flash_lock(void);
+BspFlashStatus_t bsp_flash_status(void);
+bool_t bsp_flash_erase_start(u32_t addr);
+BspFlashStatus_t bsp_flash_program(u32_t addr, const u16_t * const p_half, size_t n);
 void bsp_spin_delay(size_t iter);
+void bsp_reset(void);
+BspResetCause_t bsp_reset_cause(void);
+void bsp_start_image(u32_t addr);
 void bsp_error_trap(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,70 @@
+#include "bsp/private/crc/crc.h"
+
+#include "stm32f1xx.h"
+
+#include "types.h"
+
+static u32_t crc_unshift(u32_t crc);
+
+/**
+ * @brief Clock the CRC unit and reset its running value to CRC_INIT.
+ */
+void crc_init(void)
+{
+    RCC->AHBENR |= RCC_AHBENR_CRCEN;
+    (void)RCC->AHBENR; /* let the clock enable land before touching the unit */
+
+    CRC->CR = CRC_CR_RESET;
+}
+
+/**
+ * @brief Set the running value of the CRC unit
+ *
+ * Costs a reset and one word when crc is anything but CRC_INIT, plus 32 shift
+ * steps in software to find that word.
+ *
+ * @param[in] crc value to continue from (e.g. a value crc_update returned)
+ */
+void crc_load(u32_t crc)
+{
+    CRC->CR = CRC_CR_RESET;
+
+    if (CRC_INIT != crc) {
+        /* Feeding w after a reset leaves the 32 shift steps applied to
+           (CRC_INIT ^ w), so the word that lands on crc is
+           CRC_INIT ^ crc_unshift(crc). */
+        CRC->DR = CRC_INIT ^ crc_unshift(crc);
+    }
+}
+
+/**
+ * @brief Feed one word to the CRC unit
+ *
+ * @param[in] word next 32 bits of the stream
+ *
+ * @return The running CRC including word.
+ */
+u32_t crc_update(u32_t word)
+{
+    CRC->DR = word;
+    return CRC->DR;
+}
+
+/* Undo the 32 shift steps the unit applies to each word. A step shifts left
+   and XORs in the polynomial when the bit shifted out was set. The polynomial
+   has bit 0 set and a plain shift leaves bit 0 clear, so bit 0 of the result
+   tells which case it was. */
+static u32_t crc_unshift(u32_t crc)
+{
+    size_t i;
+
+    for (i = 0; i < 32u; i += 1) {
+        if (0u != (crc & 1UL)) {
+            crc = ((crc ^ CRC_POLY) >> 1) | 0x80000000UL;
+        } else {
+            crc >>= 1;
+        }
+    }
+
+    return crc;
+}
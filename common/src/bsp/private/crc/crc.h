@@ -0,0 +1,32 @@
+/**
+ * @brief CRC calculation unit
+ *
+ * The STM32F103 CRC unit computes the CRC-32 polynomial 0x04C11DB7 over 32 bit
+ * words, most significant bit first, starting from 0xFFFFFFFF. It has a single
+ * running value and no way to write it directly, so crc_load sets the running
+ * value by resetting the unit and feeding it the one word that leads to the
+ * requested value. That lets several streams share the unit one word at a
+ * time.
+ */
+#ifndef CRC_H
+#define CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/* Generator polynomial and reset value of the CRC unit */
+#define CRC_POLY    (0x04C11DB7UL)
+#define CRC_INIT    (0xFFFFFFFFUL)
+
+void crc_init(void);
+void crc_load(u32_t crc);
+u32_t crc_update(u32_t word);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC_H */
@@ -0,0 +1,40 @@
+/**
+ * @brief CPU cycle counter
+ *
+ * Thin wrapper around the Cortex-M3 DWT cycle counter. The counter is free
+ * running at the CPU clock (F_CPU_HZ) and wraps every 2^32 cycles (~59 seconds
+ * at 72MHz), so only differences of recent readings are meaningful.
+ */
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f1xx.h"
+
+#include "types.h"
+
+/**
+ * @brief Start the cycle counter. Calling this more than once is harmless.
+ */
+static inline void cycles_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Current value of the free running cycle counter.
+ */
+static inline u32_t cycles_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CYCLES_H */
@@ -0,0 +1,86 @@
+#include "bsp/private/deferred/deferred.h"
+
+#include "stm32f1xx.h"
+
+#include "bsp/private/startup/vectors.h"
+#include "types.h"
+
+/*
+ * Deferred work runs from the PendSV exception. Interrupt handlers post work
+ * items, which sets a bit in the pending mask and pends PendSV. The PendSV
+ * handler runs every posted item once at DEFERRED_IRQ_PRIO, after the posting
+ * handler (and anything else of higher priority) has returned. Posting an item
+ * that is already pending does nothing extra, so an item must handle
+ * everything that accumulated since it last ran.
+ */
+
+static IsrCallback_t  work_fns[DEFERRED_MAX_WORK];
+static size_t         work_count;
+static volatile u32_t pending;
+
+/**
+ * @brief Initialize the deferred work handler.
+ */
+void deferred_init(void)
+{
+    work_count = 0;
+    pending    = 0;
+
+    NVIC_SetPriority(PendSV_IRQn, DEFERRED_IRQ_PRIO);
+}
+
+/**
+ * @brief Register a deferred work item
+ *
+ * Items are registered once during initialization and never removed.
+ *
+ * @param[in] fn function to run when the item is posted
+ *
+ * @return Work item to pass to deferred_post or DEFERRED_NO_WORK if all work
+ * items are taken.
+ */
+DeferredWork_t deferred_register(IsrCallback_t fn)
+{
+    DeferredWork_t work = DEFERRED_NO_WORK;
+
+    if ((NULL_PTR != fn) && (work_count < DEFERRED_MAX_WORK)) {
+        work_fns[work_count] = fn;
+        work = (DeferredWork_t)work_count;
+        work_count += 1;
+    }
+
+    return work;
+}
+
+/**
+ * @brief Run a work item from the deferred work handler
+ *
+ * Safe to call from any interrupt priority and from thread mode.
+ *
+ * @param[in] work item returned by deferred_register
+ */
+void deferred_post(DeferredWork_t work)
+{
+    if (work < DEFERRED_MAX_WORK) {
+        /* Atomic read-modify-write (LDREX/STREX), so posts from different
+           priorities do not lose each other's bits. */
+        (void)__sync_fetch_and_or(&pending, 1UL << work);
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    }
+}
+
+void PendSV_Handler(void)
+{
+    u32_t  run;
+    size_t i;
+
+    /* Take everything posted so far. Anything posted while the items run
+       pends PendSV again. */
+    run = __sync_fetch_and_and(&pending, 0UL);
+
+    for (i = 0; i < work_count; i += 1) {
+        if (0 != (run & (1UL << i))) {
+            work_fns[i]();
+        }
+    }
+}
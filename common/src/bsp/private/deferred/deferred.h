@@ -0,0 +1,35 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f1xx.h"
+
+#include "types.h"
+
+/* Priority of the deferred work handler (PendSV). The default is the lowest
+   priority, so deferred work runs once every other interrupt has finished and
+   never delays one. */
+#ifndef DEFERRED_IRQ_PRIO
+    #define DEFERRED_IRQ_PRIO   ((1UL << __NVIC_PRIO_BITS) - 1UL)
+#endif
+
+/* Number of work items that can be registered */
+#define DEFERRED_MAX_WORK       (8u)
+
+/* Returned by deferred_register when all work items are taken */
+#define DEFERRED_NO_WORK        (DEFERRED_MAX_WORK)
+
+typedef u8_t DeferredWork_t;
+
+void deferred_init(void);
+DeferredWork_t deferred_register(IsrCallback_t fn);
+void deferred_post(DeferredWork_t work);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFERRED_H */
@@ -0,0 +1,98 @@
+#include "bsp/private/dma/dma.h"
+
+#include "stm32f1xx.h"
+#include "types.h"
+
+/* Each channel owns 4 bits of the DMA ISR and IFCR registers */
+#define BITS_PER_CHANNEL    (4u)
+
+static DMA_Channel_TypeDef * const channels[DMA_NUM_CHANNELS] = {
+    DMA1_Channel1,
+    DMA1_Channel2,
+    DMA1_Channel3,
+    DMA1_Channel4,
+    DMA1_Channel5,
+    DMA1_Channel6,
+    DMA1_Channel7,
+};
+
+/**
+ * @brief Enable the clock to the DMA1 controller.
+ */
+void dma_init(void)
+{
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+}
+
+/**
+ * @brief Configure a channel's peripheral address and control register.
+ *
+ * The channel is left disabled. The enable bit in ccr is ignored.
+ *
+ * @param[in] ch       DMA channel
+ * @param[in] p_periph peripheral data register address
+ * @param[in] ccr      channel control register value (see DMA_CCR_* bits)
+ */
+void dma_configure(DmaChannel_t ch, volatile const void * const p_periph, u32_t ccr)
+{
+    DMA_Channel_TypeDef * const p_ch = channels[ch];
+
+    p_ch->CCR  = 0;
+    p_ch->CPAR = (u32_t)p_periph;
+    p_ch->CCR  = ccr & ~DMA_CCR_EN;
+
+    dma_clear_flags(ch, DMA_FLAG_ALL);
+}
+
+/**
+ * @brief Start a transfer of len items to/from p_mem.
+ *
+ * The channel's number of data register can only be written while the channel
+ * is disabled, so the channel is briefly disabled first.
+ *
+ * @param[in] ch    DMA channel
+ * @param[in] p_mem memory address of the first item
+ * @param[in] len   number of items to transfer (1 - 65535)
+ */
+void dma_start(DmaChannel_t ch, volatile const void * const p_mem, size_t len)
+{
+    DMA_Channel_TypeDef * const p_ch = channels[ch];
+
+    p_ch->CCR  &= ~DMA_CCR_EN;
+    p_ch->CMAR  = (u32_t)p_mem;
+    p_ch->CNDTR = len;
+    p_ch->CCR  |= DMA_CCR_EN;
+}
+
+/**
+ * @brief Disable a channel. Any transfer in progress is abandoned.
+ */
+void dma_stop(DmaChannel_t ch)
+{
+    channels[ch]->CCR &= ~DMA_CCR_EN;
+}
+
+/**
+ * @brief Number of items left in the channel's current transfer.
+ */
+size_t dma_remaining(DmaChannel_t ch)
+{
+    return channels[ch]->CNDTR;
+}
+
+/**
+ * @brief Read a channel's interrupt flags (DMA_FLAG_* bits).
+ */
+u32_t dma_get_flags(DmaChannel_t ch)
+{
+    return (DMA1->ISR >> (ch * BITS_PER_CHANNEL)) & DMA_FLAG_ALL;
+}
+
+/**
+ * @brief Clear a channel's interrupt flags (DMA_FLAG_* bits).
+ */
+void dma_clear_flags(DmaChannel_t ch, u32_t flags)
+{
+    /* IFCR is write 1 to clear, so no read-modify-write is needed. */
+    DMA1->IFCR = (flags & DMA_FLAG_ALL) << (ch * BITS_PER_CHANNEL);
+}
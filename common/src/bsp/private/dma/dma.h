@@ -0,0 +1,44 @@
+#ifndef DMA_H
+#define DMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f1xx.h"
+
+#include "types.h"
+
+typedef enum dma_channel
+{
+    DMA_CHANNEL_1 = 0,
+    DMA_CHANNEL_2,
+    DMA_CHANNEL_3,
+    DMA_CHANNEL_4,
+    DMA_CHANNEL_5,
+    DMA_CHANNEL_6,
+    DMA_CHANNEL_7,
+    DMA_NUM_CHANNELS,
+} DmaChannel_t;
+
+/* Per channel interrupt flags as returned by dma_get_flags. Each channel has
+   the same 4 bit layout in the DMA ISR/IFCR registers. */
+#define DMA_FLAG_GLOBAL     (0x1u)
+#define DMA_FLAG_TC         (0x2u)  /* transfer complete */
+#define DMA_FLAG_HT         (0x4u)  /* half transfer     */
+#define DMA_FLAG_TE         (0x8u)  /* transfer error    */
+#define DMA_FLAG_ALL        (0xFu)
+
+void dma_init(void);
+void dma_configure(DmaChannel_t ch, volatile const void * const p_periph, u32_t ccr);
+void dma_start(DmaChannel_t ch, volatile const void * const p_mem, size_t len);
+void dma_stop(DmaChannel_t ch);
+size_t dma_remaining(DmaChannel_t ch);
+u32_t dma_get_flags(DmaChannel_t ch);
+void dma_clear_flags(DmaChannel_t ch, u32_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_H */
@@ -0,0 +1,142 @@
+#include "bsp/private/flash/flash.h"
+
+#include "stm32f1xx.h"
+
+#include "types.h"
+
+/* Status flags cleared by writing 1 */
+#define SR_FLAGS    (FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+#define SR_ERRORS   (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+
+/* An erased half-word. Programming it is skipped, which also skips the page
+   padding past the end of an image. */
+#define ERASED_HALF (0xFFFFu)
+
+static bool_t addr_is_valid(u32_t addr, size_t len);
+
+/**
+ * @brief Unlock the flash for erasing and programming.
+ */
+void flash_unlock(void)
+{
+    if (0u != (FLASH->CR & FLASH_CR_LOCK)) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+/**
+ * @brief Lock the flash against erasing and programming.
+ */
+void flash_lock(void)
+{
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+/**
+ * @brief State of the last erase or program operation
+ *
+ * Once the operation is done, its error flags are cleared, so an error is
+ * reported once.
+ *
+ * @return FLASH_STATUS_BUSY while it runs, then FLASH_STATUS_OK or
+ * FLASH_STATUS_ERROR.
+ */
+FlashStatus_t flash_status(void)
+{
+    FlashStatus_t status = FLASH_STATUS_OK;
+    u32_t sr;
+
+    sr = FLASH->SR;
+    if (0u != (sr & FLASH_SR_BSY)) {
+        status = FLASH_STATUS_BUSY;
+    } else {
+        if (0u != (sr & SR_ERRORS)) {
+            status = FLASH_STATUS_ERROR;
+        }
+
+        FLASH->SR = SR_FLAGS;
+        FLASH->CR &= ~(FLASH_CR_PER | FLASH_CR_PG);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Start erasing the page holding addr
+ *
+ * Poll flash_status for the result.
+ *
+ * @param[in] addr any address in the page
+ *
+ * @return E_FALSE if the flash is busy or addr is not in flash.
+ */
+bool_t flash_erase_start(u32_t addr)
+{
+    bool_t result = E_FALSE;
+
+    if ((E_TRUE == addr_is_valid(addr, 1u)) && (0u == (FLASH->SR & FLASH_SR_BSY))) {
+        FLASH->SR  = SR_FLAGS;
+        FLASH->CR |= FLASH_CR_PER;
+        FLASH->AR  = addr;
+        FLASH->CR |= FLASH_CR_STRT;
+
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Program a burst of half-words
+ *
+ * Blocks until the burst is done. Each half-word is checked against the
+ * status flags and read back. Programming stops at the first failure.
+ *
+ * @param[in] addr   half-word aligned address of the first half-word
+ * @param[in] p_half half-words to program (erased ones are skipped)
+ * @param[in] n      number of half-words
+ *
+ * @return FLASH_STATUS_OK if all n half-words read back as programmed,
+ * FLASH_STATUS_BUSY if an erase is still running (nothing is programmed),
+ * otherwise FLASH_STATUS_ERROR.
+ */
+FlashStatus_t flash_program(u32_t addr, const u16_t * const p_half, size_t n)
+{
+    FlashStatus_t status = FLASH_STATUS_OK;
+    volatile u16_t *p_dst;
+    size_t i;
+
+    if ((0u != (addr & 1u)) || (E_FALSE == addr_is_valid(addr, n * 2u))) {
+        status = FLASH_STATUS_ERROR;
+    } else if (0u != (FLASH->SR & FLASH_SR_BSY)) {
+        status = FLASH_STATUS_BUSY;
+    } else {
+        FLASH->SR  = SR_FLAGS;
+        FLASH->CR |= FLASH_CR_PG;
+
+        p_dst = (volatile u16_t*)addr;
+        for (i = 0; (i < n) && (FLASH_STATUS_OK == status); i += 1) {
+            if (ERASED_HALF != p_half[i]) {
+                p_dst[i] = p_half[i];
+                while (0u != (FLASH->SR & FLASH_SR_BSY)) { }
+            }
+
+            if ((0u != (FLASH->SR & SR_ERRORS)) || (p_half[i] != p_dst[i])) {
+                status = FLASH_STATUS_ERROR;
+            }
+        }
+
+        FLASH->SR  = SR_FLAGS;
+        FLASH->CR &= ~FLASH_CR_PG;
+    }
+
+    return status;
+}
+
+/* The range [addr, addr + len) is inside the flash */
+static bool_t addr_is_valid(u32_t addr, size_t len)
+{
+    return ((addr >= FLASH_BASE_ADDR) && (len <= FLASH_SIZE)
+        && ((addr - FLASH_BASE_ADDR) <= (FLASH_SIZE - len))) ? E_TRUE : E_FALSE;
+}
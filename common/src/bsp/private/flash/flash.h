@@ -0,0 +1,44 @@
+/**
+ * @brief Embedded flash programming (FPEC)
+ *
+ * The STM32F103C8 has 64K of flash in 1K pages. A page is erased to all 1s and
+ * then programmed a half-word at a time. Erasing is started here and left to
+ * run (about 20 ms), so the caller can get on with other work and poll
+ * flash_status. Programming is done in bursts of half-words (about 50 us
+ * each), checking every half-word as it lands.
+ *
+ * While the flash is busy, any fetch from flash stalls the CPU until it is
+ * done. DMA transfers to and from RAM carry on, so a DMA driven receiver keeps
+ * receiving through an erase.
+ */
+#ifndef FLASH_H
+#define FLASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+#define FLASH_BASE_ADDR     (0x08000000UL)
+#define FLASH_SIZE          (64u * 1024u)
+#define FLASH_PAGE_SIZE     (1024u)
+
+typedef enum flash_status
+{
+    FLASH_STATUS_OK,        /* idle, last operation succeeded           */
+    FLASH_STATUS_BUSY,      /* erase or program in progress             */
+    FLASH_STATUS_ERROR,     /* last operation failed (e.g. not erased)  */
+} FlashStatus_t;
+
+void flash_unlock(void);
+void flash_lock(void);
+FlashStatus_t flash_status(void);
+bool_t flash_erase_start(u32_t addr);
+FlashStatus_t flash_program(u32_t addr, const u16_t * const p_half, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_H */
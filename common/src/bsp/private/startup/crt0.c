@@ -33,6 +33,8 @@ extern u32_t ld__sdata;     /* RAM DATA section first entry */
 extern u32_t ld__edata;     /* RAM DATA section one past last entry */
 extern u32_t ld__sidata;    /* flash DATA section first entry */
 
+extern u32_t ld__isr_vector; /* vector table (start of the image) */
+
 extern u32_t ld__sbss;      /* BSS section first entry */
 extern u32_t ld__ebss;      /* BSS section one past last entry */
 
@@ -86,6 +88,12 @@ void startup_c__(void)
         *bss_ptr = 0u;
     }
 
+    /*
+     * Give the image a chance to act before any hardware is configured (see
+     * bsp_early_startup).
+     */
+    bsp_early_startup();
+
     /*
      * With the RAM initialized, we can do some low level initialization that
      * may or may not rely on values in the BSS or DATA segment.
@@ -119,6 +127,18 @@ void startup_c__(void)
     while(1) {  }
 }
 
+/**
+ * @brief Early startup hook
+ *
+ * Called once RAM is initialized, with the clocks and the rest of the hardware
+ * still in their reset state. Does nothing by default. An image that defines
+ * its own (e.g. the UART bootloader, to start an application from a clean
+ * reset) replaces this one.
+ */
+__attribute__((weak)) void bsp_early_startup(void)
+{
+}
+
 /**
  * @brief Configure the system clock tree
  * 
@@ -234,8 +254,14 @@ static void clock_init(void)
  *
  * A special value of 0x05FA must be written to the upper 16 bits for the
  * register to update.
+ *
+ * The vector table offset register is pointed at this image's vector table.
+ * That is a no-op for an image at the start of flash and is what lets an
+ * image linked after the bootloader take its own interrupts.
  */
 static void sys_control_block_init(void)
 {
     NVIC_SetPriorityGrouping(0x3);
+
+    SCB->VTOR = (u32_t)&ld__isr_vector;
 }
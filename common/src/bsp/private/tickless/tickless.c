@@ -0,0 +1,303 @@
+#include "bsp/private/tickless/tickless.h"
+
+#include "stm32f1xx.h"
+
+#include "bsp/private/timebase/timebase.h"
+#include "types.h"
+
+/* BSP alarm */
+static volatile u32_t  alarm_at;
+static volatile bool_t alarm_armed;
+
+/* Emulated system tick. The tick is off while the period is 0. */
+static volatile u32_t  tick_at;
+static volatile u32_t  tick_period;
+
+/* Wake up time of the current tickless_idle call */
+static volatile u32_t  wake_at;
+static volatile bool_t wake_armed;
+
+/* Who to tell when the alarm or the tick is due */
+static IsrCallback_t alarm_handler;
+static IsrCallback_t tick_handler;
+
+/* Set by tickless_wake, taken by tickless_idle */
+static volatile bool_t woken;
+
+/* Statistics since stats_start (see tickless_take_stats) */
+static u32_t          stats_start;
+static volatile u32_t asleep_us;
+static volatile u32_t sleeps;
+static volatile u32_t wakeups;
+
+static void compare_isr(void);
+static void compare_update(void);
+static u32_t earlier(u32_t at, u32_t now, u32_t wait);
+static bool_t is_due(u32_t at, u32_t now);
+
+/**
+ * @brief Take over the time base alarm. No deadline is armed.
+ *
+ * Call after timebase_init.
+ *
+ * @param[in] alarm_cb called from the compare interrupt when the alarm is due
+ * @param[in] tick_cb  called from the compare interrupt for each system tick
+ */
+void tickless_init(IsrCallback_t alarm_cb, IsrCallback_t tick_cb)
+{
+    alarm_handler = alarm_cb;
+    tick_handler  = tick_cb;
+
+    alarm_armed = E_FALSE;
+    tick_period = 0u;
+    wake_armed  = E_FALSE;
+    woken       = E_FALSE;
+
+    stats_start = timebase_now();
+    asleep_us   = 0u;
+    sleeps      = 0u;
+    wakeups     = 0u;
+
+    timebase_set_alarm_callback(compare_isr);
+}
+
+/**
+ * @brief Arm the alarm for a time, replacing any earlier setting
+ *
+ * A deadline that is already due calls back right away (from the interrupt).
+ * Deadlines must be less than 2^31 us ahead.
+ *
+ * @param[in] at timebase_now value to call back at
+ */
+void tickless_set_alarm(u32_t at)
+{
+    const u32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    alarm_at    = at;
+    alarm_armed = E_TRUE;
+    compare_update();
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Disarm the alarm. The callback does not run until it is set again.
+ */
+void tickless_cancel_alarm(void)
+{
+    const u32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    alarm_armed = E_FALSE;
+    compare_update();
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Restart the emulated system tick with a new period
+ *
+ * The first tick is one period from now.
+ *
+ * @param[in] usec tick period (0 stops the tick)
+ *
+ * @retval E_TRUE  - the tick was restarted (or stopped)
+ * @retval E_FALSE - the period is longer than TICKLESS_MAX_WAIT_US
+ */
+bool_t tickless_set_tick_period(u32_t usec)
+{
+    const u32_t primask = __get_PRIMASK();
+    bool_t      result  = E_FALSE;
+
+    if (TICKLESS_MAX_WAIT_US >= usec) {
+        __disable_irq();
+
+        tick_period = usec;
+        tick_at     = timebase_now() + usec;
+        compare_update();
+
+        __set_PRIMASK(primask);
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Keep the next tickless_idle call from sleeping
+ *
+ * Called (by the BSP) after every callback it delivers to the application.
+ * The callback may have left work for the main loop after the loop last
+ * looked, so the loop has to look again before it sleeps.
+ */
+void tickless_wake(void)
+{
+    woken = E_TRUE;
+}
+
+/**
+ * @brief Sleep until the next interrupt
+ *
+ * The compare is set for the earliest of the deadline and the other armed
+ * deadlines, so no timer interrupt wakes the core before something is due.
+ * Any other interrupt ends the sleep as well. Does not sleep (and only clears
+ * the request) if tickless_wake was called since the last tickless_idle.
+ *
+ * Interrupts are masked from the check to the WFI, so a wake up request made
+ * in between cannot be lost: its interrupt is left pending, which ends WFI
+ * even when masked. The interrupt runs when the mask is lifted, before this
+ * function returns.
+ *
+ * @param[in] has_deadline E_TRUE to wake up at deadline at the latest
+ * @param[in] deadline     timebase_now value to wake up at, less than 2^31 us
+ *                         ahead
+ */
+void tickless_idle(bool_t has_deadline, u32_t deadline)
+{
+    const u32_t primask = __get_PRIMASK();
+    u32_t       start;
+
+    __disable_irq();
+
+    if (E_FALSE == woken) {
+        wake_at    = deadline;
+        wake_armed = has_deadline;
+        compare_update();
+
+        start = timebase_now();
+        __DSB();
+        __WFI();
+        asleep_us += timebase_now() - start;
+        sleeps    += 1u;
+
+        /* Something else may have ended the sleep. The compare is left as it
+           is: if it still matches for the deadline, the interrupt finds
+           nothing due and moves the compare on. */
+        wake_armed = E_FALSE;
+    }
+
+    woken = E_FALSE;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Read and restart the sleep statistics
+ *
+ * The counts cover the time since the previous call (or tickless_init) and
+ * must be taken at least once every 2^32 us (~71.6 minutes).
+ *
+ * @param[out] p_stats statistics
+ */
+void tickless_take_stats(TicklessStats_t * const p_stats)
+{
+    const u32_t primask = __get_PRIMASK();
+    u32_t       now;
+
+    __disable_irq();
+
+    now                 = timebase_now();
+    p_stats->elapsed_us = now - stats_start;
+    p_stats->asleep_us  = asleep_us;
+    p_stats->sleeps     = sleeps;
+    p_stats->wakeups    = wakeups;
+
+    stats_start = now;
+    asleep_us   = 0u;
+    sleeps      = 0u;
+    wakeups     = 0u;
+
+    __set_PRIMASK(primask);
+}
+
+/*
+ * Time base alarm callback (TIM2 interrupt, lowest priority)
+ *
+ * Handles every deadline that is due and sets the compare for the next one.
+ */
+static void compare_isr(void)
+{
+    const u32_t now = timebase_now();
+
+    wakeups += 1u;
+
+    if ((E_TRUE == alarm_armed) && (E_TRUE == is_due(alarm_at, now))) {
+        alarm_armed = E_FALSE;
+
+        if (NULL_PTR != alarm_handler) {
+            alarm_handler();
+        }
+    }
+
+    /* Run every tick that is due. The next tick is always a whole number of
+       periods after the first one, however late this runs. */
+    while ((0u != tick_period) && (E_TRUE == is_due(tick_at, now))) {
+        tick_at += tick_period;
+
+        if (NULL_PTR != tick_handler) {
+            tick_handler();
+        }
+    }
+
+    if ((E_TRUE == wake_armed) && (E_TRUE == is_due(wake_at, now))) {
+        wake_armed = E_FALSE;
+    }
+
+    compare_update();
+}
+
+/*
+ * Set the compare for the earliest armed deadline, or turn it off when none
+ * is armed. Called with interrupts masked or from the compare interrupt.
+ */
+static void compare_update(void)
+{
+    const u32_t now   = timebase_now();
+    u32_t       wait  = TICKLESS_MAX_WAIT_US;
+    bool_t      armed = E_FALSE;
+
+    if (E_TRUE == alarm_armed) {
+        wait  = earlier(alarm_at, now, wait);
+        armed = E_TRUE;
+    }
+
+    if (0u != tick_period) {
+        wait  = earlier(tick_at, now, wait);
+        armed = E_TRUE;
+    }
+
+    if (E_TRUE == wake_armed) {
+        wait  = earlier(wake_at, now, wait);
+        armed = E_TRUE;
+    }
+
+    if (E_TRUE == armed) {
+        timebase_set_alarm(now + wait);
+    } else {
+        timebase_cancel_alarm();
+    }
+}
+
+/* The smaller of wait and the time from now until at (0 once at has passed) */
+static u32_t earlier(u32_t at, u32_t now, u32_t wait)
+{
+    const s32_t left   = (s32_t)(at - now);
+    u32_t       result = wait;
+
+    if (0 >= left) {
+        result = 0u;
+    } else if ((u32_t)left < wait) {
+        result = (u32_t)left;
+    }
+
+    return result;
+}
+
+/* E_TRUE once now has reached at */
+static bool_t is_due(u32_t at, u32_t now)
+{
+    return ((s32_t)(now - at) >= 0) ? E_TRUE : E_FALSE;
+}
@@ -0,0 +1,61 @@
+/**
+ * @brief Tickless idle
+ *
+ * Everything that has to wake the core at a given time shares the time base
+ * alarm (TIM2 channel 1, see timebase_set_alarm). There are three deadlines:
+ *
+ *  - the BSP alarm (bsp_set_alarm, which drives the timer service)
+ *  - the next system tick, when the tick is emulated (TICKLESS_SYS_TICK)
+ *  - the wake up time of the current tickless_idle call
+ *
+ * The compare is always set for the earliest of the armed deadlines, so the
+ * core wakes exactly when something is due and at no other time. The
+ * microsecond clock keeps counting while the core sleeps, so nothing has to be
+ * corrected for the time spent asleep. A late compare interrupt (e.g. held off
+ * by a higher priority interrupt) runs every tick it missed and the next tick
+ * stays on the original grid, so the emulated tick does not drift.
+ */
+#ifndef TICKLESS_H
+#define TICKLESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/* With 1, the system tick is emulated on the time base alarm and the SysTick
+   hardware is left off. Its interrupt would otherwise wake the core once per
+   period whether or not the tick is due (SysTick counts down from the period,
+   so it cannot be pointed at a deadline). With 0, the BSP runs the system
+   tick on SysTick as before and tickless_idle only sleeps through the other
+   deadlines. */
+#ifndef TICKLESS_SYS_TICK
+    #define TICKLESS_SYS_TICK   (1)
+#endif
+
+/* Longest time the compare is set ahead. The alarm compares with wrapping
+   arithmetic, so a deadline must be less than 2^31 us away. */
+#define TICKLESS_MAX_WAIT_US    (0x7FFFFFFFUL)
+
+typedef struct tickless_stats
+{
+    u32_t elapsed_us;   /* time since the last tickless_take_stats  */
+    u32_t asleep_us;    /* part of it spent in tickless_idle's WFI  */
+    u32_t sleeps;       /* tickless_idle calls that slept           */
+    u32_t wakeups;      /* compare interrupts                       */
+} TicklessStats_t;
+
+void tickless_init(IsrCallback_t alarm_cb, IsrCallback_t tick_cb);
+void tickless_set_alarm(u32_t at);
+void tickless_cancel_alarm(void);
+bool_t tickless_set_tick_period(u32_t usec);
+void tickless_wake(void);
+void tickless_idle(bool_t has_deadline, u32_t deadline);
+void tickless_take_stats(TicklessStats_t * const p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TICKLESS_H */
@@ -0,0 +1,219 @@
+#include "bsp/private/timebase/timebase.h"
+
+#include "stm32f1xx.h"
+
+#include "bsp/private/startup/vectors.h"
+#include "types.h"
+
+/* The timers run from PCLK1 times 2 (APB1 is divided by 2, see crt0), which is
+   the CPU clock. */
+#define TIMER_CLK_HZ    (F_CPU_HZ)
+
+#if 0 != (TIMER_CLK_HZ % TIMEBASE_HZ)
+    #error "The timer clock must be a multiple of the time base rate"
+#endif
+
+#define LOW_TIMER       (TIM2)  /* master, low 16 bits  */
+#define HIGH_TIMER      (TIM3)  /* slave, high 16 bits  */
+
+/* TIM2's update event on TRGO (MMS = 010) */
+#define LOW_TIMER_MMS   (TIM_CR2_MMS_1)
+
+/* TIM3 triggered from ITR1, which is TIM2's TRGO (TS = 001), and counting
+   each trigger (external clock mode 1, SMS = 111) */
+#define HIGH_TIMER_SMCR (TIM_SMCR_TS_0 | TIM_SMCR_SMS)
+
+/* The wrap interrupt runs at the highest priority so it is never preempted
+   between clearing its flag and counting the wrap (see timebase_now64). It
+   runs once every ~71.6 minutes. */
+#define WRAP_IRQ_PRIO   (0u)
+
+/* The alarm interrupt only checks the deadline and calls back, so it runs at
+   the lowest priority. */
+#define ALARM_IRQ_PRIO  ((1UL << __NVIC_PRIO_BITS) - 1UL)
+
+/* 32 bit wraps of the counter so far (the high word of the 64 bit count) */
+static volatile u32_t wraps;
+
+/* Alarm deadline, whether it is armed, and who to tell */
+static volatile u32_t         alarm_at;
+static volatile bool_t        alarm_armed;
+static volatile IsrCallback_t alarm_cb;
+
+/**
+ * @brief Start the time base at 0.
+ */
+void timebase_init(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_TIM2EN | RCC_APB1ENR_TIM3EN;
+    (void)RCC->APB1ENR; /* let the clock enable land before touching the timers */
+
+    wraps       = 0;
+    alarm_armed = E_FALSE;
+
+    /* Load the prescaler with an update event before TRGO is connected, so
+       the load is not counted by TIM3. */
+    LOW_TIMER->CR1  = 0;
+    LOW_TIMER->PSC  = (u16_t)((TIMER_CLK_HZ / TIMEBASE_HZ) - 1u);
+    LOW_TIMER->ARR  = 0xFFFFu;
+    LOW_TIMER->EGR  = TIM_EGR_UG;
+    LOW_TIMER->SR   = 0;
+    LOW_TIMER->CR2  = LOW_TIMER_MMS;
+    LOW_TIMER->DIER = 0;
+
+    HIGH_TIMER->CR1  = 0;
+    HIGH_TIMER->PSC  = 0;
+    HIGH_TIMER->ARR  = 0xFFFFu;
+    HIGH_TIMER->EGR  = TIM_EGR_UG;
+    HIGH_TIMER->SR   = 0;
+    HIGH_TIMER->SMCR = HIGH_TIMER_SMCR;
+    HIGH_TIMER->DIER = TIM_DIER_UIE;
+    HIGH_TIMER->CR1  = TIM_CR1_CEN;
+
+    NVIC_SetPriority(TIM3_IRQn, WRAP_IRQ_PRIO);
+    NVIC_EnableIRQ(TIM3_IRQn);
+    NVIC_SetPriority(TIM2_IRQn, ALARM_IRQ_PRIO);
+    NVIC_EnableIRQ(TIM2_IRQn);
+
+    /* The slave counts from here on. */
+    LOW_TIMER->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief Microseconds since timebase_init, modulo 2^32
+ *
+ * Safe to call from any context. The two halves are separate registers, so a
+ * wrap of the low half between reading them would pair a new low half with an
+ * old high half (or the reverse). Reading the high half on both sides of the
+ * low half catches that. After a change, the halves are read again, which is
+ * safe since the next low half wrap is 65 ms away.
+ *
+ * @return The 32 bit count.
+ */
+u32_t timebase_now(void)
+{
+    u32_t high;
+    u32_t low;
+
+    high = HIGH_TIMER->CNT & 0xFFFFu;
+    low  = LOW_TIMER->CNT & 0xFFFFu;
+
+    if (high != (HIGH_TIMER->CNT & 0xFFFFu)) {
+        high = HIGH_TIMER->CNT & 0xFFFFu;
+        low  = LOW_TIMER->CNT & 0xFFFFu;
+    }
+
+    return (high << 16) | low;
+}
+
+/**
+ * @brief Microseconds since timebase_init
+ *
+ * Safe to call from any context, including with interrupts masked. The wrap
+ * count and the 32 bit count are read with interrupts masked, so the wrap
+ * interrupt cannot run in between. A wrap that is still pending (its
+ * interrupt masked by this function or the caller) is counted here when the
+ * 32 bit count shows it has happened, i.e. the count is in its lower half.
+ *
+ * @return The 64 bit count. It does not wrap in practice.
+ */
+u64_t timebase_now64(void)
+{
+    const u32_t primask = __get_PRIMASK();
+    u32_t high;
+    u32_t low;
+
+    __disable_irq();
+
+    high = wraps;
+    low  = timebase_now();
+    if ((0u != (HIGH_TIMER->SR & TIM_SR_UIF)) && (low < 0x80000000UL)) {
+        high += 1u;
+    }
+
+    __set_PRIMASK(primask);
+
+    return ((u64_t)high << 32) | low;
+}
+
+/**
+ * @brief Set the function the alarm interrupt calls when the alarm is due.
+ *
+ * @param[in] cb alarm callback (runs in the TIM2 interrupt)
+ */
+void timebase_set_alarm_callback(IsrCallback_t cb)
+{
+    alarm_cb = cb;
+}
+
+/**
+ * @brief Arm the alarm for a time, replacing any earlier setting
+ *
+ * Channel 1 compares against the low half only, so it matches every 65.536 ms
+ * until the deadline is reached. Each match checks the full count and the
+ * callback runs on the first match at or past the deadline. A deadline that is
+ * already due calls back right away (from the interrupt). Deadlines must be
+ * less than 2^31 us ahead.
+ *
+ * @param[in] at timebase_now value to call back at
+ */
+void timebase_set_alarm(u32_t at)
+{
+    const u32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    alarm_at    = at;
+    alarm_armed = E_TRUE;
+
+    LOW_TIMER->CCR1  = at & 0xFFFFu;
+    LOW_TIMER->SR    = ~TIM_SR_CC1IF;
+    LOW_TIMER->DIER |= TIM_DIER_CC1IE;
+
+    /* The counter may have passed the compare value before it was written. It
+       would not match again for 65 ms, so raise the match by hand. */
+    if ((s32_t)(timebase_now() - at) >= 0) {
+        LOW_TIMER->EGR = TIM_EGR_CC1G;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Disarm the alarm. The callback does not run until it is set again.
+ */
+void timebase_cancel_alarm(void)
+{
+    const u32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    alarm_armed      = E_FALSE;
+    LOW_TIMER->DIER &= ~TIM_DIER_CC1IE;
+    LOW_TIMER->SR    = ~TIM_SR_CC1IF;
+
+    __set_PRIMASK(primask);
+}
+
+void TIM2_IRQHandler(void)
+{
+    const IsrCallback_t cb = alarm_cb;
+
+    LOW_TIMER->SR = ~TIM_SR_CC1IF;
+
+    if ((E_TRUE == alarm_armed) && ((s32_t)(timebase_now() - alarm_at) >= 0)) {
+        alarm_armed      = E_FALSE;
+        LOW_TIMER->DIER &= ~TIM_DIER_CC1IE;
+
+        if (NULL_PTR != cb) {
+            cb();
+        }
+    }
+}
+
+void TIM3_IRQHandler(void)
+{
+    /* The status flags are cleared by writing 0. */
+    HIGH_TIMER->SR = ~TIM_SR_UIF;
+    wraps += 1u;
+}
@@ -0,0 +1,39 @@
+/**
+ * @brief Microsecond time base
+ *
+ * TIM2 and TIM3 are chained into one 32 bit counter that ticks once per
+ * microsecond. TIM2 is the master and counts the low 16 bits from the timer
+ * clock divided down to 1 MHz. Its update event (the wrap from 0xFFFF to 0) is
+ * sent out on TRGO, and TIM3 is a slave in external clock mode on ITR1 (TIM2),
+ * so it counts the high 16 bits. The 32 bit count wraps every 2^32 us (~71.6
+ * minutes). TIM3's update interrupt counts those wraps, which extends the
+ * count to 64 bits.
+ *
+ * Nothing runs per tick. TIM3's update interrupt runs once per wrap, and
+ * TIM2's capture/compare channel 1 provides a single alarm (see
+ * timebase_set_alarm).
+ */
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/* Rate of the time base */
+#define TIMEBASE_HZ     (1000000UL)
+
+void timebase_init(void);
+u32_t timebase_now(void);
+u64_t timebase_now64(void);
+void timebase_set_alarm_callback(IsrCallback_t cb);
+void timebase_set_alarm(u32_t at);
+void timebase_cancel_alarm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMEBASE_H */
@@ -3,60 +3,514 @@
 #include <string.h>
 
 #include "bsp/bsp.h"
+#include "bsp/private/cycles/cycles.h"
+#include "bsp/private/deferred/deferred.h"
+#include "bsp/private/dma/dma.h"
+#include "bsp/private/gpio/gpio.h"
+#include "bsp/private/uart/uart_config.h"
 #include "bsp/private/startup/vectors.h"
 #include "stm32f1xx.h"
 #include "types.h"
 
-/* Baud rate configuration. See section 27.3.4 of the reference manual for 
-   equations and rationale. */
-#define BAUD        (115200u)
-#define DIV         (F_CPU_HZ/(16.0f * BAUD))
-#define DIV_WHOLE   ((u32_t) DIV)
-#define DIV_FRAC    ((u32_t)((DIV - DIV_WHOLE) * 16))
-
-/* Ring buffer infrastructure */
-#define BYTE_RING_MAX_SIZE  (256u)
-#define PRIVATE_RING_SIZE   BYTE_RING_MAX_SIZE  /* set ring size */
-#define PRIVATE_RING_VOLATILE_DECL              /* byte rings in this module are volatile */
+/* USART kernel clocks as set up by clock_init in crt0.c. USART1 is on APB2
+   and the others are on APB1. */
+#define APB2_CLK_HZ (F_CPU_HZ)
+#define APB1_CLK_HZ (F_CPU_HZ / 2u)
+
+/* Limits of the baud rate register. The fraction is 4 bits, so the register
+   holds USARTDIV * 16 (see section 27.3.4 of the reference manual). */
+#define BRR_MIN     (16u)
+#define BRR_MAX     (0xFFFFu)
+
+#if 1 == UART1_AUTOBAUD_ENABLE
+/* The sync character is 0x80. Sent LSB first, the start bit and the 7 low
+   data bits hold the line low for 8 bit times, followed by bit 7 and the stop
+   bit (high). The falling to rising edge time is therefore 8 bits long. */
+    #define AUTOBAUD_SYNC_BITS  (8u)
+    #define AUTOBAUD_TIMER      (TIM1)      /* channel 3 is on PA10, USART1 RX */
+
+/* A low pulse shorter than the sync character at the fastest rate the USART
+   can generate is noise. USART1 runs at the CPU clock, so a bit lasts at
+   least BRR_MIN cycles. */
+    #define AUTOBAUD_MIN_CYCLES (AUTOBAUD_SYNC_BITS * BRR_MIN)
+
+static_assert(APB2_CLK_HZ == F_CPU_HZ, "autobaud assumes USART1 and TIM1 run at the CPU clock");
+static_assert((0xFFFFFFFFu / AUTOBAUD_SYNC_BITS) >= F_CPU_HZ, "autobaud rate math overflows");
+#endif
+
+/* Ring buffer infrastructure. The rings are instantiated (and sized) in
+   uart_rings.cpp. Each driver instance reaches its rings through a table of
+   the facade functions. */
 #include "utils/private_ring.h"
 
-PRIVATE_RING_DECLARATIONS(ByteRing, u8_t)                /* create ring type of bytes */
-PRIVATE_RING_DECLARE(static volatile ByteRing, rx_ring); /* bytes to read             */
-PRIVATE_RING_DECLARE(static volatile ByteRing, tx_ring); /* bytes to write            */
+PRIVATE_RING_OPS_TYPE(ByteRingOps_t, u8_t)
+PRIVATE_RING_OPS_TYPE(WordRingOps_t, u32_t)
+#if 0 == UART_RX_DMA_ENABLE
+PRIVATE_RING_OPS_TYPE(RxRingOps_t, UART_RX_ENTRY_T)
+#endif
+
+/* Zero copy echo (see uart_set_echo) hands receive DMA segments to the
+   transmit DMA, so it needs both. */
+#define UART_ECHO_AVAILABLE ((1 == UART_TX_DMA_ENABLE) && (1 == UART_RX_DMA_ENABLE))
+
+/**
+ * @brief Source of a transmitted span
+ */
+typedef enum tx_lane
+{
+    TX_LANE_NORMAL = 0, /* transmit ring                      */
+    TX_LANE_URGENT,     /* urgent ring                        */
+    TX_LANE_ECHO,       /* receive DMA buffer (zero copy echo) */
+} TxLane_t;
+
+/**
+ * @brief Run time state of a driver instance
+ */
+typedef struct uart_state
+{
+    /* Outstanding transmit reservation. A reservation that fits before the end
+       of the transmit ring points straight into the ring. Otherwise it points
+       at the staging buffer, which is copied into the ring on commit. Producer
+       side only. */
+    size_t tx_reserve_len;
+    bool_t tx_reserve_staged;
+
+    /* Transmit lanes. tx_queued is the free running count of bytes written to
+       the normal ring (producer side) and each message end pushed to the
+       message ring is a value of it. tx_sent is the free running count of
+       normal bytes handed to the USART and tx_msg_left the number of bytes
+       left in the normal message being sent (transmit interrupts only). The
+       urgent ring is only drained while tx_msg_left is 0. */
+    u32_t          tx_queued;
+    volatile u32_t tx_sent;
+    volatile u32_t tx_msg_left;
+
+#if 1 == UART_TX_DMA_ENABLE
+    /* Length of the transmit segment the DMA is working on (0 when idle) and
+       the lane it came from. Only written from the DMA interrupt. */
+    volatile size_t   tx_dma_len;
+    volatile TxLane_t tx_dma_lane;
+#endif
+
+#if UART_ECHO_AVAILABLE
+    /* Zero copy echo. While echo_on is set, the transmit DMA is the consumer
+       of the receive DMA buffer. echo_bytes counts the bytes echoed. */
+    volatile bool_t echo_on;
+    volatile u32_t  echo_bytes;
+#endif
+
+#if 1 == UART_RX_DMA_ENABLE
+    /* rx_dma_head is the free running count of bytes the DMA has written, as
+       last published from the IDLE and DMA interrupts. rx_dma_tail is the free
+       running count of bytes read by the consumer. The same SPSC rules as the
+       rings apply. */
+    volatile u32_t rx_dma_head;
+    volatile u32_t rx_dma_tail;
+    volatile u32_t rx_dma_last_pos; /* buffer position at the last publish */
+#endif
+
+    /* Receive error counters (see uart_get_errors). Only written from the
+       interrupts, except for dropped bytes detected by the DMA reader. */
+    volatile UartErrors_t errors;
+
+    /* Events raised by the interrupts and not yet taken. Only events in
+       event_mask are raised. With a callback, the events are taken and handed
+       to the callback by the deferred work handler. */
+    volatile u32_t               events;
+    volatile u32_t               event_mask;
+    volatile UartEventCallback_t event_cb;
+    volatile u32_t               event_id;
+
+#if 1 == RING_STATS_ENABLE
+    #if 1 == UART_RX_DMA_ENABLE
+    /* Receive buffer statistics in the same form as the ring statistics.
+       Rejected pushes are bytes lost to the DMA lapping the reader. */
+    volatile RingStats_t rx_dma_stats;
+    #endif
+
+    /* Transmit interrupt cost accounting */
+    volatile u32_t tx_irq_count;
+    volatile u32_t tx_irq_cycles;
+#endif
+} UartState_t;
+
+/**
+ * @brief Fixed description of a driver instance
+ *
+ * The DMA channels follow the request mapping in table 78 of the reference
+ * manual.
+ */
+typedef struct uart_instance
+{
+    USART_TypeDef       *p_uart;
+    IRQn_Type            irq;
+    const ByteRingOps_t *p_tx_ring;
+    const ByteRingOps_t *p_urgent_ring;
+    const WordRingOps_t *p_msg_ring;    /* message ends of p_tx_ring */
+#if 1 == UART_TX_DMA_ENABLE
+    DmaChannel_t         tx_dma_ch;
+    IRQn_Type            tx_dma_irq;
+#endif
+#if 1 == UART_RX_DMA_ENABLE
+    DmaChannel_t         rx_dma_ch;
+    IRQn_Type            rx_dma_irq;
+    volatile u8_t       *p_rx_dma_buf;
+    u32_t                rx_dma_size;   /* power of 2 */
+#else
+    const RxRingOps_t   *p_rx_ring;
+#endif
+    u8_t                *p_tx_staging;  /* UART_TX_RESERVE_MAX bytes */
+    UartState_t         *p_state;
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+    GPIO_TypeDef        *p_rts_gpio;    /* NULL_PTR without flow control */
+    GpioPin_t            rts_pin;
+    u32_t                rts_high;      /* deassert RTS at this fill level */
+    u32_t                rts_low;       /* assert RTS at this fill level   */
+#endif
+} UartInstance_t;
+
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+/* RTS watermarks for a receive buffer of SIZE bytes. With receive DMA, the
+   fill level is only known when it is published, which happens at least every
+   half buffer. Up to half a buffer can therefore arrive before RTS is
+   updated. */
+    #if 1 == UART_RX_DMA_ENABLE
+        #define RTS_HIGH_WATER(SIZE)    (((SIZE) / 2u) - UART_RTS_SLACK)
+    #else
+        #define RTS_HIGH_WATER(SIZE)    ((SIZE) - UART_RTS_SLACK)
+    #endif
+    #define RTS_LOW_WATER(SIZE)         ((SIZE) / 4u)
+
+    #if 0 == UART1_ENABLE
+        #error UART1_FLOW_CONTROL_ENABLE needs USART1 buffers
+    #endif
+static_assert(RTS_HIGH_WATER(UART1_RX_BUF_SIZE) > RTS_LOW_WATER(UART1_RX_BUF_SIZE),
+              "UART1_RX_BUF_SIZE is too small for flow control");
+#endif
+
+/*
+ * Per port storage. Only ports with non-zero buffer sizes in uart_config.h
+ * are compiled in.
+ */
+#if 1 == UART1_ENABLE
+PRIVATE_RING_DECLARATIONS(uart1_tx_ring, u8_t)
+static const ByteRingOps_t uart1_tx_ring_ops = PRIVATE_RING_OPS(uart1_tx_ring);
+PRIVATE_RING_DECLARATIONS(uart1_urgent_ring, u8_t)
+static const ByteRingOps_t uart1_urgent_ring_ops = PRIVATE_RING_OPS(uart1_urgent_ring);
+PRIVATE_RING_DECLARATIONS(uart1_msg_ring, u32_t)
+static const WordRingOps_t uart1_msg_ring_ops = PRIVATE_RING_OPS(uart1_msg_ring);
+    #if 1 == UART_RX_DMA_ENABLE
+static_assert(0u == (UART1_RX_BUF_SIZE & (UART1_RX_BUF_SIZE - 1u)), "UART1_RX_BUF_SIZE must be a power of 2");
+static volatile u8_t uart1_rx_dma_buf[UART1_RX_BUF_SIZE];
+    #else
+PRIVATE_RING_DECLARATIONS(uart1_rx_ring, UART_RX_ENTRY_T)
+static const RxRingOps_t uart1_rx_ring_ops = PRIVATE_RING_OPS(uart1_rx_ring);
+    #endif
+static u8_t        uart1_tx_staging[UART_TX_RESERVE_MAX];
+static UartState_t uart1_state;
+
+static const UartInstance_t uart1 =
+{
+    .p_uart       = USART1,
+    .irq          = USART1_IRQn,
+    .p_tx_ring     = &uart1_tx_ring_ops,
+    .p_urgent_ring = &uart1_urgent_ring_ops,
+    .p_msg_ring    = &uart1_msg_ring_ops,
+    #if 1 == UART_TX_DMA_ENABLE
+    .tx_dma_ch    = DMA_CHANNEL_4,
+    .tx_dma_irq   = DMA1_Channel4_IRQn,
+    #endif
+    #if 1 == UART_RX_DMA_ENABLE
+    .rx_dma_ch    = DMA_CHANNEL_5,
+    .rx_dma_irq   = DMA1_Channel5_IRQn,
+    .p_rx_dma_buf = uart1_rx_dma_buf,
+    .rx_dma_size  = UART1_RX_BUF_SIZE,
+    #else
+    .p_rx_ring    = &uart1_rx_ring_ops,
+    #endif
+    .p_tx_staging = uart1_tx_staging,
+    .p_state      = &uart1_state,
+    #if 1 == UART1_FLOW_CONTROL_ENABLE
+    .p_rts_gpio   = GPIOA,
+    .rts_pin      = GPIO_PIN_12,
+    .rts_high     = RTS_HIGH_WATER(UART1_RX_BUF_SIZE),
+    .rts_low      = RTS_LOW_WATER(UART1_RX_BUF_SIZE),
+    #endif
+};
+#endif
+
+#if 1 == UART2_ENABLE
+PRIVATE_RING_DECLARATIONS(uart2_tx_ring, u8_t)
+static const ByteRingOps_t uart2_tx_ring_ops = PRIVATE_RING_OPS(uart2_tx_ring);
+PRIVATE_RING_DECLARATIONS(uart2_urgent_ring, u8_t)
+static const ByteRingOps_t uart2_urgent_ring_ops = PRIVATE_RING_OPS(uart2_urgent_ring);
+PRIVATE_RING_DECLARATIONS(uart2_msg_ring, u32_t)
+static const WordRingOps_t uart2_msg_ring_ops = PRIVATE_RING_OPS(uart2_msg_ring);
+    #if 1 == UART_RX_DMA_ENABLE
+static_assert(0u == (UART2_RX_BUF_SIZE & (UART2_RX_BUF_SIZE - 1u)), "UART2_RX_BUF_SIZE must be a power of 2");
+static volatile u8_t uart2_rx_dma_buf[UART2_RX_BUF_SIZE];
+    #else
+PRIVATE_RING_DECLARATIONS(uart2_rx_ring, UART_RX_ENTRY_T)
+static const RxRingOps_t uart2_rx_ring_ops = PRIVATE_RING_OPS(uart2_rx_ring);
+    #endif
+static u8_t        uart2_tx_staging[UART_TX_RESERVE_MAX];
+static UartState_t uart2_state;
+
+static const UartInstance_t uart2 =
+{
+    .p_uart       = USART2,
+    .irq          = USART2_IRQn,
+    .p_tx_ring     = &uart2_tx_ring_ops,
+    .p_urgent_ring = &uart2_urgent_ring_ops,
+    .p_msg_ring    = &uart2_msg_ring_ops,
+    #if 1 == UART_TX_DMA_ENABLE
+    .tx_dma_ch    = DMA_CHANNEL_7,
+    .tx_dma_irq   = DMA1_Channel7_IRQn,
+    #endif
+    #if 1 == UART_RX_DMA_ENABLE
+    .rx_dma_ch    = DMA_CHANNEL_6,
+    .rx_dma_irq   = DMA1_Channel6_IRQn,
+    .p_rx_dma_buf = uart2_rx_dma_buf,
+    .rx_dma_size  = UART2_RX_BUF_SIZE,
+    #else
+    .p_rx_ring    = &uart2_rx_ring_ops,
+    #endif
+    .p_tx_staging = uart2_tx_staging,
+    .p_state      = &uart2_state,
+    #if 1 == UART1_FLOW_CONTROL_ENABLE
+    .p_rts_gpio   = NULL_PTR,
+    #endif
+};
+#endif
 
-/* Readability macros for private ring functions */
-#define BYTE_RING_INIT(var_name)       PRIVATE_RING_INIT(ByteRing, var_name)
-#define BYTE_RING_IS_EMPTY(var_name)   PRIVATE_RING_IS_EMPTY(ByteRing, var_name)
-#define BYTE_RING_IS_FULL(var_name)    PRIVATE_RING_IS_FULL(ByteRing, var_name)
-#define BYTE_RING_PUSH(var_name, data) PRIVATE_RING_PUSH(ByteRing, var_name, data)
-#define BYTE_RING_POP(var_name)        PRIVATE_RING_POP(ByteRing, var_name)
-#define BYTE_RING_PEEK(var_name)       PRIVATE_RING_PEEK(ByteRing, var_name)
+#if 1 == UART3_ENABLE
+PRIVATE_RING_DECLARATIONS(uart3_tx_ring, u8_t)
+static const ByteRingOps_t uart3_tx_ring_ops = PRIVATE_RING_OPS(uart3_tx_ring);
+PRIVATE_RING_DECLARATIONS(uart3_urgent_ring, u8_t)
+static const ByteRingOps_t uart3_urgent_ring_ops = PRIVATE_RING_OPS(uart3_urgent_ring);
+PRIVATE_RING_DECLARATIONS(uart3_msg_ring, u32_t)
+static const WordRingOps_t uart3_msg_ring_ops = PRIVATE_RING_OPS(uart3_msg_ring);
+    #if 1 == UART_RX_DMA_ENABLE
+static_assert(0u == (UART3_RX_BUF_SIZE & (UART3_RX_BUF_SIZE - 1u)), "UART3_RX_BUF_SIZE must be a power of 2");
+static volatile u8_t uart3_rx_dma_buf[UART3_RX_BUF_SIZE];
+    #else
+PRIVATE_RING_DECLARATIONS(uart3_rx_ring, UART_RX_ENTRY_T)
+static const RxRingOps_t uart3_rx_ring_ops = PRIVATE_RING_OPS(uart3_rx_ring);
+    #endif
+static u8_t        uart3_tx_staging[UART_TX_RESERVE_MAX];
+static UartState_t uart3_state;
 
+static const UartInstance_t uart3 =
+{
+    .p_uart       = USART3,
+    .irq          = USART3_IRQn,
+    .p_tx_ring     = &uart3_tx_ring_ops,
+    .p_urgent_ring = &uart3_urgent_ring_ops,
+    .p_msg_ring    = &uart3_msg_ring_ops,
+    #if 1 == UART_TX_DMA_ENABLE
+    .tx_dma_ch    = DMA_CHANNEL_2,
+    .tx_dma_irq   = DMA1_Channel2_IRQn,
+    #endif
+    #if 1 == UART_RX_DMA_ENABLE
+    .rx_dma_ch    = DMA_CHANNEL_3,
+    .rx_dma_irq   = DMA1_Channel3_IRQn,
+    .p_rx_dma_buf = uart3_rx_dma_buf,
+    .rx_dma_size  = UART3_RX_BUF_SIZE,
+    #else
+    .p_rx_ring    = &uart3_rx_ring_ops,
+    #endif
+    .p_tx_staging = uart3_tx_staging,
+    .p_state      = &uart3_state,
+    #if 1 == UART1_FLOW_CONTROL_ENABLE
+    .p_rts_gpio   = NULL_PTR,
+    #endif
+};
+#endif
+
+static const UartInstance_t* instance_get(USART_TypeDef* p_uart);
+static void usart_isr(const UartInstance_t * const p_inst);
 static void usart_clock_enable(USART_TypeDef* p_uart);
+static u32_t usart_clock_hz(USART_TypeDef* p_uart);
+static bool_t baud_to_brr(u32_t clk_hz, u32_t baud, u32_t *p_brr, u32_t *p_actual, s32_t *p_error_ppm);
+static s32_t rate_error_ppm(u32_t rate, u32_t ref);
+static void tx_drain(const UartInstance_t * const p_inst);
+#if 1 == UART1_AUTOBAUD_ENABLE
+static void autobaud_arm(void);
+static void autobaud_capture(void);
+static void autobaud_measure(u32_t width);
+static bool_t autobaud_pick_brr(u32_t width, u32_t *p_brr);
+#endif
+static void tx_kick(const UartInstance_t * const p_inst);
+static void tx_msg_end(const UartInstance_t * const p_inst, size_t len);
+static size_t tx_next_span(const UartInstance_t * const p_inst, u8_t **pp_span, TxLane_t *p_lane);
+static void tx_span_done(const UartInstance_t * const p_inst, TxLane_t lane, size_t len);
+#if UART_ECHO_AVAILABLE
+static size_t echo_span(const UartInstance_t * const p_inst, u8_t **pp_span);
+#endif
+static void rx_errors_count(const UartInstance_t * const p_inst, u32_t status_reg);
+static void event_raise(const UartInstance_t * const p_inst, u32_t events);
+static void event_dispatch(void);
+static void event_deliver(const UartInstance_t * const p_inst);
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+static void rts_update(const UartInstance_t * const p_inst);
+#endif
+#if 1 == UART_TX_DMA_ENABLE
+static void tx_dma_isr(const UartInstance_t * const p_inst);
+static void tx_dma_next_segment(const UartInstance_t * const p_inst);
+#endif
+#if 1 == UART_RX_DMA_ENABLE
+static void rx_dma_isr(const UartInstance_t * const p_inst);
+static void rx_dma_publish(const UartInstance_t * const p_inst);
+static bool_t rx_dma_has_newline(const UartInstance_t * const p_inst, u32_t pos, u32_t len);
+static size_t rx_dma_count(const UartInstance_t * const p_inst);
+static u32_t rx_dma_written(const UartInstance_t * const p_inst);
+static size_t rx_dma_read(const UartInstance_t * const p_inst, u8_t * const p_bytes, size_t len);
+#endif
+#if 1 == UART_RX_TIMESTAMP_ENABLE
+static size_t rx_ring_read_stamped(const UartInstance_t * const p_inst, u8_t * const p_bytes, u32_t * const p_stamps, size_t len);
+#endif
+
+/* Deferred work item that delivers the events of all ports. Registered by the
+   first uart_init. */
+static DeferredWork_t event_work = DEFERRED_NO_WORK;
+
+#if 1 == UART1_AUTOBAUD_ENABLE
+/* Autobaud state of USART1. The detector runs in the TIM1 capture interrupt. */
+static volatile UartAutobaudState_t autobaud_state;
+static volatile bool_t              autobaud_measuring; /* start edge seen */
+static volatile u16_t               autobaud_c0;        /* start edge capture */
+static volatile u32_t               autobaud_t0;        /* start edge time (cycle counter) */
+static volatile u32_t               autobaud_detected;
+static volatile u32_t               autobaud_actual;
+static volatile s32_t               autobaud_error_ppm;
+
+/* Standard rates a measurement is snapped to (see UART_AUTOBAUD_SNAP_PPM):
+   the sync pulse widths in CPU cycles that are taken to be the rate and the
+   rate's BRR value. The compiler works the table out, so the edge interrupt
+   only compares. Fastest first, where the interrupt has the least time. */
+typedef struct autobaud_rate
+{
+    u32_t width_min;
+    u32_t width_max;
+    u32_t brr;
+} AutobaudRate_t;
+
+#define AUTOBAUD_WIDTH(rate)    ((AUTOBAUD_SYNC_BITS * F_CPU_HZ) / (rate))
+#define AUTOBAUD_SLACK(rate)    ((u32_t)(((u64_t)AUTOBAUD_WIDTH(rate) * UART_AUTOBAUD_SNAP_PPM) / 1000000u))
+#define AUTOBAUD_RATE(rate)     { AUTOBAUD_WIDTH(rate) - AUTOBAUD_SLACK(rate),  \
+                                  AUTOBAUD_WIDTH(rate) + AUTOBAUD_SLACK(rate),  \
+                                  (APB2_CLK_HZ + ((rate) / 2u)) / (rate) }
+
+static const AutobaudRate_t autobaud_std_rates[] =
+{
+    AUTOBAUD_RATE(4500000u), AUTOBAUD_RATE(4000000u), AUTOBAUD_RATE(3000000u),
+    AUTOBAUD_RATE(2500000u), AUTOBAUD_RATE(2000000u), AUTOBAUD_RATE(1500000u),
+    AUTOBAUD_RATE(1152000u), AUTOBAUD_RATE(1000000u), AUTOBAUD_RATE(921600u),
+    AUTOBAUD_RATE(576000u),  AUTOBAUD_RATE(500000u),  AUTOBAUD_RATE(460800u),
+    AUTOBAUD_RATE(230400u),  AUTOBAUD_RATE(115200u),  AUTOBAUD_RATE(57600u),
+    AUTOBAUD_RATE(38400u),   AUTOBAUD_RATE(19200u),   AUTOBAUD_RATE(9600u),
+};
+
+#define AUTOBAUD_NUM_STD_RATES  (sizeof(autobaud_std_rates) / sizeof(autobaud_std_rates[0]))
+#endif
 
 /**
  * @brief Initialize the UART hardware driver.
+ *
+ * Traps if the port is not compiled in (see uart_config.h).
  */
 void uart_init(USART_TypeDef* p_uart)
 {
-    /* Since this module relies on global data, we are going to limit the usage
-       of this driver to USART1 only. */
-    if (USART1 != p_uart) {
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+
+    if (NULL_PTR == p_inst) {
         bsp_error_trap();
     }
 
+    UartState_t * const p_state = p_inst->p_state;
+
     /* Initialize byte rings */
-    BYTE_RING_INIT(rx_ring);
-    BYTE_RING_INIT(tx_ring);
+#if 0 == UART_RX_DMA_ENABLE
+    p_inst->p_rx_ring->init();
+#endif
+    p_inst->p_tx_ring->init();
+    p_inst->p_urgent_ring->init();
+    p_inst->p_msg_ring->init();
+    p_state->tx_reserve_len    = 0;
+    p_state->tx_reserve_staged = E_FALSE;
+    p_state->tx_queued         = 0;
+    p_state->tx_sent           = 0;
+    p_state->tx_msg_left       = 0;
+
+    p_state->errors.overrun = 0;
+    p_state->errors.framing = 0;
+    p_state->errors.noise   = 0;
+    p_state->errors.dropped = 0;
+
+    p_state->event_mask = 0;
+    p_state->event_cb   = NULL_PTR;
+    p_state->event_id   = 0;
+    p_state->events     = 0;
+
+    if (DEFERRED_NO_WORK == event_work) {
+        event_work = deferred_register(event_dispatch);
+    }
 
     /* Configure the USART interrupt for about middle of the range of available
        interrupt priorities.
      */
     const u32_t usart_irq_prio = (1UL << __NVIC_PRIO_BITS) / 2;
-    NVIC_SetPriority(USART1_IRQn, usart_irq_prio);
+    NVIC_SetPriority(p_inst->irq, usart_irq_prio);
 
     /* Enable the USART interrupt in the NVIC */
-    NVIC_EnableIRQ(USART1_IRQn);
+    NVIC_EnableIRQ(p_inst->irq);
+
+#if 1 == UART_TX_DMA_ENABLE
+    /* The transmit DMA channel interrupt shares the USART's priority, so the
+       two never preempt each other. */
+    p_state->tx_dma_len    = 0;
+    p_state->tx_dma_lane   = TX_LANE_NORMAL;
+    dma_init();
+    dma_configure(p_inst->tx_dma_ch, &p_uart->DR,
+        DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_TEIE);
+    NVIC_SetPriority(p_inst->tx_dma_irq, usart_irq_prio);
+    NVIC_EnableIRQ(p_inst->tx_dma_irq);
+#endif
+
+#if UART_ECHO_AVAILABLE
+    p_state->echo_on    = E_FALSE;
+    p_state->echo_bytes = 0;
+#endif
+
+#if 1 == UART_RX_DMA_ENABLE
+    /* The receive DMA runs continuously from here on. Its interrupt shares
+       the USART's priority so a publish is never interrupted by another. */
+    p_state->rx_dma_head     = 0;
+    p_state->rx_dma_tail     = 0;
+    p_state->rx_dma_last_pos = 0;
+    dma_init();
+    dma_configure(p_inst->rx_dma_ch, &p_uart->DR,
+        DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PL_1 |
+        DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_TEIE);
+    dma_start(p_inst->rx_dma_ch, p_inst->p_rx_dma_buf, p_inst->rx_dma_size);
+    NVIC_SetPriority(p_inst->rx_dma_irq, usart_irq_prio);
+    NVIC_EnableIRQ(p_inst->rx_dma_irq);
+#endif
+
+#if 1 == RING_STATS_ENABLE
+    #if 1 == UART_RX_DMA_ENABLE
+    p_state->rx_dma_stats.high_water   = 0;
+    p_state->rx_dma_stats.push_rejects = 0;
+    p_state->rx_dma_stats.pop_empties  = 0;
+    p_state->rx_dma_stats.total_pushed = 0;
+    #endif
+    p_state->tx_irq_count  = 0;
+    p_state->tx_irq_cycles = 0;
+#endif
+
+    /* The cycle counter times the interrupts (statistics) and stamps received
+       bytes (uart_read_stamped). */
+    cycles_init();
 
     /* Enable the USART's clock in the RCC */
     usart_clock_enable(p_uart);
@@ -69,17 +523,133 @@ void uart_init(USART_TypeDef* p_uart)
     /* Enable the USART for configuration */
     p_uart->CR1 |= (USART_CR1_UE);
 
-    /* Set the baud rate as calculated from the #defines */
-    const u32_t div_mantissa = DIV_WHOLE << USART_BRR_DIV_Mantissa_Pos;
-    const u32_t div_frac     = DIV_FRAC  << USART_BRR_DIV_Fraction_Pos;
+    /* Set the default baud rate. The default is known to be within the
+       register limits, so the result is not checked. */
+    u32_t brr;
+    u32_t actual;
+    s32_t error_ppm;
 
-    p_uart->BRR = div_mantissa | div_frac;  
+    (void)baud_to_brr(usart_clock_hz(p_uart), UART_DEFAULT_BAUD, &brr, &actual, &error_ppm);
+    p_uart->BRR = brr;
 
     /* 8 data bits, 1 stop bit, and no parity are selected by default after
        zero'ing the control registers. */
- 
+
     /* Enable USART transmitter and receiver. */
-    p_uart->CR1 |= (USART_CR1_RXNEIE | USART_CR1_TE | USART_CR1_RE);    
+    p_uart->CR1 |= (USART_CR1_TE | USART_CR1_RE);
+
+#if 1 == UART_RX_DMA_ENABLE
+    /* Received bytes go straight to the DMA. The USART only interrupts when
+       the line goes idle after a burst. */
+    p_uart->CR3 |= USART_CR3_DMAR;
+    p_uart->CR1 |= USART_CR1_IDLEIE;
+
+    /* Receive errors do not come with an RXNE interrupt in DMA mode, so they
+       need their own. */
+    p_uart->CR3 |= USART_CR3_EIE;
+#else
+    p_uart->CR1 |= USART_CR1_RXNEIE;
+#endif
+
+#if 1 == UART_TX_DMA_ENABLE
+    /* Let the transmitter raise DMA requests instead of TXE interrupts. */
+    p_uart->CR3 |= USART_CR3_DMAT;
+#endif
+
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+    if (NULL_PTR != p_inst->p_rts_gpio) {
+        /* The transmitter waits for CTS. RTS was left deasserted by the pin
+           setup and is asserted now that the receiver is ready. */
+        p_uart->CR3 |= USART_CR3_CTSE;
+        rts_update(p_inst);
+    }
+#endif
+}
+
+/**
+ * @brief Check if a port is compiled into the driver
+ *
+ * @retval E_TRUE  - the port has buffers and can be initialized
+ * @retval E_FALSE - the port's buffer sizes are 0 (see uart_config.h)
+ */
+bool_t uart_is_enabled(USART_TypeDef* p_uart)
+{
+    return (NULL_PTR != instance_get(p_uart)) ? E_TRUE : E_FALSE;
+}
+
+/**
+ * @brief Check if a port was built with RTS/CTS flow control
+ *
+ * The caller configures the CTS pin as an input and the RTS pin as a general
+ * purpose output driven high (deasserted) before calling uart_init.
+ *
+ * @retval E_TRUE  - the driver uses CTS and drives RTS
+ * @retval E_FALSE - no flow control (see UART1_FLOW_CONTROL_ENABLE)
+ */
+bool_t uart_has_flow_control(USART_TypeDef* p_uart)
+{
+    bool_t result = E_FALSE;
+
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+
+    if ((NULL_PTR != p_inst) && (NULL_PTR != p_inst->p_rts_gpio)) {
+        result = E_TRUE;
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * @brief Change the baud rate
+ *
+ * The baud rate register is computed with integer math. The achieved rate is
+ * the USART clock divided by the register value, so it can differ from the
+ * requested rate. Rates the register can not hold, or that would be off by
+ * more than UART_BAUD_MAX_ERROR_PPM, are rejected and the current rate is
+ * kept.
+ *
+ * Before the rate is changed, the transmit buffer is drained and the last
+ * frame is allowed to leave the shift register. This blocks until the
+ * transmitter is done, so interrupts must be enabled if bytes are queued.
+ *
+ * @param[in]  baud        requested baud rate
+ * @param[out] p_actual    achieved baud rate (may be NULL)
+ * @param[out] p_error_ppm achieved rate error in parts per million relative to
+ *                         the requested rate (may be NULL)
+ *
+ * @retval E_TRUE  - baud rate changed
+ * @retval E_FALSE - baud rate rejected or the port is not compiled in
+ */
+bool_t uart_set_baud(USART_TypeDef* p_uart, u32_t baud, u32_t * const p_actual, s32_t * const p_error_ppm)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result;
+    u32_t  brr;
+    u32_t  actual;
+    s32_t  error_ppm;
+
+    result = baud_to_brr(usart_clock_hz(p_uart), baud, &brr, &actual, &error_ppm);
+
+    if (NULL_PTR != p_actual) {
+        *p_actual = actual;
+    }
+
+    if (NULL_PTR != p_error_ppm) {
+        *p_error_ppm = error_ppm;
+    }
+
+    if (NULL_PTR == p_inst) {
+        result = E_FALSE;
+    }
+
+    if (E_TRUE == result) {
+        tx_drain(p_inst);
+        p_uart->BRR = brr;
+    }
+
+    return result;
 }
 
 /**
@@ -90,9 +660,20 @@ void uart_init(USART_TypeDef* p_uart)
  */
 bool_t uart_data_available(USART_TypeDef* p_uart)
 {
+    const UartInstance_t * const p_inst = instance_get(p_uart);
     bool_t available;
 
-    if (E_TRUE == BYTE_RING_IS_EMPTY(rx_ring)) {
+    if (NULL_PTR == p_inst) {
+        available = E_FALSE;
+#if UART_ECHO_AVAILABLE
+    } else if (E_TRUE == p_inst->p_state->echo_on) {
+        available = E_FALSE;
+#endif
+#if 1 == UART_RX_DMA_ENABLE
+    } else if (0 == rx_dma_count(p_inst)) {
+#else
+    } else if (E_TRUE == p_inst->p_rx_ring->is_empty()) {
+#endif
         available = E_FALSE;
     } else {
         available = E_TRUE;
@@ -111,9 +692,8 @@ u8_t uart_read(USART_TypeDef* p_uart)
 {
     u8_t byte;
 
-    if (E_TRUE == uart_data_available(p_uart)) {
-        byte = BYTE_RING_POP(rx_ring);
-    } else {
+    /* A single byte read is a bulk read of one. */
+    if (1u != uart_read_buf(p_uart, &byte, 1u)) {
         byte = '\0';
     }
 
@@ -130,62 +710,1641 @@ u8_t uart_read(USART_TypeDef* p_uart)
  */
 bool_t uart_write(USART_TypeDef* p_uart, u8_t byte)
 {
-    bool_t result;
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result = E_FALSE;
 
-    /* If the ring is not full, add the byte to the buffer. */
-    if (E_FALSE == BYTE_RING_IS_FULL(tx_ring)) {
-        BYTE_RING_PUSH(tx_ring, byte);
-        result = E_TRUE;
-    } else {
-        result = E_FALSE;
+    if (NULL_PTR != p_inst) {
+        /* The byte is dropped when the ring is full. */
+        if (E_FALSE == p_inst->p_tx_ring->is_full()) {
+            tx_msg_end(p_inst, 1u);
+            result = p_inst->p_tx_ring->push(byte);
+        }
+
+        /* Regardless of the buffer state, we need to start the transmitter to
+           empty the byte we just added (or the back up of bytes preventing the
+           ring push) */
+        tx_kick(p_inst);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Read up to len bytes from the driver's buffer
+ *
+ * @param[out] p_bytes destination for the received bytes
+ * @param[in]  len     maximum number of bytes to read
+ *
+ * @return The number of bytes copied into p_bytes.
+ */
+size_t uart_read_buf(USART_TypeDef* p_uart, u8_t * const p_bytes, size_t len)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    size_t avail = 0;
+
+    if (NULL_PTR != p_inst) {
+#if UART_ECHO_AVAILABLE
+        /* The echo owns the received bytes. */
+        if (E_FALSE == p_inst->p_state->echo_on) {
+            avail = rx_dma_read(p_inst, p_bytes, len);
+        }
+#elif 1 == UART_RX_DMA_ENABLE
+        avail = rx_dma_read(p_inst, p_bytes, len);
+#elif 1 == UART_RX_TIMESTAMP_ENABLE
+        avail = rx_ring_read_stamped(p_inst, p_bytes, NULL_PTR, len);
+#else
+        avail = p_inst->p_rx_ring->pop_n(p_bytes, len);
+#endif
+
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+        /* Room was made, the far end may be allowed to send again. */
+        rts_update(p_inst);
+#endif
+    }
+
+    return avail;
+}
+
+/**
+ * @brief Read up to len bytes and their arrival times from the driver's buffer
+ *
+ * Stamps are cycle counter values (F_CPU_HZ) with the low 8 bits cleared.
+ * With UART_RX_TIMESTAMP_ENABLE, a stamp is the time the receive interrupt
+ * took the byte from the USART. Without it, the driver does not keep arrival
+ * times and every byte is stamped with the time of this call.
+ *
+ * @param[out] p_bytes  destination for the received bytes
+ * @param[out] p_stamps destination for the byte's stamps (same index)
+ * @param[in]  len      maximum number of bytes to read
+ *
+ * @return The number of bytes (and stamps) copied out.
+ */
+size_t uart_read_stamped(USART_TypeDef* p_uart, u8_t * const p_bytes, u32_t * const p_stamps, size_t len)
+{
+    size_t avail;
+
+#if 1 == UART_RX_TIMESTAMP_ENABLE
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+
+    avail = 0;
+    if (NULL_PTR != p_inst) {
+        avail = rx_ring_read_stamped(p_inst, p_bytes, p_stamps, len);
+
+    #if 1 == UART1_FLOW_CONTROL_ENABLE
+        rts_update(p_inst);
+    #endif
+    }
+#else
+    const u32_t stamp = cycles_now() & UART_RX_STAMP_MASK;
+    size_t i;
+
+    avail = uart_read_buf(p_uart, p_bytes, len);
+    for (i = 0; i < avail; i += 1) {
+        p_stamps[i] = stamp;
+    }
+#endif
+
+    return avail;
+}
+
+/**
+ * @brief Write up to len bytes to the driver's buffer
+ *
+ * Bytes are copied into the transmit ring in (at most) two contiguous chunks
+ * instead of one ring operation per byte.
+ *
+ * @param[in] p_bytes data bytes to transmit over the UART
+ * @param[in] len     number of bytes in p_bytes
+ *
+ * @return The number of bytes accepted by the driver. Anything short of len
+ * did not fit in the transmit buffer.
+ */
+size_t uart_write_buf(USART_TypeDef* p_uart, const u8_t * const p_bytes, size_t len)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    size_t written = 0;
+
+    if (NULL_PTR != p_inst) {
+        /* Only the transmitter frees space in the ring, so whatever fits now
+           still fits when it is pushed. The message ends there. */
+        written = p_inst->p_tx_ring->space();
+        if (written > len) {
+            written = len;
+        }
+
+        tx_msg_end(p_inst, written);
+        (void)p_inst->p_tx_ring->push_n(p_bytes, written);
+
+        /* Start the transmitter to empty the ring (see uart_write). */
+        tx_kick(p_inst);
     }
 
-    /* Regardless of the buffer state, we need to enable the transmitter to
-       empty the byte we just added (or the back up of bytes preventing the
-       ring push) */
-    p_uart->CR1 |= USART_CR1_TXEIE;
+    return written;
+}
+
+/**
+ * @brief Write all len bytes to the driver's buffer or none of them
+ *
+ * @param[in] p_bytes data bytes to transmit over the UART
+ * @param[in] len     number of bytes in p_bytes
+ *
+ * @retval E_TRUE  - all bytes accepted by the driver
+ * @retval E_FALSE - not enough room in the transmit buffer, nothing written
+ */
+bool_t uart_write_buf_all(USART_TypeDef* p_uart, const u8_t * const p_bytes, size_t len)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result = E_FALSE;
+
+    if (NULL_PTR != p_inst) {
+        /* Only the transmitter frees space in the ring, so if the bytes fit
+           now they still fit when they are pushed. */
+        if (p_inst->p_tx_ring->space() >= len) {
+            tx_msg_end(p_inst, len);
+            (void)p_inst->p_tx_ring->push_n(p_bytes, len);
+            result = E_TRUE;
+        }
+
+        /* Start the transmitter to empty the ring (see uart_write). */
+        tx_kick(p_inst);
+    }
 
     return result;
 }
 
-void USART1_IRQHandler(void)
+/**
+ * @brief Room in the driver's transmit buffer
+ *
+ * Only the transmitter frees space, so a write of up to this many bytes made
+ * right after the call is accepted in full.
+ *
+ * @return Number of bytes that can be written, 0 for a port that is not
+ * enabled.
+ */
+size_t uart_tx_space(USART_TypeDef* p_uart)
 {
-    u32_t status_reg;
-    u32_t data;
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    size_t space = 0;
 
-    /* Inspect the status register for USART state */
-    status_reg = USART1->SR;
+    if (NULL_PTR != p_inst) {
+        space = p_inst->p_tx_ring->space();
+    }
+
+    return space;
+}
+
+/**
+ * @brief Reserve len bytes of the transmit buffer to be filled in place
+ *
+ * The reservation is all or nothing. Either the caller gets len writable bytes
+ * or nothing is reserved. Nothing is sent until uart_tx_commit is called, and
+ * only one reservation per port can be outstanding at a time (a second
+ * reserve replaces the first). Other writes to the port must not be made
+ * while a reservation is outstanding.
+ *
+ * @param[in] len number of bytes to reserve
+ *
+ * @return Pointer to the reserved bytes or NULL_PTR if there is not enough
+ * room in the transmit buffer.
+ */
+u8_t* uart_tx_reserve(USART_TypeDef* p_uart, size_t len)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    UartState_t *p_state;
+    u8_t  *p_span = NULL_PTR;
+    size_t span_len;
 
-    if (0 != (status_reg & USART_SR_TXE)) {
-        /* Transmitter empty interrupt */
-        if (E_TRUE == BYTE_RING_IS_EMPTY(tx_ring)) {
-            USART1->CR1 &= ~USART_CR1_TXEIE;
+    if (NULL_PTR != p_inst) {
+        p_state = p_inst->p_state;
+
+        p_state->tx_reserve_len    = 0;
+        p_state->tx_reserve_staged = E_FALSE;
+
+        span_len = p_inst->p_tx_ring->write_span(&p_span);
+
+        if (span_len >= len) {
+            /* Zero copy: the caller writes straight into the ring. */
+            p_state->tx_reserve_len = len;
+        } else if ((len <= UART_TX_RESERVE_MAX) && (p_inst->p_tx_ring->space() >= len)) {
+            /* There is room, but it wraps around the end of the ring. With no
+               other writes in between, the room can only grow until the
+               commit (see uart_write_buf_all). */
+            p_span                     = p_inst->p_tx_staging;
+            p_state->tx_reserve_len    = len;
+            p_state->tx_reserve_staged = E_TRUE;
         } else {
-            data = BYTE_RING_POP(tx_ring);
-            USART1->DR = data;
+            p_span = NULL_PTR;
         }
-    } 
-    
-    if (0 != (status_reg & USART_SR_RXNE)) {
-        data = USART1->DR;
+    }
+
+    return p_span;
+}
+
+/**
+ * @brief Hand the first n bytes of the outstanding reservation to the
+ * transmitter
+ *
+ * @param[in] n number of reserved bytes that were filled in. Clamped to the
+ *              reserved length.
+ */
+void uart_tx_commit(USART_TypeDef* p_uart, size_t n)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    UartState_t *p_state;
+    size_t len;
 
-        if (E_FALSE == BYTE_RING_IS_FULL(rx_ring)) {
-            data &= 0xFF;
-            BYTE_RING_PUSH(rx_ring, data);
+    if (NULL_PTR != p_inst) {
+        p_state = p_inst->p_state;
+        len     = (n < p_state->tx_reserve_len) ? n : p_state->tx_reserve_len;
+
+        tx_msg_end(p_inst, len);
+        if (E_TRUE == p_state->tx_reserve_staged) {
+            (void)p_inst->p_tx_ring->push_n(p_inst->p_tx_staging, len);
+        } else {
+            p_inst->p_tx_ring->write_commit(len);
         }
+
+        p_state->tx_reserve_len    = 0;
+        p_state->tx_reserve_staged = E_FALSE;
+
+        /* Start the transmitter to empty the ring (see uart_write). */
+        tx_kick(p_inst);
     }
 }
 
-static void usart_clock_enable(USART_TypeDef* p_uart)
+/**
+ * @brief Write a message to the urgent transmit lane
+ *
+ * The urgent lane has its own buffer (UART_TX_URGENT_BUF_SIZE) and is sent
+ * ahead of everything written with the other write functions. The transmitter
+ * only switches lanes where a normal message ends, so an urgent message never
+ * lands in the middle of another one. A normal message is the data of one
+ * write, write_buf, write_buf_all or tx_commit call. The urgent message waits
+ * at most for the normal transfer in progress, which always stops at a
+ * message end and never runs past the end of the transmit ring.
+ *
+ * @param[in] p_bytes message bytes
+ * @param[in] len     number of bytes in p_bytes
+ *
+ * @retval E_TRUE  - the whole message was queued
+ * @retval E_FALSE - not enough room in the urgent buffer (nothing written) or
+ *                   the port is not compiled in
+ */
+bool_t uart_write_urgent(USART_TypeDef* p_uart, const u8_t * const p_bytes, size_t len)
 {
-    if (USART1 == p_uart) {
-        RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result = E_FALSE;
+
+    if (NULL_PTR != p_inst) {
+        /* Urgent messages are all or nothing, so the urgent lane only ever
+           holds whole messages and needs no message ends of its own. */
+        if (p_inst->p_urgent_ring->space() >= len) {
+            (void)p_inst->p_urgent_ring->push_n(p_bytes, len);
+            result = E_TRUE;
+        }
+
+        tx_kick(p_inst);
     }
-    else {
-        const u32_t en = (USART2 == p_uart) ? RCC_APB1ENR_USART2EN :
-                         (USART3 == p_uart) ? RCC_APB1ENR_USART3EN :
-                                              0                    ;
 
-        RCC->APB1ENR |= en;
+    return result;
+}
+
+/**
+ * @brief Read the driver's ring statistics
+ *
+ * @param[out] p_rx statistics of the receive ring
+ * @param[out] p_tx statistics of the transmit ring
+ *
+ * @retval E_TRUE  - statistics copied out
+ * @retval E_FALSE - ring statistics are compiled out (see RING_STATS_ENABLE)
+ *                   or the port is not compiled in
+ */
+bool_t uart_get_stats(USART_TypeDef* p_uart, RingStats_t * const p_rx, RingStats_t * const p_tx)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result;
+
+    if (NULL_PTR == p_inst) {
+        result = E_FALSE;
+    } else {
+#if (1 == UART_RX_DMA_ENABLE) && (1 == RING_STATS_ENABLE)
+        const volatile RingStats_t * const p_dma = &p_inst->p_state->rx_dma_stats;
+
+        p_rx->high_water   = p_dma->high_water;
+        p_rx->push_rejects = p_dma->push_rejects;
+        p_rx->pop_empties  = p_dma->pop_empties;
+        p_rx->total_pushed = p_dma->total_pushed;
+        result = E_TRUE;
+#elif 1 == UART_RX_DMA_ENABLE
+        result = E_FALSE;
+#else
+        result = p_inst->p_rx_ring->get_stats(p_rx);
+#endif
+    }
+
+    if (E_TRUE == result) {
+        result = p_inst->p_tx_ring->get_stats(p_tx);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Read the driver's transmit interrupt accounting
+ *
+ * @param[out] p_irqs   number of interrupts serviced for the transmitter
+ * @param[out] p_cycles CPU cycles spent servicing those interrupts
+ *
+ * @retval E_TRUE  - counters copied out
+ * @retval E_FALSE - counters are compiled out (see RING_STATS_ENABLE) or the
+ *                   port is not compiled in
+ */
+bool_t uart_get_irq_stats(USART_TypeDef* p_uart, u32_t * const p_irqs, u32_t * const p_cycles)
+{
+#if 1 == RING_STATS_ENABLE
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result = E_FALSE;
+
+    if (NULL_PTR != p_inst) {
+        *p_irqs   = p_inst->p_state->tx_irq_count;
+        *p_cycles = p_inst->p_state->tx_irq_cycles;
+        result    = E_TRUE;
     }
-}
\ No newline at end of file
+
+    return result;
+#else
+    return E_FALSE;
+#endif
+}
+
+/**
+ * @brief Read the driver's receive error counters
+ *
+ * @param[out] p_errors error counts since uart_init
+ *
+ * @retval E_TRUE  - counters copied out
+ * @retval E_FALSE - the port is not compiled in
+ */
+bool_t uart_get_errors(USART_TypeDef* p_uart, UartErrors_t * const p_errors)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result = E_FALSE;
+
+    if (NULL_PTR != p_inst) {
+        const volatile UartErrors_t * const p_src = &p_inst->p_state->errors;
+
+        p_errors->overrun = p_src->overrun;
+        p_errors->framing = p_src->framing;
+        p_errors->noise   = p_src->noise;
+        p_errors->dropped = p_src->dropped;
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Select the events a port raises and how they are delivered
+ *
+ * With a callback, raised events are handed to cb from the deferred work
+ * handler at DEFERRED_IRQ_PRIO. Without one (cb NULL), raised events collect
+ * in the driver until uart_take_events is called. Events raised before this
+ * call are discarded.
+ *
+ * @param[in] mask UART_EVENT_* flags to raise (0 turns events off)
+ * @param[in] cb   callback or NULL to poll with uart_take_events
+ * @param[in] id   value passed back to cb
+ *
+ * @retval E_TRUE  - events configured
+ * @retval E_FALSE - the port is not compiled in or no deferred work item was
+ *                   left for the callback
+ */
+bool_t uart_set_events(USART_TypeDef* p_uart, u32_t mask, UartEventCallback_t cb, u32_t id)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    bool_t result = E_FALSE;
+
+    if ((NULL_PTR != p_inst) && ((NULL_PTR == cb) || (DEFERRED_NO_WORK != event_work))) {
+        UartState_t * const p_state = p_inst->p_state;
+
+        /* Turn the events off while the callback changes, so an interrupt
+           never pairs the new callback with the old id. The mask goes back on
+           last. */
+        p_state->event_mask = 0;
+        __sync_synchronize();
+        p_state->event_cb = cb;
+        p_state->event_id = id;
+        (void)__sync_fetch_and_and(&p_state->events, 0UL);
+        __sync_synchronize();
+        p_state->event_mask = mask;
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Take the events raised since the last call
+ *
+ * Meant for ports without an event callback (see uart_set_events).
+ *
+ * @return UART_EVENT_* flags (0 if none were raised or the port is not
+ * compiled in).
+ */
+u32_t uart_take_events(USART_TypeDef* p_uart)
+{
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    u32_t events = 0;
+
+    if (NULL_PTR != p_inst) {
+        events = __sync_fetch_and_and(&p_inst->p_state->events, 0UL);
+    }
+
+    return events;
+}
+
+/**
+ * @brief Turn the zero copy echo on or off
+ *
+ * While the echo is on, every received byte is sent back out of the port by
+ * pointing the transmit DMA at the receive DMA buffer. The CPU copies
+ * nothing, and reads return no data. Bytes written to the port go out between
+ * echoed segments. If the transmitter falls more than the receive buffer
+ * behind (e.g. held off by CTS), the oldest bytes are lost and counted as
+ * dropped.
+ *
+ * The receive buffer's read position has one owner at a time: the transmit
+ * DMA interrupt while the echo is on, the reader while it is off. Turning the
+ * echo off therefore waits for an echo segment in flight to finish (at most
+ * one receive buffer's worth of bytes), so the reader takes over a position
+ * that no longer moves. Call from the context that reads the port, with
+ * interrupts enabled.
+ *
+ * @param[in] enable E_TRUE to start echoing, E_FALSE to stop
+ *
+ * @retval E_TRUE  - echo state changed
+ * @retval E_FALSE - the port is not compiled in or the driver was built
+ *                   without transmit and receive DMA
+ */
+bool_t uart_set_echo(USART_TypeDef* p_uart, bool_t enable)
+{
+    bool_t result = E_FALSE;
+
+#if UART_ECHO_AVAILABLE
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+    UartState_t *p_state;
+
+    if (NULL_PTR != p_inst) {
+        p_state = p_inst->p_state;
+        p_state->echo_on = enable;
+
+        if (E_TRUE == enable) {
+            /* Echo whatever is already waiting. */
+            tx_kick(p_inst);
+        } else {
+            /* No echo segment starts once echo_on is clear, since segments
+               only start in the DMA interrupt. The one in flight (if any)
+               still moves the read position when it completes. */
+            while ((0 != p_state->tx_dma_len) && (TX_LANE_ECHO == p_state->tx_dma_lane)) {
+                /* wait for the echo segment */
+            }
+        }
+
+        result = E_TRUE;
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * @brief Number of bytes sent by the zero copy echo
+ *
+ * @return Free running count of echoed bytes since uart_init (0 without
+ * echo support).
+ */
+u32_t uart_echo_count(USART_TypeDef* p_uart)
+{
+    u32_t count = 0;
+
+#if UART_ECHO_AVAILABLE
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+
+    if (NULL_PTR != p_inst) {
+        count = p_inst->p_state->echo_bytes;
+    }
+#endif
+
+    return count;
+}
+
+/**
+ * @brief Detect the baud rate from the next byte the far end sends
+ *
+ * The transmitter is drained and the receiver is turned off. The far end then
+ * sends the sync character 0x80, which is timed on the RX pin. The detected
+ * rate (or the standard rate it is within UART_AUTOBAUD_SNAP_PPM of) is
+ * programmed and the receiver is turned back on. The sync character itself is
+ * not received. Nothing may be written to the port until uart_autobaud_status
+ * reports a result.
+ *
+ * Any rate the USART can generate from its clock (up to 4.5 Mbaud on USART1)
+ * can be detected. Both edges of the sync character are captured by TIM1_CH3
+ * at the CPU clock, so the timing error is one cycle over 8 bit times however
+ * late the interrupt runs. Only turning the receiver back on waits for the
+ * interrupt: it is back on a few dozen cycles after the low pulse ends, which
+ * is inside the two bit times before the next start bit up to about 2 Mbaud.
+ * Above that, or if interrupts may be masked for longer, the far end must
+ * pause (one character time is plenty) after the sync character.
+ *
+ * @retval E_TRUE  - waiting for the sync character
+ * @retval E_FALSE - the port does not support autobaud (see
+ *                   UART1_AUTOBAUD_ENABLE)
+ */
+bool_t uart_autobaud_start(USART_TypeDef* p_uart)
+{
+    bool_t result = E_FALSE;
+
+#if 1 == UART1_AUTOBAUD_ENABLE
+    const UartInstance_t * const p_inst = instance_get(p_uart);
+
+    if ((NULL_PTR != p_inst) && (USART1 == p_uart)) {
+        NVIC_DisableIRQ(TIM1_CC_IRQn);
+        tx_drain(p_inst);
+        p_uart->CR1 &= ~USART_CR1_RE;
+
+        autobaud_detected  = 0;
+        autobaud_actual    = 0;
+        autobaud_error_ppm = 0;
+        autobaud_state     = UART_AUTOBAUD_WAITING;
+        autobaud_arm();
+
+        /* The edges are timed by the capture hardware. The interrupt gets the
+           highest priority so the receiver is back on before the next start
+           bit. */
+        NVIC_SetPriority(TIM1_CC_IRQn, 0);
+        NVIC_EnableIRQ(TIM1_CC_IRQn);
+        result = E_TRUE;
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * @brief Read the result of automatic baud rate detection
+ *
+ * @param[out] p_detected rate measured on the line (may be NULL)
+ * @param[out] p_actual   rate programmed into the USART (may be NULL)
+ * @param[out] p_error_ppm error of the programmed rate relative to the
+ *                         measured rate in parts per million (may be NULL)
+ *
+ * @return Detection state. The rates are only filled in once the state is
+ * UART_AUTOBAUD_LOCKED or UART_AUTOBAUD_FAILED.
+ */
+UartAutobaudState_t uart_autobaud_status(USART_TypeDef* p_uart, u32_t * const p_detected, u32_t * const p_actual, s32_t * const p_error_ppm)
+{
+    UartAutobaudState_t state = UART_AUTOBAUD_OFF;
+    u32_t detected = 0;
+    u32_t actual   = 0;
+    s32_t ppm      = 0;
+
+#if 1 == UART1_AUTOBAUD_ENABLE
+    if ((USART1 == p_uart) && (NULL_PTR != instance_get(p_uart))) {
+        state = autobaud_state;
+        if ((UART_AUTOBAUD_LOCKED == state) || (UART_AUTOBAUD_FAILED == state)) {
+            detected = autobaud_detected;
+            actual   = autobaud_actual;
+            ppm      = autobaud_error_ppm;
+        }
+    }
+#endif
+
+    if (NULL_PTR != p_detected) {
+        *p_detected = detected;
+    }
+
+    if (NULL_PTR != p_actual) {
+        *p_actual = actual;
+    }
+
+    if (NULL_PTR != p_error_ppm) {
+        *p_error_ppm = ppm;
+    }
+
+    return state;
+}
+
+/*
+ * Interrupt handlers. Each port gets its USART handler and (with DMA) its two
+ * DMA channel handlers. Ports that are not compiled in leave the default
+ * handlers in place.
+ */
+#if 1 == UART1_ENABLE
+void USART1_IRQHandler(void)
+{
+    usart_isr(&uart1);
+}
+
+    #if 1 == UART_TX_DMA_ENABLE
+void DMA1_Channel4_IRQHandler(void)
+{
+    tx_dma_isr(&uart1);
+}
+    #endif
+
+    #if 1 == UART_RX_DMA_ENABLE
+void DMA1_Channel5_IRQHandler(void)
+{
+    rx_dma_isr(&uart1);
+}
+    #endif
+#endif
+
+#if 1 == UART2_ENABLE
+void USART2_IRQHandler(void)
+{
+    usart_isr(&uart2);
+}
+
+    #if 1 == UART_TX_DMA_ENABLE
+void DMA1_Channel7_IRQHandler(void)
+{
+    tx_dma_isr(&uart2);
+}
+    #endif
+
+    #if 1 == UART_RX_DMA_ENABLE
+void DMA1_Channel6_IRQHandler(void)
+{
+    rx_dma_isr(&uart2);
+}
+    #endif
+#endif
+
+#if 1 == UART3_ENABLE
+void USART3_IRQHandler(void)
+{
+    usart_isr(&uart3);
+}
+
+    #if 1 == UART_TX_DMA_ENABLE
+void DMA1_Channel2_IRQHandler(void)
+{
+    tx_dma_isr(&uart3);
+}
+    #endif
+
+    #if 1 == UART_RX_DMA_ENABLE
+void DMA1_Channel3_IRQHandler(void)
+{
+    rx_dma_isr(&uart3);
+}
+    #endif
+#endif
+
+#if 1 == UART1_AUTOBAUD_ENABLE
+void TIM1_CC_IRQHandler(void)
+{
+    autobaud_capture();
+}
+#endif
+
+/*
+ * Find the driver instance of a USART. NULL_PTR if the port is not compiled
+ * in.
+ */
+static const UartInstance_t* instance_get(USART_TypeDef* p_uart)
+{
+    const UartInstance_t *p_inst = NULL_PTR;
+
+#if 1 == UART1_ENABLE
+    if (USART1 == p_uart) {
+        p_inst = &uart1;
+    }
+#endif
+#if 1 == UART2_ENABLE
+    if (USART2 == p_uart) {
+        p_inst = &uart2;
+    }
+#endif
+#if 1 == UART3_ENABLE
+    if (USART3 == p_uart) {
+        p_inst = &uart3;
+    }
+#endif
+
+    return p_inst;
+}
+
+static void usart_isr(const UartInstance_t * const p_inst)
+{
+    USART_TypeDef * const p_uart = p_inst->p_uart;
+    u32_t status_reg;
+
+    /* Inspect the status register for USART state */
+    status_reg = p_uart->SR;
+
+    rx_errors_count(p_inst, status_reg);
+
+#if 0 == UART_TX_DMA_ENABLE
+    if ((0 != (p_uart->CR1 & USART_CR1_TXEIE)) && (0 != (status_reg & USART_SR_TXE))) {
+    #if 1 == RING_STATS_ENABLE
+        const u32_t start = cycles_now();
+    #endif
+
+        /* Transmitter empty interrupt. One byte at a time from whichever
+           lane is next. */
+        u8_t  *p_span;
+        TxLane_t lane;
+
+        if (0 == tx_next_span(p_inst, &p_span, &lane)) {
+            p_uart->CR1 &= ~USART_CR1_TXEIE;
+            event_raise(p_inst, UART_EVENT_TX_DRAINED);
+        } else {
+            p_uart->DR = p_span[0];
+            tx_span_done(p_inst, lane, 1u);
+        }
+
+    #if 1 == RING_STATS_ENABLE
+        p_inst->p_state->tx_irq_count  += 1;
+        p_inst->p_state->tx_irq_cycles += cycles_now() - start;
+    #endif
+    }
+#endif
+
+#if 1 == UART_RX_DMA_ENABLE
+    if (0 != (status_reg & USART_SR_IDLE)) {
+        /* The IDLE flag is cleared by the status register read above followed
+           by a data register read. The line is idle, so the read does not take
+           a byte away from the DMA. */
+        (void)p_uart->DR;
+        rx_dma_publish(p_inst);
+    } else if ((0 != (status_reg & (USART_SR_ORE | USART_SR_FE | USART_SR_NE))) &&
+               (0 == (status_reg & USART_SR_RXNE))) {
+        /* An error flag is cleared by the status register read above followed
+           by a data register read. The data register read normally comes
+           from the DMA, but if the DMA already took the byte, finish the
+           sequence here or the error interrupt keeps firing. */
+        (void)p_uart->DR;
+    }
+#else
+    if (0 != (status_reg & USART_SR_RXNE)) {
+        const u32_t data = p_uart->DR;
+    #if 1 == UART_RX_TIMESTAMP_ENABLE
+        const u32_t entry = (cycles_now() & UART_RX_STAMP_MASK) | (data & 0xFF);
+    #else
+        const u8_t  entry = (u8_t)(data & 0xFF);
+    #endif
+
+        /* The byte is dropped if the receive ring is full. */
+        if (E_FALSE == p_inst->p_rx_ring->push(entry)) {
+            p_inst->p_state->errors.dropped += 1;
+        } else {
+            event_raise(p_inst, ('\n' == (data & 0xFF)) ?
+                (UART_EVENT_RX_DATA | UART_EVENT_RX_LINE) : UART_EVENT_RX_DATA);
+        }
+
+    #if 1 == UART1_FLOW_CONTROL_ENABLE
+        rts_update(p_inst);
+    #endif
+    }
+#endif
+}
+
+/*
+ * Count the receive errors flagged in a status register value. Interrupt
+ * context only.
+ */
+static void rx_errors_count(const UartInstance_t * const p_inst, u32_t status_reg)
+{
+    volatile UartErrors_t * const p_errors = &p_inst->p_state->errors;
+
+    if (0 != (status_reg & USART_SR_ORE)) {
+        p_errors->overrun += 1;
+    }
+
+    if (0 != (status_reg & USART_SR_FE)) {
+        p_errors->framing += 1;
+    }
+
+    if (0 != (status_reg & USART_SR_NE)) {
+        p_errors->noise += 1;
+    }
+}
+
+/*
+ * Raise events on a port. Events outside the port's mask are ignored. Safe to
+ * call from any of the port's interrupts.
+ */
+static void event_raise(const UartInstance_t * const p_inst, u32_t events)
+{
+    UartState_t * const p_state = p_inst->p_state;
+
+    events &= p_state->event_mask;
+    if (0 != events) {
+        (void)__sync_fetch_and_or(&p_state->events, events);
+
+        if (NULL_PTR != p_state->event_cb) {
+            deferred_post(event_work);
+        }
+    }
+}
+
+/*
+ * Deferred work item. Hands the raised events of every port with a callback
+ * to the callback.
+ */
+static void event_dispatch(void)
+{
+#if 1 == UART1_ENABLE
+    event_deliver(&uart1);
+#endif
+#if 1 == UART2_ENABLE
+    event_deliver(&uart2);
+#endif
+#if 1 == UART3_ENABLE
+    event_deliver(&uart3);
+#endif
+}
+
+static void event_deliver(const UartInstance_t * const p_inst)
+{
+    UartState_t * const       p_state = p_inst->p_state;
+    const UartEventCallback_t cb      = p_state->event_cb;
+    u32_t events;
+
+    if (NULL_PTR != cb) {
+        events = __sync_fetch_and_and(&p_state->events, 0UL);
+        if (0 != events) {
+            cb(p_state->event_id, events);
+        }
+    }
+}
+
+#if 1 == UART_TX_DMA_ENABLE
+static void tx_dma_isr(const UartInstance_t * const p_inst)
+{
+    UartState_t * const p_state = p_inst->p_state;
+    u32_t flags;
+#if 1 == RING_STATS_ENABLE
+    const u32_t start = cycles_now();
+#endif
+
+    flags = dma_get_flags(p_inst->tx_dma_ch);
+    dma_clear_flags(p_inst->tx_dma_ch, flags);
+
+    /* A completed segment is handed back to the producer. On a transfer error
+       the segment is dropped rather than retried. */
+    if (0 != (flags & (DMA_FLAG_TC | DMA_FLAG_TE))) {
+        dma_stop(p_inst->tx_dma_ch);
+        tx_span_done(p_inst, p_state->tx_dma_lane, p_state->tx_dma_len);
+        p_state->tx_dma_len = 0;
+    }
+
+    /* This also runs when the interrupt was pended by tx_kick. In that case
+       there are no flags set and the DMA might already be busy. */
+    if (0 == p_state->tx_dma_len) {
+        tx_dma_next_segment(p_inst);
+
+        /* A segment finished and there was nothing left to start. */
+        if ((0 == p_state->tx_dma_len) && (0 != (flags & DMA_FLAG_TC))) {
+            event_raise(p_inst, UART_EVENT_TX_DRAINED);
+        }
+    }
+
+#if 1 == RING_STATS_ENABLE
+    p_state->tx_irq_count  += 1;
+    p_state->tx_irq_cycles += cycles_now() - start;
+#endif
+}
+
+/*
+ * Start the DMA on the next contiguous segment of the transmit lanes (if
+ * any). Must only be called from the DMA interrupt.
+ */
+static void tx_dma_next_segment(const UartInstance_t * const p_inst)
+{
+    u8_t    *p_span;
+    TxLane_t lane;
+    size_t   len;
+
+    len = tx_next_span(p_inst, &p_span, &lane);
+    if (0 != len) {
+        p_inst->p_state->tx_dma_lane   = lane;
+        p_inst->p_state->tx_dma_len    = len;
+
+        /* The DMA's writes to DR do not clear TC the way the TXE interrupt's
+           status read and data write do. Clear it here (writing 1 leaves the
+           other flags alone), so TC only reads set again once the segment's
+           last frame is out (see tx_drain). */
+        p_inst->p_uart->SR = ~USART_SR_TC;
+        dma_start(p_inst->tx_dma_ch, p_span, len);
+    }
+}
+#endif
+
+#if 1 == UART_RX_DMA_ENABLE
+static void rx_dma_isr(const UartInstance_t * const p_inst)
+{
+    u32_t flags;
+
+    flags = dma_get_flags(p_inst->rx_dma_ch);
+    dma_clear_flags(p_inst->rx_dma_ch, flags);
+
+    /* Publish whatever arrived before the error, then restart the buffer
+       from the top. The hardware disables the channel on a transfer error. */
+    rx_dma_publish(p_inst);
+    if (0 != (flags & DMA_FLAG_TE)) {
+        dma_start(p_inst->rx_dma_ch, p_inst->p_rx_dma_buf, p_inst->rx_dma_size);
+        p_inst->p_state->rx_dma_last_pos = 0;
+    }
+}
+
+/*
+ * Advance the published write count to the DMA's current position in the
+ * circular buffer. Must only be called from the USART and DMA interrupts,
+ * which share a priority. The half and full transfer interrupts guarantee a call at least
+ * every half buffer, so the position can not move a full lap between calls.
+ */
+static void rx_dma_publish(const UartInstance_t * const p_inst)
+{
+    UartState_t * const p_state = p_inst->p_state;
+    const u32_t mask  = p_inst->rx_dma_size - 1u;
+    const u32_t pos   = (p_inst->rx_dma_size - dma_remaining(p_inst->rx_dma_ch)) & mask;
+    const u32_t delta = (pos - p_state->rx_dma_last_pos) & mask;
+    u32_t events      = UART_EVENT_RX_DATA;
+
+    /* The line scan costs a pass over the new bytes, so it is only done when
+       someone asked for line events. */
+    if ((0 != (p_state->event_mask & UART_EVENT_RX_LINE)) &&
+        (E_TRUE == rx_dma_has_newline(p_inst, p_state->rx_dma_last_pos, delta))) {
+        events |= UART_EVENT_RX_LINE;
+    }
+
+    p_state->rx_dma_last_pos = pos;
+
+    __sync_synchronize(); /* DMA writes land before head is published */
+    p_state->rx_dma_head += delta;
+
+    if (0 != delta) {
+        event_raise(p_inst, events);
+
+    #if UART_ECHO_AVAILABLE
+        if (E_TRUE == p_state->echo_on) {
+            tx_kick(p_inst);
+        }
+    #endif
+    }
+
+#if 1 == RING_STATS_ENABLE
+    const u32_t level = p_state->rx_dma_head - p_state->rx_dma_tail;
+
+    p_state->rx_dma_stats.total_pushed += delta;
+    if (level > p_state->rx_dma_stats.high_water) {
+        p_state->rx_dma_stats.high_water = level;
+    }
+#endif
+
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+    rts_update(p_inst);
+#endif
+}
+
+/*
+ * Check len bytes of the receive buffer, starting at buffer position pos, for
+ * a '\n'.
+ */
+static bool_t rx_dma_has_newline(const UartInstance_t * const p_inst, u32_t pos, u32_t len)
+{
+    const u32_t mask = p_inst->rx_dma_size - 1u;
+    bool_t found     = E_FALSE;
+    u32_t  i;
+
+    for (i = 0; (i < len) && (E_FALSE == found); i += 1) {
+        if ('\n' == p_inst->p_rx_dma_buf[(pos + i) & mask]) {
+            found = E_TRUE;
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Number of received bytes waiting to be read. If the DMA has lapped the
+ * reader, everything older than the last buffer's worth of bytes was
+ * overwritten. The reader then skips ahead to the oldest byte still in the
+ * buffer, and only the overwritten bytes are counted as lost. Consumer side
+ * only.
+ */
+static size_t rx_dma_count(const UartInstance_t * const p_inst)
+{
+    UartState_t * const p_state = p_inst->p_state;
+    const u32_t head = p_state->rx_dma_head;
+    u32_t used       = head - p_state->rx_dma_tail;
+    u32_t lost;
+
+    if (used > p_inst->rx_dma_size) {
+        lost = used - p_inst->rx_dma_size;
+        p_state->errors.dropped += lost;
+    #if 1 == RING_STATS_ENABLE
+        p_state->rx_dma_stats.push_rejects += lost;
+    #endif
+        p_state->rx_dma_tail = head - p_inst->rx_dma_size;
+        used                 = p_inst->rx_dma_size;
+    }
+
+    return used;
+}
+
+/*
+ * Free running count of bytes the DMA has written, including the ones not
+ * published yet. Consumer side only: the head and the position it was
+ * published at are re-read until no publish ran in between.
+ */
+static u32_t rx_dma_written(const UartInstance_t * const p_inst)
+{
+    const UartState_t * const p_state = p_inst->p_state;
+    const u32_t mask = p_inst->rx_dma_size - 1u;
+    u32_t head;
+    u32_t last_pos;
+    u32_t pos;
+
+    do {
+        head     = p_state->rx_dma_head;
+        last_pos = p_state->rx_dma_last_pos;
+        pos      = (p_inst->rx_dma_size - dma_remaining(p_inst->rx_dma_ch)) & mask;
+        __sync_synchronize();
+    } while ((head != p_state->rx_dma_head) || (last_pos != p_state->rx_dma_last_pos));
+
+    return head + ((pos - last_pos) & mask);
+}
+
+/*
+ * Copy up to len received bytes out of the DMA buffer and hand their slots
+ * back. Consumer side only.
+ *
+ * The DMA keeps writing past the published head while the bytes are copied.
+ * Once the copy is done, any copied byte whose slot the DMA has written again
+ * since is dropped (and counted as lost) and the rest are moved down.
+ */
+static size_t rx_dma_read(const UartInstance_t * const p_inst, u8_t * const p_bytes, size_t len)
+{
+    UartState_t * const p_state = p_inst->p_state;
+    const u32_t         mask    = p_inst->rx_dma_size - 1u;
+    size_t avail;
+    size_t i;
+    u32_t  t;
+    u32_t  oldest;
+    u32_t  lost = 0;
+
+    avail = rx_dma_count(p_inst);
+    if (avail > len) {
+        avail = len;
+    }
+
+    __sync_synchronize(); /* head observed before data is read */
+    t = p_state->rx_dma_tail;
+    for (i = 0; i < avail; i += 1) {
+        p_bytes[i] = p_inst->p_rx_dma_buf[(t + i) & mask];
+    }
+    __sync_synchronize(); /* data read before the slots are handed back */
+    p_state->rx_dma_tail = t + avail;
+
+    /* Bytes older than the last buffer's worth the DMA has written are gone */
+    oldest = rx_dma_written(p_inst) - p_inst->rx_dma_size;
+    if ((s32_t)(oldest - t) > 0) {
+        lost = oldest - t;
+        if (lost > avail) {
+            lost = (u32_t)avail;
+        }
+        for (i = lost; i < avail; i += 1) {
+            p_bytes[i - lost] = p_bytes[i];
+        }
+        avail -= lost;
+
+        p_state->errors.dropped += lost;
+    #if 1 == RING_STATS_ENABLE
+        p_state->rx_dma_stats.push_rejects += lost;
+    #endif
+    }
+
+#if 1 == RING_STATS_ENABLE
+    if ((0 == avail) && (0 != len)) {
+        p_state->rx_dma_stats.pop_empties += 1;
+    }
+#endif
+
+    return avail;
+}
+#endif
+
+#if 1 == UART_RX_TIMESTAMP_ENABLE
+/*
+ * Pop up to len stamped entries from the receive ring and split them into
+ * bytes and stamps. p_stamps may be NULL_PTR. Consumer side only.
+ */
+static size_t rx_ring_read_stamped(const UartInstance_t * const p_inst, u8_t * const p_bytes, u32_t * const p_stamps, size_t len)
+{
+    u32_t *p_span;
+    size_t span_len;
+    size_t popped = 0;
+    size_t i;
+
+    /* At most two passes: up to the end of the ring, then from the start. */
+    while (popped < len) {
+        span_len = p_inst->p_rx_ring->read_span(&p_span);
+        if (0 == span_len) {
+            break;
+        }
+
+        if (span_len > (len - popped)) {
+            span_len = len - popped;
+        }
+
+        for (i = 0; i < span_len; i += 1) {
+            p_bytes[popped + i] = (u8_t)(p_span[i] & 0xFF);
+            if (NULL_PTR != p_stamps) {
+                p_stamps[popped + i] = p_span[i] & UART_RX_STAMP_MASK;
+            }
+        }
+
+        p_inst->p_rx_ring->read_commit(span_len);
+        popped += span_len;
+    }
+
+    return popped;
+}
+#endif
+
+#if 1 == UART1_FLOW_CONTROL_ENABLE
+/*
+ * Drive RTS (active low) from the receive buffer level. Called by both the
+ * producer (interrupts) and the consumer. If the two race, the pin can end up
+ * one step behind the level, which the next call from either side corrects.
+ * The watermark slack covers the difference.
+ */
+static void rts_update(const UartInstance_t * const p_inst)
+{
+    u32_t level;
+
+    if (NULL_PTR != p_inst->p_rts_gpio) {
+#if 1 == UART_RX_DMA_ENABLE
+        level = p_inst->p_state->rx_dma_head - p_inst->p_state->rx_dma_tail;
+#else
+        level = p_inst->p_rx_ring->count();
+#endif
+
+        if (level >= p_inst->rts_high) {
+            gpio_write_pin(p_inst->p_rts_gpio, p_inst->rts_pin, E_BIT_1); /* stop */
+        } else if (level <= p_inst->rts_low) {
+            gpio_write_pin(p_inst->p_rts_gpio, p_inst->rts_pin, E_BIT_0); /* go   */
+        }
+    }
+}
+#endif
+
+/*
+ * Record the end of a normal message of len bytes that is about to be pushed
+ * to the transmit ring. The end goes in before the bytes, so the transmitter
+ * never sees bytes of a message without knowing where it ends (unless the
+ * message ring is full). Producer side only.
+ */
+static void tx_msg_end(const UartInstance_t * const p_inst, size_t len)
+{
+    UartState_t * const p_state = p_inst->p_state;
+
+    if (0 != len) {
+        p_state->tx_queued += len;
+
+        /* If the end can not be recorded, this message is merged with the
+           next one. */
+        (void)p_inst->p_msg_ring->push(p_state->tx_queued);
+    }
+}
+
+/*
+ * Pick the next contiguous span to transmit. The urgent lane goes first, but
+ * only at a normal message end. A normal span never runs past the end of the
+ * message it belongs to. Echoed bytes go last, also only at a normal message
+ * end. Transmit interrupts only.
+ */
+static size_t tx_next_span(const UartInstance_t * const p_inst, u8_t **pp_span, TxLane_t *p_lane)
+{
+    UartState_t * const p_state = p_inst->p_state;
+    size_t len = 0;
+    s32_t  left;
+    s32_t  next;
+
+    *p_lane = TX_LANE_NORMAL;
+
+    if (0 == p_state->tx_msg_left) {
+        len = p_inst->p_urgent_ring->read_span(pp_span);
+        if (0 != len) {
+            *p_lane = TX_LANE_URGENT;
+        }
+    }
+
+    if (0 == len) {
+        len = p_inst->p_tx_ring->read_span(pp_span);
+
+        if ((0 != len) && (0 == p_state->tx_msg_left)) {
+            /* Start of a new message. While no urgent bytes are waiting,
+               messages that end within the span are sent together, so short
+               writes do not cost a transfer each. Ends at or behind tx_sent
+               were already passed and are skipped. Without a recorded end,
+               the bytes in the ring are taken as one message. */
+            left = 0;
+            while (E_FALSE == p_inst->p_msg_ring->is_empty()) {
+                next = (s32_t)(p_inst->p_msg_ring->peek() - p_state->tx_sent);
+
+                if ((0 < next) && (0 < left) &&
+                    ((next > (s32_t)len) || (E_FALSE == p_inst->p_urgent_ring->is_empty()))) {
+                    break;
+                }
+
+                (void)p_inst->p_msg_ring->pop();
+                if (next > left) {
+                    left = next;
+                }
+            }
+
+            p_state->tx_msg_left = (0 < left) ? (u32_t)left : p_inst->p_tx_ring->count();
+        }
+
+        if (len > p_state->tx_msg_left) {
+            len = p_state->tx_msg_left;
+        }
+    }
+
+#if UART_ECHO_AVAILABLE
+    if ((0 == len) && (0 == p_state->tx_msg_left) && (E_TRUE == p_state->echo_on)) {
+        len = echo_span(p_inst, pp_span);
+        *p_lane = TX_LANE_ECHO;
+    }
+#endif
+
+    return len;
+}
+
+/*
+ * Hand a transmitted span back to its lane. Transmit interrupts only.
+ */
+static void tx_span_done(const UartInstance_t * const p_inst, TxLane_t lane, size_t len)
+{
+    UartState_t * const p_state = p_inst->p_state;
+
+    switch (lane) {
+        case TX_LANE_URGENT:
+            p_inst->p_urgent_ring->read_commit(len);
+            break;
+        case TX_LANE_ECHO:
+#if UART_ECHO_AVAILABLE
+            /* The bytes are sent, hand the slots back to the receive DMA. */
+            __sync_synchronize();
+            p_state->rx_dma_tail += len;
+            p_state->echo_bytes  += len;
+#endif
+            break;
+        case TX_LANE_NORMAL:
+        default:
+            p_inst->p_tx_ring->read_commit(len);
+            p_state->tx_sent     += len;
+            p_state->tx_msg_left -= len;
+            break;
+    }
+}
+
+#if UART_ECHO_AVAILABLE
+/*
+ * Next contiguous span of received bytes to echo, straight out of the receive
+ * DMA buffer. The receive position is published first, so a busy link echoes
+ * whatever arrived during the previous segment. Transmit DMA interrupt only
+ * (it shares the receive interrupts' priority).
+ */
+static size_t echo_span(const UartInstance_t * const p_inst, u8_t **pp_span)
+{
+    UartState_t * const p_state = p_inst->p_state;
+    u32_t pos;
+    u32_t to_end;
+    u32_t len;
+
+    rx_dma_publish(p_inst);
+
+    /* Also resyncs (and counts the loss) if the receiver lapped the echo. */
+    len    = rx_dma_count(p_inst);
+    pos    = p_state->rx_dma_tail & (p_inst->rx_dma_size - 1u);
+    to_end = p_inst->rx_dma_size - pos;
+    if (len > to_end) {
+        len = to_end;
+    }
+
+    __sync_synchronize(); /* head observed before the span is read */
+
+    /* The DMA reads the buffer as plain memory. */
+    *pp_span = (u8_t*)&p_inst->p_rx_dma_buf[pos];
+
+    return len;
+}
+#endif
+
+#if 1 == UART1_AUTOBAUD_ENABLE
+/*
+ * Capture both edges of the RX pin (PA10) with TIM1 counting at the CPU clock:
+ * falling edges on channel 3 and rising edges on channel 4, which is mapped to
+ * the same input (TI3). Then wait for the falling edge of a start bit.
+ */
+static void autobaud_arm(void)
+{
+    RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+    (void)RCC->APB2ENR;
+
+    AUTOBAUD_TIMER->CR1   = 0;
+    AUTOBAUD_TIMER->DIER  = 0;
+    AUTOBAUD_TIMER->CCER  = 0;
+    AUTOBAUD_TIMER->PSC   = 0;
+    AUTOBAUD_TIMER->ARR   = 0xFFFFu;
+    AUTOBAUD_TIMER->CCMR2 = TIM_CCMR2_CC3S_0 | TIM_CCMR2_CC4S_1;
+    AUTOBAUD_TIMER->CCER  = TIM_CCER_CC3E | TIM_CCER_CC3P | TIM_CCER_CC4E;
+    AUTOBAUD_TIMER->EGR   = TIM_EGR_UG;
+    AUTOBAUD_TIMER->SR    = 0;
+
+    autobaud_measuring = E_FALSE;
+    AUTOBAUD_TIMER->DIER  = TIM_DIER_CC3IE | TIM_DIER_CC4IE;
+    AUTOBAUD_TIMER->CR1   = TIM_CR1_CEN;
+}
+
+/*
+ * Capture interrupt of the sync character. The falling edge (channel 3)
+ * starts the measurement and the rising edge (channel 4) ends it. Interrupt
+ * context only.
+ *
+ * The captures are exact but only 16 bits wide, while a sync pulse at low
+ * rates lasts up to 8 * BRR_MAX cycles. Each capture is therefore also placed
+ * on the cycle counter, from how far the timer has run since. That rough time
+ * only picks the number of whole timer periods, so it may be off by anything
+ * short of half a period (the interrupt must run within about 0.9 ms of
+ * each edge).
+ *
+ * If the interrupt was held off, both flags may be up. The edges are then
+ * taken in the order they happened: a falling edge before the rising one
+ * starts a new measurement, one after it is the next start bit.
+ */
+static void autobaud_capture(void)
+{
+    const u32_t sr = AUTOBAUD_TIMER->SR;
+    const bool_t fall = (0u != (sr & TIM_SR_CC3IF)) ? E_TRUE : E_FALSE;
+    const bool_t rise = (0u != (sr & TIM_SR_CC4IF)) ? E_TRUE : E_FALSE;
+    /* Reading a capture register clears its flag. */
+    const u16_t c3 = (u16_t)AUTOBAUD_TIMER->CCR3;
+    const u16_t c4 = (u16_t)AUTOBAUD_TIMER->CCR4;
+    /* Both captures are older than this pair. */
+    const u16_t cnt = (u16_t)AUTOBAUD_TIMER->CNT;
+    const u32_t now = cycles_now();
+    const u32_t t3  = now - (u16_t)(cnt - c3);
+    const u32_t t4  = now - (u16_t)(cnt - c4);
+    const bool_t fall_first = ((E_TRUE == fall) &&
+                               ((E_FALSE == rise) || ((s32_t)(t4 - t3) >= 0))) ? E_TRUE : E_FALSE;
+    u16_t fine;
+    u32_t rough;
+
+    if (E_TRUE == fall_first) {
+        /* Start bit (or noise). Wait for the end of the low pulse. */
+        autobaud_c0        = c3;
+        autobaud_t0        = t3;
+        autobaud_measuring = E_TRUE;
+    }
+
+    if ((E_TRUE == rise) && (E_TRUE == autobaud_measuring)) {
+        /* Exact low 16 bits, whole periods from the cycle counter. */
+        fine  = (u16_t)(c4 - autobaud_c0);
+        rough = t4 - autobaud_t0;
+        autobaud_measure((u32_t)fine + ((rough - fine + 0x8000u) & 0xFFFF0000u));
+    }
+
+    if ((E_TRUE == fall) && (E_FALSE == fall_first) &&
+        (UART_AUTOBAUD_WAITING == autobaud_state)) {
+        /* The low pulse that just ended was noise, this one may be the
+           start bit. */
+        autobaud_c0        = c3;
+        autobaud_t0        = t3;
+        autobaud_measuring = E_TRUE;
+    }
+}
+
+/*
+ * Sync pulse of width (CPU cycles) received. Interrupt context only.
+ *
+ * The next start bit can follow the rising edge by as little as two bit
+ * times, so the receiver goes back on first and the rates that are only
+ * reported (with their divisions) are worked out after.
+ */
+static void autobaud_measure(u32_t width)
+{
+    const UartInstance_t * const p_inst = &uart1;
+    bool_t usable;
+    u32_t  brr;
+    u32_t  measured;
+    u32_t  actual;
+
+    if (width < AUTOBAUD_MIN_CYCLES) {
+        /* Noise, wait for a real start bit. */
+        autobaud_measuring = E_FALSE;
+    } else {
+        AUTOBAUD_TIMER->DIER = 0;
+        AUTOBAUD_TIMER->CR1  = 0;
+        AUTOBAUD_TIMER->CCER = 0;
+
+        /* The line is in bit 7 or the stop bit (high), so the receiver starts
+           cleanly on the next start bit. On failure the old rate is kept. */
+        usable = autobaud_pick_brr(width, &brr);
+        if (E_TRUE == usable) {
+            p_inst->p_uart->BRR = brr;
+        }
+        p_inst->p_uart->CR1 |= USART_CR1_RE;
+
+        /* rate = bits / (width / F_CPU_HZ), rounded to nearest */
+        measured = ((AUTOBAUD_SYNC_BITS * F_CPU_HZ) + (width / 2u)) / width;
+        actual   = (APB2_CLK_HZ + (brr / 2u)) / brr;
+
+        autobaud_measuring = E_FALSE;
+        autobaud_detected  = measured;
+        autobaud_actual    = actual;
+        autobaud_error_ppm = rate_error_ppm(actual, measured);
+        autobaud_state     = (E_TRUE == usable) ? UART_AUTOBAUD_LOCKED : UART_AUTOBAUD_FAILED;
+    }
+}
+
+/*
+ * BRR value for a sync pulse width (CPU cycles). A width close to a standard
+ * rate gets that rate's value. Otherwise the value is the bit time itself
+ * (USART1 runs at the CPU clock), which is only usable within the register
+ * limits and about UART_BAUD_MAX_ERROR_PPM of the measurement. Shifts and
+ * compares only, see autobaud_measure. *p_brr is always within the register
+ * limits.
+ */
+static bool_t autobaud_pick_brr(u32_t width, u32_t *p_brr)
+{
+    bool_t result  = E_FALSE;
+    bool_t snapped = E_FALSE;
+    u32_t  brr;
+    u32_t  diff;
+    size_t i;
+
+    for (i = 0; (i < AUTOBAUD_NUM_STD_RATES) && (E_FALSE == snapped); i += 1) {
+        if ((width >= autobaud_std_rates[i].width_min) &&
+            (width <= autobaud_std_rates[i].width_max)) {
+            brr     = autobaud_std_rates[i].brr;
+            snapped = E_TRUE;
+        }
+    }
+
+    if (E_TRUE == snapped) {
+        result = E_TRUE;
+    } else {
+        /* Rounded to nearest. The division by a power of 2 is a shift. */
+        brr  = (width + (AUTOBAUD_SYNC_BITS / 2u)) / AUTOBAUD_SYNC_BITS;
+        diff = ((brr * AUTOBAUD_SYNC_BITS) > width) ? ((brr * AUTOBAUD_SYNC_BITS) - width) :
+                                                      (width - (brr * AUTOBAUD_SYNC_BITS));
+
+        if (brr > BRR_MAX) {
+            brr = BRR_MAX;
+        } else if ((diff * (1000000u / UART_BAUD_MAX_ERROR_PPM)) <= width) {
+            result = E_TRUE;
+        }
+    }
+
+    *p_brr = brr;
+
+    return result;
+}
+#endif
+
+/*
+ * Wait until both transmit lanes are empty, the DMA is done with its segment
+ * (which may be an echo segment that is in neither ring) and the last frame
+ * has been shifted out. TC is set out of reset, so this does not hang on a
+ * transmitter that was never used. With the DMA, TC is cleared as each
+ * segment starts, so it cannot be left over from an earlier transfer. Needs
+ * interrupts enabled if bytes are queued.
+ */
+static void tx_drain(const UartInstance_t * const p_inst)
+{
+    while ((E_FALSE == p_inst->p_tx_ring->is_empty()) ||
+           (E_FALSE == p_inst->p_urgent_ring->is_empty())) {
+        /* wait for the transmitter */
+    }
+
+#if 1 == UART_TX_DMA_ENABLE
+    while (0 != p_inst->p_state->tx_dma_len) {
+        /* wait for the segment in flight */
+    }
+#endif
+
+    while (0 == (p_inst->p_uart->SR & USART_SR_TC)) {
+        /* wait for the shift register */
+    }
+}
+
+/*
+ * Get the transmitter going after bytes were added to the transmit ring.
+ */
+static void tx_kick(const UartInstance_t * const p_inst)
+{
+#if 1 == UART_TX_DMA_ENABLE
+    /* All DMA (re)starts happen in the DMA interrupt, so there is no race with
+       a segment completing. If the DMA is idle, pend its interrupt to start the
+       next segment. NVIC pending is a plain register write. */
+    if (0 == p_inst->p_state->tx_dma_len) {
+        NVIC_SetPendingIRQ(p_inst->tx_dma_irq);
+    }
+#else
+    p_inst->p_uart->CR1 |= USART_CR1_TXEIE;
+#endif
+}
+
+/*
+ * Compute the baud rate register value for a baud rate and check it against
+ * the register limits and the error threshold. The achieved rate and error are
+ * filled in even when the rate is rejected (both 0 if the rate is 0).
+ */
+static bool_t baud_to_brr(u32_t clk_hz, u32_t baud, u32_t *p_brr, u32_t *p_actual, s32_t *p_error_ppm)
+{
+    bool_t result = E_FALSE;
+    u32_t  brr;
+    u32_t  actual;
+    s32_t  ppm;
+
+    *p_brr       = 0;
+    *p_actual    = 0;
+    *p_error_ppm = 0;
+
+    if (0 != baud) {
+        /* BRR holds USARTDIV * 16 = clk / baud, rounded to nearest. */
+        brr = (clk_hz + (baud / 2u)) / baud;
+        if (brr < BRR_MIN) {
+            brr = BRR_MIN;
+        } else if (brr > BRR_MAX) {
+            brr = BRR_MAX;
+        }
+
+        actual = (clk_hz + (brr / 2u)) / brr;
+        ppm    = rate_error_ppm(actual, baud);
+
+        *p_brr       = brr;
+        *p_actual    = actual;
+        *p_error_ppm = ppm;
+
+        result = (((ppm < 0) ? (u32_t)-ppm : (u32_t)ppm) <= UART_BAUD_MAX_ERROR_PPM) ? E_TRUE : E_FALSE;
+    }
+
+    return result;
+}
+
+/*
+ * Error of a rate relative to a reference rate in parts per million. Saturates
+ * for absurd errors. The reference must not be 0.
+ */
+static s32_t rate_error_ppm(u32_t rate, u32_t ref)
+{
+    const u32_t diff = (rate > ref) ? (rate - ref) : (ref - rate);
+    u32_t  ppm;
+    u32_t  rem;
+    size_t i;
+
+    /* ppm = diff * 10^6 / ref without 64 bit math (there is no libgcc to
+       provide the division). Long division two decimal digits at a time keeps
+       every product under 2^32. */
+    ppm = 0;
+    rem = diff;
+    for (i = 0; i < 3; i += 1) {
+        if ((rem > (0xFFFFFFFFu / 100u)) || (ppm > (0x7FFFFFFFu / 100u))) {
+            ppm = 0x7FFFFFFFu; /* absurd error, saturate */
+            break;
+        }
+        rem *= 100u;
+        ppm  = (ppm * 100u) + (rem / ref);
+        rem %= ref;
+    }
+
+    return (rate >= ref) ? (s32_t)ppm : -(s32_t)ppm;
+}
+
+static u32_t usart_clock_hz(USART_TypeDef* p_uart)
+{
+    return (USART1 == p_uart) ? APB2_CLK_HZ : APB1_CLK_HZ;
+}
+
+static void usart_clock_enable(USART_TypeDef* p_uart)
+{
+    if (USART1 == p_uart) {
+        RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+    }
+    else {
+        const u32_t en = (USART2 == p_uart) ? RCC_APB1ENR_USART2EN :
+                         (USART3 == p_uart) ? RCC_APB1ENR_USART3EN :
+                                              0                    ;
+
+        RCC->APB1ENR |= en;
+    }
+}
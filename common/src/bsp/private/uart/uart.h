@@ -3,15 +3,74 @@
 
 #include "stm32f1xx.h"
 #include "types.h"
+#include "utils/ring_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Receive error counters
+ */
+typedef struct uart_errors
+{
+    u32_t overrun;  /* ORE: byte lost before the data register was read */
+    u32_t framing;  /* FE:  stop bit missing (e.g. baud rate mismatch)  */
+    u32_t noise;    /* NE:  noise detected on the line                  */
+    u32_t dropped;  /* bytes lost because the receive buffer was full   */
+} UartErrors_t;
+
+/* Driver events (see uart_set_events) */
+#define UART_EVENT_RX_DATA      (0x1UL) /* bytes were added to the receive buffer */
+#define UART_EVENT_RX_LINE      (0x2UL) /* a '\n' was received                    */
+#define UART_EVENT_TX_DRAINED   (0x4UL) /* the transmit buffer ran empty          */
+
+/**
+ * @brief Event callback
+ *
+ * Runs from the deferred work handler (see deferred.h), never from the
+ * USART or DMA interrupts.
+ *
+ * @param[in] id     value given to uart_set_events
+ * @param[in] events UART_EVENT_* flags raised since the last call
+ */
+typedef void (*UartEventCallback_t)(u32_t id, u32_t events);
+
+/**
+ * @brief Automatic baud rate detection state
+ */
+typedef enum uart_autobaud_state
+{
+    UART_AUTOBAUD_OFF = 0,  /* never started                             */
+    UART_AUTOBAUD_WAITING,  /* receiver off, waiting for the sync char   */
+    UART_AUTOBAUD_LOCKED,   /* rate detected and programmed              */
+    UART_AUTOBAUD_FAILED,   /* detected rate could not be generated      */
+} UartAutobaudState_t;
+
 void uart_init(USART_TypeDef* p_uart);
+bool_t uart_is_enabled(USART_TypeDef* p_uart);
+bool_t uart_has_flow_control(USART_TypeDef* p_uart);
+bool_t uart_set_baud(USART_TypeDef* p_uart, u32_t baud, u32_t * const p_actual, s32_t * const p_error_ppm);
 bool_t uart_data_available(USART_TypeDef* p_uart);
 u8_t uart_read(USART_TypeDef* p_uart);
 bool_t uart_write(USART_TypeDef* p_uart, u8_t byte);
+size_t uart_read_buf(USART_TypeDef* p_uart, u8_t * const p_bytes, size_t len);
+size_t uart_read_stamped(USART_TypeDef* p_uart, u8_t * const p_bytes, u32_t * const p_stamps, size_t len);
+size_t uart_write_buf(USART_TypeDef* p_uart, const u8_t * const p_bytes, size_t len);
+bool_t uart_write_buf_all(USART_TypeDef* p_uart, const u8_t * const p_bytes, size_t len);
+size_t uart_tx_space(USART_TypeDef* p_uart);
+u8_t* uart_tx_reserve(USART_TypeDef* p_uart, size_t len);
+void uart_tx_commit(USART_TypeDef* p_uart, size_t n);
+bool_t uart_write_urgent(USART_TypeDef* p_uart, const u8_t * const p_bytes, size_t len);
+bool_t uart_get_stats(USART_TypeDef* p_uart, RingStats_t * const p_rx, RingStats_t * const p_tx);
+bool_t uart_get_irq_stats(USART_TypeDef* p_uart, u32_t * const p_irqs, u32_t * const p_cycles);
+bool_t uart_get_errors(USART_TypeDef* p_uart, UartErrors_t * const p_errors);
+bool_t uart_set_events(USART_TypeDef* p_uart, u32_t mask, UartEventCallback_t cb, u32_t id);
+u32_t uart_take_events(USART_TypeDef* p_uart);
+bool_t uart_set_echo(USART_TypeDef* p_uart, bool_t enable);
+u32_t uart_echo_count(USART_TypeDef* p_uart);
+bool_t uart_autobaud_start(USART_TypeDef* p_uart);
+UartAutobaudState_t uart_autobaud_status(USART_TypeDef* p_uart, u32_t * const p_detected, u32_t * const p_actual, s32_t * const p_error_ppm);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,130 @@
+/*
+ * Build time configuration of the UART driver. Shared by uart.c and the ring
+ * storage in uart_rings.cpp so both agree on which rings exist and how big
+ * they are.
+ */
+#ifndef UART_CONFIG_H
+#define UART_CONFIG_H
+
+/* Transmit path selection. When set, the transmit ring is drained by DMA1
+   channel 4 one contiguous segment at a time and the CPU only gets involved
+   once per segment. When clear, the original TXE interrupt per byte driver is
+   used. The interrupt and cycle counters (see uart_get_irq_stats) can be used
+   to compare the two. */
+#ifndef UART_TX_DMA_ENABLE
+    #define UART_TX_DMA_ENABLE (1)
+#endif
+
+/* Receive timestamping. When set, the receive interrupt stores the cycle
+   counter alongside each byte, so readers can tell how long a byte waited in
+   the receive buffer (see uart_read_stamped). Each receive ring entry grows
+   from 1 to 4 bytes. Needs the per byte receive interrupt, so receive DMA
+   defaults to off in this mode. */
+#ifndef UART_RX_TIMESTAMP_ENABLE
+    #define UART_RX_TIMESTAMP_ENABLE (0)
+#endif
+
+/* Receive path selection. When set, DMA1 channel 5 writes received bytes into
+   a circular buffer and the driver only looks at the DMA position when the
+   line goes idle or the buffer is half or completely filled. When clear, the
+   RXNE interrupt per byte driver and the receive ring are used. */
+#ifndef UART_RX_DMA_ENABLE
+    #if 1 == UART_RX_TIMESTAMP_ENABLE
+        #define UART_RX_DMA_ENABLE (0)
+    #else
+        #define UART_RX_DMA_ENABLE (1)
+    #endif
+#endif
+
+#if (1 == UART_RX_TIMESTAMP_ENABLE) && (1 == UART_RX_DMA_ENABLE)
+    #error UART_RX_TIMESTAMP_ENABLE needs UART_RX_DMA_ENABLE set to 0
+#endif
+
+/* Receive ring entry. With timestamps, an entry is the cycle counter at the
+   time the byte arrived with its low 8 bits replaced by the byte. The stamp
+   resolution is 256 cycles (~3.6 us at 72 MHz) and it wraps with the cycle
+   counter (~59 s). */
+#if 1 == UART_RX_TIMESTAMP_ENABLE
+    #define UART_RX_ENTRY_T     u32_t
+#else
+    #define UART_RX_ENTRY_T     u8_t
+#endif
+#define UART_RX_STAMP_MASK      (0xFFFFFF00u)
+
+/* Baud rate set by uart_init. Can be changed at runtime with uart_set_baud. */
+#define UART_DEFAULT_BAUD   (115200u)
+
+/* Largest baud rate error (in parts per million) uart_set_baud accepts. The
+   receiver samples the middle of each bit, so the two ends together can be off
+   by a few percent. This leaves the other end most of that budget. */
+#define UART_BAUD_MAX_ERROR_PPM (15000u)
+
+/* Per port receive and transmit buffer sizes. Each must be a power of 2. A
+   port is only compiled in when both of its sizes are non-zero, so a port
+   left at 0 costs neither RAM nor interrupt handlers. */
+#ifndef UART1_RX_BUF_SIZE
+    #define UART1_RX_BUF_SIZE   (256u)
+#endif
+#ifndef UART1_TX_BUF_SIZE
+    #define UART1_TX_BUF_SIZE   (256u)
+#endif
+#ifndef UART2_RX_BUF_SIZE
+    #define UART2_RX_BUF_SIZE   (0u)
+#endif
+#ifndef UART2_TX_BUF_SIZE
+    #define UART2_TX_BUF_SIZE   (0u)
+#endif
+#ifndef UART3_RX_BUF_SIZE
+    #define UART3_RX_BUF_SIZE   (0u)
+#endif
+#ifndef UART3_TX_BUF_SIZE
+    #define UART3_TX_BUF_SIZE   (0u)
+#endif
+
+#define UART1_ENABLE    ((0u != UART1_RX_BUF_SIZE) && (0u != UART1_TX_BUF_SIZE))
+#define UART2_ENABLE    ((0u != UART2_RX_BUF_SIZE) && (0u != UART2_TX_BUF_SIZE))
+#define UART3_ENABLE    ((0u != UART3_RX_BUF_SIZE) && (0u != UART3_TX_BUF_SIZE))
+
+/* Hardware flow control on USART1 (CTS on PA11, RTS on PA12). CTS is handled
+   by the USART, which holds off transmission while the far end deasserts it.
+   RTS is driven as a GPIO from the receive buffer level, so the far end is
+   told to stop before the buffer (not just the data register) overflows. */
+#ifndef UART1_FLOW_CONTROL_ENABLE
+    #define UART1_FLOW_CONTROL_ENABLE (0)
+#endif
+
+/* Automatic baud rate detection on USART1 (see uart_autobaud_start). The
+   width of a sync character on the RX pin (PA10) is timed by input capture on
+   the pin's timer channel (TIM1_CH3), so TIM1 is busy while detecting. */
+#ifndef UART1_AUTOBAUD_ENABLE
+    #define UART1_AUTOBAUD_ENABLE (0)
+#endif
+
+/* A measured rate within this many parts per million of a standard rate is
+   taken to be that rate. */
+#define UART_AUTOBAUD_SNAP_PPM  (30000u)
+
+/* Bytes the far end may still send after RTS is deasserted (e.g. the FIFO of
+   a USB serial adapter). RTS is deasserted this far below the point where the
+   receive buffer would overflow. */
+#define UART_RTS_SLACK      (16u)
+
+/* Urgent transmit lane (see uart_write_urgent). Every port gets a second
+   transmit ring of this size for short control and error messages. The
+   transmitter drains it ahead of the normal ring, switching lanes only where
+   a normal message ends. Must be a power of 2. */
+#ifndef UART_TX_URGENT_BUF_SIZE
+    #define UART_TX_URGENT_BUF_SIZE (64u)
+#endif
+
+/* Number of normal message ends the transmitter can look ahead. Past this,
+   message ends are not recorded and the messages are merged into one, which
+   only makes the lane switch points coarser. Must be a power of 2. */
+#define UART_TX_MSG_ENDS    (16u)
+
+/* Largest transmit reservation (see uart_tx_reserve) that is still granted
+   when it does not fit before the end of the transmit ring. Such reservations
+   are staged in a buffer of this size and copied in on commit. */
+#define UART_TX_RESERVE_MAX (128u)
+
+#endif /* UART_CONFIG_H */
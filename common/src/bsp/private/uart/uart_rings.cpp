@@ -0,0 +1,42 @@
+/*
+ * Storage for the UART driver's byte rings. The rings live in a C++ file so
+ * they can use the Ring<T, N> template behind the private_ring.h facade.
+ */
+#include "bsp/private/uart/uart_config.h"
+#include "utils/private_ring.h"
+#include "types.h"
+
+/* Ring sizes are set per port in uart_config.h. Must be a power of 2 (checked
+   at compile time). Ports with a size of 0 have no rings. With receive DMA,
+   received bytes live in a DMA buffer in uart.c and there is no receive
+   ring. With receive timestamps, the receive ring holds stamped entries
+   instead of bytes.
+
+   Each port also has an urgent transmit ring and a ring of message end
+   positions for the normal transmit ring (see uart_write_urgent). */
+#if 1 == UART1_ENABLE
+    #if 0 == UART_RX_DMA_ENABLE
+PRIVATE_RING_DEFINITIONS(uart1_rx_ring, UART_RX_ENTRY_T, UART1_RX_BUF_SIZE) /* bytes to read  */
+    #endif
+PRIVATE_RING_DEFINITIONS(uart1_tx_ring, u8_t, UART1_TX_BUF_SIZE) /* bytes to write */
+PRIVATE_RING_DEFINITIONS(uart1_urgent_ring, u8_t, UART_TX_URGENT_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(uart1_msg_ring, u32_t, UART_TX_MSG_ENDS)
+#endif
+
+#if 1 == UART2_ENABLE
+    #if 0 == UART_RX_DMA_ENABLE
+PRIVATE_RING_DEFINITIONS(uart2_rx_ring, UART_RX_ENTRY_T, UART2_RX_BUF_SIZE)
+    #endif
+PRIVATE_RING_DEFINITIONS(uart2_tx_ring, u8_t, UART2_TX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(uart2_urgent_ring, u8_t, UART_TX_URGENT_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(uart2_msg_ring, u32_t, UART_TX_MSG_ENDS)
+#endif
+
+#if 1 == UART3_ENABLE
+    #if 0 == UART_RX_DMA_ENABLE
+PRIVATE_RING_DEFINITIONS(uart3_rx_ring, UART_RX_ENTRY_T, UART3_RX_BUF_SIZE)
+    #endif
+PRIVATE_RING_DEFINITIONS(uart3_tx_ring, u8_t, UART3_TX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(uart3_urgent_ring, u8_t, UART_TX_URGENT_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(uart3_msg_ring, u32_t, UART_TX_MSG_ENDS)
+#endif
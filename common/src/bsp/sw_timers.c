@@ -1,183 +1,268 @@
 #include "bsp/sw_timers.h"
 
-#include "stm32f1xx.h"
-
 #include "bsp/bsp.h"
 #include "types.h"
 
+#define MAX_SW_TIMERS           (SW_TIMER_MAX_TIMERS)
+
+/* Division by 1000 as a multiply and a shift. floor(x * DIV_1000_MUL / 2^38)
+   equals floor(x / 1000) for every 32 bit x (checked exhaustively). The
+   multiply is a single 32 x 32 -> 64 bit UMULL. */
+#define DIV_1000_MUL            (0x10624DD3UL)
+#define DIV_1000_SHIFT          (38u)
+
+/* 2^32 = TWO32_DIV_1000 * 1000 + TWO32_MOD_1000, used to fold the high word
+   of a 64 bit value into its low word before dividing. */
+#define TWO32_DIV_1000          (4294967UL)
+#define TWO32_MOD_1000          (296u)
 
-#define HW_TIMER                (TIM1)
-#define HW_TIMER_RCC_REGISTER   (RCC->APB2ENR)
-#define HW_TIMER_RCC_ENABLE     (RCC_APB2ENR_TIM1EN)
-#define MAX_SW_TIMERS           (4u)
-#define USEC_PER_TIMER_CNT      (500u)
-#define TICK_ROLLOVER_OFFSET    (0xFFFF + 1)
+#define USEC_PER_MSEC           (1000u)
+#define SATURATE_U32            (0xFFFFFFFFUL)
 
+/* A timer only keeps the time it was reset at. Everything else is worked out
+   from the 64 bit microsecond clock when it is asked for, so nothing has to
+   run in between and nothing wraps. The deadline of the last sw_timer_expired
+   call that came back E_FALSE is kept for sw_timer_next_deadline. */
 typedef struct sw_timer
 {
-    u32_t sec;
-    u32_t msec;
-    u32_t usec;
-    u32_t  prev_ticks;
+    u64_t  start;       /* bsp_time_us64 at the last reset          */
+    u64_t  deadline;    /* bsp_time_us64 the caller is waiting for  */
+    bool_t waiting;     /* deadline is set                          */
+    bool_t acquired;    /* handed out by sw_timer_acquire           */
 } SwTimer_t;
 
 
-/* Ring buffer infrastructure */
-#define PRIVATE_RING_SIZE MAX_SW_TIMERS
+/* Ring buffer infrastructure. The ring is instantiated (and sized) in
+   sw_timers_ring.cpp. */
 #include "utils/private_ring.h"
 
-PRIVATE_RING_DECLARATIONS(SwTimers, SwTimerHandle_t) /* create ring type of timer handles */
-PRIVATE_RING_DECLARE(static SwTimers, handle_ring);  /* instances of timer handle ring    */
-static SwTimer_t timer_mem[MAX_SW_TIMERS];           /* backing storage for handles       */
+PRIVATE_RING_DECLARATIONS(sw_timer_handle_ring, SwTimerHandle_t) /* free timer handles          */
+static SwTimer_t timer_mem[MAX_SW_TIMERS];                       /* backing storage for handles */
 
 /* Readability macros for private ring functions */
-#define TIMER_RING_INIT(var_name)       PRIVATE_RING_INIT(SwTimers, var_name)
-#define TIMER_RING_IS_EMPTY(var_name)   PRIVATE_RING_IS_EMPTY(SwTimers, var_name)
-#define TIMER_RING_IS_FULL(var_name)    PRIVATE_RING_IS_FULL(SwTimers, var_name)
-#define TIMER_RING_PUSH(var_name, data) PRIVATE_RING_PUSH(SwTimers, var_name, data)
-#define TIMER_RING_POP(var_name)        PRIVATE_RING_POP(SwTimers, var_name)
-#define TIMER_RING_PEEK(var_name)       PRIVATE_RING_PEEK(SwTimers, var_name)
-
-
-static void init_hw_timer(void);
-
+#define TIMER_RING_INIT()       PRIVATE_RING_INIT(sw_timer_handle_ring)
+#define TIMER_RING_IS_EMPTY()   PRIVATE_RING_IS_EMPTY(sw_timer_handle_ring)
+#define TIMER_RING_IS_FULL()    PRIVATE_RING_IS_FULL(sw_timer_handle_ring)
+#define TIMER_RING_PUSH(data)   PRIVATE_RING_PUSH(sw_timer_handle_ring, data)
+#define TIMER_RING_POP()        PRIVATE_RING_POP(sw_timer_handle_ring)
+#define TIMER_RING_PEEK()       PRIVATE_RING_PEEK(sw_timer_handle_ring)
+
+
+static u64_t elapsed_usec(SwTimerHandle_t t);
+static u64_t div_1000(u64_t x);
+static u32_t saturate(u64_t x);
+
+/**
+ * @brief Initialize the software timer facility
+ *
+ * All handles are returned to the pool. The timers run on the BSP's
+ * microsecond clock (bsp_time_us64), which bsp_init starts.
+ */
 void sw_timer_init(void)
 {
     size_t t;
 
-    /* Start the hardware timer */
-    init_hw_timer();
-
     /* Clear out the ring buffer */
-    TIMER_RING_INIT(handle_ring);
-    
+    TIMER_RING_INIT();
+
     /* Reset all timer instances and enqueue their handles in the ring */
     for (t = 0; t < MAX_SW_TIMERS; t += 1) {
+        timer_mem[t].acquired = E_FALSE;
         sw_timer_reset(&timer_mem[t]);
-        TIMER_RING_PUSH(handle_ring, &timer_mem[t]);
-    }
-}
-
-void sw_timer_task(void)
-{
-    size_t t;
-
-    /* This task needs to be called as often as possible since our timer is only
-       8-bits. It is very likely that overflows will be missed and time keeping
-       will be inaccurate if this function is delayed for too long. 
-       
-       Since this function calls a function with multiplication and division
-       with values wider than the native processor width, this can get very
-       expensive very fast. The number of software timers must be balanced with 
-       execution time of this refresh function. */
-    for (t = 0; t < MAX_SW_TIMERS; t += 1) {
-        (void)sw_timer_sec(&timer_mem[t]);
+        (void)TIMER_RING_PUSH(&timer_mem[t]);
     }
 }
 
+/**
+ * @brief Take a timer handle from the pool. The timer starts at 0.
+ *
+ * @return The handle or SW_TIMER_NO_TIMER if all handles are taken.
+ */
 SwTimerHandle_t sw_timer_acquire(void)
 {
     SwTimerHandle_t handle;
 
-    if (E_TRUE == TIMER_RING_IS_EMPTY(handle_ring)) {
+    if (E_TRUE == TIMER_RING_IS_EMPTY()) {
         handle  = SW_TIMER_NO_TIMER;
     } else {
-        handle = TIMER_RING_POP(handle_ring);
+        handle = TIMER_RING_POP();
+        handle->acquired = E_TRUE;
         sw_timer_reset(handle);
     }
 
     return handle;
 }
 
+/**
+ * @brief Return a timer handle to the pool
+ *
+ * The handle must not be used afterwards. Releasing a handle twice does
+ * nothing.
+ *
+ * @param[in] t handle from sw_timer_acquire
+ */
+void sw_timer_release(SwTimerHandle_t t)
+{
+    if ((SW_TIMER_NO_TIMER != t) && (E_TRUE == t->acquired)) {
+        t->acquired = E_FALSE;
+        t->waiting  = E_FALSE;
+        (void)TIMER_RING_PUSH(t);
+    }
+}
+
+/**
+ * @brief Restart a timer at 0.
+ *
+ * @param[in] t handle from sw_timer_acquire
+ */
 void sw_timer_reset(SwTimerHandle_t t)
 {
     if (SW_TIMER_NO_TIMER != t) {
-        /* Initialize non-null handles to 0. Previous ticks is set to properly
-           compute deltas from reset. */
-        t->msec       = 0u;
-        t->sec        = 0u;
-        t->usec       = 0u;
-        t->prev_ticks = HW_TIMER->CNT;
+        t->start   = bsp_time_us64();
+        t->waiting = E_FALSE;
     }
 }
 
+/**
+ * @brief Seconds since the timer was reset
+ *
+ * @param[in] t handle from sw_timer_acquire
+ */
 u32_t sw_timer_sec(SwTimerHandle_t t)
 {
-    /* It is expected that second timers are used for very coarse timings that 
-       do not require high accuracy. */
-    t->sec = (sw_timer_msec(t) / 1000);
-    return t->sec;
+    return saturate(div_1000(div_1000(elapsed_usec(t))));
 }
 
+/**
+ * @brief Milliseconds since the timer was reset
+ *
+ * Saturates at 0xFFFFFFFF (after ~49.7 days).
+ *
+ * @param[in] t handle from sw_timer_acquire
+ */
 u32_t sw_timer_msec(SwTimerHandle_t t)
 {
-    /* It is expected that millsecond timers are used for very coarse timings that 
-       do not require high accuracy. */
-    t->msec = (sw_timer_usec(t) / 1000);
-    return t->msec;
+    return saturate(div_1000(elapsed_usec(t)));
 }
 
+/**
+ * @brief Microseconds since the timer was reset
+ *
+ * Saturates at 0xFFFFFFFF (after ~71.6 minutes).
+ *
+ * @param[in] t handle from sw_timer_acquire
+ */
 u32_t sw_timer_usec(SwTimerHandle_t t)
 {
-    u32_t usec;
-    u32_t lapsed_ticks;
-    u32_t curr_ticks;
+    return saturate(elapsed_usec(t));
+}
 
-    if (SW_TIMER_NO_TIMER == t) {
-        usec = 0u;
-    } else {
+/**
+ * @brief Check a timer against a deadline
+ *
+ * Cheaper than comparing sw_timer_msec against the deadline, since the
+ * deadline is converted to microseconds (a multiply) instead of the elapsed
+ * time to milliseconds. Unlike an equality test on sw_timer_msec, a deadline
+ * cannot be missed by checking too late.
+ *
+ * @param[in] t             handle from sw_timer_acquire
+ * @param[in] deadline_msec milliseconds after the last reset
+ *
+ * A deadline that has not passed yet is remembered until the timer expires
+ * or is reset, so bsp_idle can sleep until it (see sw_timer_next_deadline).
+ *
+ * @return E_TRUE once deadline_msec or more have passed since the timer was
+ * reset. Always E_FALSE for SW_TIMER_NO_TIMER.
+ */
+bool_t sw_timer_expired(SwTimerHandle_t t, u32_t deadline_msec)
+{
+    bool_t expired = E_FALSE;
+    u64_t  deadline;
 
-        curr_ticks = HW_TIMER->CNT;
+    if (SW_TIMER_NO_TIMER != t) {
+        deadline = t->start + ((u64_t)deadline_msec * USEC_PER_MSEC);
 
-        /* When the current ticks is less than the previous ticks, a rollover 
-           occurred and an offset of 0xFFFF (ticks to get back to 0) needs to be
-           accounted for in the lapsed ticks. */
-        if (curr_ticks < t->prev_ticks) {
-            lapsed_ticks = (curr_ticks + TICK_ROLLOVER_OFFSET) - t->prev_ticks;
+        if (bsp_time_us64() >= deadline) {
+            expired    = E_TRUE;
+            t->waiting = E_FALSE;
         } else {
-            lapsed_ticks = curr_ticks - t->prev_ticks;
+            t->deadline = deadline;
+            t->waiting  = E_TRUE;
         }
+    }
 
-        /* Update the previous ticks for next time */
-        t->prev_ticks = curr_ticks;
+    return expired;
+}
+
+/**
+ * @brief Earliest deadline a timer is being checked against
+ *
+ * Covers the acquired timers whose last sw_timer_expired call came back
+ * E_FALSE. The pool is small, so this is a scan of all timers.
+ *
+ * @param[out] p_at bsp_time_us64 value of the earliest deadline
+ *
+ * @retval E_TRUE  - *p_at holds the deadline
+ * @retval E_FALSE - no timer is waiting for a deadline (*p_at is unchanged)
+ */
+bool_t sw_timer_next_deadline(u64_t * const p_at)
+{
+    bool_t found = E_FALSE;
+    u64_t  at    = 0u;
+    size_t t;
+
+    for (t = 0; t < MAX_SW_TIMERS; t += 1) {
+        if ((E_TRUE == timer_mem[t].acquired) && (E_TRUE == timer_mem[t].waiting)) {
+            if ((E_FALSE == found) || (timer_mem[t].deadline < at)) {
+                at    = timer_mem[t].deadline;
+                found = E_TRUE;
+            }
+        }
+    }
 
-        /* Each tick of the timer is 64 usec. This makes it hard to get accurate
-           timings, but for the software timers this is ok. If finer timing
-           control is required, a hardware timer will need to be used. */
-        t->usec += (lapsed_ticks * USEC_PER_TIMER_CNT);
-        
-        usec = t->usec;
+    if (E_TRUE == found) {
+        *p_at = at;
+    }
+
+    return found;
+}
+
+/* Microseconds since the last reset, 0 for no timer */
+static u64_t elapsed_usec(SwTimerHandle_t t)
+{
+    u64_t usec = 0u;
+
+    if (SW_TIMER_NO_TIMER != t) {
+        usec = bsp_time_us64() - t->start;
     }
 
     return usec;
 }
 
-static void init_hw_timer(void)
+/*
+ * x / 1000 without a divide instruction (the Cortex-M3 has none for 64 bit
+ * values). Each pass moves the high word into the quotient using
+ * hi * 2^32 = hi * TWO32_DIV_1000 * 1000 + hi * TWO32_MOD_1000, which leaves a
+ * value about 2^22 times smaller. At most four passes are needed for any 64
+ * bit x, and none for a value that already fits in 32 bits.
+ */
+static u64_t div_1000(u64_t x)
 {
-    /*
-     * Enable the clock to the timer's IP block
-     */
-    HW_TIMER_RCC_REGISTER |= HW_TIMER_RCC_ENABLE;
-
-    /*
-     * Use TIM1 in up count mode with the timer tick set to 1 tick per 500 usec.
-     */
-    const u32_t TIMER_FREQ = 2000; /* 2KHz or 500usec period */
-    const u16_t PRESCALER  = (F_CPU_HZ / TIMER_FREQ) - 1;
-    
-    /* Verify the above calculation didn't overflow or cause a zero prescaler */
-    const u32_t TIMER_FREQ_VERIFICATION = F_CPU_HZ / (PRESCALER + 1);
-    if (TIMER_FREQ_VERIFICATION != TIMER_FREQ) {
-        bsp_error_trap();
+    u64_t q = 0u;
+    u32_t hi;
+
+    hi = (u32_t)(x >> 32);
+    while (0u != hi) {
+        q += (u64_t)hi * TWO32_DIV_1000;
+        x  = ((u64_t)hi * TWO32_MOD_1000) + (u32_t)x;
+        hi = (u32_t)(x >> 32);
     }
 
-    HW_TIMER->PSC = PRESCALER;
+    return q + (((u64_t)(u32_t)x * DIV_1000_MUL) >> DIV_1000_SHIFT);
+}
 
-    /*
-     * Configure the timer to overflow at the maximum timer count.
-     */
-    HW_TIMER->CNT = 0;              /* ensure the count starts at 0          */
-    HW_TIMER->ARR = 0xFFFF;         /* maximum counter value                 */
-    HW_TIMER->EGR |= TIM_EGR_UG;    /* force update event to load new config */
-    HW_TIMER->CR1 = TIM_CR1_CEN;    /* enable timer's counter                */
-}
\ No newline at end of file
+/* Clamp a 64 bit count to 32 bits */
+static u32_t saturate(u64_t x)
+{
+    return (x > SATURATE_U32) ? SATURATE_U32 : (u32_t)x;
+}
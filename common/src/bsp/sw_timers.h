@@ -8,16 +8,19 @@ extern "C" {
 #endif
 
 #define SW_TIMER_NO_TIMER   (NULL_PTR)
+#define SW_TIMER_MAX_TIMERS (4u)         /* number of handles that can be acquired */
 
 typedef struct sw_timer* SwTimerHandle_t;
 
 void sw_timer_init(void);
-void sw_timer_task(void);
 SwTimerHandle_t sw_timer_acquire(void);
+void sw_timer_release(SwTimerHandle_t t);
 void sw_timer_reset(SwTimerHandle_t t);
 u32_t sw_timer_sec(SwTimerHandle_t t);
 u32_t sw_timer_msec(SwTimerHandle_t t);
 u32_t sw_timer_usec(SwTimerHandle_t t);
+bool_t sw_timer_expired(SwTimerHandle_t t, u32_t deadline_msec);
+bool_t sw_timer_next_deadline(u64_t * const p_at);
 
 #ifdef __cplusplus
 }
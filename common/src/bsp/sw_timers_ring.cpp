@@ -0,0 +1,9 @@
+/*
+ * Storage for the software timer module's handle ring. The ring lives in a C++
+ * file so it can use the Ring<T, N> template behind the private_ring.h facade.
+ */
+#include "bsp/sw_timers.h"
+#include "utils/private_ring.h"
+#include "types.h"
+
+PRIVATE_RING_DEFINITIONS(sw_timer_handle_ring, SwTimerHandle_t, SW_TIMER_MAX_TIMERS)
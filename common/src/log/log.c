@@ -0,0 +1,208 @@
+#include "log/log.h"
+
+#include "bsp/bsp.h"
+#include "packet/cobs.h"
+#include "utils/private_ring.h"
+#include "types.h"
+
+/* Queued record: argument count, then the ID and the arguments as little
+   endian words */
+#define WORD_LEN            (4u)
+#define RECORD_MAX_LEN      (1u + (WORD_LEN * (1u + LOG_MAX_ARGS)))
+
+/* Longest varint of a u32_t */
+#define VARINT_MAX_LEN      (5u)
+
+/* Longest record on the wire */
+#define PLAIN_MAX_LEN       (VARINT_MAX_LEN * (1u + LOG_MAX_ARGS))
+#define WIRE_MAX_LEN        COBS_ENCODED_MAX(PLAIN_MAX_LEN)
+
+PRIVATE_RING_DECLARATIONS(log_ring, u8_t)
+
+static void emit(u32_t id, u32_t num_args, const u32_t * const p_args);
+static void put_word(u8_t * const p_dst, u32_t word);
+static u32_t get_word(const u8_t * const p_src);
+static size_t put_varint(u8_t * const p_dst, u32_t value);
+static void wire_append(const u8_t * const p_bytes, size_t len);
+
+/* Reported by log_task when records were dropped */
+static const char dropped_fmt[] LOG_FMT_ATTR = "log: %u records dropped";
+
+static LogWriteFn_t   log_write;
+static volatile u32_t dropped;      /* records lost since the last report */
+
+/* Encoded record, sent from wire_pos on */
+static CobsEncoder_t  enc;
+static u8_t           wire[WIRE_MAX_LEN];
+static size_t         wire_len;
+static size_t         wire_pos;
+
+/**
+ * @brief Initialize the log queue
+ *
+ * @param[in] write function taking the encoded records (e.g.
+ *                  bsp_serial_write_buf)
+ */
+void log_init(LogWriteFn_t write)
+{
+    PRIVATE_RING_INIT(log_ring);
+
+    log_write = write;
+    dropped   = 0;
+    wire_len  = 0;
+    wire_pos  = 0;
+}
+
+/**
+ * @brief Send queued records
+ *
+ * Call from the main loop. Returns once the queue is empty or the write
+ * function stops taking bytes. A record the write function only took part of
+ * is finished on the next call.
+ */
+void log_task(void)
+{
+    u8_t   record[RECORD_MAX_LEN];
+    u32_t  args[LOG_MAX_ARGS];
+    u32_t  lost;
+    u32_t  state;
+    size_t num_args;
+    size_t i;
+
+    while (NULL_PTR != log_write) {
+        if (wire_pos < wire_len) {
+            wire_pos += log_write(&wire[wire_pos], wire_len - wire_pos);
+            if (wire_pos < wire_len) {
+                break;
+            }
+        }
+
+        /* Report losses before the records that made it, which were
+           queued after them */
+        state   = bsp_irq_save();
+        lost    = dropped;
+        dropped = 0;
+        bsp_irq_restore(state);
+
+        if (0u != lost) {
+            emit((u32_t)(size_t)dropped_fmt, 1u, &lost);
+        } else if (E_TRUE == PRIVATE_RING_IS_EMPTY(log_ring)) {
+            break;
+        } else {
+            /* Producers push whole records with interrupts masked, so the
+               rest of the record is there. */
+            num_args = PRIVATE_RING_PEEK(log_ring);
+            (void)PRIVATE_RING_POP_N(log_ring, record, 1u + (WORD_LEN * (1u + num_args)));
+
+            for (i = 0; i < num_args; i += 1) {
+                args[i] = get_word(&record[1u + (WORD_LEN * (1u + i))]);
+            }
+
+            emit(get_word(&record[1]), (u32_t)num_args, args);
+        }
+    }
+}
+
+/**
+ * @brief Queue a record. Use the LOG macro rather than calling this.
+ *
+ * Safe to call from any interrupt priority and from thread mode.
+ *
+ * @param[in] id       address of the format string in .log_fmt
+ * @param[in] num_args number of arguments used (clamped to LOG_MAX_ARGS)
+ * @param[in] a0       first argument
+ * @param[in] a1       second argument
+ * @param[in] a2       third argument
+ * @param[in] a3       fourth argument
+ */
+void log_record(u32_t id, u32_t num_args, u32_t a0, u32_t a1, u32_t a2, u32_t a3)
+{
+    u8_t   record[RECORD_MAX_LEN];
+    u32_t  state;
+    size_t len;
+
+    if (num_args > LOG_MAX_ARGS) {
+        num_args = LOG_MAX_ARGS;
+    }
+
+    record[0] = (u8_t)num_args;
+    put_word(&record[1], id);
+    put_word(&record[1u + (1u * WORD_LEN)], a0);
+    put_word(&record[1u + (2u * WORD_LEN)], a1);
+    put_word(&record[1u + (3u * WORD_LEN)], a2);
+    put_word(&record[1u + (4u * WORD_LEN)], a3);
+    len = 1u + (WORD_LEN * (1u + num_args));
+
+    /* Several contexts produce, so the space check and the push must not be
+       split by another producer */
+    state = bsp_irq_save();
+    if (PRIVATE_RING_SPACE(log_ring) >= len) {
+        (void)PRIVATE_RING_PUSH_N(log_ring, record, len);
+    } else {
+        dropped += 1u;
+    }
+    bsp_irq_restore(state);
+}
+
+/* Encode a record into wire */
+static void emit(u32_t id, u32_t num_args, const u32_t * const p_args)
+{
+    u8_t   plain[PLAIN_MAX_LEN];
+    size_t len;
+    size_t i;
+
+    len = put_varint(plain, id);
+    for (i = 0; i < num_args; i += 1) {
+        len += put_varint(&plain[len], p_args[i]);
+    }
+
+    wire_len = 0;
+    wire_pos = 0;
+    cobs_encoder_init(&enc, wire_append);
+    cobs_encoder_put(&enc, plain, len);
+    cobs_encoder_end(&enc);
+}
+
+/* Store word at p_dst, little endian */
+static void put_word(u8_t * const p_dst, u32_t word)
+{
+    p_dst[0] = (u8_t)word;
+    p_dst[1] = (u8_t)(word >> 8);
+    p_dst[2] = (u8_t)(word >> 16);
+    p_dst[3] = (u8_t)(word >> 24);
+}
+
+/* Load a little endian word from p_src */
+static u32_t get_word(const u8_t * const p_src)
+{
+    return (u32_t)p_src[0]
+        | ((u32_t)p_src[1] << 8)
+        | ((u32_t)p_src[2] << 16)
+        | ((u32_t)p_src[3] << 24);
+}
+
+/* Store value as an unsigned LEB128 varint. Returns its length. */
+static size_t put_varint(u8_t * const p_dst, u32_t value)
+{
+    size_t len = 0;
+
+    while (value >= 0x80u) {
+        p_dst[len] = (u8_t)(value | 0x80u);
+        value >>= 7;
+        len += 1u;
+    }
+
+    p_dst[len] = (u8_t)value;
+    return len + 1u;
+}
+
+/* Collect encoded blocks in wire */
+static void wire_append(const u8_t * const p_bytes, size_t len)
+{
+    size_t i;
+
+    for (i = 0; (i < len) && (wire_len < WIRE_MAX_LEN); i += 1) {
+        wire[wire_len] = p_bytes[i];
+        wire_len += 1u;
+    }
+}
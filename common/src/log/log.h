@@ -0,0 +1,84 @@
+/**
+ * @file log.h
+ * @brief Binary logging with the format strings kept off the device
+ *
+ * LOG takes a printf style format string and up to 4 integer arguments:
+ *
+ *      LOG("uart%u overrun, %u bytes lost", port, lost);
+ *
+ * The format string goes into the .log_fmt section, which the linker script
+ * keeps in the ELF file but out of flash. Its address within the section is
+ * the message ID. A call only queues the ID and the raw argument words, with
+ * interrupts masked for the copy, so it is cheap enough for interrupt
+ * handlers (including USART1_IRQHandler and the sys_tick callback) as well as
+ * the main loop. Nothing is formatted on the device.
+ *
+ * log_task, called from the main loop, turns queued records into the wire
+ * format and hands them to the write function given to log_init. Each record
+ * is the ID and then the arguments as unsigned LEB128 varints (7 bits per
+ * byte, low bits first), COBS encoded and ended by a 0x00. A small argument
+ * takes one byte, so most records are 4 to 8 bytes on the wire against
+ * 20 to 60 bytes of formatted text.
+ *
+ * scripts/log_decoder.py reads the format strings from the ELF file and
+ * prints the records. Arguments are 32 bit: %d and %i print them signed, %c
+ * as a character, and everything else (%u, %x, ...) unsigned. %s and floating
+ * point are not supported. A record that does not fit in the queue is dropped
+ * and the loss is reported in the log.
+ */
+#ifndef LOG_H
+#define LOG_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bytes of queued records. A record takes 1 + 4 + 4 per argument bytes. Must
+   be a power of 2 (checked at compile time). */
+#ifndef LOG_BUF_SIZE
+    #define LOG_BUF_SIZE    (256u)
+#endif
+
+/* Most arguments per message */
+#define LOG_MAX_ARGS        (4u)
+
+/* Puts a format string into the .log_fmt section */
+#define LOG_FMT_ATTR        __attribute__((section(".log_fmt")))
+
+/* Takes encoded records. Returns the number of bytes it took, like
+   bsp_serial_write_buf. */
+typedef size_t (*LogWriteFn_t)(const u8_t * const p_bytes, size_t len);
+
+void log_init(LogWriteFn_t write);
+void log_task(void);
+void log_record(u32_t id, u32_t num_args, u32_t a0, u32_t a1, u32_t a2, u32_t a3);
+
+/* LOG(fmt, ...) with 0 to 4 arguments. The format string is counted as the
+   first argument so __VA_ARGS__ is never empty. */
+#define LOG(...)            LOG_CAT(LOG_, LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+#define LOG_CAT(a, b)       LOG_CAT_(a, b)
+#define LOG_CAT_(a, b)      a ## b
+#define LOG_NARGS(...)      LOG_NARGS_(__VA_ARGS__, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_1, _2, _3, _4, _5, N, ...) N
+
+#define LOG_1(fmt)                  LOG_RECORD(fmt, 0u, 0u, 0u, 0u, 0u)
+#define LOG_2(fmt, a)               LOG_RECORD(fmt, 1u, a, 0u, 0u, 0u)
+#define LOG_3(fmt, a, b)            LOG_RECORD(fmt, 2u, a, b, 0u, 0u)
+#define LOG_4(fmt, a, b, c)         LOG_RECORD(fmt, 3u, a, b, c, 0u)
+#define LOG_5(fmt, a, b, c, d)      LOG_RECORD(fmt, 4u, a, b, c, d)
+
+#define LOG_RECORD(fmt, n, a, b, c, d)                                          \
+do {                                                                            \
+    static const char log_fmt[] LOG_FMT_ATTR = fmt;                             \
+    log_record((u32_t)(size_t)log_fmt, (n),                                     \
+        (u32_t)(a), (u32_t)(b), (u32_t)(c), (u32_t)(d));                        \
+} while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_H */
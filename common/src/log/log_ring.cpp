@@ -0,0 +1,9 @@
+/*
+ * Storage for the log record queue. The ring lives in a C++ file so it can
+ * use the Ring<T, N> template behind the private_ring.h facade.
+ */
+#include "log/log.h"
+#include "utils/private_ring.h"
+#include "types.h"
+
+PRIVATE_RING_DEFINITIONS(log_ring, u8_t, LOG_BUF_SIZE)
@@ -0,0 +1,317 @@
+#include "mux/mux.h"
+
+#include "bsp/bsp.h"
+#include "mux/mux_config.h"
+#include "packet/cobs.h"
+#include "packet/packet.h"
+#include "utils/private_ring.h"
+#include "types.h"
+
+/* Serial bytes a frame with len channel bytes can take, including its
+   channel ID, CRC and COBS overhead. The serial port's transmit buffer must
+   hold at least FRAME_WIRE_MAX(MUX_FRAME_MAX) or full frames never go out. */
+#define FRAME_WIRE_MAX(len)     COBS_ENCODED_MAX(1u + (len) + PACKET_CRC_LEN)
+
+/* Bytes of an oversized received frame thrown away per packet_receive call */
+#define RX_DISCARD_LEN          (16u)
+
+static_assert((0u != MUX_CONSOLE_QUANTUM) && (0u != MUX_LOG_QUANTUM) && (0u != MUX_DATA_QUANTUM),
+              "every channel needs a non-zero quantum");
+
+PRIVATE_RING_OPS_TYPE(MuxRingOps_t, u8_t)
+
+PRIVATE_RING_DECLARATIONS(mux_console_rx_ring, u8_t)
+PRIVATE_RING_DECLARATIONS(mux_console_tx_ring, u8_t)
+PRIVATE_RING_DECLARATIONS(mux_log_rx_ring, u8_t)
+PRIVATE_RING_DECLARATIONS(mux_log_tx_ring, u8_t)
+PRIVATE_RING_DECLARATIONS(mux_data_rx_ring, u8_t)
+PRIVATE_RING_DECLARATIONS(mux_data_tx_ring, u8_t)
+
+static const MuxRingOps_t mux_console_rx_ring_ops = PRIVATE_RING_OPS(mux_console_rx_ring);
+static const MuxRingOps_t mux_console_tx_ring_ops = PRIVATE_RING_OPS(mux_console_tx_ring);
+static const MuxRingOps_t mux_log_rx_ring_ops     = PRIVATE_RING_OPS(mux_log_rx_ring);
+static const MuxRingOps_t mux_log_tx_ring_ops     = PRIVATE_RING_OPS(mux_log_tx_ring);
+static const MuxRingOps_t mux_data_rx_ring_ops    = PRIVATE_RING_OPS(mux_data_rx_ring);
+static const MuxRingOps_t mux_data_tx_ring_ops    = PRIVATE_RING_OPS(mux_data_tx_ring);
+
+/* Fixed description of a channel */
+typedef struct channel_def
+{
+    const MuxRingOps_t *p_rx;       /* received bytes waiting for mux_read  */
+    const MuxRingOps_t *p_tx;       /* written bytes waiting to be sent     */
+    u32_t               quantum;    /* bytes sent per scheduling round      */
+} ChannelDef_t;
+
+/* Runtime state of a channel */
+typedef struct channel_state
+{
+    u32_t      deficit;     /* bytes left in the current turn (0: not started) */
+    MuxStats_t stats;
+} ChannelState_t;
+
+static const ChannelDef_t channel_defs[MUX_NUM_CHANNELS] =
+{
+    [MUX_CHANNEL_CONSOLE] = { &mux_console_rx_ring_ops, &mux_console_tx_ring_ops, MUX_CONSOLE_QUANTUM },
+    [MUX_CHANNEL_LOG]     = { &mux_log_rx_ring_ops,     &mux_log_tx_ring_ops,     MUX_LOG_QUANTUM     },
+    [MUX_CHANNEL_DATA]    = { &mux_data_rx_ring_ops,    &mux_data_tx_ring_ops,    MUX_DATA_QUANTUM    },
+};
+
+static void receive(void);
+static void receive_done(void);
+static void transmit(void);
+static void send_frame(MuxChannel_t channel, size_t len);
+
+static ChannelState_t channel_states[MUX_NUM_CHANNELS];
+static MuxChannel_t   tx_turn;
+
+/* Received frame so far: the channel ID followed by up to MUX_FRAME_MAX
+   bytes. rx_overflow is set once the frame outgrows the buffer. */
+static u8_t   rx_frame[1u + MUX_FRAME_MAX];
+static size_t rx_len;
+static bool_t rx_overflow;
+
+/**
+ * @brief Initialize the multiplexer and the packet module under it
+ *
+ * Must be called after bsp_init.
+ */
+void mux_init(void)
+{
+    size_t i;
+
+    packet_init();
+
+    for (i = 0; i < MUX_NUM_CHANNELS; i += 1) {
+        ChannelState_t * const p_state = &channel_states[i];
+
+        channel_defs[i].p_rx->init();
+        channel_defs[i].p_tx->init();
+
+        p_state->deficit          = 0;
+        p_state->stats.tx_bytes   = 0;
+        p_state->stats.tx_frames  = 0;
+        p_state->stats.rx_bytes   = 0;
+        p_state->stats.rx_frames  = 0;
+        p_state->stats.rx_dropped = 0;
+    }
+
+    tx_turn     = MUX_CHANNEL_CONSOLE;
+    rx_len      = 0;
+    rx_overflow = E_FALSE;
+}
+
+/**
+ * @brief Move frames between the channel queues and the serial port
+ *
+ * Call from the main loop. Each call takes in received bytes up to the end of
+ * at most one frame and sends at most one frame, and neither waits for the
+ * serial port.
+ */
+void mux_task(void)
+{
+    receive();
+    transmit();
+}
+
+/**
+ * @brief Queue bytes on a channel
+ *
+ * Bytes may be split across frames and are sent in order.
+ *
+ * @param[in] channel channel to write to
+ * @param[in] p_bytes bytes to send
+ * @param[in] len     number of bytes
+ *
+ * @return Number of bytes queued. The rest did not fit in the channel's
+ * transmit queue.
+ */
+size_t mux_write(MuxChannel_t channel, const u8_t * const p_bytes, size_t len)
+{
+    size_t written = 0;
+
+    if ((MUX_NUM_CHANNELS > (u32_t)channel) && (NULL_PTR != p_bytes)) {
+        written = channel_defs[channel].p_tx->push_n(p_bytes, len);
+    }
+
+    return written;
+}
+
+/**
+ * @brief Take received bytes from a channel
+ *
+ * @param[in]  channel channel to read from
+ * @param[out] p_bytes received bytes
+ * @param[in]  len     size of p_bytes
+ *
+ * @return Number of bytes read.
+ */
+size_t mux_read(MuxChannel_t channel, u8_t * const p_bytes, size_t len)
+{
+    size_t read = 0;
+
+    if ((MUX_NUM_CHANNELS > (u32_t)channel) && (NULL_PTR != p_bytes)) {
+        read = channel_defs[channel].p_rx->pop_n(p_bytes, len);
+    }
+
+    return read;
+}
+
+/**
+ * @brief Traffic counters of a channel
+ *
+ * @param[in]  channel channel to query
+ * @param[out] p_stats counters since mux_init
+ *
+ * @retval E_TRUE  - p_stats was filled in
+ * @retval E_FALSE - invalid channel
+ */
+bool_t mux_get_stats(MuxChannel_t channel, MuxStats_t * const p_stats)
+{
+    bool_t result = E_FALSE;
+
+    if ((MUX_NUM_CHANNELS > (u32_t)channel) && (NULL_PTR != p_stats)) {
+        *p_stats = channel_states[channel].stats;
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/* Stage received bytes until the end of a frame (or until there are none) */
+static void receive(void)
+{
+    u8_t       discard[RX_DISCARD_LEN];
+    PacketRx_t result;
+    size_t     len;
+
+    do {
+        if (rx_len < sizeof(rx_frame)) {
+            result  = packet_receive(&rx_frame[rx_len], sizeof(rx_frame) - rx_len, &len);
+            rx_len += len;
+        } else {
+            /* Too long for any channel. Read it out to find its end. */
+            result = packet_receive(discard, RX_DISCARD_LEN, &len);
+            if (0u != len) {
+                rx_overflow = E_TRUE;
+            }
+        }
+
+        switch (result) {
+            case PACKET_RX_FRAME_OK:
+                receive_done();
+                break;
+            case PACKET_RX_FRAME_BAD:
+                rx_len      = 0;
+                rx_overflow = E_FALSE;
+                break;
+            case PACKET_RX_NONE:
+            case PACKET_RX_DATA:
+            default:
+                break;
+        }
+    } while (PACKET_RX_DATA == result);
+}
+
+/* Queue a frame that checked out on its channel, all of it or none of it */
+static void receive_done(void)
+{
+    if ((0u != rx_len) && (MUX_NUM_CHANNELS > rx_frame[0])) {
+        const ChannelDef_t * const p_def = &channel_defs[rx_frame[0]];
+        MuxStats_t * const p_stats       = &channel_states[rx_frame[0]].stats;
+        const size_t len                 = rx_len - 1u;
+
+        if ((E_FALSE == rx_overflow) && (p_def->p_rx->space() >= len)) {
+            (void)p_def->p_rx->push_n(&rx_frame[1], len);
+            p_stats->rx_bytes  += len;
+            p_stats->rx_frames += 1u;
+        } else {
+            p_stats->rx_dropped += 1u;
+        }
+    }
+
+    rx_len      = 0;
+    rx_overflow = E_FALSE;
+}
+
+/*
+ * Send the next frame, if there is one and the serial port has room for all
+ * of it. Deficit round robin: a channel's turn lasts for up to its quantum of
+ * bytes, in frames of up to MUX_FRAME_MAX. A channel that runs out of bytes
+ * ends its turn and does not save up the rest.
+ */
+static void transmit(void)
+{
+    size_t pending;
+    size_t len;
+    size_t tries;
+
+    for (tries = 0; tries < MUX_NUM_CHANNELS; tries += 1) {
+        const ChannelDef_t * const p_def = &channel_defs[tx_turn];
+        ChannelState_t * const p_state   = &channel_states[tx_turn];
+
+        pending = p_def->p_tx->count();
+        if (0u == pending) {
+            p_state->deficit = 0;
+            tx_turn = (MuxChannel_t)((tx_turn + 1u) % MUX_NUM_CHANNELS);
+            continue;
+        }
+
+        if (0u == p_state->deficit) {
+            p_state->deficit = p_def->quantum;
+        }
+
+        len = pending;
+        if (len > p_state->deficit) {
+            len = p_state->deficit;
+        }
+        if (len > MUX_FRAME_MAX) {
+            len = MUX_FRAME_MAX;
+        }
+
+        /* Without room for the whole frame, the channel keeps its turn until
+           the next call */
+        if (bsp_serial_port_tx_space(PACKET_SERIAL_PORT) >= FRAME_WIRE_MAX(len)) {
+            send_frame(tx_turn, len);
+
+            p_state->deficit -= len;
+            if ((0u == p_state->deficit) || (len == pending)) {
+                p_state->deficit = 0;
+                tx_turn = (MuxChannel_t)((tx_turn + 1u) % MUX_NUM_CHANNELS);
+            }
+        }
+
+        break;
+    }
+}
+
+/* Send len bytes of the channel's transmit queue as one frame */
+static void send_frame(MuxChannel_t channel, size_t len)
+{
+    const ChannelDef_t * const p_def = &channel_defs[channel];
+    MuxStats_t * const p_stats       = &channel_states[channel].stats;
+    const u8_t id = (u8_t)channel;
+    u8_t      *p_span;
+    size_t     span_len;
+    size_t     left;
+
+    packet_send_begin();
+    packet_send(&id, 1u);
+
+    /* At most two spans: up to the end of the ring, then from the start */
+    left = len;
+    while (0u != left) {
+        span_len = p_def->p_tx->read_span(&p_span);
+        if (span_len > left) {
+            span_len = left;
+        }
+
+        packet_send(p_span, span_len);
+        p_def->p_tx->read_commit(span_len);
+        left -= span_len;
+    }
+
+    packet_send_end();
+
+    p_stats->tx_bytes  += len;
+    p_stats->tx_frames += 1u;
+}
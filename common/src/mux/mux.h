@@ -0,0 +1,59 @@
+/**
+ * @file mux.h
+ * @brief Virtual channels multiplexed over one serial port
+ *
+ * Each channel has its own receive and transmit queue. On the wire, every
+ * frame is a packet (see packet/packet.h) whose first payload byte is the
+ * channel ID:
+ *
+ *      COBS(channel | data | crc32) 0x00
+ *
+ * mux_task moves data between the queues and the serial port from the main
+ * loop. Received frames are only queued once their CRC checks out, and a frame
+ * that does not fit in its channel's queue is dropped whole. Outgoing frames
+ * are scheduled deficit round robin by bytes (see mux_config.h), so bulk data
+ * on one channel cannot starve the console.
+ *
+ * scripts/mux_demux.py is the host side. It exposes each channel as a pty.
+ *
+ * The multiplexer owns the packet module and its serial port.
+ */
+#ifndef MUX_H
+#define MUX_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum mux_channel
+{
+    MUX_CHANNEL_CONSOLE = 0,    /* interactive text            */
+    MUX_CHANNEL_LOG,            /* log output                  */
+    MUX_CHANNEL_DATA,           /* bulk binary data            */
+    MUX_NUM_CHANNELS,
+} MuxChannel_t;
+
+/* Per channel counters since mux_init. Bytes are channel data, not counting
+   the channel ID or framing. */
+typedef struct mux_stats
+{
+    u32_t tx_bytes;     /* bytes sent                                    */
+    u32_t tx_frames;    /* frames sent                                   */
+    u32_t rx_bytes;     /* bytes received and queued                     */
+    u32_t rx_frames;    /* frames received and queued                    */
+    u32_t rx_dropped;   /* frames dropped because the queue was full     */
+} MuxStats_t;
+
+void mux_init(void);
+void mux_task(void);
+size_t mux_write(MuxChannel_t channel, const u8_t * const p_bytes, size_t len);
+size_t mux_read(MuxChannel_t channel, u8_t * const p_bytes, size_t len);
+bool_t mux_get_stats(MuxChannel_t channel, MuxStats_t * const p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUX_H */
@@ -0,0 +1,48 @@
+/*
+ * Build time configuration of the channel multiplexer. Shared by mux.c and
+ * the ring storage in mux_rings.cpp so both agree on the ring sizes.
+ */
+#ifndef MUX_CONFIG_H
+#define MUX_CONFIG_H
+
+/* Most channel bytes in one frame. Bounds how long a channel has to wait for
+   the frame in front of it, and the receive staging buffer in mux.c. */
+#ifndef MUX_FRAME_MAX
+    #define MUX_FRAME_MAX           (64u)
+#endif
+
+/* Ring sizes per channel. Must be a power of 2 (checked at compile time). */
+#ifndef MUX_CONSOLE_RX_BUF_SIZE
+    #define MUX_CONSOLE_RX_BUF_SIZE (64u)
+#endif
+#ifndef MUX_CONSOLE_TX_BUF_SIZE
+    #define MUX_CONSOLE_TX_BUF_SIZE (128u)
+#endif
+#ifndef MUX_LOG_RX_BUF_SIZE
+    #define MUX_LOG_RX_BUF_SIZE     (16u)
+#endif
+#ifndef MUX_LOG_TX_BUF_SIZE
+    #define MUX_LOG_TX_BUF_SIZE     (256u)
+#endif
+#ifndef MUX_DATA_RX_BUF_SIZE
+    #define MUX_DATA_RX_BUF_SIZE    (256u)
+#endif
+#ifndef MUX_DATA_TX_BUF_SIZE
+    #define MUX_DATA_TX_BUF_SIZE    (256u)
+#endif
+
+/* Transmit share of each channel, in bytes per scheduling round (deficit
+   round robin). With equal quanta every backlogged channel gets the same
+   share of the line, so a busy channel can delay another by at most one
+   frame per other channel. */
+#ifndef MUX_CONSOLE_QUANTUM
+    #define MUX_CONSOLE_QUANTUM     (MUX_FRAME_MAX)
+#endif
+#ifndef MUX_LOG_QUANTUM
+    #define MUX_LOG_QUANTUM         (MUX_FRAME_MAX)
+#endif
+#ifndef MUX_DATA_QUANTUM
+    #define MUX_DATA_QUANTUM        (MUX_FRAME_MAX)
+#endif
+
+#endif /* MUX_CONFIG_H */
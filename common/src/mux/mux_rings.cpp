@@ -0,0 +1,16 @@
+/*
+ * Storage for the multiplexer's per channel rings. The rings live in a C++
+ * file so they can use the Ring<T, N> template behind the private_ring.h
+ * facade.
+ */
+#include "mux/mux_config.h"
+#include "utils/private_ring.h"
+#include "types.h"
+
+/* Ring sizes are set per channel in mux_config.h */
+PRIVATE_RING_DEFINITIONS(mux_console_rx_ring, u8_t, MUX_CONSOLE_RX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(mux_console_tx_ring, u8_t, MUX_CONSOLE_TX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(mux_log_rx_ring, u8_t, MUX_LOG_RX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(mux_log_tx_ring, u8_t, MUX_LOG_TX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(mux_data_rx_ring, u8_t, MUX_DATA_RX_BUF_SIZE)
+PRIVATE_RING_DEFINITIONS(mux_data_tx_ring, u8_t, MUX_DATA_TX_BUF_SIZE)
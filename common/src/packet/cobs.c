@@ -0,0 +1,125 @@
+#include "packet/cobs.h"
+
+#include "types.h"
+
+static void encoder_flush(CobsEncoder_t * const p_enc);
+
+/**
+ * @brief Start encoding a frame
+ *
+ * @param[out] p_enc encoder to start
+ * @param[in]  write function taking the encoded blocks
+ */
+void cobs_encoder_init(CobsEncoder_t * const p_enc, CobsWriteFn_t write)
+{
+    p_enc->write = write;
+    p_enc->len   = 0;
+}
+
+/**
+ * @brief Encode the next bytes of the frame
+ *
+ * Each block is passed to the write function as soon as it is complete.
+ *
+ * @param[in,out] p_enc   encoder
+ * @param[in]     p_bytes frame bytes
+ * @param[in]     len     number of frame bytes
+ */
+void cobs_encoder_put(CobsEncoder_t * const p_enc, const u8_t * const p_bytes, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += 1) {
+        if (COBS_DELIMITER == p_bytes[i]) {
+            /* The code byte of a short block stands in for the 0x00 */
+            encoder_flush(p_enc);
+        } else {
+            p_enc->len += 1u;
+            p_enc->block[p_enc->len] = p_bytes[i];
+
+            if (COBS_BLOCK_MAX == p_enc->len) {
+                encoder_flush(p_enc);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Finish the frame
+ *
+ * Writes the last block (possibly just a code byte) and the delimiter. The
+ * encoder is ready for the next frame afterwards.
+ *
+ * @param[in,out] p_enc encoder
+ */
+void cobs_encoder_end(CobsEncoder_t * const p_enc)
+{
+    const u8_t delimiter = COBS_DELIMITER;
+
+    encoder_flush(p_enc);
+    p_enc->write(&delimiter, 1u);
+}
+
+/**
+ * @brief Start decoding
+ *
+ * Anything before the first delimiter is treated as a frame, so a decoder
+ * started in the middle of a frame reports that frame as an error (or with a
+ * bad CRC one level up) and then lines up with the next one.
+ *
+ * @param[out] p_dec decoder to start
+ */
+void cobs_decoder_init(CobsDecoder_t * const p_dec)
+{
+    p_dec->code     = 0;
+    p_dec->left     = 0;
+    p_dec->in_frame = E_FALSE;
+}
+
+/**
+ * @brief Decode one received byte
+ *
+ * @param[in,out] p_dec decoder
+ * @param[in]     in    received byte
+ * @param[out]    p_out decoded byte (only written for COBS_DECODE_BYTE)
+ *
+ * @return What the byte did to the frame (see CobsDecode_t).
+ */
+CobsDecode_t cobs_decoder_put(CobsDecoder_t * const p_dec, u8_t in, u8_t * const p_out)
+{
+    CobsDecode_t result = COBS_DECODE_NONE;
+
+    if (COBS_DELIMITER == in) {
+        /* Back to back delimiters are idle line, not empty frames */
+        if (E_TRUE == p_dec->in_frame) {
+            result = (0u == p_dec->left) ? COBS_DECODE_END : COBS_DECODE_ERROR;
+        }
+
+        cobs_decoder_init(p_dec);
+    } else if (0u == p_dec->left) {
+        /* A code byte. The 0x00 a short block stands for is only known to be
+           there once another block follows it. */
+        if ((E_TRUE == p_dec->in_frame) && (0xFFu != p_dec->code)) {
+            *p_out = COBS_DELIMITER;
+            result = COBS_DECODE_BYTE;
+        }
+
+        p_dec->code     = in;
+        p_dec->left     = (u8_t)(in - 1u);
+        p_dec->in_frame = E_TRUE;
+    } else {
+        *p_out = in;
+        result = COBS_DECODE_BYTE;
+        p_dec->left -= 1u;
+    }
+
+    return result;
+}
+
+/* Write the block with its code byte and start an empty one */
+static void encoder_flush(CobsEncoder_t * const p_enc)
+{
+    p_enc->block[0] = (u8_t)(p_enc->len + 1u);
+    p_enc->write(p_enc->block, p_enc->len + 1u);
+    p_enc->len = 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file cobs.h
+ * @brief Streaming Consistent Overhead Byte Stuffing (COBS)
+ *
+ * COBS removes every 0x00 from a frame so 0x00 can mark the end of the frame.
+ * The encoded frame is a series of blocks, each a code byte followed by
+ * (code - 1) data bytes. A code below 0xFF means a 0x00 followed the block in
+ * the original frame (except for the last block); 0xFF means 254 data bytes
+ * with no 0x00 after them. The overhead is one byte per 254 bytes, plus the
+ * final 0x00.
+ *
+ * The encoder needs to know where the next 0x00 is before it can write a
+ * block's code byte, so it holds back at most one block (255 bytes) and hands
+ * each finished block to a write function. The decoder holds nothing: it is
+ * fed one encoded byte at a time and gives back at most one decoded byte.
+ * Neither side ever holds a whole frame.
+ */
+#ifndef COBS_H
+#define COBS_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most data bytes in one block */
+#define COBS_BLOCK_MAX      (254u)
+
+/* Frame delimiter */
+#define COBS_DELIMITER      (0x00u)
+
+/* Upper bound on the encoded length of len data bytes, including the
+   delimiter */
+#define COBS_ENCODED_MAX(len) ((len) + ((len) / COBS_BLOCK_MAX) + 2u)
+
+/* Takes each encoded block (and the final delimiter) from the encoder */
+typedef void (*CobsWriteFn_t)(const u8_t * const p_bytes, size_t len);
+
+typedef struct cobs_encoder
+{
+    CobsWriteFn_t write;
+    size_t        len;                          /* data bytes in block  */
+    u8_t          block[COBS_BLOCK_MAX + 1u];   /* code byte, then data */
+} CobsEncoder_t;
+
+typedef enum cobs_decode
+{
+    COBS_DECODE_NONE,   /* nothing to hand out (code byte or idle 0x00) */
+    COBS_DECODE_BYTE,   /* a decoded byte was written to *p_out          */
+    COBS_DECODE_END,    /* the frame ended cleanly                       */
+    COBS_DECODE_ERROR,  /* the frame ended inside a block                */
+} CobsDecode_t;
+
+typedef struct cobs_decoder
+{
+    u8_t   code;        /* code byte of the current block       */
+    u8_t   left;        /* data bytes left in the current block */
+    bool_t in_frame;    /* a code byte has been seen            */
+} CobsDecoder_t;
+
+void cobs_encoder_init(CobsEncoder_t * const p_enc, CobsWriteFn_t write);
+void cobs_encoder_put(CobsEncoder_t * const p_enc, const u8_t * const p_bytes, size_t len);
+void cobs_encoder_end(CobsEncoder_t * const p_enc);
+
+void cobs_decoder_init(CobsDecoder_t * const p_dec);
+CobsDecode_t cobs_decoder_put(CobsDecoder_t * const p_dec, u8_t in, u8_t * const p_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COBS_H */
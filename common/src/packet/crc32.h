@@ -0,0 +1,59 @@
+/**
+ * @file crc32.h
+ * @brief Streaming CRC-32 in the STM32 CRC unit's format
+ *
+ * The CRC is polynomial 0x04C11DB7, most significant bit first, initial value
+ * 0xFFFFFFFF, no reflection and no final XOR. Like the CRC unit, it works on
+ * 32 bit words: bytes are packed little endian (the first byte is bits 0-7)
+ * and a final partial word is padded with zero bytes.
+ *
+ * On the target the words go through the CRC unit (see bsp_crc32_update).
+ * Host builds (anything without STM32F103xB, or with CRC32_HW_ENABLE set to 0)
+ * use a 256 entry table instead and give the same results. Either way, any
+ * number of Crc32_t streams can be in progress at once:
+ *
+ *      Crc32_t crc;
+ *
+ *      crc32_init(&crc);
+ *      crc32_update(&crc, p_bytes, len);
+ *      ...
+ *      value = crc32_final(&crc);
+ *
+ * With the CRC unit, the streams must all be fed from the same execution
+ * context (e.g. the main loop), since they share the unit.
+ */
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CRC32_HW_ENABLE
+    #if defined(STM32F103xB)
+        #define CRC32_HW_ENABLE (1)
+    #else
+        #define CRC32_HW_ENABLE (0)
+    #endif
+#endif
+
+#define CRC32_INIT  (0xFFFFFFFFUL)
+
+typedef struct crc32
+{
+    u32_t crc;          /* CRC of the complete words so far  */
+    u32_t word;         /* bytes of the current partial word */
+    u8_t  num_bytes;    /* number of bytes in word (0 to 3)  */
+} Crc32_t;
+
+void crc32_init(Crc32_t * const p_crc);
+void crc32_update(Crc32_t * const p_crc, const u8_t * const p_bytes, size_t len);
+u32_t crc32_final(Crc32_t * const p_crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC32_H */
@@ -0,0 +1,390 @@
+#include "packet/packet.h"
+
+#include "bsp/bsp.h"
+#include "packet/cobs.h"
+#include "packet/crc32.h"
+#include "types.h"
+
+/* Received bytes taken from the serial driver at a time. Whatever is left
+   after the end of a frame waits here for the next call. */
+#define RX_CHUNK_SIZE           (16u)
+
+#if PACKET_BENCH_ENABLE
+/* Benchmark frames. The payload has a 0x00 every 16 bytes, so the encoder
+   sees both short and full blocks. */
+#define BENCH_PAYLOAD_LEN       (256u)
+#define BENCH_FRAMES            (16u)
+#define BENCH_BYTES             (BENCH_PAYLOAD_LEN * BENCH_FRAMES)
+#define BENCH_ZERO_EVERY        (16u)
+#define BENCH_WIRE_LEN          COBS_ENCODED_MAX(BENCH_PAYLOAD_LEN + PACKET_CRC_LEN)
+#define BENCH_DECODE_CHUNK      (64u)
+
+/* Cycles per byte are worked out in 1/16ths, and F_CPU_HZ in those units
+   still fits a u32_t. */
+#define RATE_FRAC_BITS          (4u)
+static_assert(F_CPU_HZ <= (0xFFFFFFFFUL >> RATE_FRAC_BITS), "F_CPU_HZ is too large for the rate math");
+#endif
+
+/* Outgoing frame: the CRC so far and the block being encoded */
+typedef struct tx_frame
+{
+    Crc32_t       crc;
+    CobsEncoder_t enc;
+} TxFrame_t;
+
+/* Incoming frame */
+typedef struct rx_frame
+{
+    CobsDecoder_t dec;
+    Crc32_t       crc;
+    u32_t         hold;     /* last decoded bytes, oldest in bits 0-7 */
+    u8_t          hold_len; /* bytes in hold (0 to PACKET_CRC_LEN)    */
+} RxFrame_t;
+
+static void tx_frame_begin(TxFrame_t * const p_tx, CobsWriteFn_t write);
+static void tx_frame_put(TxFrame_t * const p_tx, const u8_t * const p_bytes, size_t len);
+static void tx_frame_end(TxFrame_t * const p_tx);
+static void rx_frame_reset(RxFrame_t * const p_rx);
+static size_t rx_frame_decode(RxFrame_t * const p_rx, const u8_t * const p_in, size_t in_len,
+    u8_t * const p_dst, size_t dst_len, size_t * const p_out, PacketStats_t * const p_stats,
+    PacketRx_t * const p_result);
+static void serial_write(const u8_t * const p_bytes, size_t len);
+#if PACKET_BENCH_ENABLE
+static void bench_write(const u8_t * const p_bytes, size_t len);
+static void bench_rate(PacketRate_t * const p_rate, u32_t cycles);
+#endif
+
+static TxFrame_t     tx;
+static RxFrame_t     rx;
+static u8_t          rx_raw[RX_CHUNK_SIZE];
+static size_t        rx_raw_len;
+static size_t        rx_raw_pos;
+static PacketStats_t stats;
+
+#if PACKET_BENCH_ENABLE
+/* The benchmark encodes into memory instead of the serial port */
+static TxFrame_t     bench_tx;
+static RxFrame_t     bench_rx;
+static u8_t          bench_payload[BENCH_PAYLOAD_LEN];
+static u8_t          bench_wire[BENCH_WIRE_LEN];
+static size_t        bench_wire_len;
+#endif
+
+/**
+ * @brief Initialize the packet module
+ *
+ * Must be called after bsp_init.
+ */
+void packet_init(void)
+{
+    tx_frame_begin(&tx, serial_write);
+    rx_frame_reset(&rx);
+
+    rx_raw_len = 0;
+    rx_raw_pos = 0;
+
+    stats.tx_frames      = 0;
+    stats.rx_frames      = 0;
+    stats.rx_bad_crc     = 0;
+    stats.rx_bad_framing = 0;
+}
+
+/**
+ * @brief Start sending a frame
+ *
+ * Drops anything passed to packet_send since the last packet_send_end that
+ * has not gone out yet. Blocks already handed to the serial port stay sent,
+ * and the receiver sees a bad frame.
+ */
+void packet_send_begin(void)
+{
+    tx_frame_begin(&tx, serial_write);
+}
+
+/**
+ * @brief Send the next payload bytes of the frame
+ *
+ * Blocks until the serial driver has taken every completed block.
+ *
+ * @param[in] p_bytes payload bytes
+ * @param[in] len     number of payload bytes
+ */
+void packet_send(const u8_t * const p_bytes, size_t len)
+{
+    if (NULL_PTR != p_bytes) {
+        tx_frame_put(&tx, p_bytes, len);
+    }
+}
+
+/**
+ * @brief Finish the frame
+ *
+ * Sends the rest of the frame, its CRC and the delimiter. Blocks until the
+ * serial driver has taken all of it.
+ */
+void packet_send_end(void)
+{
+    tx_frame_end(&tx);
+    stats.tx_frames += 1u;
+}
+
+/**
+ * @brief Receive payload bytes
+ *
+ * Returns at the end of each frame, so the bytes in p_dst never span two
+ * frames.
+ *
+ * @param[out] p_dst      payload bytes of the current frame
+ * @param[in]  len        size of p_dst
+ * @param[out] p_received number of bytes written to p_dst
+ *
+ * @retval PACKET_RX_NONE      - no payload bytes and no frame end
+ * @retval PACKET_RX_DATA      - p_dst holds more payload of the current frame
+ * @retval PACKET_RX_FRAME_OK  - p_dst holds the last payload bytes (possibly
+ *                               none) of a frame whose CRC checked out
+ * @retval PACKET_RX_FRAME_BAD - the current frame is broken and everything
+ *                               received for it must be dropped
+ */
+PacketRx_t packet_receive(u8_t * const p_dst, size_t len, size_t * const p_received)
+{
+    PacketRx_t result = PACKET_RX_NONE;
+    size_t     out    = 0;
+    size_t     used;
+
+    while ((PACKET_RX_NONE == result) || (PACKET_RX_DATA == result)) {
+        if (rx_raw_pos == rx_raw_len) {
+            rx_raw_len = bsp_serial_port_read_buf(PACKET_SERIAL_PORT, rx_raw, RX_CHUNK_SIZE);
+            rx_raw_pos = 0;
+        }
+
+        if ((0u == rx_raw_len) || (out == len)) {
+            break;
+        }
+
+        used = rx_frame_decode(&rx, &rx_raw[rx_raw_pos], rx_raw_len - rx_raw_pos,
+            &p_dst[out], len - out, &out, &stats, &result);
+        rx_raw_pos += used;
+    }
+
+    *p_received = out;
+    return result;
+}
+
+/**
+ * @brief Frame counters since packet_init
+ *
+ * @param[out] p_stats counters
+ */
+void packet_get_stats(PacketStats_t * const p_stats)
+{
+    *p_stats = stats;
+}
+
+#if PACKET_BENCH_ENABLE
+/**
+ * @brief Measure the throughput of the packet codec
+ *
+ * Encodes BENCH_FRAMES frames of BENCH_PAYLOAD_LEN bytes into memory and then
+ * decodes and checks them, timing each half with the cycle counter. This is
+ * the CPU cost of the framing and CRC alone: the serial port and its buffers
+ * are not involved. Interrupts that fire during the run count against the
+ * codec, so run it before enabling them for a clean figure.
+ *
+ * @param[out] p_bench encode and decode rates
+ *
+ * @retval E_TRUE  - every frame decoded with a good CRC
+ * @retval E_FALSE - a frame failed to decode (the rates are still filled in)
+ */
+bool_t packet_benchmark(PacketBench_t * const p_bench)
+{
+    u8_t          dst[BENCH_DECODE_CHUNK];
+    PacketStats_t bench_stats;
+    PacketRx_t    result;
+    bool_t        ok = E_TRUE;
+    u32_t         start;
+    u32_t         cycles;
+    size_t        pos;
+    size_t        out;
+    size_t        i;
+
+    for (i = 0; i < BENCH_PAYLOAD_LEN; i += 1) {
+        bench_payload[i] = (0u == (i % BENCH_ZERO_EVERY)) ? 0x00u : (u8_t)i;
+    }
+
+    /* Every frame encodes to the same bytes, so only the last one needs to be
+       kept for the decode half. */
+    start = bsp_cycles_now();
+    for (i = 0; i < BENCH_FRAMES; i += 1) {
+        bench_wire_len = 0;
+        tx_frame_begin(&bench_tx, bench_write);
+        tx_frame_put(&bench_tx, bench_payload, BENCH_PAYLOAD_LEN);
+        tx_frame_end(&bench_tx);
+    }
+    cycles = bsp_cycles_now() - start;
+    bench_rate(&p_bench->encode, cycles);
+
+    start = bsp_cycles_now();
+    for (i = 0; i < BENCH_FRAMES; i += 1) {
+        rx_frame_reset(&bench_rx);
+        pos    = 0;
+        result = PACKET_RX_NONE;
+
+        while ((pos < bench_wire_len) && (PACKET_RX_FRAME_OK != result) && (PACKET_RX_FRAME_BAD != result)) {
+            out  = 0;
+            pos += rx_frame_decode(&bench_rx, &bench_wire[pos], bench_wire_len - pos,
+                dst, BENCH_DECODE_CHUNK, &out, &bench_stats, &result);
+        }
+
+        if (PACKET_RX_FRAME_OK != result) {
+            ok = E_FALSE;
+        }
+    }
+    cycles = bsp_cycles_now() - start;
+    bench_rate(&p_bench->decode, cycles);
+
+    return ok;
+}
+#endif
+
+/* Start a frame that writes its blocks with write */
+static void tx_frame_begin(TxFrame_t * const p_tx, CobsWriteFn_t write)
+{
+    crc32_init(&p_tx->crc);
+    cobs_encoder_init(&p_tx->enc, write);
+}
+
+/* Add payload bytes to the frame */
+static void tx_frame_put(TxFrame_t * const p_tx, const u8_t * const p_bytes, size_t len)
+{
+    crc32_update(&p_tx->crc, p_bytes, len);
+    cobs_encoder_put(&p_tx->enc, p_bytes, len);
+}
+
+/* Append the CRC (little endian) and end the frame */
+static void tx_frame_end(TxFrame_t * const p_tx)
+{
+    u8_t   crc_bytes[PACKET_CRC_LEN];
+    u32_t  crc;
+    size_t i;
+
+    crc = crc32_final(&p_tx->crc);
+    for (i = 0; i < PACKET_CRC_LEN; i += 1) {
+        crc_bytes[i] = (u8_t)(crc >> (8u * i));
+    }
+
+    cobs_encoder_put(&p_tx->enc, crc_bytes, PACKET_CRC_LEN);
+    cobs_encoder_end(&p_tx->enc);
+
+    crc32_init(&p_tx->crc);
+}
+
+/* Get ready for the next frame */
+static void rx_frame_reset(RxFrame_t * const p_rx)
+{
+    cobs_decoder_init(&p_rx->dec);
+    crc32_init(&p_rx->crc);
+    p_rx->hold     = 0;
+    p_rx->hold_len = 0;
+}
+
+/* Decode received bytes until they run out, p_dst is full or a frame ends.
+   Payload bytes go to p_dst and are counted in *p_out (which is added to, not
+   set). *p_result is set as for packet_receive. Returns the number of
+   received bytes used. */
+static size_t rx_frame_decode(RxFrame_t * const p_rx, const u8_t * const p_in, size_t in_len,
+    u8_t * const p_dst, size_t dst_len, size_t * const p_out, PacketStats_t * const p_stats,
+    PacketRx_t * const p_result)
+{
+    CobsDecode_t decode = COBS_DECODE_NONE;
+    size_t       used   = 0;
+    size_t       out    = 0;
+    u8_t         byte   = 0;
+
+    while ((used < in_len) && (out < dst_len)) {
+        decode = cobs_decoder_put(&p_rx->dec, p_in[used], &byte);
+        used  += 1u;
+
+        if (COBS_DECODE_BYTE == decode) {
+            /* The newest PACKET_CRC_LEN bytes might be the CRC. Whatever
+               they push out is payload. */
+            if (PACKET_CRC_LEN == p_rx->hold_len) {
+                p_dst[out] = (u8_t)p_rx->hold;
+                out += 1u;
+                p_rx->hold = (p_rx->hold >> 8) | ((u32_t)byte << 24);
+            } else {
+                p_rx->hold |= (u32_t)byte << (8u * p_rx->hold_len);
+                p_rx->hold_len += 1u;
+            }
+        } else if ((COBS_DECODE_END == decode) || (COBS_DECODE_ERROR == decode)) {
+            break;
+        } else {
+            /* code byte or idle delimiter */
+        }
+    }
+
+    crc32_update(&p_rx->crc, p_dst, out);
+    *p_out += out;
+
+    if (COBS_DECODE_END == decode) {
+        if (PACKET_CRC_LEN != p_rx->hold_len) {
+            p_stats->rx_bad_framing += 1u;
+            *p_result = PACKET_RX_FRAME_BAD;
+        } else if (crc32_final(&p_rx->crc) != p_rx->hold) {
+            p_stats->rx_bad_crc += 1u;
+            *p_result = PACKET_RX_FRAME_BAD;
+        } else {
+            p_stats->rx_frames += 1u;
+            *p_result = PACKET_RX_FRAME_OK;
+        }
+        rx_frame_reset(p_rx);
+    } else if (COBS_DECODE_ERROR == decode) {
+        p_stats->rx_bad_framing += 1u;
+        *p_result = PACKET_RX_FRAME_BAD;
+        rx_frame_reset(p_rx);
+    } else if (0u != *p_out) {
+        *p_result = PACKET_RX_DATA;
+    } else {
+        *p_result = PACKET_RX_NONE;
+    }
+
+    return used;
+}
+
+/* Hand an encoded block to the serial port, waiting for room */
+static void serial_write(const u8_t * const p_bytes, size_t len)
+{
+    size_t sent = 0;
+
+    while (sent < len) {
+        sent += bsp_serial_port_write_buf(PACKET_SERIAL_PORT, &p_bytes[sent], len - sent);
+    }
+}
+
+#if PACKET_BENCH_ENABLE
+/* Collect an encoded block for the decode half of the benchmark */
+static void bench_write(const u8_t * const p_bytes, size_t len)
+{
+    size_t i;
+
+    for (i = 0; (i < len) && (bench_wire_len < BENCH_WIRE_LEN); i += 1) {
+        bench_wire[bench_wire_len] = p_bytes[i];
+        bench_wire_len += 1u;
+    }
+}
+
+/* Turn the cycles taken for BENCH_BYTES payload bytes into rates */
+static void bench_rate(PacketRate_t * const p_rate, u32_t cycles)
+{
+    u32_t per_byte;
+
+    /* Cycles per byte in 1/16ths, without overflowing cycles << 4 */
+    per_byte = ((cycles / BENCH_BYTES) << RATE_FRAC_BITS)
+             + (((cycles % BENCH_BYTES) << RATE_FRAC_BITS) / BENCH_BYTES);
+    if (0u == per_byte) {
+        per_byte = 1u;
+    }
+
+    p_rate->cycles_per_byte = (per_byte + (1UL << (RATE_FRAC_BITS - 1u))) >> RATE_FRAC_BITS;
+    p_rate->bytes_per_sec   = ((u32_t)F_CPU_HZ << RATE_FRAC_BITS) / per_byte;
+}
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file packet.h
+ * @brief COBS framed packets with a CRC-32 over a serial port
+ *
+ * A frame on the wire is the payload followed by its CRC-32 (little endian,
+ * see packet/crc32.h), COBS encoded (see packet/cobs.h) and ended by a 0x00:
+ *
+ *      COBS(payload | crc32(payload)) 0x00
+ *
+ * Both directions stream. A frame is sent in as many pieces as the caller
+ * likes and goes out a block at a time, and received payload bytes are handed
+ * out as they are decoded. Only the last 4 decoded bytes are held back, since
+ * they may turn out to be the CRC. Neither side buffers a whole frame, so
+ * there is no frame size limit.
+ *
+ * The catch is that received bytes are handed out before the frame has been
+ * checked. A receiver that acts on a frame keeps what it got until
+ * packet_receive reports PACKET_RX_FRAME_OK, and drops it on
+ * PACKET_RX_FRAME_BAD.
+ *
+ * The packet module owns PACKET_SERIAL_PORT while it is in use: other output
+ * on the port would land in the middle of frames. All functions are for the
+ * main loop only and sending needs interrupts enabled to make progress.
+ */
+#ifndef PACKET_H
+#define PACKET_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Serial port carrying the frames */
+#ifndef PACKET_SERIAL_PORT
+    #define PACKET_SERIAL_PORT  BSP_SERIAL_1
+#endif
+
+/* With 1, packet_benchmark is built (e.g. -DPACKET_BENCH_ENABLE=1). It is off
+   by default, so its buffers are not linked into every image that uses the
+   packet module. */
+#ifndef PACKET_BENCH_ENABLE
+    #define PACKET_BENCH_ENABLE (0)
+#endif
+
+/* CRC bytes at the end of every frame */
+#define PACKET_CRC_LEN          (4u)
+
+typedef enum packet_rx
+{
+    PACKET_RX_NONE,         /* nothing received                             */
+    PACKET_RX_DATA,         /* payload bytes of a frame still in progress   */
+    PACKET_RX_FRAME_OK,     /* last payload bytes of a frame with a good CRC */
+    PACKET_RX_FRAME_BAD,    /* the frame had a bad CRC or broken framing    */
+} PacketRx_t;
+
+typedef struct packet_stats
+{
+    u32_t tx_frames;        /* frames sent                              */
+    u32_t rx_frames;        /* frames received with a good CRC          */
+    u32_t rx_bad_crc;       /* frames received with a bad CRC           */
+    u32_t rx_bad_framing;   /* frames cut short or too short for a CRC  */
+} PacketStats_t;
+
+/* Codec throughput for one direction */
+typedef struct packet_rate
+{
+    u32_t bytes_per_sec;    /* payload bytes per second of CPU time */
+    u32_t cycles_per_byte;  /* CPU cycles per payload byte          */
+} PacketRate_t;
+
+typedef struct packet_bench
+{
+    PacketRate_t encode;    /* CRC, COBS encode and block output    */
+    PacketRate_t decode;    /* COBS decode, CRC and frame check     */
+} PacketBench_t;
+
+void packet_init(void);
+void packet_send_begin(void);
+void packet_send(const u8_t * const p_bytes, size_t len);
+void packet_send_end(void);
+PacketRx_t packet_receive(u8_t * const p_dst, size_t len, size_t * const p_received);
+void packet_get_stats(PacketStats_t * const p_stats);
+#if PACKET_BENCH_ENABLE
+bool_t packet_benchmark(PacketBench_t * const p_bench);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PACKET_H */
@@ -0,0 +1,452 @@
+#include "timer/timer.h"
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+#define WHEEL_MASK          (TIMER_WHEEL_SLOTS - 1u)
+
+#if TIMER_BENCH_ENABLE
+/* Ticks timed by the benchmark at each timer count, and the range of the
+   benchmark timers' periods (64 to 32831 ticks, so they spread over levels 1
+   to 3 and some of them expire during the run). */
+#define BENCH_TICKS         (4096u)
+#define BENCH_MIN_PERIOD    (64u)
+#define BENCH_PERIOD_SPAN   (32768u)
+#endif
+
+typedef struct timer
+{
+    struct timer    *p_next;    /* next timer in the same list              */
+    struct timer   **pp_prev;   /* link that points at this timer, NULL_PTR
+                                   while the timer is not running           */
+    u32_t            expires;   /* tick the timer is due in                 */
+    u32_t            period;    /* ticks between expiries, 0 for one-shot   */
+    TimerCallback_t  cb;        /* NULL_PTR while the timer is free         */
+    void            *p_arg;
+} Timer_t;
+
+static void alarm_expired(void);
+static void run_tick(void);
+static void wheel_add(Timer_t * const p_timer);
+static void list_push(Timer_t ** const pp_head, Timer_t * const p_timer);
+static void list_remove(Timer_t * const p_timer);
+#if TIMER_BENCH_ENABLE
+static void bench_expired(TimerHandle_t t, void *p_arg);
+#endif
+
+static Timer_t  pool[TIMER_MAX_TIMERS];
+static Timer_t *p_free;                                         /* free timers, linked by p_next */
+static Timer_t *wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];   /* running timers                */
+static Timer_t *p_due;          /* timers of the tick being run that have not been called back  */
+static u32_t    wheel_tick;     /* next tick to run                                             */
+static u32_t    wheel_tick_us;  /* bsp_time_us at which wheel_tick is due                       */
+static u32_t    running;        /* timers in the wheel and the due list                         */
+#if TIMER_BENCH_ENABLE
+static u32_t    bench_expiries;
+#endif
+
+/**
+ * @brief Initialize the timer pool and take over the BSP alarm.
+ */
+void timer_init(void)
+{
+    size_t level;
+    size_t slot;
+    size_t i;
+
+    p_free = NULL_PTR;
+    for (i = TIMER_MAX_TIMERS; i != 0u; i -= 1u) {
+        pool[i - 1u].cb      = NULL_PTR;
+        pool[i - 1u].pp_prev = NULL_PTR;
+        pool[i - 1u].p_next  = p_free;
+        p_free = &pool[i - 1u];
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level += 1) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot += 1) {
+            wheel[level][slot] = NULL_PTR;
+        }
+    }
+
+    p_due      = NULL_PTR;
+    wheel_tick = 0;
+    running    = 0;
+
+    bsp_cancel_alarm();
+    bsp_register_alarm_callback(alarm_expired);
+}
+
+/**
+ * @brief Take a timer from the pool
+ *
+ * The timer is stopped until timer_start is called.
+ *
+ * @param[in] cb    called each time the timer expires
+ * @param[in] p_arg passed to cb
+ *
+ * @return The timer or TIMER_NO_TIMER if cb is NULL_PTR or the pool is empty.
+ */
+TimerHandle_t timer_alloc(TimerCallback_t cb, void *p_arg)
+{
+    Timer_t *p_timer = TIMER_NO_TIMER;
+    u32_t    state;
+
+    if (NULL_PTR != cb) {
+        state = bsp_irq_save();
+        p_timer = p_free;
+        if (NULL_PTR != p_timer) {
+            p_free = p_timer->p_next;
+
+            p_timer->p_next  = NULL_PTR;
+            p_timer->pp_prev = NULL_PTR;
+            p_timer->cb      = cb;
+            p_timer->p_arg   = p_arg;
+        }
+        bsp_irq_restore(state);
+    }
+
+    return p_timer;
+}
+
+/**
+ * @brief Stop a timer and return it to the pool.
+ *
+ * @param[in] t timer from timer_alloc
+ */
+void timer_free(TimerHandle_t t)
+{
+    u32_t state;
+
+    if ((TIMER_NO_TIMER != t) && (NULL_PTR != t->cb)) {
+        timer_stop(t);
+
+        state = bsp_irq_save();
+        t->cb     = NULL_PTR;
+        t->p_next = p_free;
+        p_free    = t;
+        bsp_irq_restore(state);
+    }
+}
+
+/**
+ * @brief Start (or restart) a timer
+ *
+ * The first expiry is delay_msec after the next tick, so the timer never
+ * fires early and at most one tick late. A periodic timer is then due every
+ * period_msec after its previous due time, however late its callback ran.
+ *
+ * @param[in] t           timer from timer_alloc
+ * @param[in] delay_msec  time to the first expiry
+ * @param[in] period_msec time between later expiries, 0 for a one-shot timer
+ *
+ * @retval E_TRUE  - timer started
+ * @retval E_FALSE - bad timer, or a time longer than TIMER_MAX_MSEC
+ */
+bool_t timer_start(TimerHandle_t t, u32_t delay_msec, u32_t period_msec)
+{
+    bool_t result = E_FALSE;
+    u32_t  state;
+
+    if ((TIMER_NO_TIMER != t) && (NULL_PTR != t->cb)
+        && (TIMER_MAX_MSEC >= delay_msec) && (TIMER_MAX_MSEC >= period_msec)) {
+        state = bsp_irq_save();
+
+        if (NULL_PTR != t->pp_prev) {
+            list_remove(t);
+            running -= 1u;
+        }
+
+        /* An idle wheel does not track time, so its next tick is due one tick
+           from now. */
+        if (0u == running) {
+            wheel_tick_us = bsp_time_us() + TIMER_TICK_USEC;
+            bsp_set_alarm(wheel_tick_us);
+        }
+
+        t->expires = wheel_tick + delay_msec;
+        t->period  = period_msec;
+        wheel_add(t);
+        running += 1u;
+
+        bsp_irq_restore(state);
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Stop a timer. Stopping a stopped timer does nothing.
+ *
+ * @param[in] t timer from timer_alloc
+ */
+void timer_stop(TimerHandle_t t)
+{
+    u32_t state;
+
+    if (TIMER_NO_TIMER != t) {
+        state = bsp_irq_save();
+
+        if (NULL_PTR != t->pp_prev) {
+            list_remove(t);
+            running -= 1u;
+
+            if (0u == running) {
+                bsp_cancel_alarm();
+            }
+        }
+
+        bsp_irq_restore(state);
+    }
+}
+
+/**
+ * @brief Whether a timer is running
+ *
+ * A one-shot timer stops just before its callback runs.
+ *
+ * @param[in] t timer from timer_alloc
+ */
+bool_t timer_is_running(TimerHandle_t t)
+{
+    return ((TIMER_NO_TIMER != t) && (NULL_PTR != t->pp_prev)) ? E_TRUE : E_FALSE;
+}
+
+#if TIMER_BENCH_ENABLE
+/**
+ * @brief Measure the cost of a tick against the number of running timers
+ *
+ * For 4, 16, 64 and 256 timers, starts that many periodic timers with pseudo
+ * random periods, runs BENCH_TICKS ticks straight through the wheel (without
+ * the alarm) and times each tick with the cycle counter. The cost includes
+ * the cascades and the expiries (with an empty callback) that happen during
+ * the run. Counts the pool cannot supply are skipped (reported as 0 timers).
+ *
+ * Must run while no timers are running, e.g. right after timer_init.
+ *
+ * @param[out] p_bench cost at each timer count
+ *
+ * @retval E_TRUE  - measured
+ * @retval E_FALSE - timers were running, nothing was measured
+ */
+bool_t timer_benchmark(TimerBench_t * const p_bench)
+{
+    static const u32_t counts[TIMER_BENCH_POINTS] = { 4u, 16u, 64u, 256u };
+
+    TimerBenchPoint_t *p_point;
+    TimerHandle_t      t;
+    bool_t             ok;
+    u32_t              seed;
+    u32_t              start;
+    u32_t              cycles;
+    u32_t              total;
+    size_t             point;
+    size_t             i;
+
+    ok = (0u == running) ? E_TRUE : E_FALSE;
+
+    for (point = 0; point < TIMER_BENCH_POINTS; point += 1) {
+        p_point = &p_bench->points[point];
+        p_point->timers          = 0;
+        p_point->cycles_per_tick = 0;
+        p_point->max_cycles      = 0;
+        p_point->expiries        = 0;
+
+        if ((E_FALSE == ok) || (counts[point] > TIMER_MAX_TIMERS)) {
+            continue;
+        }
+
+        /* Added straight to the wheel, since timer_start would set the
+           alarm. */
+        seed = 1u;
+        for (i = 0; i < counts[point]; i += 1) {
+            seed = (seed * 1664525UL) + 1013904223UL;
+
+            t = timer_alloc(bench_expired, NULL_PTR);
+            if (TIMER_NO_TIMER == t) {
+                break;
+            }
+
+            t->period  = BENCH_MIN_PERIOD + ((seed >> 16) & (BENCH_PERIOD_SPAN - 1u));
+            t->expires = wheel_tick + t->period;
+            wheel_add(t);
+            running += 1u;
+        }
+
+        /* Only measured with the full count (the application may hold some
+           of the pool). */
+        if (i == counts[point]) {
+            bench_expiries = 0;
+            total          = 0;
+            for (i = 0; i < BENCH_TICKS; i += 1) {
+                start = bsp_cycles_now();
+                run_tick();
+                cycles = bsp_cycles_now() - start;
+
+                total += cycles;
+                if (cycles > p_point->max_cycles) {
+                    p_point->max_cycles = cycles;
+                }
+            }
+
+            p_point->timers          = counts[point];
+            p_point->cycles_per_tick = total / BENCH_TICKS;
+            p_point->expiries        = bench_expiries;
+        }
+
+        for (i = 0; i < TIMER_MAX_TIMERS; i += 1) {
+            if (bench_expired == pool[i].cb) {
+                timer_free(&pool[i]);
+            }
+        }
+    }
+
+    return ok;
+}
+#endif
+
+/*
+ * BSP alarm callback (deferred work handler). Runs every tick that is due,
+ * then sets the alarm for the next one if anything is still running.
+ */
+static void alarm_expired(void)
+{
+    while ((0u != running) && ((s32_t)(bsp_time_us() - wheel_tick_us) >= 0)) {
+        run_tick();
+    }
+
+    if (0u != running) {
+        bsp_set_alarm(wheel_tick_us);
+    }
+}
+
+/*
+ * Run one tick: move the timers of the levels that turn over into the levels
+ * below, then call back the timers due in the tick. Interrupts are masked for
+ * one timer at a time, never for a whole list. The callbacks run with
+ * interrupts unmasked, after a periodic timer has been put back into the
+ * wheel and a one-shot timer stopped.
+ */
+static void run_tick(void)
+{
+    const u32_t tick = wheel_tick;
+
+    TimerCallback_t cb;
+    void           *p_arg;
+    Timer_t        *p_timer;
+    Timer_t       **pp_slot;
+    u32_t           shift;
+    u32_t           state;
+    size_t          level;
+
+    /* Level n turns over when the low n * TIMER_WHEEL_BITS bits of the tick
+       are 0. Its slot for this turn then holds the timers due in the next
+       span of level n - 1, which all go to lower levels. */
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level += 1) {
+        shift = TIMER_WHEEL_BITS * level;
+        if (0u != (tick & ((1UL << shift) - 1u))) {
+            break;
+        }
+
+        pp_slot = &wheel[level][(tick >> shift) & WHEEL_MASK];
+        do {
+            state = bsp_irq_save();
+            p_timer = *pp_slot;
+            if (NULL_PTR != p_timer) {
+                list_remove(p_timer);
+                wheel_add(p_timer);
+            }
+            bsp_irq_restore(state);
+        } while (NULL_PTR != p_timer);
+    }
+
+    /* Every timer in the tick's level 0 slot is due now. The wheel moves on
+       before any callback runs, so timers started from a callback count from
+       the next tick. */
+    state = bsp_irq_save();
+    pp_slot = &wheel[0][tick & WHEEL_MASK];
+    p_due   = *pp_slot;
+    *pp_slot = NULL_PTR;
+    if (NULL_PTR != p_due) {
+        p_due->pp_prev = &p_due;
+    }
+    wheel_tick     = tick + 1u;
+    wheel_tick_us += TIMER_TICK_USEC;
+    bsp_irq_restore(state);
+
+    do {
+        cb    = NULL_PTR;
+        p_arg = NULL_PTR;
+
+        state = bsp_irq_save();
+        p_timer = p_due;
+        if (NULL_PTR != p_timer) {
+            list_remove(p_timer);
+
+            if (0u != p_timer->period) {
+                p_timer->expires += p_timer->period;
+                wheel_add(p_timer);
+            } else {
+                running -= 1u;
+            }
+
+            cb    = p_timer->cb;
+            p_arg = p_timer->p_arg;
+        }
+        bsp_irq_restore(state);
+
+        if (NULL_PTR != cb) {
+            cb(p_timer, p_arg);
+        }
+    } while (NULL_PTR != p_timer);
+}
+
+/*
+ * Put a timer in the lowest level whose span covers the ticks to its expiry.
+ * Level n spans 2^((n + 1) * TIMER_WHEEL_BITS) ticks and is indexed by bits
+ * n * TIMER_WHEEL_BITS and up of the expiry tick.
+ */
+static void wheel_add(Timer_t * const p_timer)
+{
+    const u32_t delta = p_timer->expires - wheel_tick;
+    size_t      level = 0;
+
+    while (((level + 1u) < TIMER_WHEEL_LEVELS)
+           && (0u != (delta >> (TIMER_WHEEL_BITS * (level + 1u))))) {
+        level += 1u;
+    }
+
+    list_push(&wheel[level][(p_timer->expires >> (TIMER_WHEEL_BITS * level)) & WHEEL_MASK], p_timer);
+}
+
+/* Link a timer in at the head of a list */
+static void list_push(Timer_t ** const pp_head, Timer_t * const p_timer)
+{
+    p_timer->p_next = *pp_head;
+    if (NULL_PTR != p_timer->p_next) {
+        p_timer->p_next->pp_prev = &p_timer->p_next;
+    }
+
+    *pp_head = p_timer;
+    p_timer->pp_prev = pp_head;
+}
+
+/* Unlink a timer from whichever list it is on, without knowing the list */
+static void list_remove(Timer_t * const p_timer)
+{
+    *p_timer->pp_prev = p_timer->p_next;
+    if (NULL_PTR != p_timer->p_next) {
+        p_timer->p_next->pp_prev = p_timer->pp_prev;
+    }
+
+    p_timer->p_next  = NULL_PTR;
+    p_timer->pp_prev = NULL_PTR;
+}
+
+#if TIMER_BENCH_ENABLE
+/* Benchmark timer callback */
+static void bench_expired(TimerHandle_t t, void *p_arg)
+{
+    bench_expiries += 1u;
+}
+#endif
@@ -0,0 +1,100 @@
+/**
+ * @file timer.h
+ * @brief One-shot and periodic timers with callbacks
+ *
+ * Timers come from a static pool of TIMER_MAX_TIMERS. A timer is allocated
+ * once with its callback and then started and stopped as often as needed:
+ *
+ *      t = timer_alloc(blink, NULL_PTR);
+ *      timer_start(t, 500u, 500u);     every 500 ms, first in 500 ms
+ *
+ * Time is counted in ticks of TIMER_TICK_USEC (1 ms). The timers sit in a
+ * hierarchical timing wheel of TIMER_WHEEL_LEVELS levels with
+ * TIMER_WHEEL_SLOTS slots each. Level 0 has one slot per tick. Each higher
+ * level has one slot per full turn of the level below it. A timer goes in the
+ * lowest level whose span covers its delay. When a level turns over, the next
+ * slot of the level above is emptied into the levels below, so each timer
+ * moves down at most once per level. Starting, stopping and expiring a timer
+ * are O(1), and a tick touches only the timers due in it, plus the cascade
+ * when a level turns over. Neither depends on how many timers are running.
+ *
+ * The wheel is driven by the BSP alarm (one compare on the microsecond clock,
+ * see bsp_set_alarm). The alarm is set for the next tick while any timer is
+ * running and left off otherwise. Callbacks run from the alarm's deferred work
+ * handler (PendSV, see bsp_register_alarm_callback), never in the timer
+ * interrupt. A late handler catches up on every tick it missed, so periodic
+ * timers do not drift.
+ *
+ * The functions can be called from the main loop, from interrupt handlers and
+ * from timer callbacks (e.g. to stop or restart the timer that fired).
+ */
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Timers in the pool */
+#ifndef TIMER_MAX_TIMERS
+    #define TIMER_MAX_TIMERS    (32u)
+#endif
+
+/* Length of a tick */
+#define TIMER_TICK_USEC         (1000u)
+
+/* Wheel geometry. 5 levels of 32 slots span 2^25 ticks (~9.3 hours). */
+#define TIMER_WHEEL_BITS        (5u)
+#define TIMER_WHEEL_SLOTS       (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS      (5u)
+
+/* Longest delay or period timer_start accepts */
+#define TIMER_MAX_MSEC          ((1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1u)
+
+#define TIMER_NO_TIMER          (NULL_PTR)
+
+/* With 1, timer_benchmark is built (e.g. -DTIMER_BENCH_ENABLE=1). Its 64 and
+   256 timer points also need a pool that large (TIMER_MAX_TIMERS). */
+#ifndef TIMER_BENCH_ENABLE
+    #define TIMER_BENCH_ENABLE  (0)
+#endif
+
+/* Timer counts measured by timer_benchmark */
+#define TIMER_BENCH_POINTS      (4u)
+
+typedef struct timer* TimerHandle_t;
+
+/* Called when a timer expires, with the argument given to timer_alloc */
+typedef void (*TimerCallback_t)(TimerHandle_t t, void *p_arg);
+
+/* Cost of advancing the wheel with a number of timers running */
+typedef struct timer_bench_point
+{
+    u32_t timers;           /* timers running (0 if the pool is too small)  */
+    u32_t cycles_per_tick;  /* mean CPU cycles per tick                     */
+    u32_t max_cycles;       /* CPU cycles of the slowest tick               */
+    u32_t expiries;         /* callbacks run during the measurement         */
+} TimerBenchPoint_t;
+
+typedef struct timer_bench
+{
+    TimerBenchPoint_t points[TIMER_BENCH_POINTS];  /* 4, 16, 64 and 256 timers */
+} TimerBench_t;
+
+void timer_init(void);
+TimerHandle_t timer_alloc(TimerCallback_t cb, void *p_arg);
+void timer_free(TimerHandle_t t);
+bool_t timer_start(TimerHandle_t t, u32_t delay_msec, u32_t period_msec);
+void timer_stop(TimerHandle_t t);
+bool_t timer_is_running(TimerHandle_t t);
+#if TIMER_BENCH_ENABLE
+bool_t timer_benchmark(TimerBench_t * const p_bench);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMER_H */
@@ -0,0 +1,514 @@
+/**
+ * @file fmt.h
+ * @brief Header only, type safe formatting into a caller's buffer or straight
+ * into the serial transmit buffer
+ *
+ * Format strings use {} placeholders, one per argument:
+ *
+ *      FMT_TX("Letters    : {}\n", count);
+ *      FMT_TX("addr {08x} temp {.2} C\n", addr, fmt_fixed<8>(temp_q8));
+ *      p_end = FMT_TO(p_dst, "{} of {}", done, total);
+ *
+ * A placeholder is {[0][width][.precision][type]}:
+ *
+ *      0           pad to width with '0' instead of ' '
+ *      width       minimum field width (at most FMT_WIDTH_MAX)
+ *      .precision  decimals of a fixed point value (at most FMT_PREC_MAX)
+ *      type        d (decimal, the default), x or X (hex), c (character)
+ *
+ * {{ and }} stand for literal braces.
+ *
+ * The format string is checked when the code is compiled: a malformed
+ * placeholder or a placeholder count that does not match the arguments is a
+ * static_assert. The longest possible output is worked out at compile time
+ * from the string and the argument types as well, so FMT_TX reserves exactly
+ * that much in the transmit buffer, formats into it and commits what it used.
+ * There is no intermediate string and no heap.
+ *
+ * Arguments are the built in integer types, char, and FmtFixed<F> (a signed
+ * value with F fraction bits, made with fmt_fixed<F>). Other types can be
+ * added by specializing FmtArg<T> with max_len and put members like the ones
+ * below.
+ *
+ * The FMT_* macros are the front end. They hand the format string to the
+ * compile time checks as well as to the formatter, which walks it again at
+ * run time, copying literal text and formatting each argument in turn.
+ */
+#ifndef FMT_H
+#define FMT_H
+
+#ifndef __cplusplus
+    #error fmt.h is C++ only.
+#endif
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+/* Limits of the placeholder fields */
+#define FMT_WIDTH_MAX   (32u)
+#define FMT_PREC_MAX    (4u)
+
+/*
+ * Placeholder parsing. p points just past the '{'. These are constexpr so the
+ * same code checks and sizes the format at compile time and reads the
+ * placeholders at run time.
+ */
+constexpr bool fmt_is_digit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+constexpr bool fmt_is_type(char c)
+{
+    return ('d' == c) || ('x' == c) || ('X' == c) || ('c' == c);
+}
+
+constexpr const char* fmt_skip_digits(const char *p)
+{
+    return fmt_is_digit(*p) ? fmt_skip_digits(p + 1) : p;
+}
+
+constexpr u32_t fmt_parse_num(const char *p, u32_t acc)
+{
+    return fmt_is_digit(*p) ? fmt_parse_num(p + 1, (acc * 10u) + (u32_t)(*p - '0')) : acc;
+}
+
+constexpr const char* fmt_after_zero(const char *p)
+{
+    return ('0' == *p) ? (p + 1) : p;
+}
+
+constexpr const char* fmt_after_width(const char *p)
+{
+    return fmt_skip_digits(fmt_after_zero(p));
+}
+
+constexpr const char* fmt_after_prec(const char *p)
+{
+    return ('.' == *fmt_after_width(p)) ? fmt_skip_digits(fmt_after_width(p) + 1) : fmt_after_width(p);
+}
+
+constexpr const char* fmt_after_type(const char *p)
+{
+    return fmt_is_type(*fmt_after_prec(p)) ? (fmt_after_prec(p) + 1) : fmt_after_prec(p);
+}
+
+constexpr bool fmt_spec_zero(const char *p)
+{
+    return '0' == *p;
+}
+
+constexpr u32_t fmt_spec_width(const char *p)
+{
+    return fmt_parse_num(fmt_after_zero(p), 0u);
+}
+
+constexpr u32_t fmt_spec_prec(const char *p)
+{
+    return ('.' == *fmt_after_width(p)) ? fmt_parse_num(fmt_after_width(p) + 1, 0u) : 0u;
+}
+
+constexpr char fmt_spec_type(const char *p)
+{
+    return fmt_is_type(*fmt_after_prec(p)) ? *fmt_after_prec(p) : 'd';
+}
+
+constexpr bool fmt_spec_ok(const char *p)
+{
+    return ('}' == *fmt_after_type(p))
+        && (fmt_spec_width(p) <= FMT_WIDTH_MAX)
+        && (fmt_spec_prec(p) <= FMT_PREC_MAX);
+}
+
+/* First character after the placeholder's '}' */
+constexpr const char* fmt_spec_end(const char *p)
+{
+    return fmt_after_type(p) + 1;
+}
+
+constexpr bool fmt_is_escape(const char *s)
+{
+    return (('{' == s[0]) && ('{' == s[1])) || (('}' == s[0]) && ('}' == s[1]));
+}
+
+/* Every placeholder is well formed and every lone brace is part of one */
+constexpr bool fmt_valid(const char *s)
+{
+    return ('\0' == *s)          ? true
+         : fmt_is_escape(s)      ? fmt_valid(s + 2)
+         : ('}' == *s)           ? false
+         : ('{' == *s)           ? (fmt_spec_ok(s + 1) && fmt_valid(fmt_spec_end(s + 1)))
+         :                         fmt_valid(s + 1);
+}
+
+/* Number of placeholders (up to the first malformed one) */
+constexpr size_t fmt_count(const char *s)
+{
+    return ('\0' == *s)                         ? 0u
+         : fmt_is_escape(s)                     ? fmt_count(s + 2)
+         : (('{' == *s) && !fmt_spec_ok(s + 1)) ? 0u
+         : ('{' == *s)                          ? (1u + fmt_count(fmt_spec_end(s + 1)))
+         :                                        fmt_count(s + 1);
+}
+
+constexpr size_t fmt_max(size_t a, size_t b)
+{
+    return (a > b) ? a : b;
+}
+
+/* A placeholder as read at run time */
+struct FmtSpec
+{
+    u32_t width;
+    u32_t prec;
+    char  type;
+    bool  zero;
+};
+
+/*
+ * Digit output shared by the argument types. The digits are produced into a
+ * small scratch array least significant first and then copied out in order
+ * with the padding.
+ */
+static inline char* fmt_put_digits(char *p_dst, const FmtSpec &spec, bool negative,
+    u32_t value, u32_t min_digits)
+{
+    static const char hex_lower[] = "0123456789abcdef";
+    static const char hex_upper[] = "0123456789ABCDEF";
+    const char *digits_of = ('X' == spec.type) ? hex_upper : hex_lower;
+    const u32_t base      = (('x' == spec.type) || ('X' == spec.type)) ? 16u : 10u;
+    char   digits[32];
+    u32_t  len = 0;
+    u32_t  used;
+
+    do {
+        digits[len] = digits_of[value % base];
+        len += 1u;
+        value /= base;
+    } while ((0u != value) || (len < min_digits));
+
+    used = len + (negative ? 1u : 0u);
+
+    /* '0' padding goes between the sign and the digits, ' ' before both */
+    if (negative && spec.zero) {
+        *p_dst++ = '-';
+    }
+    for (; used < spec.width; used += 1u) {
+        *p_dst++ = spec.zero ? '0' : ' ';
+    }
+    if (negative && !spec.zero) {
+        *p_dst++ = '-';
+    }
+
+    while (0u != len) {
+        len -= 1u;
+        *p_dst++ = digits[len];
+    }
+
+    return p_dst;
+}
+
+/* Argument formatting, specialized per type */
+template <typename T>
+struct FmtArg;
+
+/* Unsigned integers of BITS bits */
+template <typename T, u32_t BITS>
+struct FmtUnsigned
+{
+    static constexpr size_t max_len(char type, u32_t prec)
+    {
+        return ('c' == type) ? 1u
+             : (('x' == type) || ('X' == type)) ? (BITS / 4u)
+             : ((BITS <= 8u) ? 3u : (BITS <= 16u) ? 5u : 10u);
+    }
+
+    static char* put(char *p_dst, const FmtSpec &spec, T value)
+    {
+        if ('c' == spec.type) {
+            *p_dst++ = (char)value;
+            return p_dst;
+        }
+
+        return fmt_put_digits(p_dst, spec, false, (u32_t)value, 1u);
+    }
+};
+
+/* Signed integers of BITS bits. Hex shows the two's complement bits. */
+template <typename T, u32_t BITS>
+struct FmtSigned
+{
+    static constexpr size_t max_len(char type, u32_t prec)
+    {
+        return ('c' == type) ? 1u
+             : (('x' == type) || ('X' == type)) ? (BITS / 4u)
+             : (1u + ((BITS <= 8u) ? 3u : (BITS <= 16u) ? 5u : 10u));
+    }
+
+    static char* put(char *p_dst, const FmtSpec &spec, T value)
+    {
+        const u32_t mask = (BITS < 32u) ? ((1UL << (BITS % 32u)) - 1u) : 0xFFFFFFFFUL;
+
+        if ('c' == spec.type) {
+            *p_dst++ = (char)value;
+            return p_dst;
+        }
+
+        if (('x' == spec.type) || ('X' == spec.type)) {
+            return fmt_put_digits(p_dst, spec, false, (u32_t)value & mask, 1u);
+        }
+
+        /* Negate in unsigned math, so the most negative value works */
+        return (value < 0)
+            ? fmt_put_digits(p_dst, spec, true, 0u - (u32_t)value, 1u)
+            : fmt_put_digits(p_dst, spec, false, (u32_t)value, 1u);
+    }
+};
+
+template <> struct FmtArg<unsigned char>  : FmtUnsigned<unsigned char, 8u>  { };
+template <> struct FmtArg<unsigned short> : FmtUnsigned<unsigned short, 16u> { };
+template <> struct FmtArg<unsigned int>   : FmtUnsigned<unsigned int, 32u>   { };
+template <> struct FmtArg<unsigned long>  : FmtUnsigned<unsigned long, 32u>  { };
+template <> struct FmtArg<signed char>    : FmtSigned<signed char, 8u>       { };
+template <> struct FmtArg<short>          : FmtSigned<short, 16u>            { };
+template <> struct FmtArg<int>            : FmtSigned<int, 32u>              { };
+template <> struct FmtArg<long>           : FmtSigned<long, 32u>             { };
+
+/* A plain char prints as a character, or as its code with x or X */
+template <>
+struct FmtArg<char>
+{
+    static constexpr size_t max_len(char type, u32_t prec)
+    {
+        return (('x' == type) || ('X' == type)) ? 2u : 1u;
+    }
+
+    static char* put(char *p_dst, const FmtSpec &spec, char value)
+    {
+        u32_t used;
+
+        if (('x' == spec.type) || ('X' == spec.type)) {
+            return FmtUnsigned<unsigned char, 8u>::put(p_dst, spec, (unsigned char)value);
+        }
+
+        for (used = 1u; used < spec.width; used += 1u) {
+            *p_dst++ = ' ';
+        }
+        *p_dst++ = value;
+
+        return p_dst;
+    }
+};
+
+/* Signed fixed point value with F fraction bits (e.g. F = 8 for Q23.8). The
+   precision is the number of decimals, rounded half up. */
+template <u8_t F>
+struct FmtFixed
+{
+    static_assert(F <= 16u, "FmtFixed supports up to 16 fraction bits");
+
+    s32_t value;
+};
+
+template <u8_t F>
+static inline FmtFixed<F> fmt_fixed(s32_t value)
+{
+    FmtFixed<F> fixed = { value };
+    return fixed;
+}
+
+template <u8_t F>
+struct FmtArg<FmtFixed<F> >
+{
+    static constexpr size_t max_len(char type, u32_t prec)
+    {
+        return 11u + ((0u != prec) ? (1u + prec) : 0u);
+    }
+
+    static char* put(char *p_dst, const FmtSpec &spec, FmtFixed<F> fixed)
+    {
+        static const u32_t pow10[FMT_PREC_MAX + 1u] = { 1u, 10u, 100u, 1000u, 10000u };
+        const bool  negative = fixed.value < 0;
+        const u32_t mag      = negative ? (0u - (u32_t)fixed.value) : (u32_t)fixed.value;
+        const u32_t scale    = pow10[spec.prec];
+        FmtSpec int_spec     = spec;
+        u32_t whole = mag >> F;
+        u32_t frac  = mag & ((1UL << F) - 1u);
+
+        /* The fraction in decimals, rounded. F <= 16 and scale <= 10^4 keep
+           the product inside 32 bits. */
+        frac = ((frac * scale) + ((1UL << F) >> 1)) >> F;
+        if (frac >= scale) {
+            whole += 1u;
+            frac  -= scale;
+        }
+
+        /* The width covers the whole field, so the integer part gets what
+           the point and the decimals leave */
+        const u32_t frac_len = (0u != spec.prec) ? (spec.prec + 1u) : 0u;
+
+        int_spec.type  = 'd';
+        int_spec.width = (spec.width > frac_len) ? (spec.width - frac_len) : 0u;
+
+        /* No sign on a value that rounds to zero */
+        p_dst = fmt_put_digits(p_dst, int_spec, negative && ((0u != whole) || (0u != frac)), whole, 1u);
+
+        if (0u != spec.prec) {
+            FmtSpec frac_spec = { 0u, 0u, 'd', false };
+
+            *p_dst++ = '.';
+            p_dst = fmt_put_digits(p_dst, frac_spec, false, frac, spec.prec);
+        }
+
+        return p_dst;
+    }
+};
+
+/*
+ * Longest output of a format string with the given argument types. Literal
+ * text counts one byte per character (or escape pair), and each placeholder
+ * counts the larger of its width and the type's longest output.
+ */
+template <typename... Args>
+struct FmtLen;
+
+template <>
+struct FmtLen<>
+{
+    static constexpr size_t get(const char *s)
+    {
+        return ('\0' == *s)     ? 0u
+             : fmt_is_escape(s) ? (1u + get(s + 2))
+             :                    (1u + get(s + 1));
+    }
+};
+
+template <typename T, typename... Rest>
+struct FmtLen<T, Rest...>
+{
+    static constexpr size_t get(const char *s)
+    {
+        return ('\0' == *s)     ? 0u
+             : fmt_is_escape(s) ? (1u + get(s + 2))
+             : ('{' == *s)      ? (fmt_max(fmt_spec_width(s + 1),
+                                           FmtArg<T>::max_len(fmt_spec_type(s + 1), fmt_spec_prec(s + 1)))
+                                   + FmtLen<Rest...>::get(fmt_spec_end(s + 1)))
+             :                    (1u + get(s + 1));
+    }
+};
+
+/* Argument types of a FMT_* call, format string first. Only used
+   unevaluated, through decltype. */
+template <typename... Args>
+struct FmtTypes { };
+
+template <typename... Args>
+FmtTypes<Args...> fmt_types(const Args&...);
+
+template <typename List>
+struct FmtLenOf;
+
+template <typename Fmt, typename... Args>
+struct FmtLenOf<FmtTypes<Fmt, Args...> >
+{
+    static constexpr size_t get(const char *s)
+    {
+        return FmtLen<Args...>::get(s);
+    }
+};
+
+/* Run time formatting: copy literal text up to the next placeholder, format
+   the next argument into it, and carry on with the rest. */
+static inline char* fmt_walk(char *p_dst, const char *s)
+{
+    while ('\0' != *s) {
+        *p_dst++ = *s;
+        s += fmt_is_escape(s) ? 2 : 1;
+    }
+
+    return p_dst;
+}
+
+template <typename T, typename... Rest>
+static inline char* fmt_walk(char *p_dst, const char *s, const T &arg, const Rest&... rest)
+{
+    while ('\0' != *s) {
+        if (fmt_is_escape(s)) {
+            *p_dst++ = *s;
+            s += 2;
+        } else if ('{' == *s) {
+            const FmtSpec spec = {
+                fmt_spec_width(s + 1), fmt_spec_prec(s + 1), fmt_spec_type(s + 1), fmt_spec_zero(s + 1)
+            };
+
+            p_dst = FmtArg<T>::put(p_dst, spec, arg);
+            return fmt_walk(p_dst, fmt_spec_end(s + 1), rest...);
+        } else {
+            *p_dst++ = *s;
+            s += 1;
+        }
+    }
+
+    return p_dst;
+}
+
+/* Checked entry points behind the FMT_* macros */
+template <bool VALID, size_t COUNT, typename... Args>
+static inline char* fmt_to(char *p_dst, const char *fmt, const Args&... args)
+{
+    static_assert(VALID, "malformed format string placeholder (see utils/fmt.h)");
+    static_assert(COUNT == sizeof...(Args), "format string placeholders do not match the arguments");
+
+    return fmt_walk(p_dst, fmt, args...);
+}
+
+template <bool VALID, size_t COUNT, size_t MAX_LEN, typename... Args>
+static inline bool_t fmt_tx(const char *fmt, const Args&... args)
+{
+    bool_t result = E_FALSE;
+    char  *p_dst;
+    char  *p_end;
+
+    static_assert(MAX_LEN <= BSP_SERIAL_TX_RESERVE_MAX,
+                  "FMT_TX output can be longer than a transmit reservation; split it");
+
+    p_dst = (char*)bsp_serial_tx_reserve(MAX_LEN);
+    if (NULL_PTR != p_dst) {
+        p_end = fmt_to<VALID, COUNT>(p_dst, fmt, args...);
+        bsp_serial_tx_commit((size_t)(p_end - p_dst));
+        result = E_TRUE;
+    }
+
+    return result;
+}
+
+#define FMT_FIRST(...)              FMT_FIRST_(__VA_ARGS__, unused)
+#define FMT_FIRST_(first, ...)      first
+
+/**
+ * Longest output of FMT_TO/FMT_TX with the same arguments, as a constant
+ * expression (e.g. for sizing a buffer).
+ */
+#define FMT_MAX_LEN(...)                                                        \
+    FmtLenOf<decltype(fmt_types(__VA_ARGS__))>::get(FMT_FIRST(__VA_ARGS__))
+
+/**
+ * Format into p_dst, which must hold FMT_MAX_LEN of the same arguments. No
+ * null terminator is written. Evaluates to the end of the output.
+ */
+#define FMT_TO(p_dst, ...)                                                      \
+    fmt_to<fmt_valid(FMT_FIRST(__VA_ARGS__)),                                   \
+           fmt_count(FMT_FIRST(__VA_ARGS__))>(p_dst, __VA_ARGS__)
+
+/**
+ * Format straight into the default serial port's transmit buffer. Evaluates to
+ * E_FALSE (and sends nothing) if the buffer has no room for the longest
+ * possible output. That output must be at most BSP_SERIAL_TX_RESERVE_MAX
+ * bytes (checked at compile time), or it could be refused with room to spare.
+ */
+#define FMT_TX(...)                                                             \
+    fmt_tx<fmt_valid(FMT_FIRST(__VA_ARGS__)),                                   \
+           fmt_count(FMT_FIRST(__VA_ARGS__)),                                   \
+           FMT_MAX_LEN(__VA_ARGS__)>(__VA_ARGS__)
+
+#endif /* FMT_H */
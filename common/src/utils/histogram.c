@@ -0,0 +1,116 @@
+#include "utils/histogram.h"
+
+#include "types.h"
+
+/**
+ * @brief Set up a histogram over caller supplied bins
+ *
+ * @param[out] p_hist   histogram to set up
+ * @param[in]  p_bins   bin storage (num_bins entries)
+ * @param[in]  num_bins number of bins (at least 1)
+ * @param[in]  shift    log2 of the bin width
+ */
+void histogram_init(Histogram_t * const p_hist, u32_t * const p_bins, size_t num_bins, u8_t shift)
+{
+    p_hist->p_bins   = p_bins;
+    p_hist->num_bins = num_bins;
+    p_hist->shift    = shift;
+
+    histogram_reset(p_hist);
+}
+
+/**
+ * @brief Clear all samples
+ */
+void histogram_reset(Histogram_t * const p_hist)
+{
+    size_t i;
+
+    for (i = 0; i < p_hist->num_bins; i += 1) {
+        p_hist->p_bins[i] = 0;
+    }
+
+    p_hist->count = 0;
+    p_hist->min   = 0;
+    p_hist->max   = 0;
+}
+
+/**
+ * @brief Add a sample
+ *
+ * Samples past the last bin are counted in the last bin. Counts saturate
+ * rather than wrap.
+ */
+void histogram_add(Histogram_t * const p_hist, u32_t sample)
+{
+    size_t bin;
+
+    bin = (size_t)(sample >> p_hist->shift);
+    if (bin >= p_hist->num_bins) {
+        bin = p_hist->num_bins - 1u;
+    }
+
+    if (0xFFFFFFFFu != p_hist->p_bins[bin]) {
+        p_hist->p_bins[bin] += 1;
+    }
+
+    if ((0 == p_hist->count) || (sample < p_hist->min)) {
+        p_hist->min = sample;
+    }
+
+    if (sample > p_hist->max) {
+        p_hist->max = sample;
+    }
+
+    if (0xFFFFFFFFu != p_hist->count) {
+        p_hist->count += 1;
+    }
+}
+
+/**
+ * @brief Upper bound of a percentile
+ *
+ * Finds the bin holding the sample at the given percentile and returns the
+ * largest value that bin can hold, capped at the largest sample. The result
+ * is therefore never below the true percentile and at most one bin width
+ * above it.
+ *
+ * @param[in] percent percentile (0 to 100)
+ *
+ * @return Upper bound of the percentile or 0 if there are no samples.
+ */
+u32_t histogram_percentile(const Histogram_t * const p_hist, u8_t percent)
+{
+    const u32_t pct    = (percent > 100u) ? 100u : percent;
+    u32_t       result = 0;
+    u32_t       target;
+    u32_t       seen;
+    u32_t       bound;
+    size_t      i;
+
+    if (0 != p_hist->count) {
+        /* Rank of the sample (1 based), rounded up without overflowing. */
+        target = ((p_hist->count / 100u) * pct) +
+                 ((((p_hist->count % 100u) * pct) + 99u) / 100u);
+        if (0 == target) {
+            target = 1;
+        }
+
+        /* Stops one past the bin holding the sample */
+        seen = 0;
+        for (i = 0; (i < p_hist->num_bins) && (seen < target); i += 1) {
+            seen += p_hist->p_bins[i];
+        }
+
+        /* The last bin has no upper edge. */
+        result = p_hist->max;
+        if (i < p_hist->num_bins) {
+            bound = (u32_t)((i << p_hist->shift) - 1u);
+            if (bound < result) {
+                result = bound;
+            }
+        }
+    }
+
+    return result;
+}
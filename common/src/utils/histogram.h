@@ -0,0 +1,43 @@
+/**
+ * @file histogram.h
+ * @brief Fixed bin histogram for latency and other u32_t measurements
+ *
+ * Bins are 2^shift units wide, so binning a sample is a shift and a compare.
+ * The last bin also counts every sample past the end of the range. The bin
+ * array is supplied by the caller:
+ *
+ *      static u32_t     bins[32];
+ *      static Histogram_t hist;
+ *
+ *      histogram_init(&hist, bins, 32u, 4u); // 32 bins of 16 units each
+ *      histogram_add(&hist, bsp_cycles_now() - stamp);
+ */
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct histogram
+{
+    u32_t *p_bins;      /* sample counts, num_bins entries        */
+    size_t num_bins;
+    u8_t   shift;       /* a sample lands in bin (sample >> shift) */
+    u32_t  count;       /* samples added since the last reset     */
+    u32_t  min;         /* smallest sample (0 when count is 0)    */
+    u32_t  max;         /* largest sample                         */
+} Histogram_t;
+
+void histogram_init(Histogram_t * const p_hist, u32_t * const p_bins, size_t num_bins, u8_t shift);
+void histogram_reset(Histogram_t * const p_hist);
+void histogram_add(Histogram_t * const p_hist, u32_t sample);
+u32_t histogram_percentile(const Histogram_t * const p_hist, u8_t percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HISTOGRAM_H */
@@ -1,110 +1,140 @@
 /**
  * @file private_ring.h
- * @brief Generic ring buffer implementation that is meant to be private to a
- * C module
+ * @brief C facade over the Ring<T, N> template for rings that are private to
+ * a C module
  *
+ * The ring is a single-producer/single-consumer (SPSC) queue. It is safe to
+ * push from one execution context (e.g. an ISR) while popping from another
+ * (e.g. the main loop) without disabling interrupts, provided each side only
+ * uses its own operations:
  *
+ *  - producer: is_full, space, push, push_n, write_span, write_commit
+ *  - consumer: is_empty, count, pop, pop_n, peek, read_span, read_commit
  *
- * Here typically goes a more extensive explanation of what the header
- * defines. Doxygens tags are words preceeded by either a backslash @\
- * or by an at symbol @@.
- * @see http://www.stack.nl/~dimitri/doxygen/docblocks.html
- * @see http://www.stack.nl/~dimitri/doxygen/commands.html
+ * A span is the largest contiguous region of the backing array that can be
+ * written (producer) or read (consumer) in one go. The caller fills or drains
+ * the span directly (e.g. with DMA) and then commits the number of elements it
+ * actually used.
+ *
+ * See utils/ring.h for the index and memory ordering details, and
+ * utils/ring_stats.h for the optional statistics returned by get_stats.
+ *
+ * Each facade is bound to one ring instance. The owning C module declares the
+ * facade functions with PRIVATE_RING_DECLARATIONS and a companion C++ file
+ * instantiates the ring with PRIVATE_RING_DEFINITIONS, which is also where the
+ * ring's capacity is chosen:
+ *
+ *      foo.c:          PRIVATE_RING_DECLARATIONS(foo_ring, u8_t)
+ *                      ...
+ *                      PRIVATE_RING_PUSH(foo_ring, byte);
+ *
+ *      foo_ring.cpp:   PRIVATE_RING_DEFINITIONS(foo_ring, u8_t, 64u)
  */
 
 #ifndef PRIVATE_RING_H
 #define PRIVATE_RING_H
 
 #include "types.h"
+#include "utils/ring_stats.h"
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+#define PRIVATE_RING_DECLARATIONS(NAME, T)                                              \
+void   NAME ## _init(void);                                                             \
+size_t NAME ## _count(void);                                                            \
+size_t NAME ## _space(void);                                                            \
+bool_t NAME ## _is_empty(void);                                                         \
+bool_t NAME ## _is_full(void);                                                          \
+bool_t NAME ## _push(T d);                                                              \
+T      NAME ## _pop(void);                                                              \
+T      NAME ## _peek(void);                                                             \
+size_t NAME ## _push_n(const T *p_src, size_t n);                                       \
+size_t NAME ## _pop_n(T *p_dst, size_t n);                                              \
+size_t NAME ## _write_span(T **pp_span);                                                \
+void   NAME ## _write_commit(size_t n);                                                 \
+size_t NAME ## _read_span(T **pp_span);                                                 \
+void   NAME ## _read_commit(size_t n);                                                 \
+bool_t NAME ## _get_stats(RingStats_t *p_stats);
 
-#ifndef PRIVATE_RING_SIZE
-    #define PRIVATE_RING_SIZE  (16u)
-#endif
+/* Table of a facade's functions, for code that picks one of several rings at
+   runtime (e.g. one ring per driver instance). PRIVATE_RING_OPS_TYPE declares
+   the table type for rings of T and PRIVATE_RING_OPS fills one in:
 
-#if ((PRIVATE_RING_SIZE & (PRIVATE_RING_SIZE-1)) != 0)
-    #error PRIVATE_RING_SIZE must be a power of 2!
-#endif
-
-#ifdef PRIVATE_RING_VOLATILE_DECL
-    #define PRIVATE_RING_VOLATILE__ volatile
-#else
-    #define PRIVATE_RING_VOLATILE__
-#endif
-
-#define PRIVATE_RING_DECLARATIONS(T_RING, T)                                            \
-typedef struct T_RING ## pointer_ring                                                   \
-{                                                                                       \
-    size_t head;                                                                        \
-    size_t tail;                                                                        \
-    T data[PRIVATE_RING_SIZE];                                                          \
-} T_RING ## PrivateRing_t;                                                              \
-                                                                                        \
-static inline void T_RING ## prv_ring_init(PRIVATE_RING_VOLATILE__ T_RING ## PrivateRing_t *p_ring) \
-{                                                                                       \
-    p_ring->head  = 0;                                                                  \
-    p_ring->tail = PRIVATE_RING_SIZE - 1;                                               \
-                                                                                        \
-    for (size_t i = 0; i < PRIVATE_RING_SIZE; i += 1) {                                 \
-        p_ring->data[i] = 0;                                                            \
-    }                                                                                   \
-}                                                                                       \
-                                                                                        \
-static inline bool_t T_RING ## prv_ring_is_empty(PRIVATE_RING_VOLATILE__ T_RING ## PrivateRing_t *p_ring) \
-{                                                                                       \
-    size_t next_tail = (p_ring->tail + 1) & (PRIVATE_RING_SIZE - 1);                    \
-    return next_tail == p_ring->head;                                                   \
-}                                                                                       \
-                                                                                        \
-static inline bool_t T_RING ## prv_ring_is_full(PRIVATE_RING_VOLATILE__ T_RING ## PrivateRing_t *p_ring) \
-{                                                                                       \
-    size_t next_head = (p_ring->head + 1) & (PRIVATE_RING_SIZE - 1);                    \
-    return next_head == p_ring->tail;                                                   \
-}                                                                                       \
-                                                                                        \
-static inline void T_RING ## prv_ring_push(PRIVATE_RING_VOLATILE__ T_RING ## PrivateRing_t *p_ring, T d) \
-{                                                                                       \
-    if (E_FALSE == T_RING ## prv_ring_is_full(p_ring)) {                                \
-        p_ring->data[p_ring->head] = d;                                                 \
-        p_ring->head = (p_ring->head + 1) & (PRIVATE_RING_SIZE - 1);                    \
-                                                                                        \
-    }                                                                                   \
-}                                                                                       \
-                                                                                        \
-static inline T T_RING ## prv_ring_pop(PRIVATE_RING_VOLATILE__ T_RING ## PrivateRing_t *p_ring) \
+        PRIVATE_RING_OPS_TYPE(ByteRingOps_t, u8_t)
+        static const ByteRingOps_t foo_ring_ops = PRIVATE_RING_OPS(foo_ring);
+ */
+#define PRIVATE_RING_OPS_TYPE(TYPE_NAME, T)                                             \
+typedef struct                                                                          \
 {                                                                                       \
-    size_t next_tail = (p_ring->tail + 1) & (PRIVATE_RING_SIZE - 1);                    \
-    T d = p_ring->data[next_tail];                                                      \
-                                                                                        \
-    if (E_FALSE ==  T_RING ## prv_ring_is_empty(p_ring)) {                              \
-        p_ring->data[p_ring->head] = d;                                                 \
-        p_ring->tail = next_tail;                                                       \
-    }                                                                                   \
-                                                                                        \
-    return d;                                                                           \
-}                                                                                       \
-                                                                                        \
-static inline T T_RING ## prv_ring_peek(PRIVATE_RING_VOLATILE__ T_RING ## PrivateRing_t *p_ring) \
+    void   (*init)(void);                                                               \
+    size_t (*count)(void);                                                              \
+    size_t (*space)(void);                                                              \
+    bool_t (*is_empty)(void);                                                           \
+    bool_t (*is_full)(void);                                                            \
+    bool_t (*push)(T d);                                                                \
+    T      (*pop)(void);                                                                \
+    T      (*peek)(void);                                                               \
+    size_t (*push_n)(const T *p_src, size_t n);                                         \
+    size_t (*pop_n)(T *p_dst, size_t n);                                                \
+    size_t (*write_span)(T **pp_span);                                                  \
+    void   (*write_commit)(size_t n);                                                   \
+    size_t (*read_span)(T **pp_span);                                                   \
+    void   (*read_commit)(size_t n);                                                    \
+    bool_t (*get_stats)(RingStats_t *p_stats);                                          \
+} TYPE_NAME;
+
+#define PRIVATE_RING_OPS(NAME)                                                          \
 {                                                                                       \
-    size_t next_tail = (p_ring->tail + 1) & (PRIVATE_RING_SIZE - 1);                    \
-    T d = p_ring->data[next_tail];                                                      \
-    return d;                                                                           \
+    NAME ## _init,       NAME ## _count,        NAME ## _space,                         \
+    NAME ## _is_empty,   NAME ## _is_full,      NAME ## _push,                          \
+    NAME ## _pop,        NAME ## _peek,         NAME ## _push_n,                        \
+    NAME ## _pop_n,      NAME ## _write_span,   NAME ## _write_commit,                  \
+    NAME ## _read_span,  NAME ## _read_commit,  NAME ## _get_stats,                     \
 }
 
-#define PRIVATE_RING_DECLARE(T_RING, var_name)      T_RING ## PrivateRing_t var_name
-
-#define PRIVATE_RING_INIT(T_RING, var_name)         T_RING ## prv_ring_init(&var_name)
-#define PRIVATE_RING_IS_EMPTY(T_RING, var_name)     T_RING ## prv_ring_is_empty(&var_name)
-#define PRIVATE_RING_IS_FULL(T_RING, var_name)      T_RING ## prv_ring_is_full(&var_name)
-#define PRIVATE_RING_PUSH(T_RING, var_name, data)   T_RING ## prv_ring_push(&var_name, data)
-#define PRIVATE_RING_POP(T_RING, var_name)          T_RING ## prv_ring_pop(&var_name)
-#define PRIVATE_RING_PEEK(T_RING, var_name)         T_RING ## prv_ring_peek(&var_name)
+#define PRIVATE_RING_INIT(NAME)                     NAME ## _init()
+#define PRIVATE_RING_COUNT(NAME)                    NAME ## _count()
+#define PRIVATE_RING_SPACE(NAME)                    NAME ## _space()
+#define PRIVATE_RING_IS_EMPTY(NAME)                 NAME ## _is_empty()
+#define PRIVATE_RING_IS_FULL(NAME)                  NAME ## _is_full()
+#define PRIVATE_RING_PUSH(NAME, data)               NAME ## _push(data)
+#define PRIVATE_RING_POP(NAME)                      NAME ## _pop()
+#define PRIVATE_RING_PEEK(NAME)                     NAME ## _peek()
+#define PRIVATE_RING_PUSH_N(NAME, p_src, n)         NAME ## _push_n(p_src, n)
+#define PRIVATE_RING_POP_N(NAME, p_dst, n)          NAME ## _pop_n(p_dst, n)
+#define PRIVATE_RING_WRITE_SPAN(NAME, pp_span)      NAME ## _write_span(pp_span)
+#define PRIVATE_RING_WRITE_COMMIT(NAME, n)          NAME ## _write_commit(n)
+#define PRIVATE_RING_READ_SPAN(NAME, pp_span)       NAME ## _read_span(pp_span)
+#define PRIVATE_RING_READ_COMMIT(NAME, n)           NAME ## _read_commit(n)
+#define PRIVATE_RING_GET_STATS(NAME, p_stats)       NAME ## _get_stats(p_stats)
 
 #ifdef __cplusplus
+
+#include "utils/ring.h"
+
+/* Instantiate the ring behind a facade and give the facade functions C
+   linkage. The capacity is checked at compile time by Ring<T, N>. */
+#define PRIVATE_RING_DEFINITIONS(NAME, T, N)                                                      \
+static Ring<T, N> NAME ## _instance;                                                              \
+                                                                                                  \
+extern "C" {                                                                                      \
+PRIVATE_RING_DECLARATIONS(NAME, T)                                                                \
+                                                                                                  \
+void   NAME ## _init(void)                 { NAME ## _instance.init(); }                          \
+size_t NAME ## _count(void)                { return NAME ## _instance.count(); }                  \
+size_t NAME ## _space(void)                { return NAME ## _instance.space(); }                  \
+bool_t NAME ## _is_empty(void)             { return NAME ## _instance.is_empty(); }               \
+bool_t NAME ## _is_full(void)              { return NAME ## _instance.is_full(); }                \
+bool_t NAME ## _push(T d)                  { return NAME ## _instance.push(d); }                  \
+T      NAME ## _pop(void)                  { return NAME ## _instance.pop(); }                    \
+T      NAME ## _peek(void)                 { return NAME ## _instance.peek(); }                   \
+size_t NAME ## _push_n(const T *p_src, size_t n) { return NAME ## _instance.push_n(p_src, n); }   \
+size_t NAME ## _pop_n(T *p_dst, size_t n)  { return NAME ## _instance.pop_n(p_dst, n); }          \
+size_t NAME ## _write_span(T **pp_span)    { return NAME ## _instance.write_span(pp_span); }      \
+void   NAME ## _write_commit(size_t n)     { NAME ## _instance.write_commit(n); }                 \
+size_t NAME ## _read_span(T **pp_span)     { return NAME ## _instance.read_span(pp_span); }       \
+void   NAME ## _read_commit(size_t n)      { NAME ## _instance.read_commit(n); }                  \
+bool_t NAME ## _get_stats(RingStats_t *p_stats) { return NAME ## _instance.get_stats(p_stats); }  \
 }
-#endif
 
-#endif /* PRIVATE_RING_H */
\ No newline at end of file
+#endif /* __cplusplus */
+
+#endif /* PRIVATE_RING_H */
@@ -0,0 +1,330 @@
+/**
+ * @file ring.h
+ * @brief Header only single-producer/single-consumer ring buffer template
+ *
+ * Ring<T, N> is the C++ implementation behind the C facade in private_ring.h.
+ * It has the same ownership rules and memory ordering as the facade:
+ *
+ *  - producer: is_full, space, push, push_n, write_span, write_commit
+ *  - consumer: is_empty, count, pop, pop_n, peek, read_span, read_commit
+ *
+ * The head and tail indices are free running. Their type is the smallest
+ * unsigned type that can hold a fill level of N, so the indices wrap on their
+ * own at a multiple of N and only the slot lookup needs the (N - 1) mask:
+ *
+ *      N <= 128    u8_t
+ *      N <= 32768  u16_t
+ *      otherwise   u32_t
+ *
+ * A 256 byte UART ring therefore keeps its indices in 2 bytes each instead of
+ * a size_t each.
+ *
+ * When RING_STATS_ENABLE is set (see utils/ring_stats.h), each ring also keeps
+ * a high-water mark, rejected push and empty pop counts, and a total push
+ * count. The producer side counters are only written by the producer and the
+ * consumer side counter only by the consumer, so the SPSC rules still hold.
+ * With the option off, the statistics base class is empty and adds neither
+ * storage nor code.
+ *
+ * The class has no constructor, so a ring with static storage is zero
+ * initialized by the startup code and does not add a global constructor.
+ * init() must still be called before use.
+ */
+#ifndef RING_H
+#define RING_H
+
+#ifndef __cplusplus
+    #error ring.h is C++ only. C modules use the facade in private_ring.h.
+#endif
+
+#include "types.h"
+#include "utils/ring_stats.h"
+
+/* Full memory barrier. On the Cortex-M3 this is a DMB instruction, which also
+   acts as a compiler barrier. */
+#define RING_BARRIER()  __sync_synchronize()
+
+/*
+ * Index type selection. A free running index wraps at 2^bits, and the fill
+ * level (head - tail) must be able to reach N without wrapping to 0.
+ */
+template <size_t N, bool FITS_U8 = (N <= 128u), bool FITS_U16 = (N <= 32768u)>
+struct RingIndex
+{
+    typedef u32_t type;
+};
+
+template <size_t N>
+struct RingIndex<N, true, true>
+{
+    typedef u8_t type;
+};
+
+template <size_t N>
+struct RingIndex<N, false, true>
+{
+    typedef u16_t type;
+};
+
+/*
+ * Ring statistics. The disabled variant is empty, and the empty base class
+ * optimization keeps it from adding any storage to the ring.
+ */
+template <bool ENABLED>
+class RingStatsPolicy
+{
+public:
+    bool_t get_stats(RingStats_t *p_stats) const
+    {
+        return E_FALSE;
+    }
+
+protected:
+    void stats_reset(void) { }
+    void stats_pushed(size_t n, size_t level) { }
+    void stats_push_rejected(size_t n) { }
+    void stats_pop_empty(void) { }
+};
+
+template <>
+class RingStatsPolicy<true>
+{
+public:
+    bool_t get_stats(RingStats_t *p_stats) const
+    {
+        p_stats->high_water   = stats.high_water;
+        p_stats->push_rejects = stats.push_rejects;
+        p_stats->pop_empties  = stats.pop_empties;
+        p_stats->total_pushed = stats.total_pushed;
+        return E_TRUE;
+    }
+
+protected:
+    void stats_reset(void)
+    {
+        stats.high_water   = 0;
+        stats.push_rejects = 0;
+        stats.pop_empties  = 0;
+        stats.total_pushed = 0;
+    }
+
+    void stats_pushed(size_t n, size_t level)
+    {
+        stats.total_pushed += n;
+        if (level > stats.high_water) {
+            stats.high_water = level;
+        }
+    }
+
+    void stats_push_rejected(size_t n)
+    {
+        stats.push_rejects += n;
+    }
+
+    void stats_pop_empty(void)
+    {
+        stats.pop_empties += 1u;
+    }
+
+private:
+    volatile RingStats_t stats;
+};
+
+template <typename T, size_t N>
+class Ring : public RingStatsPolicy<0 != RING_STATS_ENABLE>
+{
+public:
+    typedef typename RingIndex<N>::type Index_t;
+
+    static_assert(0u != N, "Ring capacity must be non-zero");
+    static_assert(0u == (N & (N - 1u)), "Ring capacity must be a power of 2");
+    static_assert(N <= ((static_cast<u32_t>(static_cast<Index_t>(~0u)) / 2u) + 1u),
+                  "Ring index type is too narrow for the capacity");
+
+    void init(void)
+    {
+        head = 0;
+        tail = 0;
+        this->stats_reset();
+
+        for (size_t i = 0; i < N; i += 1) {
+            data[i] = T();
+        }
+    }
+
+    size_t count(void) const
+    {
+        /* The cast back to the index type keeps the subtraction modulo the
+           index width after integer promotion. */
+        return static_cast<Index_t>(head - tail);
+    }
+
+    size_t space(void) const
+    {
+        return N - count();
+    }
+
+    bool_t is_empty(void) const
+    {
+        return (0u == count()) ? E_TRUE : E_FALSE;
+    }
+
+    bool_t is_full(void) const
+    {
+        return (N <= count()) ? E_TRUE : E_FALSE;
+    }
+
+    bool_t push(T d)
+    {
+        const Index_t h = head;
+        bool_t result   = E_FALSE;
+
+        if (E_FALSE == is_full()) {
+            data[h & MASK] = d;
+            RING_BARRIER(); /* data must land before head is published */
+            head = static_cast<Index_t>(h + 1u);
+            result = E_TRUE;
+            this->stats_pushed(1u, count());
+        } else {
+            this->stats_push_rejected(1u);
+        }
+
+        return result;
+    }
+
+    T pop(void)
+    {
+        const Index_t t = tail;
+        T d = T();
+
+        if (E_FALSE == is_empty()) {
+            RING_BARRIER(); /* head observed before data is read */
+            d = data[t & MASK];
+            RING_BARRIER(); /* data read before slot is handed back */
+            tail = static_cast<Index_t>(t + 1u);
+        } else {
+            this->stats_pop_empty();
+        }
+
+        return d;
+    }
+
+    T peek(void) const
+    {
+        T d = T();
+
+        if (E_FALSE == is_empty()) {
+            RING_BARRIER();
+            d = data[tail & MASK];
+        }
+
+        return d;
+    }
+
+    size_t write_span(T **pp_span)
+    {
+        const size_t slot   = head & MASK;
+        const size_t to_end = N - slot;
+        const size_t avail  = space();
+
+        *pp_span = &data[slot];
+        return (avail < to_end) ? avail : to_end;
+    }
+
+    void write_commit(size_t n)
+    {
+        RING_BARRIER(); /* span contents must land before head is published */
+        head = static_cast<Index_t>(head + n);
+        this->stats_pushed(n, count());
+    }
+
+    size_t read_span(T **pp_span)
+    {
+        const size_t slot   = tail & MASK;
+        const size_t to_end = N - slot;
+        const size_t used   = count();
+
+        RING_BARRIER(); /* head observed before the span is read */
+        *pp_span = &data[slot];
+        return (used < to_end) ? used : to_end;
+    }
+
+    void read_commit(size_t n)
+    {
+        RING_BARRIER(); /* span read before the slots are handed back */
+        tail = static_cast<Index_t>(tail + n);
+    }
+
+    size_t push_n(const T *p_src, size_t n)
+    {
+        T     *p_span;
+        size_t span_len;
+        size_t pushed = 0;
+
+        /* At most two passes: up to the end of the array, then from the start. */
+        while (pushed < n) {
+            span_len = write_span(&p_span);
+            if (0u == span_len) {
+                break;
+            }
+
+            if (span_len > (n - pushed)) {
+                span_len = n - pushed;
+            }
+
+            for (size_t i = 0; i < span_len; i += 1) {
+                p_span[i] = p_src[pushed + i];
+            }
+
+            write_commit(span_len);
+            pushed += span_len;
+        }
+
+        if (pushed < n) {
+            this->stats_push_rejected(n - pushed);
+        }
+
+        return pushed;
+    }
+
+    size_t pop_n(T *p_dst, size_t n)
+    {
+        T     *p_span;
+        size_t span_len;
+        size_t popped = 0;
+
+        /* At most two passes: up to the end of the array, then from the start. */
+        while (popped < n) {
+            span_len = read_span(&p_span);
+            if (0u == span_len) {
+                break;
+            }
+
+            if (span_len > (n - popped)) {
+                span_len = n - popped;
+            }
+
+            for (size_t i = 0; i < span_len; i += 1) {
+                p_dst[popped + i] = p_span[i];
+            }
+
+            read_commit(span_len);
+            popped += span_len;
+        }
+
+        if ((0u == popped) && (0u != n)) {
+            this->stats_pop_empty();
+        }
+
+        return popped;
+    }
+
+private:
+    static const size_t MASK = N - 1u;
+
+    volatile Index_t head;  /* free running write index (producer owned) */
+    volatile Index_t tail;  /* free running read index (consumer owned)  */
+    T data[N];
+};
+
+#endif /* RING_H */
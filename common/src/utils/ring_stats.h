@@ -0,0 +1,35 @@
+/**
+ * @file ring_stats.h
+ * @brief Optional ring buffer instrumentation
+ *
+ * When RING_STATS_ENABLE is set to 1 (e.g. -DRING_STATS_ENABLE=1 on the
+ * compiler command line), every Ring<T, N> keeps the counters below. When it
+ * is 0 (the default) the counters and the code that maintains them compile
+ * away completely.
+ */
+#ifndef RING_STATS_H
+#define RING_STATS_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef RING_STATS_ENABLE
+    #define RING_STATS_ENABLE (0)
+#endif
+
+typedef struct ring_stats
+{
+    u32_t high_water;   /* most elements ever held at once           */
+    u32_t push_rejects; /* elements refused because the ring was full */
+    u32_t pop_empties;  /* pops attempted while the ring was empty    */
+    u32_t total_pushed; /* elements that have gone into the ring      */
+} RingStats_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RING_STATS_H */
@@ -0,0 +1,181 @@
+#!/usr/bin/env python
+
+""" Binary log decoder
+
+Prints the records of the firmware's binary log (common/src/log). The format
+strings are not sent by the device: they are read from the .log_fmt section of
+the application's ELF file, where a record's message ID is the offset of its
+format string. Records are read from a serial port, a pty (e.g. the log
+channel of scripts/mux_demux.py) or a capture file:
+
+    python scripts/log_decoder.py bin/07_sentence_statistics/07_sentence_statistics.elf /dev/ttyUSB0
+
+The section is extracted with objcopy (arm-none-eabi-objcopy by default).
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+import packet
+
+# printf conversion: flags, width, precision, length and conversion
+_SPEC = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcp%])')
+
+
+def load_formats(elf, objcopy):
+    """Map of message ID to format string from the ELF's .log_fmt section."""
+
+    with tempfile.TemporaryDirectory() as tmp:
+        dump = os.path.join(tmp, 'log_fmt.bin')
+        cmd = [objcopy, '--dump-section', f'.log_fmt={dump}', elf, os.path.join(tmp, 'out.elf')]
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        if result.returncode != 0 or not os.path.exists(dump):
+            sys.exit(f'Cannot read .log_fmt from {elf}: {result.stderr.strip()}')
+
+        with open(dump, 'rb') as f:
+            blob = f.read()
+
+    formats = {}
+    offset = 0
+    while offset < len(blob):
+        end = blob.find(b'\x00', offset)
+        if end < 0:
+            end = len(blob)
+        if end > offset:
+            formats[offset] = blob[offset:end].decode('ascii', errors='replace')
+        offset = end + 1
+
+    return formats
+
+
+def read_varints(data):
+    """Unsigned LEB128 varints of data. None if the last one is cut short."""
+
+    values = []
+    value = 0
+    shift = 0
+
+    for b in data:
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            values.append(value & 0xFFFFFFFF)
+            value = 0
+            shift = 0
+
+    return values if shift == 0 else None
+
+
+def render(fmt, args):
+    """Format a record like the device's printf would have."""
+
+    args = list(args)
+
+    def convert(m):
+        flags, width, precision, conv = m.groups()
+        if conv == '%':
+            return '%'
+        if not args:
+            return '<missing>'
+
+        value = args.pop(0)
+        spec = '%' + flags + width + (f'.{precision}' if precision else '')
+
+        if conv in 'di':
+            return (spec + 'd') % (value - (1 << 32) if value & 0x80000000 else value)
+        if conv == 'c':
+            return (spec + 'c') % chr(value & 0xFF)
+        if conv == 'p':
+            return (spec + 'x') % value
+        if conv == 'u':
+            return (spec + 'd') % value
+        return (spec + conv) % value
+
+    return _SPEC.sub(convert, fmt)
+
+
+class LogDecoder:
+    """Binary log decoder"""
+
+    def __init__(self):
+        self._cli()
+
+
+    def _cli(self):
+        """Application CLI"""
+
+        parser = argparse.ArgumentParser(description=self.__doc__)
+
+        parser.add_argument('elf', help='ELF file of the running application.')
+        parser.add_argument('source', help='Serial port, pty or capture file.')
+        parser.add_argument('-b', '--baud', type=int, default=115200, help='Baud rate of a serial port (default 115200).')
+        parser.add_argument('--objcopy', default='arm-none-eabi-objcopy', help='objcopy to extract the format strings with.')
+
+        args = parser.parse_args()
+
+        self._elf     = args.elf
+        self._source  = args.source
+        self._baud    = args.baud
+        self._objcopy = args.objcopy
+
+
+    def _open(self):
+        """Byte reader for the source. Returns b'' at the end of a capture
+        file and None when a port has nothing yet."""
+
+        if os.path.isfile(self._source):
+            f = open(self._source, 'rb')
+            return lambda: f.read(4096)
+
+        import serial
+        port = serial.Serial(self._source, self._baud, timeout=0.5)
+
+        def read():
+            data = port.read(port.in_waiting or 1)
+            return data if data else None
+
+        return read
+
+
+    def _print(self, frame):
+        record = packet.cobs_decode(frame)
+        values = read_varints(record) if record is not None else None
+
+        if not values:
+            print(f'<bad record {frame.hex()}>')
+        elif values[0] not in self._formats:
+            print(f'<unknown id {values[0]:#x}: {values[1:]}>')
+        else:
+            print(render(self._formats[values[0]], values[1:]))
+
+
+    def Main(self):
+        self._formats = load_formats(self._elf, self._objcopy)
+        read = self._open()
+        frame = bytearray()
+
+        try:
+            while True:
+                data = read()
+                if data is None:
+                    continue
+                if not data:
+                    break
+
+                for b in data:
+                    if b != 0:
+                        frame.append(b)
+                    elif frame:
+                        self._print(bytes(frame))
+                        frame.clear()
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    app = LogDecoder()
+    app.Main()
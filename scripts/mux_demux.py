@@ -0,0 +1,147 @@
+#!/usr/bin/env python
+
+""" Serial channel demultiplexer
+
+Host side of the firmware's channel multiplexer (common/src/mux). Every frame
+on the serial port carries a channel ID as its first payload byte. This script
+opens one pty per channel and moves bytes between the ptys and the serial
+port, so each channel can be used with its own terminal program:
+
+    python scripts/mux_demux.py /dev/ttyUSB0
+    picocom /dev/pts/5      # console, as printed at startup
+
+Needs pyserial and a POSIX system (ptys).
+"""
+
+import argparse
+import os
+import select
+import sys
+import time
+import tty
+
+import serial
+
+import packet
+
+# Channel IDs and names, in the order of MuxChannel_t in mux.h
+CHANNELS = ['console', 'log', 'data']
+
+# Channel bytes per frame (MUX_FRAME_MAX in mux_config.h)
+FRAME_MAX = 64
+
+
+class Channel:
+    """One virtual channel exposed as a pty."""
+
+    def __init__(self, chan_id, name, link_dir):
+        self.id      = chan_id
+        self.name    = name
+        self.link    = None
+        self.rx      = 0 # bytes from the board
+        self.tx      = 0 # bytes to the board
+
+        self.master, slave = os.openpty()
+        tty.setraw(slave)
+        self.pty = os.ttyname(slave)
+
+        # Keep the slave open, so the master does not see EOF when the
+        # terminal program on the other end restarts.
+        self._slave = slave
+
+        if link_dir:
+            self.link = os.path.join(link_dir, name)
+            if os.path.lexists(self.link):
+                os.remove(self.link)
+            os.symlink(self.pty, self.link)
+
+
+    def close(self):
+        if self.link:
+            os.remove(self.link)
+        os.close(self.master)
+        os.close(self._slave)
+
+
+class Demux:
+    """Serial channel demultiplexer"""
+
+    def __init__(self):
+        self._cli()
+
+
+    def _cli(self):
+        """Application CLI"""
+
+        parser = argparse.ArgumentParser(description=self.__doc__)
+
+        parser.add_argument('port', help='Serial port of the board.')
+        parser.add_argument('-b', '--baud', type=int, default=115200, help='Baud rate (default 115200).')
+        parser.add_argument('-l', '--link-dir', help='Directory for named links to the ptys (e.g. /tmp/kata).')
+        parser.add_argument('-s', '--stats', type=float, default=0, metavar='SEC',
+                            help='Print per channel byte rates every SEC seconds.')
+
+        args = parser.parse_args()
+
+        self._port     = args.port
+        self._baud     = args.baud
+        self._link_dir = args.link_dir
+        self._stats    = args.stats
+
+
+    def _print_stats(self, elapsed):
+        rates = ', '.join(f'{c.name} rx {c.rx / elapsed:.0f} B/s tx {c.tx / elapsed:.0f} B/s'
+                          for c in self._channels)
+        print(f'{rates}, bad frames {self._decoder.bad_frames}')
+
+        for c in self._channels:
+            c.rx = 0
+            c.tx = 0
+
+
+    def Main(self):
+        if self._link_dir:
+            os.makedirs(self._link_dir, exist_ok=True)
+
+        self._decoder  = packet.Decoder()
+        self._channels = [Channel(i, name, self._link_dir) for i, name in enumerate(CHANNELS)]
+        by_fd          = {c.master: c for c in self._channels}
+
+        for c in self._channels:
+            print(f'{c.name:8} {c.link or c.pty}')
+
+        port = serial.Serial(self._port, self._baud, timeout=0)
+        last = time.monotonic()
+
+        try:
+            while True:
+                ready, _, _ = select.select([port.fileno()] + list(by_fd), [], [], 0.5)
+
+                for fd in ready:
+                    if fd == port.fileno():
+                        for payload in self._decoder.feed(port.read(port.in_waiting or 1)):
+                            if payload and payload[0] < len(self._channels):
+                                c = self._channels[payload[0]]
+                                os.write(c.master, payload[1:])
+                                c.rx += len(payload) - 1
+                    else:
+                        c = by_fd[fd]
+                        data = os.read(fd, FRAME_MAX)
+                        port.write(packet.encode(bytes([c.id]) + data))
+                        c.tx += len(data)
+
+                now = time.monotonic()
+                if self._stats and now - last >= self._stats:
+                    self._print_stats(now - last)
+                    last = now
+        except KeyboardInterrupt:
+            pass
+        finally:
+            port.close()
+            for c in self._channels:
+                c.close()
+
+
+if __name__ == "__main__":
+    app = Demux()
+    app.Main()
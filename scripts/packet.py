@@ -0,0 +1,130 @@
+""" Packet framing shared with the firmware (common/src/packet)
+
+A frame on the wire is the payload followed by its CRC-32 (little endian),
+COBS encoded and ended by a 0x00 byte. The CRC is the one the STM32 CRC unit
+computes: polynomial 0x04C11DB7, most significant bit first, initial value
+0xFFFFFFFF, no reflection and no final XOR, over the payload packed into
+little endian 32 bit words with the last word padded with zero bytes.
+"""
+
+_POLY = 0x04C11DB7
+
+def _make_table():
+    table = []
+    for i in range(256):
+        crc = i << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ _POLY) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+        table.append(crc)
+    return table
+
+_TABLE = _make_table()
+
+CRC_LEN = 4
+
+
+def crc32(data):
+    """CRC-32 of data in the STM32 CRC unit's format."""
+
+    data = bytes(data) + bytes(-len(data) % 4)
+    crc = 0xFFFFFFFF
+
+    for i in range(0, len(data), 4):
+        # The word's top byte (the last of its 4 bytes) goes in first
+        for b in reversed(data[i:i + 4]):
+            crc = ((crc << 8) & 0xFFFFFFFF) ^ _TABLE[(crc >> 24) ^ b]
+
+    return crc
+
+
+def cobs_encode(data):
+    """COBS encode data. The 0x00 delimiter is not added."""
+
+    out = bytearray()
+    block = bytearray()
+
+    for b in data:
+        if b == 0:
+            out.append(len(block) + 1)
+            out += block
+            block.clear()
+        else:
+            block.append(b)
+            if len(block) == 254:
+                out.append(0xFF)
+                out += block
+                block.clear()
+
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """COBS decode one frame (without its delimiter). None if it is broken."""
+
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+
+        out += data[i + 1:i + code]
+        i += code
+
+        if code != 0xFF and i < len(data):
+            out.append(0)
+
+    return bytes(out)
+
+
+def encode(payload):
+    """Frame payload for the wire, delimiter included."""
+
+    payload = bytes(payload)
+    return cobs_encode(payload + crc32(payload).to_bytes(CRC_LEN, 'little')) + b'\x00'
+
+
+class Decoder:
+    """Splits a received byte stream into checked payloads."""
+
+    def __init__(self):
+        self._frame = bytearray()
+        self.bad_frames = 0
+
+
+    def feed(self, data):
+        """Add received bytes. Returns the payloads of the frames they ended."""
+
+        payloads = []
+
+        for b in data:
+            if b != 0:
+                self._frame.append(b)
+                continue
+
+            # Back to back delimiters are idle line, not empty frames
+            if self._frame:
+                payload = self._check(cobs_decode(bytes(self._frame)))
+                if payload is None:
+                    self.bad_frames += 1
+                else:
+                    payloads.append(payload)
+                self._frame.clear()
+
+        return payloads
+
+
+    @staticmethod
+    def _check(frame):
+        if frame is None or len(frame) < CRC_LEN:
+            return None
+
+        payload = frame[:-CRC_LEN]
+        if crc32(payload) != int.from_bytes(frame[-CRC_LEN:], 'little'):
+            return None
+
+        return payload
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+
+""" UART receive throughput test
+
+Streams pseudo random data to the echo of 06_uart_echo as fast as the serial
+port takes it, reads the echo back at the same time and checks that every
+byte comes back in order. Build the echo for the rate under test (the highest
+one the 72 MHz USART1 clock supports is 4.5 Mbaud) and use an adapter that
+can do that rate:
+
+    make KATA=6 ECHO_BAUD=4500000 clean flash
+    python scripts/uart_throughput.py --port /dev/ttyUSB0 --baud 4500000
+
+The echo runs at the line rate in both directions, so a byte the board failed
+to take in shows up here as a missing byte. The test passes when all of the
+data comes back unchanged. On a failure, the board's serial_errors (watch it
+with make KATA=6 gdb) tells whether the bytes were lost to a USART overrun or
+to a full receive buffer (dropped).
+
+Exits with 1 when data was lost or changed.
+"""
+
+import argparse
+import random
+import sys
+import threading
+import time
+
+# Bytes handed to the serial driver at a time
+BLOCK = 4096
+
+# Seconds without echo data, after everything was sent, before giving up
+DRAIN_TIMEOUT = 1.0
+
+
+class Throughput:
+    """UART receive throughput test"""
+
+    def __init__(self):
+        self._cli()
+
+
+    def _cli(self):
+        """Application CLI"""
+
+        parser = argparse.ArgumentParser(description=self.__doc__)
+
+        parser.add_argument('-p', '--port', required=True, help='Serial port of the board.')
+        parser.add_argument('-b', '--baud', type=int, default=4500000, help='Baud rate (default 4500000, ECHO_BAUD).')
+        parser.add_argument('-n', '--bytes', type=int, default=4 * 1024 * 1024, help='Bytes to send (default 4 MiB).')
+        parser.add_argument('-s', '--seed', type=int, default=1, help='Seed of the test data (default 1).')
+
+        args = parser.parse_args()
+
+        self._port_name = args.port
+        self._baud      = args.baud
+        self._len       = args.bytes
+        self._seed      = args.seed
+
+
+    def _send(self, data):
+        for i in range(0, len(data), BLOCK):
+            self._port.write(data[i:i + BLOCK])
+        self._port.flush()
+
+
+    def Main(self):
+        import serial
+
+        data = random.Random(self._seed).randbytes(self._len)
+        echo = bytearray()
+
+        self._port = serial.Serial(self._port_name, self._baud, timeout=0.1)
+        self._port.reset_input_buffer()
+
+        sender = threading.Thread(target=self._send, args=(data,))
+        begin  = time.monotonic()
+        last   = begin
+        sender.start()
+
+        while len(echo) < len(data):
+            chunk = self._port.read(self._port.in_waiting or 1)
+            now   = time.monotonic()
+
+            if chunk:
+                echo += chunk
+                last  = now
+            elif not sender.is_alive() and now - last > DRAIN_TIMEOUT:
+                break
+
+        elapsed = last - begin
+        sender.join()
+        self._port.close()
+
+        first_bad = next((i for i, (a, b) in enumerate(zip(data, echo)) if a != b), None)
+        lost      = len(data) - len(echo)
+
+        print(f'sent {len(data)} bytes, received {len(echo)} in {elapsed:.2f} s '
+              f'({len(echo) * 10 / elapsed / 1e6:.2f} Mbaud of {self._baud / 1e6:.2f})')
+
+        if lost > 0 or first_bad is not None:
+            where = f', first difference at byte {first_bad}' if first_bad is not None else ''
+            sys.exit(f'FAILED: {lost} bytes missing{where} (check serial_errors on the board)')
+
+        print('passed: no bytes lost or changed')
+
+
+if __name__ == "__main__":
+    app = Throughput()
+    app.Main()
@@ -0,0 +1,200 @@
+#!/usr/bin/env python
+
+""" UART bootloader uploader
+
+Uploads an application image to the UART bootloader (09_bootloader) over its
+serial port and starts it. Build the application with BOOTLOADED=1, so it is
+linked to run after the bootloader, and upload the raw binary:
+
+    python scripts/uploader.py --port /dev/ttyUSB0 bin/08_morse_encoder/08_morse_encoder_app.bin
+
+The bootloader only waits for a host for a moment after a reset, so start the
+uploader first and then reset the board. The message format and the flow
+control are described in 09_bootloader/src/boot.h.
+
+The effective rate printed at the end is image bytes over the time from the
+first data message to the bootloader confirming the image is written, so it
+includes erasing and programming the flash.
+"""
+
+import argparse
+import os
+import sys
+import time
+
+import packet
+
+# Commands and statuses (09_bootloader/src/boot.h)
+CMD_START  = 0x01
+CMD_DATA   = 0x02
+CMD_FINISH = 0x03
+CMD_RUN    = 0x04
+
+STATUS_OK       = 0
+STATUS_SEQUENCE = 1
+STATUS_BUSY     = 8
+STATUS_NAMES    = ['ok', 'out of sequence', 'bad size', 'bad crc', 'flash failed',
+                   'wrong state', 'bad command', 'no application', 'busy']
+
+DATA_MAX = 256      # BOOT_DATA_MAX
+WINDOW   = 1024     # BOOT_WINDOW
+
+# Seconds without progress before the unacknowledged data is sent again
+RESEND_TIMEOUT = 1.0
+
+# Seconds between START attempts while waiting for the bootloader
+START_INTERVAL = 0.1
+
+
+def status_name(status):
+    return STATUS_NAMES[status] if status < len(STATUS_NAMES) else f'status {status}'
+
+
+class Uploader:
+    """UART bootloader uploader"""
+
+    def __init__(self):
+        self._cli()
+
+        # Make sure the input file exists
+        if not os.path.exists(self._image):
+            sys.exit(f'Cannot find image: {self._image}')
+
+
+    def _cli(self):
+        """Application CLI"""
+
+        parser = argparse.ArgumentParser(description=self.__doc__)
+
+        parser.add_argument('-p', '--port', required=True, help='Serial port of the board.')
+        parser.add_argument('-b', '--baud', type=int, default=460800, help='Baud rate (default 460800, BOOT_BAUD).')
+        parser.add_argument('-w', '--wait', type=float, default=30.0, help='Seconds to wait for the bootloader (default 30).')
+        parser.add_argument('--no-run', action='store_true', help='Leave the bootloader running after the upload.')
+        parser.add_argument('image', help='Raw binary image (.bin) linked for the bootloader.')
+
+        args = parser.parse_args()
+
+        self._port_name = args.port
+        self._baud      = args.baud
+        self._wait      = args.wait
+        self._run       = not args.no_run
+        self._image     = args.image
+
+
+    def _send(self, payload):
+        self._port.write(packet.encode(payload))
+
+
+    def _responses(self, timeout):
+        """Responses (command, status, offset) received within timeout."""
+
+        deadline = time.monotonic() + timeout
+        responses = []
+
+        while not responses and time.monotonic() < deadline:
+            data = self._port.read(self._port.in_waiting or 1)
+            for payload in self._decoder.feed(data):
+                if len(payload) == 6:
+                    responses.append((payload[0], payload[1], int.from_bytes(payload[2:6], 'little')))
+
+        return responses
+
+
+    def _command(self, payload, timeout, retries):
+        """Send a command until it gets a response. Returns (status, offset)."""
+
+        for _ in range(retries):
+            self._send(payload)
+            for cmd, status, offset in self._responses(timeout):
+                if cmd == payload[0]:
+                    return status, offset
+
+        sys.exit(f'No response to command {payload[0]:#x}')
+
+
+    def _start(self, image):
+        """Wait for the bootloader and start the upload."""
+
+        start = bytes([CMD_START]) + len(image).to_bytes(4, 'little') + packet.crc32(image).to_bytes(4, 'little')
+        deadline = time.monotonic() + self._wait
+
+        print(f'Waiting for the bootloader on {self._port_name} (reset the board)...')
+        while time.monotonic() < deadline:
+            self._send(start)
+            for cmd, status, _ in self._responses(START_INTERVAL):
+                if cmd != CMD_START or status == STATUS_BUSY:
+                    continue
+                if status != STATUS_OK:
+                    sys.exit(f'Upload refused: {status_name(status)}')
+                return
+
+        sys.exit('No bootloader found')
+
+
+    def _upload(self, image):
+        """Send the image, keeping up to WINDOW bytes in flight."""
+
+        acked = 0
+        sent = 0
+        progress = time.monotonic()
+
+        while acked < len(image):
+            while sent < len(image) and sent - acked < WINDOW:
+                chunk = image[sent:sent + DATA_MAX]
+                self._send(bytes([CMD_DATA]) + sent.to_bytes(4, 'little') + chunk)
+                sent += len(chunk)
+
+            for cmd, status, offset in self._responses(0.05):
+                if cmd != CMD_DATA:
+                    continue
+                if status == STATUS_OK:
+                    if offset > acked:
+                        acked = offset
+                        progress = time.monotonic()
+                elif status == STATUS_SEQUENCE:
+                    # A message was lost. Carry on from where the bootloader is.
+                    acked = max(acked, offset)
+                    sent = offset
+                else:
+                    sys.exit(f'\nUpload failed at {offset}: {status_name(status)}')
+
+            if time.monotonic() - progress > RESEND_TIMEOUT:
+                sent = acked
+                progress = time.monotonic()
+
+            print(f'\r{acked}/{len(image)} bytes', end='', flush=True)
+
+        print()
+
+
+    def Main(self):
+        import serial
+
+        with open(self._image, 'rb') as f:
+            image = f.read()
+
+        self._port = serial.Serial(self._port_name, self._baud, timeout=0.05)
+        self._decoder = packet.Decoder()
+
+        self._start(image)
+
+        begin = time.monotonic()
+        self._upload(image)
+
+        status, _ = self._command(bytes([CMD_FINISH]), 1.0, 5)
+        if status != STATUS_OK:
+            sys.exit(f'Upload failed: {status_name(status)}')
+        elapsed = time.monotonic() - begin
+
+        print(f'Wrote {len(image)} bytes in {elapsed:.2f} s ({len(image) / elapsed / 1024:.1f} KB/s)')
+
+        if self._run:
+            status, _ = self._command(bytes([CMD_RUN]), 1.0, 5)
+            if status != STATUS_OK:
+                sys.exit(f'Cannot start the application: {status_name(status)}')
+            print('Application started')
+
+
+if __name__ == "__main__":
+    app = Uploader()
+    app.Main()
@@ -0,0 +1,531 @@
+/**
+ * @brief Bootloader test
+ *
+ * Runs flash_stream and the bootloader protocol (boot.c) against a simulated
+ * flash controller and serial link (see sim_bsp.c). The host side of the
+ * protocol is written out here as scripts/uploader.py does it:
+ *
+ *  - an image streamed through flash_stream lands in flash unchanged, padded
+ *    with 0xFF, with its first page written last and only on commit
+ *  - flash_stream refuses what it cannot do and gives up on a failed page
+ *  - a windowed upload over the protocol completes, the image checks out and
+ *    RUN restarts into it
+ *  - malformed, out of order and repeated messages get the documented
+ *    responses, and an image with the wrong CRC is never made startable
+ *  - a flash failure during an upload is reported
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "boot.h"
+#include "check.h"
+#include "flash_stream.h"
+#include "sim_bsp.h"
+#include "bsp/bsp.h"
+#include "packet/cobs.h"
+#include "packet/crc32.h"
+#include "packet/packet.h"
+#include "types.h"
+
+#define PAGE            (BSP_FLASH_PAGE_SIZE)
+#define APP_ADDR        SIM_FLASH_ADDR(SIM_APP_OFFSET)
+#define IMAGE_LEN       ((3u * PAGE) + 500u)
+#define MAX_CALLS       (100000u)   /* task calls before a test gives up */
+#define MAX_RESPONSES   (64u)
+
+typedef struct response
+{
+    u8_t  cmd;
+    u8_t  status;
+    u32_t offset;
+} Response_t;
+
+static void test_stream(void);
+static void test_stream_errors(void);
+static void test_upload(void);
+static void test_protocol_errors(void);
+static void test_flash_failure(void);
+static void make_image(u32_t seed);
+static size_t stream_write(const u8_t * const p_bytes, size_t len);
+static bool_t stream_idle(void);
+static void host_send(const u8_t * const p_bytes, size_t len);
+static void to_boot_append(const u8_t * const p_bytes, size_t len);
+static void host_start(u32_t size, u32_t crc);
+static void host_data(u32_t offset, size_t len);
+static void host_cmd(u8_t cmd);
+static size_t host_receive(Response_t * const p_resps, size_t max);
+static Response_t exchange(void);
+static u32_t image_crc32(void);
+static void boot_reset(void);
+static void run(u32_t calls);
+static void put_le32(u8_t * const p_dst, u32_t value);
+
+static u8_t   image[IMAGE_LEN];
+static size_t from_boot_pos;    /* responses read so far */
+
+int main(void)
+{
+    test_stream();
+    test_stream_errors();
+    test_upload();
+    test_protocol_errors();
+    test_flash_failure();
+
+    return check_status();
+}
+
+static void test_stream(void)
+{
+    size_t written = 0;
+    size_t n;
+    u32_t  calls;
+
+    sim_reset();
+    make_image(1u);
+
+    CHECK_EQ(E_TRUE, flash_stream_start(APP_ADDR, IMAGE_LEN));
+
+    /* Random pieces, as much as the stream takes, with the task in between */
+    for (calls = 0; (calls < MAX_CALLS) && (written < IMAGE_LEN); calls += 1) {
+        n = 1u + ((size_t)rand() % 300u);
+        if (n > (IMAGE_LEN - written)) {
+            n = IMAGE_LEN - written;
+        }
+        if (n > flash_stream_space()) {
+            n = flash_stream_space();
+        }
+
+        CHECK_EQ(n, flash_stream_write(&image[written], n));
+        written += n;
+        flash_stream_task();
+    }
+
+    CHECK_EQ(E_TRUE, flash_stream_flush());
+    CHECK_EQ(0u, flash_stream_space());
+    CHECK_EQ(E_TRUE, stream_idle());
+
+    /* Everything but the first page is in. The first page is erased. */
+    CHECK(0 == memcmp(&sim_flash[SIM_APP_OFFSET + PAGE], &image[PAGE], IMAGE_LEN - PAGE));
+    CHECK_EQ(0xFFu, sim_flash[SIM_APP_OFFSET]);
+    CHECK_EQ(0xFFu, sim_flash[SIM_APP_OFFSET + PAGE - 1u]);
+
+    CHECK_EQ(E_TRUE, flash_stream_commit());
+    CHECK_EQ(E_TRUE, stream_idle());
+
+    CHECK(0 == memcmp(&sim_flash[SIM_APP_OFFSET], image, IMAGE_LEN));
+    for (n = IMAGE_LEN; n < (4u * PAGE); n += 1) {
+        CHECK_EQ(0xFFu, sim_flash[SIM_APP_OFFSET + n]);
+    }
+
+    CHECK_EQ(4u, sim_flash_stats.erases);
+    CHECK_EQ(SIM_APP_OFFSET, sim_flash_stats.last_page_offset);
+    CHECK_EQ(0u, sim_flash_stats.locked_ops);
+    CHECK_EQ(E_TRUE, sim_flash_locked);
+}
+
+static void test_stream_errors(void)
+{
+    sim_reset();
+    make_image(2u);
+
+    CHECK_EQ(E_FALSE, flash_stream_start(APP_ADDR + 2u, IMAGE_LEN));
+    CHECK_EQ(E_FALSE, flash_stream_start(APP_ADDR, 0u));
+
+    /* Only one image at a time */
+    CHECK_EQ(E_TRUE, flash_stream_start(APP_ADDR, 10u));
+    CHECK_EQ(E_FALSE, flash_stream_start(APP_ADDR, 10u));
+
+    /* Nothing past the image size, and no flush or commit before its end */
+    CHECK_EQ(E_FALSE, flash_stream_commit());
+    CHECK_EQ(4u, flash_stream_write(image, 4u));
+    CHECK_EQ(E_FALSE, flash_stream_flush());
+    CHECK_EQ(6u, flash_stream_space());
+    CHECK_EQ(6u, flash_stream_write(&image[4], 20u));
+    CHECK_EQ(E_TRUE, flash_stream_flush());
+    CHECK_EQ(0u, flash_stream_write(image, 1u));
+    CHECK_EQ(E_TRUE, flash_stream_commit());
+    CHECK_EQ(E_TRUE, stream_idle());
+    CHECK(0 == memcmp(&sim_flash[SIM_APP_OFFSET], image, 10u));
+
+    /* A page that fails to erase ends the image */
+    sim_reset();
+    sim_flash_fail_offset = SIM_APP_OFFSET + PAGE;
+
+    CHECK_EQ(E_TRUE, flash_stream_start(APP_ADDR, IMAGE_LEN));
+    CHECK_EQ(2u * PAGE, flash_stream_write(image, 2u * PAGE));
+    CHECK_EQ(E_FALSE, stream_idle());
+    CHECK_EQ(FLASH_STREAM_ERROR, flash_stream_state());
+    CHECK_EQ(0u, flash_stream_space());
+    CHECK_EQ(0u, flash_stream_write(image, 1u));
+    CHECK_EQ(E_FALSE, flash_stream_flush());
+    CHECK_EQ(E_FALSE, flash_stream_commit());
+    CHECK_EQ(E_TRUE, sim_flash_locked);
+
+    /* The next image starts over */
+    sim_flash_fail_offset = SIM_FLASH_SIZE;
+    CHECK_EQ(E_TRUE, flash_stream_start(APP_ADDR, IMAGE_LEN));
+    CHECK_EQ(FLASH_STREAM_BUSY, flash_stream_state());
+    CHECK_EQ(IMAGE_LEN, stream_write(image, IMAGE_LEN));
+    CHECK_EQ(E_TRUE, flash_stream_flush());
+    CHECK_EQ(E_TRUE, flash_stream_commit());
+    CHECK_EQ(E_TRUE, stream_idle());
+    CHECK(0 == memcmp(&sim_flash[SIM_APP_OFFSET], image, IMAGE_LEN));
+}
+
+static void test_upload(void)
+{
+    Response_t resps[MAX_RESPONSES];
+    Response_t resp;
+    u32_t      sent  = 0;
+    u32_t      acked = 0;
+    size_t     num;
+    size_t     n;
+    size_t     i;
+    u32_t      calls;
+
+    boot_reset();
+    make_image(3u);
+
+    CHECK_EQ(E_FALSE, boot_app_is_valid());
+    CHECK_EQ(E_FALSE, boot_host_seen());
+
+    host_start(IMAGE_LEN, image_crc32());
+    resp = exchange();
+    CHECK_EQ(BOOT_CMD_START, resp.cmd);
+    CHECK_EQ(BOOT_STATUS_OK, resp.status);
+    CHECK_EQ(E_TRUE, boot_host_seen());
+
+    /* Up to BOOT_WINDOW bytes in flight past the last acknowledged offset */
+    for (calls = 0; (calls < MAX_CALLS) && (acked < IMAGE_LEN); calls += 1) {
+        while ((sent < IMAGE_LEN) && ((sent - acked) < BOOT_WINDOW)) {
+            n = ((IMAGE_LEN - sent) < BOOT_DATA_MAX) ? (IMAGE_LEN - sent) : BOOT_DATA_MAX;
+            host_data(sent, n);
+            sent += (u32_t)n;
+        }
+
+        boot_task();
+
+        num = host_receive(resps, MAX_RESPONSES);
+        for (i = 0; i < num; i += 1) {
+            CHECK_EQ(BOOT_CMD_DATA, resps[i].cmd);
+            CHECK_EQ(BOOT_STATUS_OK, resps[i].status);
+            acked = resps[i].offset;
+        }
+    }
+
+    CHECK_EQ(IMAGE_LEN, acked);
+
+    host_cmd(BOOT_CMD_FINISH);
+    resp = exchange();
+    CHECK_EQ(BOOT_CMD_FINISH, resp.cmd);
+    CHECK_EQ(BOOT_STATUS_OK, resp.status);
+    CHECK_EQ(IMAGE_LEN, resp.offset);
+
+    CHECK(0 == memcmp(&sim_flash[SIM_APP_OFFSET], image, IMAGE_LEN));
+    CHECK_EQ(SIM_APP_OFFSET, sim_flash_stats.last_page_offset);
+    CHECK_EQ(E_TRUE, sim_flash_locked);
+    CHECK_EQ(E_TRUE, boot_app_is_valid());
+
+    /* A repeated FINISH gets the same answer */
+    host_cmd(BOOT_CMD_FINISH);
+    CHECK_EQ(BOOT_STATUS_OK, exchange().status);
+
+    CHECK_EQ(0u, sim_resets);
+    host_cmd(BOOT_CMD_RUN);
+    resp = exchange();
+    CHECK_EQ(BOOT_CMD_RUN, resp.cmd);
+    CHECK_EQ(BOOT_STATUS_OK, resp.status);
+    CHECK_EQ(1u, sim_resets);
+}
+
+static void test_protocol_errors(void)
+{
+    static const u8_t UNKNOWN[] = { 0x7Fu };
+    static const u8_t SHORT_START[] = { BOOT_CMD_START, 0x10u, 0x00u };
+    Response_t resps[MAX_RESPONSES];
+    Response_t resp;
+    size_t     num;
+
+    boot_reset();
+    make_image(4u);
+
+    host_send(UNKNOWN, sizeof(UNKNOWN));
+    CHECK_EQ(BOOT_STATUS_COMMAND, exchange().status);
+    host_send(SHORT_START, sizeof(SHORT_START));
+    CHECK_EQ(BOOT_STATUS_COMMAND, exchange().status);
+
+    host_data(0u, 16u);
+    CHECK_EQ(BOOT_STATUS_STATE, exchange().status);
+    host_cmd(BOOT_CMD_FINISH);
+    CHECK_EQ(BOOT_STATUS_STATE, exchange().status);
+    host_cmd(BOOT_CMD_RUN);
+    CHECK_EQ(BOOT_STATUS_NO_APP, exchange().status);
+
+    host_start((u32_t)SIM_FLASH_SIZE, 0u);
+    CHECK_EQ(BOOT_STATUS_SIZE, exchange().status);
+    host_start(0u, 0u);
+    CHECK_EQ(BOOT_STATUS_SIZE, exchange().status);
+
+    /* The CRC is off by one, so the image must never become startable */
+    host_start(IMAGE_LEN, image_crc32() ^ 1u);
+    CHECK_EQ(BOOT_STATUS_OK, exchange().status);
+
+    /* A gap is reported once, then dropped until the host goes back */
+    host_data(BOOT_DATA_MAX, BOOT_DATA_MAX);
+    host_data(2u * BOOT_DATA_MAX, BOOT_DATA_MAX);
+    run(100u);
+    num = host_receive(resps, MAX_RESPONSES);
+    CHECK_EQ(1u, num);
+    CHECK_EQ(BOOT_STATUS_SEQUENCE, resps[0].status);
+    CHECK_EQ(0u, resps[0].offset);
+
+    host_data(0u, BOOT_DATA_MAX);
+    resp = exchange();
+    CHECK_EQ(BOOT_STATUS_OK, resp.status);
+    CHECK_EQ(BOOT_DATA_MAX, resp.offset);
+
+    /* Repeated data is acknowledged and not taken twice */
+    host_data(0u, BOOT_DATA_MAX);
+    resp = exchange();
+    CHECK_EQ(BOOT_STATUS_OK, resp.status);
+    CHECK_EQ(BOOT_DATA_MAX, resp.offset);
+
+    /* FINISH before the whole image */
+    host_cmd(BOOT_CMD_FINISH);
+    CHECK_EQ(BOOT_STATUS_SIZE, exchange().status);
+
+    host_data(BOOT_DATA_MAX, IMAGE_LEN - BOOT_DATA_MAX);
+    CHECK_EQ(BOOT_STATUS_COMMAND, exchange().status);   /* too long for one message */
+
+    for (resp.offset = BOOT_DATA_MAX; resp.offset < IMAGE_LEN; ) {
+        host_data(resp.offset, ((IMAGE_LEN - resp.offset) < BOOT_DATA_MAX) ? (IMAGE_LEN - resp.offset) : BOOT_DATA_MAX);
+        resp = exchange();
+        CHECK_EQ(BOOT_STATUS_OK, resp.status);
+    }
+
+    host_cmd(BOOT_CMD_FINISH);
+    CHECK_EQ(BOOT_STATUS_CRC, exchange().status);
+    CHECK_EQ(E_TRUE, stream_idle());
+
+    /* The first page was never written */
+    CHECK_EQ(0xFFu, sim_flash[SIM_APP_OFFSET]);
+    CHECK(0 == memcmp(&sim_flash[SIM_APP_OFFSET + PAGE], &image[PAGE], IMAGE_LEN - PAGE));
+    CHECK_EQ(E_FALSE, boot_app_is_valid());
+
+    host_cmd(BOOT_CMD_RUN);
+    CHECK_EQ(BOOT_STATUS_NO_APP, exchange().status);
+    CHECK_EQ(0u, sim_resets);
+}
+
+static void test_flash_failure(void)
+{
+    Response_t resp;
+    u32_t      offset = 0;
+    size_t     n;
+
+    boot_reset();
+    make_image(5u);
+    sim_flash_fail_offset = SIM_APP_OFFSET + (2u * PAGE);
+
+    host_start(IMAGE_LEN, image_crc32());
+    CHECK_EQ(BOOT_STATUS_OK, exchange().status);
+
+    resp.status = BOOT_STATUS_OK;
+    while ((offset < IMAGE_LEN) && (BOOT_STATUS_OK == resp.status)) {
+        n = ((IMAGE_LEN - offset) < BOOT_DATA_MAX) ? (IMAGE_LEN - offset) : BOOT_DATA_MAX;
+        host_data(offset, n);
+        resp = exchange();
+        offset += (u32_t)n;
+    }
+
+    /* Either a DATA message or FINISH finds out */
+    if (BOOT_STATUS_OK == resp.status) {
+        host_cmd(BOOT_CMD_FINISH);
+        resp = exchange();
+    }
+
+    CHECK_EQ(BOOT_STATUS_FLASH, resp.status);
+    CHECK_EQ(E_FALSE, boot_app_is_valid());
+    CHECK_EQ(E_TRUE, sim_flash_locked);
+}
+
+/* Random image with a startable vector table */
+static void make_image(u32_t seed)
+{
+    size_t i;
+
+    srand(seed);
+    for (i = 0; i < IMAGE_LEN; i += 1) {
+        image[i] = (0 == (rand() % 8)) ? 0xFFu : (u8_t)rand();
+    }
+
+    put_le32(&image[0], 0x20005000UL);              /* initial stack pointer */
+    put_le32(&image[4], APP_ADDR + 0x101u);         /* thumb reset handler   */
+}
+
+/* Write all of p_bytes, running flash_stream_task while the page buffers
+   are full */
+static size_t stream_write(const u8_t * const p_bytes, size_t len)
+{
+    size_t written = 0;
+    u32_t  calls;
+
+    for (calls = 0; (calls < MAX_CALLS) && (written < len); calls += 1) {
+        written += flash_stream_write(&p_bytes[written], len - written);
+        flash_stream_task();
+    }
+
+    return written;
+}
+
+/* Run flash_stream_task until the queued pages are written */
+static bool_t stream_idle(void)
+{
+    u32_t calls;
+
+    for (calls = 0; (calls < MAX_CALLS) && (FLASH_STREAM_BUSY == flash_stream_state()); calls += 1) {
+        flash_stream_task();
+    }
+
+    return (FLASH_STREAM_IDLE == flash_stream_state()) ? E_TRUE : E_FALSE;
+}
+
+/* Frame a message as scripts/packet.py encode() does: COBS of the payload
+   and its CRC, then the delimiter */
+static void host_send(const u8_t * const p_bytes, size_t len)
+{
+    CobsEncoder_t enc;
+    Crc32_t       crc;
+    u8_t          crc_bytes[PACKET_CRC_LEN];
+
+    crc32_init(&crc);
+    crc32_update(&crc, p_bytes, len);
+    put_le32(crc_bytes, crc32_final(&crc));
+
+    cobs_encoder_init(&enc, to_boot_append);
+    cobs_encoder_put(&enc, p_bytes, len);
+    cobs_encoder_put(&enc, crc_bytes, PACKET_CRC_LEN);
+    cobs_encoder_end(&enc);
+}
+
+static void to_boot_append(const u8_t * const p_bytes, size_t len)
+{
+    memcpy(&to_boot[to_boot_len], p_bytes, len);
+    to_boot_len += len;
+}
+
+static void host_start(u32_t size, u32_t crc)
+{
+    u8_t msg[9];
+
+    msg[0] = BOOT_CMD_START;
+    put_le32(&msg[1], size);
+    put_le32(&msg[5], crc);
+    host_send(msg, sizeof(msg));
+}
+
+static void host_data(u32_t offset, size_t len)
+{
+    u8_t msg[5u + IMAGE_LEN];
+
+    msg[0] = BOOT_CMD_DATA;
+    put_le32(&msg[1], offset);
+    memcpy(&msg[5], &image[offset], len);
+    host_send(msg, 5u + len);
+}
+
+static void host_cmd(u8_t cmd)
+{
+    host_send(&cmd, 1u);
+}
+
+/* Responses the bootloader sent since the last call */
+static size_t host_receive(Response_t * const p_resps, size_t max)
+{
+    CobsDecoder_t dec;
+    CobsDecode_t  result;
+    u8_t          payload[16];
+    size_t        len = 0;
+    size_t        num = 0;
+    Crc32_t       crc;
+
+    cobs_decoder_init(&dec);
+
+    while ((from_boot_pos < from_boot_len) && (num < max)) {
+        result = cobs_decoder_put(&dec, from_boot[from_boot_pos], &payload[len]);
+        from_boot_pos += 1u;
+
+        if ((COBS_DECODE_BYTE == result) && (len < sizeof(payload))) {
+            len += 1u;
+        } else if (COBS_DECODE_END == result) {
+            CHECK_EQ(6u + PACKET_CRC_LEN, len);
+
+            crc32_init(&crc);
+            crc32_update(&crc, payload, 6u);
+            CHECK_EQ(crc32_final(&crc), (u32_t)payload[6] | ((u32_t)payload[7] << 8)
+                | ((u32_t)payload[8] << 16) | ((u32_t)payload[9] << 24));
+
+            p_resps[num].cmd    = payload[0];
+            p_resps[num].status = payload[1];
+            p_resps[num].offset = (u32_t)payload[2] | ((u32_t)payload[3] << 8)
+                | ((u32_t)payload[4] << 16) | ((u32_t)payload[5] << 24);
+            num += 1u;
+            len  = 0;
+        } else {
+            CHECK(COBS_DECODE_ERROR != result);
+        }
+    }
+
+    return num;
+}
+
+/* Run the bootloader until it answers the message just sent */
+static Response_t exchange(void)
+{
+    Response_t resp = { 0u, 0xFFu, 0u };
+    u32_t      calls;
+    size_t     num = 0;
+
+    for (calls = 0; (calls < MAX_CALLS) && (0u == num); calls += 1) {
+        boot_task();
+        num = host_receive(&resp, 1u);
+    }
+
+    CHECK_EQ(1u, num);
+    CHECK_EQ(to_boot_len, to_boot_pos);
+    return resp;
+}
+
+static u32_t image_crc32(void)
+{
+    Crc32_t crc;
+
+    crc32_init(&crc);
+    crc32_update(&crc, image, IMAGE_LEN);
+    return crc32_final(&crc);
+}
+
+static void boot_reset(void)
+{
+    sim_reset();
+    from_boot_pos = 0;
+    packet_init();
+    boot_init();
+}
+
+static void run(u32_t calls)
+{
+    u32_t i;
+
+    for (i = 0; i < calls; i += 1) {
+        boot_task();
+    }
+}
+
+static void put_le32(u8_t * const p_dst, u32_t value)
+{
+    p_dst[0] = (u8_t)value;
+    p_dst[1] = (u8_t)(value >> 8);
+    p_dst[2] = (u8_t)(value >> 16);
+    p_dst[3] = (u8_t)(value >> 24);
+}
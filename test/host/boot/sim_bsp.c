@@ -0,0 +1,227 @@
+/**
+ * @brief BSP stand-in for the bootloader test
+ *
+ * The flash controller works like the FPEC as the BSP exposes it: erasing
+ * and programming need the flash unlocked, an erase runs for a few
+ * bsp_flash_status polls and blocks programming meanwhile, and programming a
+ * half-word that is not erased fails (PGERR). Erased half-words are skipped,
+ * as flash.c does.
+ *
+ * The serial port is a pair of byte buffers, one per direction. The
+ * bootloader reads a few bytes per call, like a driver with a short receive
+ * buffer.
+ */
+#include "sim_bsp.h"
+
+#include <string.h>
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+#define READ_MAX        (37u)   /* bytes handed out per serial read */
+#define ERASED_HALF     (0xFFFFu)
+
+u8_t sim_flash[SIM_FLASH_SIZE] __attribute__((aligned(BSP_FLASH_PAGE_SIZE)));
+
+SimFlashStats_t sim_flash_stats;
+bool_t          sim_flash_locked;
+u32_t           sim_flash_fail_offset;
+
+u8_t   to_boot[SIM_WIRE_SIZE];
+size_t to_boot_len;
+size_t to_boot_pos;
+u8_t   from_boot[SIM_WIRE_SIZE];
+size_t from_boot_len;
+
+u32_t  sim_resets;
+
+static u32_t erase_polls;   /* status polls left of the running erase */
+static bool_t erase_failed;
+
+static bool_t in_flash(u32_t addr, size_t len);
+
+void sim_reset(void)
+{
+    memset(sim_flash, 0xFF, sizeof(sim_flash));
+    memset(&sim_flash_stats, 0, sizeof(sim_flash_stats));
+
+    sim_flash_locked      = E_TRUE;
+    sim_flash_fail_offset = SIM_FLASH_SIZE;
+    erase_polls           = 0;
+    erase_failed          = E_FALSE;
+
+    to_boot_len   = 0;
+    to_boot_pos   = 0;
+    from_boot_len = 0;
+    sim_resets    = 0;
+}
+
+void bsp_flash_unlock(void)
+{
+    sim_flash_locked = E_FALSE;
+}
+
+void bsp_flash_lock(void)
+{
+    sim_flash_locked = E_TRUE;
+}
+
+BspFlashStatus_t bsp_flash_status(void)
+{
+    BspFlashStatus_t status = BSP_FLASH_OK;
+
+    if (0u != erase_polls) {
+        erase_polls -= 1u;
+        status = BSP_FLASH_BUSY;
+    } else if (E_FALSE != erase_failed) {
+        /* Reported once, like the cleared error flags */
+        erase_failed = E_FALSE;
+        status = BSP_FLASH_ERROR;
+    } else {
+        /* idle */
+    }
+
+    return status;
+}
+
+bool_t bsp_flash_erase_start(u32_t addr)
+{
+    bool_t result = E_FALSE;
+    u32_t  offset;
+
+    if (E_FALSE != sim_flash_locked) {
+        sim_flash_stats.locked_ops += 1u;
+    } else if ((0u == erase_polls) && (E_TRUE == in_flash(addr, 1u))) {
+        offset = (addr - SIM_FLASH_ADDR(0)) & ~(BSP_FLASH_PAGE_SIZE - 1u);
+
+        if (offset == sim_flash_fail_offset) {
+            erase_failed = E_TRUE;
+        } else {
+            memset(&sim_flash[offset], 0xFF, BSP_FLASH_PAGE_SIZE);
+            sim_flash_stats.erases += 1u;
+        }
+
+        erase_polls = SIM_ERASE_POLLS;
+        result      = E_TRUE;
+    } else {
+        /* busy or outside the flash */
+    }
+
+    return result;
+}
+
+BspFlashStatus_t bsp_flash_program(u32_t addr, const u16_t * const p_half, size_t n)
+{
+    BspFlashStatus_t status = BSP_FLASH_OK;
+    u8_t  *p_dst;
+    u16_t  half;
+    size_t i;
+
+    if (E_FALSE != sim_flash_locked) {
+        sim_flash_stats.locked_ops += 1u;
+        status = BSP_FLASH_ERROR;
+    } else if ((0u != (addr & 1u)) || (E_FALSE == in_flash(addr, n * 2u))) {
+        status = BSP_FLASH_ERROR;
+    } else if (0u != erase_polls) {
+        sim_flash_stats.busy_programs += 1u;
+        status = BSP_FLASH_BUSY;
+    } else {
+        p_dst = &sim_flash[addr - SIM_FLASH_ADDR(0)];
+
+        for (i = 0; (i < n) && (BSP_FLASH_OK == status); i += 1) {
+            memcpy(&half, &p_dst[2u * i], sizeof(half));
+
+            if (ERASED_HALF == p_half[i]) {
+                /* skipped */
+            } else if (ERASED_HALF != half) {
+                status = BSP_FLASH_ERROR;
+            } else {
+                memcpy(&p_dst[2u * i], &p_half[i], sizeof(half));
+                sim_flash_stats.halves += 1u;
+            }
+        }
+
+        sim_flash_stats.last_page_offset = (addr - SIM_FLASH_ADDR(0)) & ~(BSP_FLASH_PAGE_SIZE - 1u);
+    }
+
+    return status;
+}
+
+size_t bsp_serial_port_read_buf(BspSerialPort_t port, u8_t * const p_bytes, size_t len)
+{
+    size_t n = to_boot_len - to_boot_pos;
+
+    if (n > len) {
+        n = len;
+    }
+    if (n > READ_MAX) {
+        n = READ_MAX;
+    }
+
+    memcpy(p_bytes, &to_boot[to_boot_pos], n);
+    to_boot_pos += n;
+
+    return n;
+}
+
+size_t bsp_serial_port_write_buf(BspSerialPort_t port, const u8_t * const p_bytes, size_t len)
+{
+    size_t n = SIM_WIRE_SIZE - from_boot_len;
+
+    if (n > len) {
+        n = len;
+    }
+
+    memcpy(&from_boot[from_boot_len], p_bytes, n);
+    from_boot_len += n;
+
+    return n;
+}
+
+bool_t bsp_serial_set_events(u32_t mask, BspSerialEventCallback_t callback)
+{
+    return E_TRUE;
+}
+
+/* Everything written went out at once */
+u32_t bsp_serial_take_events(void)
+{
+    return BSP_SERIAL_EVENT_TX_DRAINED;
+}
+
+u32_t bsp_cycles_now(void)
+{
+    static u32_t cycles;
+
+    cycles += 1000000u;
+    return cycles;
+}
+
+void bsp_spin_delay(size_t iterations)
+{
+}
+
+void bsp_toggle_builtin_led(void)
+{
+}
+
+/* Returns, unlike on the target, so the test can look at the outcome */
+void bsp_reset(void)
+{
+    sim_resets += 1u;
+}
+
+BspResetCause_t bsp_reset_cause(void)
+{
+    return BSP_RESET_POWER;
+}
+
+void bsp_start_image(u32_t addr)
+{
+}
+
+static bool_t in_flash(u32_t addr, size_t len)
+{
+    return ((addr >= SIM_FLASH_ADDR(0)) && (len <= SIM_FLASH_SIZE)
+        && ((addr - SIM_FLASH_ADDR(0)) <= (SIM_FLASH_SIZE - len))) ? E_TRUE : E_FALSE;
+}
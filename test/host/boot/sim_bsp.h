@@ -0,0 +1,46 @@
+/**
+ * @brief Simulated flash controller and serial link of the bootloader test
+ * (see sim_bsp.c)
+ */
+#ifndef SIM_BSP_H
+#define SIM_BSP_H
+
+#include "types.h"
+
+#define SIM_FLASH_SIZE      (64u * 1024u)
+#define SIM_APP_OFFSET      (16u * 1024u)   /* as in STM32F103C8TX_BOOT.ld */
+#define SIM_ERASE_POLLS     (3u)            /* bsp_flash_status calls an erase takes */
+#define SIM_WIRE_SIZE       (128u * 1024u)
+
+/* Flash contents. The test links ld__app_start and ld__app_end to addresses
+   inside it, so it has to sit below 4G (a non-PIE executable). */
+extern u8_t sim_flash[SIM_FLASH_SIZE];
+
+/* Address of byte offset in sim_flash, as the bootloader sees it */
+#define SIM_FLASH_ADDR(offset)  ((u32_t)(size_t)&sim_flash[offset])
+
+typedef struct sim_flash_stats
+{
+    u32_t erases;           /* pages erased                                */
+    u32_t halves;           /* half-words programmed                       */
+    u32_t busy_programs;    /* bsp_flash_program calls while erasing       */
+    u32_t locked_ops;       /* erase or program attempts while locked      */
+    u32_t last_page_offset; /* offset of the page programmed last          */
+} SimFlashStats_t;
+
+extern SimFlashStats_t sim_flash_stats;
+extern bool_t          sim_flash_locked;
+extern u32_t           sim_flash_fail_offset;  /* page whose erase fails */
+
+/* Bytes from the host to the bootloader and back */
+extern u8_t   to_boot[SIM_WIRE_SIZE];
+extern size_t to_boot_len;
+extern size_t to_boot_pos;
+extern u8_t   from_boot[SIM_WIRE_SIZE];
+extern size_t from_boot_len;
+
+extern u32_t  sim_resets;   /* bsp_reset calls */
+
+void sim_reset(void);
+
+#endif /* SIM_BSP_H */
@@ -0,0 +1,110 @@
+/**
+ * @brief Histogram test
+ *
+ * Checks the binning and the percentile bounds of utils/histogram against
+ * sample sets whose percentiles are known, the same way exercise 7 uses it
+ * for the report latency (32 bins of 16 us).
+ */
+#include "check.h"
+#include "types.h"
+#include "utils/histogram.h"
+
+#define NUM_BINS    (32u)
+#define SHIFT       (4u)    /* 16 units per bin */
+
+static u32_t       bins[NUM_BINS];
+static Histogram_t hist;
+
+static void test_empty(void);
+static void test_percentiles(void);
+static void test_overflow_bin(void);
+static void test_reset(void);
+
+int main(void)
+{
+    test_empty();
+    test_percentiles();
+    test_overflow_bin();
+    test_reset();
+
+    return check_status();
+}
+
+static void test_empty(void)
+{
+    histogram_init(&hist, bins, NUM_BINS, SHIFT);
+
+    CHECK_EQ(0u, hist.count);
+    CHECK_EQ(0u, histogram_percentile(&hist, 50u));
+    CHECK_EQ(0u, histogram_percentile(&hist, 100u));
+}
+
+static void test_percentiles(void)
+{
+    u32_t i;
+
+    /* 3, 6, ... 300: the sample at rank r is 3 * r */
+    histogram_init(&hist, bins, NUM_BINS, SHIFT);
+    for (i = 1u; i <= 100u; i += 1u) {
+        histogram_add(&hist, 3u * i);
+    }
+
+    CHECK_EQ(100u, hist.count);
+    CHECK_EQ(3u, hist.min);
+    CHECK_EQ(300u, hist.max);
+
+    /* Rank 1 (3) is in bin 0, which ends at 15. */
+    CHECK_EQ(15u, histogram_percentile(&hist, 0u));
+    CHECK_EQ(15u, histogram_percentile(&hist, 1u));
+
+    /* Rank 50 (150) is in bin 9, which ends at 159. */
+    CHECK_EQ(159u, histogram_percentile(&hist, 50u));
+
+    /* Rank 99 (297) is in bin 18, which ends at 303, past the largest
+       sample. */
+    CHECK_EQ(300u, histogram_percentile(&hist, 99u));
+    CHECK_EQ(300u, histogram_percentile(&hist, 100u));
+    CHECK_EQ(300u, histogram_percentile(&hist, 200u));
+
+    /* Never below the true percentile and less than a bin above it */
+    for (i = 1u; i <= 100u; i += 1u) {
+        CHECK(histogram_percentile(&hist, (u8_t)i) >= (3u * i));
+        CHECK(histogram_percentile(&hist, (u8_t)i) < ((3u * i) + (1u << SHIFT)));
+    }
+}
+
+static void test_overflow_bin(void)
+{
+    histogram_init(&hist, bins, NUM_BINS, SHIFT);
+    histogram_add(&hist, 1u);
+    histogram_add(&hist, 100000u);  /* far past the last bin (496 to 511) */
+
+    CHECK_EQ(1u, bins[0]);
+    CHECK_EQ(1u, bins[NUM_BINS - 1u]);
+
+    /* The last bin has no upper edge, so the bound is the largest sample. */
+    CHECK_EQ(15u, histogram_percentile(&hist, 50u));
+    CHECK_EQ(100000u, histogram_percentile(&hist, 100u));
+}
+
+static void test_reset(void)
+{
+    size_t i;
+
+    histogram_init(&hist, bins, NUM_BINS, SHIFT);
+    histogram_add(&hist, 40u);
+    histogram_add(&hist, 7u);
+    histogram_reset(&hist);
+
+    CHECK_EQ(0u, hist.count);
+    CHECK_EQ(0u, hist.min);
+    CHECK_EQ(0u, hist.max);
+    for (i = 0; i < NUM_BINS; i += 1) {
+        CHECK_EQ(0u, bins[i]);
+    }
+
+    /* The minimum starts over with the first sample after a reset. */
+    histogram_add(&hist, 90u);
+    CHECK_EQ(90u, hist.min);
+    CHECK_EQ(90u, hist.max);
+}
@@ -0,0 +1,49 @@
+/**
+ * @brief Minimal checks for the host tests
+ *
+ * CHECK records a failure (with its file and line) and carries on, so one run
+ * reports every broken case. A test's main returns check_status().
+ *
+ *      CHECK(3u == histogram_percentile(&hist, 50u));
+ *      CHECK_EQ(3u, histogram_percentile(&hist, 50u));  // prints both values
+ *
+ *      return check_status();
+ */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned long check_failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures += 1u;                                           \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(expected, actual)                                          \
+    do {                                                                    \
+        const unsigned long long e_ = (unsigned long long)(expected);       \
+        const unsigned long long a_ = (unsigned long long)(actual);         \
+        if (e_ != a_) {                                                     \
+            printf("%s:%d: %s is %llu, expected %llu\n",                    \
+                __FILE__, __LINE__, #actual, a_, e_);                       \
+            check_failures += 1u;                                           \
+        }                                                                   \
+    } while (0)
+
+/* Prints the outcome. Returns the exit status for main. */
+static inline int check_status(void)
+{
+    if (0u != check_failures) {
+        printf("%lu check(s) failed\n", check_failures);
+    }
+
+    return (0u == check_failures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif /* CHECK_H */
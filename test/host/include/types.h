@@ -0,0 +1,46 @@
+/**
+ * @brief Host build stand-in for common/src/types.h
+ *
+ * The target's int_types.h defines size_t and the 32 bit types for the 32 bit
+ * ARM ABI, which clash with the host C library on a 64 bit machine. Here the
+ * fixed width types come from stdint.h instead. The boolean types and
+ * constants are the target's own.
+ */
+#ifndef TYPES_H
+#define TYPES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bsp/private/data_types/boolean_types.h"
+#include "bsp/private/data_types/constants.h"
+
+typedef float FLOAT_T;
+
+typedef int8_t   s8_t;
+typedef int16_t  s16_t;
+typedef int32_t  s32_t;
+typedef int64_t  s64_t;
+
+typedef uint8_t  u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef uint64_t u64_t;
+
+/*
+ * ISR callback function pointer type.
+ *
+ * Maps to function with the signature void my_callback(void)
+ */
+typedef void (*IsrCallback_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TYPES_H */
@@ -0,0 +1,21 @@
+/**
+ * @brief Interrupt masking fakes for the log test
+ *
+ * The test has a single thread, so there is nothing to mask. The depth only
+ * lets the test check that every save is paired with a restore.
+ */
+#include "bsp/bsp.h"
+#include "types.h"
+
+u32_t irq_depth;
+
+u32_t bsp_irq_save(void)
+{
+    irq_depth += 1u;
+    return 0u;
+}
+
+void bsp_irq_restore(u32_t state)
+{
+    irq_depth -= 1u;
+}
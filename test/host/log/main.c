@@ -0,0 +1,247 @@
+/**
+ * @brief Binary log test
+ *
+ * Queues records and decodes what log_task writes the way
+ * scripts/log_decoder.py does (COBS frames of LEB128 varints):
+ *
+ *  - records come out as the ID and the arguments, matching frames made by
+ *    scripts/packet.py
+ *  - LOG passes 0 to 4 arguments as 32 bit words, and each call site has its
+ *    own ID
+ *  - a write function that takes a few bytes at a time (or none) gets the
+ *    same bytes as one that takes everything
+ *  - records that do not fit in the queue are dropped, and the loss is
+ *    reported ahead of the records that were kept
+ *
+ * On the host, a message ID is the low 32 bits of the format string's
+ * address rather than its offset in .log_fmt, so the IDs of LOG call sites
+ * are only compared with each other.
+ */
+#include <string.h>
+
+#include "check.h"
+#include "log/log.h"
+#include "packet/cobs.h"
+#include "types.h"
+
+#define OUT_SIZE        (8192u)
+#define MAX_RECORDS     (128u)
+#define RECORD_LEN(n)   (1u + (4u * (1u + (n))))   /* queued bytes, as in log.c */
+
+typedef struct record
+{
+    u32_t  values[1u + LOG_MAX_ARGS];   /* ID, then the arguments */
+    size_t num_values;
+} Record_t;
+
+extern u32_t irq_depth;     /* see fake_bsp.c */
+
+static u8_t   out[OUT_SIZE];
+static size_t out_len;
+static size_t write_max;    /* most bytes the write function takes per call */
+
+static Record_t records[MAX_RECORDS];
+static size_t   num_records;
+
+static void test_wire_format(void);
+static void test_log_macro(void);
+static void test_slow_writer(void);
+static void test_dropped(void);
+static size_t take(const u8_t * const p_bytes, size_t len);
+static void reset(size_t max);
+static void decode(void);
+
+int main(void)
+{
+    test_wire_format();
+    test_log_macro();
+    test_slow_writer();
+    test_dropped();
+
+    CHECK_EQ(0u, irq_depth);
+
+    return check_status();
+}
+
+static void test_wire_format(void)
+{
+    /* Frames from scripts/packet.py cobs_encode() of the varints */
+    static const u8_t EXPECTED[] =
+    {
+        0x06, 0xB4, 0x24, 0x01, 0xAC, 0x02, 0x00,   /* 0x1234: 1, 300  */
+        0x01, 0x01, 0x01, 0x00,                     /* 0: 0            */
+        0x06, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00,   /* 0xFFFFFFFF      */
+    };
+
+    reset(OUT_SIZE);
+    log_record(0x1234u, 2u, 1u, 300u, 7u, 7u);
+    log_record(0u, 1u, 0u, 7u, 7u, 7u);
+    log_record(0xFFFFFFFFUL, 0u, 7u, 7u, 7u, 7u);
+    log_task();
+
+    CHECK_EQ(sizeof(EXPECTED), out_len);
+    CHECK(0 == memcmp(out, EXPECTED, sizeof(EXPECTED)));
+
+    /* More than LOG_MAX_ARGS is clamped */
+    reset(OUT_SIZE);
+    log_record(5u, LOG_MAX_ARGS + 3u, 1u, 2u, 3u, 4u);
+    log_task();
+    decode();
+    CHECK_EQ(1u, num_records);
+    CHECK_EQ(1u + LOG_MAX_ARGS, records[0].num_values);
+    CHECK_EQ(4u, records[0].values[LOG_MAX_ARGS]);
+}
+
+static void test_log_macro(void)
+{
+    u32_t i;
+
+    reset(OUT_SIZE);
+    LOG("boot");
+    LOG("uart%u overrun, %u bytes lost", 1, 300);
+    LOG("temp %d C, flags %#06x, ch '%c'", -5, 0xBEEF, 'A');
+    LOG("four %u %u %u %u", 1, 2, 3, 4000000000u);
+    for (i = 0; i < 3u; i += 1) {
+        LOG("loop %u", i);
+    }
+    log_task();
+    decode();
+
+    CHECK_EQ(7u, num_records);
+    CHECK_EQ(1u, records[0].num_values);
+    CHECK_EQ(3u, records[1].num_values);
+    CHECK_EQ(300u, records[1].values[2]);
+    CHECK_EQ(4u, records[2].num_values);
+    CHECK_EQ(0xFFFFFFFBUL, records[2].values[1]);
+    CHECK_EQ(0xBEEFu, records[2].values[2]);
+    CHECK_EQ('A', records[2].values[3]);
+    CHECK_EQ(5u, records[3].num_values);
+    CHECK_EQ(4000000000UL, records[3].values[4]);
+
+    /* One ID per call site */
+    CHECK(records[0].values[0] != records[1].values[0]);
+    CHECK(records[1].values[0] != records[2].values[0]);
+    CHECK(records[2].values[0] != records[3].values[0]);
+    for (i = 0; i < 3u; i += 1) {
+        CHECK_EQ(records[4].values[0], records[4u + i].values[0]);
+        CHECK_EQ(i, records[4u + i].values[1]);
+    }
+}
+
+static void test_slow_writer(void)
+{
+    u8_t   whole[OUT_SIZE];
+    size_t whole_len;
+    size_t calls;
+    u32_t  i;
+
+    reset(OUT_SIZE);
+    for (i = 0; i < 20u; i += 1) {
+        log_record(1000u + i, i % (LOG_MAX_ARGS + 1u), i, i << 8, i << 16, i << 24);
+    }
+    log_task();
+    memcpy(whole, out, out_len);
+    whole_len = out_len;
+
+    /* Nothing taken: the record waits */
+    reset(0u);
+    for (i = 0; i < 20u; i += 1) {
+        log_record(1000u + i, i % (LOG_MAX_ARGS + 1u), i, i << 8, i << 16, i << 24);
+    }
+    log_task();
+    CHECK_EQ(0u, out_len);
+
+    /* Then 3 bytes per call */
+    write_max = 3u;
+    for (calls = 0; (calls < 1000u) && (out_len < whole_len); calls += 1) {
+        log_task();
+    }
+
+    CHECK_EQ(whole_len, out_len);
+    CHECK(0 == memcmp(out, whole, whole_len));
+}
+
+static void test_dropped(void)
+{
+    const u32_t queued = LOG_BUF_SIZE / RECORD_LEN(0u);
+    u32_t       i;
+
+    reset(OUT_SIZE);
+    for (i = 0; i < (queued + 9u); i += 1) {
+        log_record(i, 0u, 0u, 0u, 0u, 0u);
+    }
+    log_task();
+    decode();
+
+    /* The report, then the records that fit */
+    CHECK_EQ(1u + queued, num_records);
+    CHECK_EQ(2u, records[0].num_values);
+    CHECK_EQ(9u, records[0].values[1]);
+    for (i = 0; i < queued; i += 1) {
+        CHECK_EQ(i, records[1u + i].values[0]);
+    }
+
+    /* Reported once */
+    reset(OUT_SIZE);
+    log_record(77u, 0u, 0u, 0u, 0u, 0u);
+    log_task();
+    decode();
+    CHECK_EQ(1u, num_records);
+    CHECK_EQ(77u, records[0].values[0]);
+}
+
+/* Write function of the log: takes up to write_max bytes */
+static size_t take(const u8_t * const p_bytes, size_t len)
+{
+    size_t n = (len < write_max) ? len : write_max;
+
+    if (n > (OUT_SIZE - out_len)) {
+        n = OUT_SIZE - out_len;
+    }
+
+    memcpy(&out[out_len], p_bytes, n);
+    out_len += n;
+
+    return n;
+}
+
+static void reset(size_t max)
+{
+    log_init(take);
+    out_len   = 0;
+    write_max = max;
+}
+
+/* Split out into records: COBS frames, each a list of varints */
+static void decode(void)
+{
+    CobsDecoder_t dec;
+    CobsDecode_t  result;
+    Record_t     *p_rec;
+    u32_t         shift = 0;
+    u8_t          byte;
+    size_t        i;
+
+    num_records = 0;
+    memset(records, 0, sizeof(records));
+    cobs_decoder_init(&dec);
+
+    for (i = 0; (i < out_len) && (num_records < MAX_RECORDS); i += 1) {
+        p_rec  = &records[num_records];
+        result = cobs_decoder_put(&dec, out[i], &byte);
+        CHECK(COBS_DECODE_ERROR != result);
+
+        if ((COBS_DECODE_BYTE == result) && (p_rec->num_values <= LOG_MAX_ARGS)) {
+            p_rec->values[p_rec->num_values] |= (u32_t)(byte & 0x7Fu) << shift;
+            shift += 7u;
+            if (0u == (byte & 0x80u)) {
+                p_rec->num_values += 1u;
+                shift = 0;
+            }
+        } else if (COBS_DECODE_END == result) {
+            CHECK_EQ(0u, shift);
+            num_records += 1u;
+            shift = 0;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**
+ * @brief Serial port and cycle counter fakes for the mux test
+ *
+ * Written bytes land in a wire buffer and reads take them back out, so every
+ * frame the multiplexer sends comes back to it on the same channel. The
+ * transmit space it reports is set by the test (wire_tx_space) to hold frames
+ * back.
+ */
+#include "fake_bsp.h"
+
+#include <string.h>
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+u8_t   wire[WIRE_SIZE];
+size_t wire_len;
+size_t wire_pos;
+size_t wire_tx_space;
+
+size_t bsp_serial_port_tx_space(BspSerialPort_t port)
+{
+    size_t space = WIRE_SIZE - wire_len;
+
+    if (space > wire_tx_space) {
+        space = wire_tx_space;
+    }
+
+    return space;
+}
+
+size_t bsp_serial_port_write_buf(BspSerialPort_t port, const u8_t * const p_bytes, size_t len)
+{
+    size_t n = bsp_serial_port_tx_space(port);
+
+    if (n > len) {
+        n = len;
+    }
+
+    memcpy(&wire[wire_len], p_bytes, n);
+    wire_len += n;
+
+    return n;
+}
+
+size_t bsp_serial_port_read_buf(BspSerialPort_t port, u8_t * const p_bytes, size_t len)
+{
+    size_t n = wire_len - wire_pos;
+
+    if (n > len) {
+        n = len;
+    }
+    if (n > READ_MAX) {
+        n = READ_MAX;
+    }
+
+    memcpy(p_bytes, &wire[wire_pos], n);
+    wire_pos += n;
+
+    return n;
+}
+
+u32_t bsp_cycles_now(void)
+{
+    static u32_t cycles;
+
+    cycles += 1000000u;
+    return cycles;
+}
+
+void wire_reset(void)
+{
+    wire_len      = 0;
+    wire_pos      = 0;
+    wire_tx_space = WIRE_SIZE;
+}
@@ -0,0 +1,237 @@
+/**
+ * @brief Channel multiplexer test
+ *
+ * Runs the multiplexer against itself over a fake serial wire (see
+ * fake_bsp.c), so each frame it sends is received back on its own channel:
+ *
+ *  - bytes written on each channel come back unchanged, split into frames of
+ *    up to MUX_FRAME_MAX, and the counters agree
+ *  - a frame that does not fit in its channel's receive queue is dropped as a
+ *    whole and counted
+ *  - a received frame longer than MUX_FRAME_MAX, or for an unknown channel,
+ *    is thrown away and the next frame is received normally
+ *  - nothing is sent while the serial port lacks room for a whole frame
+ *  - deficit round robin: the console gets its turn while the log and data
+ *    channels are backlogged, and those two share the line evenly
+ */
+#include <string.h>
+
+#include "check.h"
+#include "fake_bsp.h"
+#include "mux/mux.h"
+#include "mux/mux_config.h"
+#include "packet/cobs.h"
+#include "packet/packet.h"
+#include "types.h"
+
+#define IDLE_CALLS      (200u)  /* mux_task calls to send and receive everything */
+
+static void test_round_trip(void);
+static void test_full_queue(void);
+static void test_frame_limit(void);
+static void test_tx_space(void);
+static void test_fairness(void);
+static void run(u32_t calls);
+static void inject_frame(u8_t id, const u8_t * const p_bytes, size_t len);
+static MuxStats_t stats_of(MuxChannel_t channel);
+
+int main(void)
+{
+    test_round_trip();
+    test_full_queue();
+    test_frame_limit();
+    test_tx_space();
+    test_fairness();
+
+    return check_status();
+}
+
+static void test_round_trip(void)
+{
+    static const size_t LENS[MUX_NUM_CHANNELS] =
+    {
+        [MUX_CHANNEL_CONSOLE] = 40u,
+        [MUX_CHANNEL_LOG]     = MUX_LOG_RX_BUF_SIZE,
+        [MUX_CHANNEL_DATA]    = 200u,
+    };
+    u8_t       sent[MUX_NUM_CHANNELS][256];
+    u8_t       got[300];
+    MuxStats_t stats;
+    size_t     c;
+    size_t     i;
+
+    wire_reset();
+    mux_init();
+
+    for (c = 0; c < MUX_NUM_CHANNELS; c += 1) {
+        for (i = 0; i < LENS[c]; i += 1) {
+            sent[c][i] = (u8_t)((c << 6) + (i * 7u));
+        }
+        CHECK_EQ(LENS[c], mux_write((MuxChannel_t)c, sent[c], LENS[c]));
+    }
+
+    run(IDLE_CALLS);
+    CHECK_EQ(wire_len, wire_pos);
+
+    for (c = 0; c < MUX_NUM_CHANNELS; c += 1) {
+        CHECK_EQ(LENS[c], mux_read((MuxChannel_t)c, got, sizeof(got)));
+        CHECK(0 == memcmp(got, sent[c], LENS[c]));
+
+        stats = stats_of((MuxChannel_t)c);
+        CHECK_EQ(LENS[c], stats.tx_bytes);
+        CHECK_EQ(LENS[c], stats.rx_bytes);
+        CHECK_EQ((LENS[c] + MUX_FRAME_MAX - 1u) / MUX_FRAME_MAX, stats.tx_frames);
+        CHECK_EQ(stats.tx_frames, stats.rx_frames);
+        CHECK_EQ(0u, stats.rx_dropped);
+    }
+
+    /* The transmit queue takes what fits */
+    CHECK_EQ(MUX_DATA_TX_BUF_SIZE, mux_write(MUX_CHANNEL_DATA, got, MUX_DATA_TX_BUF_SIZE + 10u));
+    CHECK_EQ(0u, mux_write(MUX_NUM_CHANNELS, got, 1u));
+    CHECK_EQ(0u, mux_read(MUX_NUM_CHANNELS, got, 1u));
+    CHECK_EQ(E_FALSE, mux_get_stats(MUX_NUM_CHANNELS, &stats));
+}
+
+static void test_full_queue(void)
+{
+    static const u8_t FIRST[]  = "0123456789";
+    static const u8_t SECOND[] = "abcdefghij";
+    u8_t       got[MUX_LOG_RX_BUF_SIZE];
+    MuxStats_t stats;
+
+    wire_reset();
+    mux_init();
+
+    /* Too long for the log's receive queue even when it is empty */
+    CHECK_EQ(MUX_LOG_RX_BUF_SIZE + 1u, mux_write(MUX_CHANNEL_LOG, got, MUX_LOG_RX_BUF_SIZE + 1u));
+    run(IDLE_CALLS);
+
+    /* The second frame only fits once the first was read */
+    (void)mux_write(MUX_CHANNEL_LOG, FIRST, 10u);
+    run(IDLE_CALLS);
+    (void)mux_write(MUX_CHANNEL_LOG, SECOND, 10u);
+    run(IDLE_CALLS);
+
+    stats = stats_of(MUX_CHANNEL_LOG);
+    CHECK_EQ(3u, stats.tx_frames);
+    CHECK_EQ(1u, stats.rx_frames);
+    CHECK_EQ(10u, stats.rx_bytes);
+    CHECK_EQ(2u, stats.rx_dropped);
+
+    /* None of a dropped frame made it into the queue */
+    CHECK_EQ(10u, mux_read(MUX_CHANNEL_LOG, got, sizeof(got)));
+    CHECK(0 == memcmp(got, FIRST, 10u));
+}
+
+static void test_frame_limit(void)
+{
+    u8_t       bytes[MUX_FRAME_MAX + 1u];
+    u8_t       got[MUX_FRAME_MAX + 1u];
+    MuxStats_t stats;
+    size_t     i;
+
+    for (i = 0; i < sizeof(bytes); i += 1) {
+        bytes[i] = (u8_t)(i + 1u);
+    }
+
+    wire_reset();
+    mux_init();
+
+    inject_frame(MUX_CHANNEL_CONSOLE, bytes, MUX_FRAME_MAX + 1u);
+    inject_frame(MUX_NUM_CHANNELS, bytes, 4u);
+    inject_frame(MUX_CHANNEL_CONSOLE, bytes, MUX_FRAME_MAX);
+    run(IDLE_CALLS);
+
+    stats = stats_of(MUX_CHANNEL_CONSOLE);
+    CHECK_EQ(1u, stats.rx_frames);
+    CHECK_EQ(MUX_FRAME_MAX, stats.rx_bytes);
+    CHECK_EQ(1u, stats.rx_dropped);
+
+    CHECK_EQ(MUX_FRAME_MAX, mux_read(MUX_CHANNEL_CONSOLE, got, sizeof(got)));
+    CHECK(0 == memcmp(got, bytes, MUX_FRAME_MAX));
+    CHECK_EQ(0u, stats_of(MUX_CHANNEL_LOG).rx_frames + stats_of(MUX_CHANNEL_DATA).rx_frames);
+}
+
+static void test_tx_space(void)
+{
+    u8_t bytes[MUX_FRAME_MAX];
+
+    memset(bytes, 0x00, sizeof(bytes));
+
+    wire_reset();
+    mux_init();
+
+    /* One byte short of the worst case frame */
+    wire_tx_space = COBS_ENCODED_MAX(1u + MUX_FRAME_MAX + PACKET_CRC_LEN) - 1u;
+    (void)mux_write(MUX_CHANNEL_DATA, bytes, sizeof(bytes));
+    run(10u);
+    CHECK_EQ(0u, wire_len);
+    CHECK_EQ(0u, stats_of(MUX_CHANNEL_DATA).tx_frames);
+
+    wire_tx_space += 1u;
+    run(1u);
+    CHECK_EQ(1u, stats_of(MUX_CHANNEL_DATA).tx_frames);
+}
+
+static void test_fairness(void)
+{
+    u8_t   bulk[256];
+    u32_t  calls;
+    u32_t  log_frames;
+    u32_t  data_frames;
+
+    memset(bulk, 0x55, sizeof(bulk));
+
+    wire_reset();
+    mux_init();
+
+    (void)mux_write(MUX_CHANNEL_LOG, bulk, sizeof(bulk));
+    (void)mux_write(MUX_CHANNEL_DATA, bulk, sizeof(bulk));
+    run(3u);
+
+    /* With both bulk channels backlogged, the console waits for at most one
+       frame of each */
+    (void)mux_write(MUX_CHANNEL_CONSOLE, bulk, 10u);
+    for (calls = 0; (calls < MUX_NUM_CHANNELS) && (0u == stats_of(MUX_CHANNEL_CONSOLE).tx_frames); calls += 1) {
+        mux_task();
+    }
+    CHECK_EQ(1u, stats_of(MUX_CHANNEL_CONSOLE).tx_frames);
+
+    /* Equal quanta: the bulk channels take turns frame by frame */
+    for (calls = 0; calls < IDLE_CALLS; calls += 1) {
+        mux_task();
+
+        log_frames  = stats_of(MUX_CHANNEL_LOG).tx_frames;
+        data_frames = stats_of(MUX_CHANNEL_DATA).tx_frames;
+        CHECK((log_frames <= (data_frames + 1u)) && (data_frames <= (log_frames + 1u)));
+    }
+
+    CHECK_EQ(sizeof(bulk), stats_of(MUX_CHANNEL_LOG).tx_bytes);
+    CHECK_EQ(sizeof(bulk), stats_of(MUX_CHANNEL_DATA).tx_bytes);
+}
+
+static void run(u32_t calls)
+{
+    u32_t i;
+
+    for (i = 0; i < calls; i += 1) {
+        mux_task();
+    }
+}
+
+/* Put a frame on the wire the way the far end would send it */
+static void inject_frame(u8_t id, const u8_t * const p_bytes, size_t len)
+{
+    packet_send_begin();
+    packet_send(&id, 1u);
+    packet_send(p_bytes, len);
+    packet_send_end();
+}
+
+static MuxStats_t stats_of(MuxChannel_t channel)
+{
+    MuxStats_t stats;
+
+    (void)mux_get_stats(channel, &stats);
+    return stats;
+}
@@ -0,0 +1,19 @@
+/**
+ * @brief Serial wire of the packet test (see fake_bsp.c)
+ */
+#ifndef FAKE_BSP_H
+#define FAKE_BSP_H
+
+#include "types.h"
+
+#define WIRE_SIZE   (1UL << 20)
+#define WRITE_MAX   (7u)    /* bytes the fake serial port takes per write */
+#define READ_MAX    (5u)    /* bytes it hands out per read                */
+
+extern u8_t   wire[WIRE_SIZE];
+extern size_t wire_len;
+extern size_t wire_pos;
+
+void wire_reset(void);
+
+#endif /* FAKE_BSP_H */
@@ -0,0 +1,226 @@
+/**
+ * @brief Packet framing test
+ *
+ * Runs the packet module against itself over a fake serial wire (see
+ * fake_bsp.c):
+ *
+ *  - the CRC and the frame bytes match scripts/packet.py, the host side of
+ *    the framing
+ *  - random frames (with runs of zeros and blocks longer than 254 bytes),
+ *    sent and received in random pieces, come back unchanged
+ *  - a corrupted or cut short frame is reported bad and the next frame is
+ *    received normally
+ *  - the built in benchmark decodes its own frames
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "fake_bsp.h"
+#include "packet/crc32.h"
+#include "packet/packet.h"
+#include "types.h"
+
+#define NUM_FRAMES      (50u)
+#define FRAME_MAX       (1200u)
+
+static void test_crc32(void);
+static void test_wire_format(void);
+static void test_round_trip(void);
+static void test_bad_frames(void);
+static void test_benchmark(void);
+static void send_frame(const u8_t * const p_bytes, size_t len, size_t max_piece);
+static PacketRx_t receive_frame(u8_t * const p_dst, size_t * const p_len);
+
+int main(void)
+{
+    srand(1);
+
+    test_crc32();
+    test_wire_format();
+    test_round_trip();
+    test_bad_frames();
+    test_benchmark();
+
+    return check_status();
+}
+
+static void test_crc32(void)
+{
+    static const u8_t CHECK_STR[] = "123456789";
+    static const u8_t WORD[]      = { 0x78, 0x56, 0x34, 0x12 };
+    Crc32_t crc;
+    size_t  i;
+
+    /* Values from scripts/packet.py */
+    crc32_init(&crc);
+    CHECK_EQ(0xFFFFFFFFUL, crc32_final(&crc));
+
+    crc32_init(&crc);
+    crc32_update(&crc, WORD, sizeof(WORD));
+    CHECK_EQ(0xDF8A8A2BUL, crc32_final(&crc));
+
+    crc32_init(&crc);
+    crc32_update(&crc, CHECK_STR, 9u);
+    CHECK_EQ(0xAFF19057UL, crc32_final(&crc));
+
+    /* The split into updates does not matter */
+    crc32_init(&crc);
+    crc32_update(&crc, WORD, 1u);
+    crc32_update(&crc, &WORD[1], 3u);
+    CHECK_EQ(0xDF8A8A2BUL, crc32_final(&crc));
+
+    crc32_init(&crc);
+    for (i = 0; i < 9u; i += 1) {
+        crc32_update(&crc, &CHECK_STR[i], 1u);
+    }
+    CHECK_EQ(0xAFF19057UL, crc32_final(&crc));
+}
+
+static void test_wire_format(void)
+{
+    static const u8_t PAYLOAD[]  = { 0x11, 0x00, 0x22, 0x00 };
+    static const u8_t FRAME[]    = { 0x02, 0x11, 0x02, 0x22, 0x05, 0x52, 0xD2, 0x70, 0xB7, 0x00 };
+    static const u8_t EMPTY[]    = { 0x05, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+    /* Frames from scripts/packet.py encode() */
+    packet_init();
+    wire_reset();
+    send_frame(PAYLOAD, sizeof(PAYLOAD), 1u);
+    CHECK_EQ(sizeof(FRAME), wire_len);
+    CHECK(0 == memcmp(wire, FRAME, sizeof(FRAME)));
+
+    wire_reset();
+    send_frame(NULL_PTR, 0u, 1u);
+    CHECK_EQ(sizeof(EMPTY), wire_len);
+    CHECK(0 == memcmp(wire, EMPTY, sizeof(EMPTY)));
+}
+
+static void test_round_trip(void)
+{
+    static u8_t   frames[NUM_FRAMES][FRAME_MAX];
+    static size_t lens[NUM_FRAMES];
+    u8_t          got[FRAME_MAX + 64u];
+    size_t        got_len;
+    PacketStats_t stats;
+    size_t        k;
+    size_t        i;
+
+    packet_init();
+    wire_reset();
+
+    for (k = 0; k < NUM_FRAMES; k += 1) {
+        lens[k] = (size_t)rand() % FRAME_MAX;
+        for (i = 0; i < lens[k]; i += 1) {
+            frames[k][i] = (0 == (rand() % 4)) ? 0x00u : (u8_t)rand();
+        }
+
+        /* Only zeros (a block per byte) and no zeros (full blocks) */
+        if (3u == k) {
+            memset(frames[k], 0x00, lens[k]);
+        } else if (4u == k) {
+            memset(frames[k], 0xAA, lens[k]);
+        }
+
+        send_frame(frames[k], lens[k], 300u);
+    }
+
+    for (k = 0; k < NUM_FRAMES; k += 1) {
+        CHECK_EQ(PACKET_RX_FRAME_OK, receive_frame(got, &got_len));
+        CHECK_EQ(lens[k], got_len);
+        CHECK(0 == memcmp(got, frames[k], lens[k]));
+    }
+
+    CHECK_EQ(wire_len, wire_pos);
+
+    packet_get_stats(&stats);
+    CHECK_EQ(NUM_FRAMES, stats.tx_frames);
+    CHECK_EQ(NUM_FRAMES, stats.rx_frames);
+    CHECK_EQ(0u, stats.rx_bad_crc);
+    CHECK_EQ(0u, stats.rx_bad_framing);
+}
+
+static void test_bad_frames(void)
+{
+    static const u8_t PAYLOAD[] = "The quick brown fox";
+    u8_t          got[FRAME_MAX + 64u];
+    size_t        got_len;
+    PacketStats_t stats;
+
+    packet_init();
+    wire_reset();
+
+    /* A flipped bit inside the frame */
+    send_frame(PAYLOAD, sizeof(PAYLOAD), 5u);
+    wire[3] ^= 0x40u;
+
+    /* A frame cut short: its last block ends early */
+    send_frame(PAYLOAD, sizeof(PAYLOAD), 5u);
+    wire[wire_len - 4u] = 0x00;
+    wire_len -= 3u;
+
+    /* A good frame after them */
+    send_frame(PAYLOAD, sizeof(PAYLOAD), 5u);
+
+    CHECK_EQ(PACKET_RX_FRAME_BAD, receive_frame(got, &got_len));
+    CHECK_EQ(PACKET_RX_FRAME_BAD, receive_frame(got, &got_len));
+    CHECK_EQ(PACKET_RX_FRAME_OK, receive_frame(got, &got_len));
+    CHECK_EQ(sizeof(PAYLOAD), got_len);
+    CHECK(0 == memcmp(got, PAYLOAD, sizeof(PAYLOAD)));
+
+    packet_get_stats(&stats);
+    CHECK_EQ(1u, stats.rx_frames);
+    CHECK_EQ(1u, stats.rx_bad_crc);
+    CHECK_EQ(1u, stats.rx_bad_framing);
+}
+
+static void test_benchmark(void)
+{
+    PacketBench_t bench;
+
+    CHECK_EQ(E_TRUE, packet_benchmark(&bench));
+    CHECK(0u != bench.encode.cycles_per_byte);
+    CHECK(0u != bench.encode.bytes_per_sec);
+    CHECK(0u != bench.decode.cycles_per_byte);
+    CHECK(0u != bench.decode.bytes_per_sec);
+}
+
+/* Send a frame in random pieces of up to max_piece bytes */
+static void send_frame(const u8_t * const p_bytes, size_t len, size_t max_piece)
+{
+    size_t sent = 0;
+    size_t n;
+
+    packet_send_begin();
+    while (sent < len) {
+        n = 1u + ((size_t)rand() % max_piece);
+        if (n > (len - sent)) {
+            n = len - sent;
+        }
+
+        packet_send(&p_bytes[sent], n);
+        sent += n;
+    }
+    packet_send_end();
+}
+
+/* Receive the next frame into p_dst, in random pieces. PACKET_RX_NONE if the
+   wire ran dry first. */
+static PacketRx_t receive_frame(u8_t * const p_dst, size_t * const p_len)
+{
+    PacketRx_t result = PACKET_RX_DATA;
+    size_t     got    = 0;
+    size_t     n;
+
+    while (PACKET_RX_DATA == result) {
+        result = packet_receive(&p_dst[got], 1u + ((size_t)rand() % 33u), &n);
+        got   += n;
+
+        if ((PACKET_RX_NONE == result) && (wire_pos != wire_len)) {
+            result = PACKET_RX_DATA;
+        }
+    }
+
+    *p_len = got;
+    return result;
+}
@@ -0,0 +1,37 @@
+/**
+ * @brief Cycle counter and serial port stubs for the packet codec benchmark
+ *
+ * packet_benchmark works in memory, so the serial port is never used. The
+ * cycle counter is the time stamp counter on x86 and nanoseconds elsewhere
+ * (see main.c).
+ */
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+size_t bsp_serial_port_write_buf(BspSerialPort_t port, const u8_t * const p_bytes, size_t len)
+{
+    return 0u;
+}
+
+size_t bsp_serial_port_read_buf(BspSerialPort_t port, u8_t * const p_bytes, size_t len)
+{
+    return 0u;
+}
+
+u32_t bsp_cycles_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (u32_t)__rdtsc();
+#else
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u32_t)(((u64_t)ts.tv_sec * 1000000000u) + (u64_t)ts.tv_nsec);
+#endif
+}
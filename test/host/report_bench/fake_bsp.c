@@ -0,0 +1,19 @@
+/**
+ * @brief Serial transmit buffer fake for the report benchmark
+ *
+ * report_output formats into the transmit buffer. The reservation is always
+ * granted, at the start of the buffer, so nothing is ever sent.
+ */
+#include "bsp/bsp.h"
+#include "types.h"
+
+static u8_t tx_buf[BSP_SERIAL_TX_RESERVE_MAX];
+
+u8_t* bsp_serial_tx_reserve(size_t len)
+{
+    return (len <= sizeof(tx_buf)) ? tx_buf : NULL_PTR;
+}
+
+void bsp_serial_tx_commit(size_t n)
+{
+}
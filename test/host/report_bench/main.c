@@ -0,0 +1,247 @@
+/**
+ * @brief Report formatter benchmark
+ *
+ * Formats exercise 7's report (see 07_sentence_statistics/src/report.h) for a
+ * set of contexts with:
+ *
+ *  - report_format, the utils/fmt.h formatter, into a buffer
+ *  - report_output, the same formatter straight into the (fake) transmit
+ *    buffer
+ *  - the append based formatter report.h replaced, kept here as the baseline
+ *
+ * and reports the cost per report. The baseline's output is compared with
+ * report_format's, so a mismatch shows up here as well.
+ *
+ * Costs are in time stamp counter ticks on x86 (about CPU cycles) and in
+ * nanoseconds elsewhere. The numbers compare the formatters with each other;
+ * they are not Cortex-M3 cycle counts.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_UNIT      "cycles"
+#else
+    #define BENCH_UNIT      "ns"
+#endif
+
+#include "report.h"
+#include "types.h"
+#include "utils/ascii_char.h"
+
+#define NUM_CONTEXTS    (64u)
+#define ROUNDS          (20000u)    /* passes over the contexts per measurement */
+
+typedef enum method
+{
+    E_METHOD_FORMAT,
+    E_METHOD_OUTPUT,
+    E_METHOD_APPEND,
+} Method_t;
+
+static Context_t contexts[NUM_CONTEXTS];
+
+static double run(Method_t method);
+static bool_t outputs_match(void);
+static char* format_context_append(char *p_dst, const Context_t *p_ctx);
+static char* append_element(char *p_dst, const Element_t *p_elem);
+static char* append_c_str(char *p_dst, const char * const c_str);
+static void num_to_c_str(u8_t num, char * c_str);
+static u64_t ticks_now(void);
+
+int main(void)
+{
+    Element_t *p_elem;
+    size_t     i;
+    size_t     k;
+
+    /* Counts of 1, 2 and 3 digits, some clamped */
+    for (i = 0; i < NUM_CONTEXTS; i += 1) {
+        p_elem = &contexts[i].letters;
+        for (k = 0; k < 5u; k += 1) {
+            p_elem[k].count   = (u8_t)(((i + 1u) * (k + 3u) * 37u) % 256u);
+            p_elem[k].clamped = (255u == p_elem[k].count) ? E_TRUE : E_FALSE;
+        }
+    }
+    contexts[0].letters.count   = 255u;
+    contexts[0].letters.clamped = E_TRUE;
+
+    printf("%-28s %10s\n", "formatter", BENCH_UNIT "/report");
+    printf("%-28s %10.1f\n", "report_format", run(E_METHOD_FORMAT));
+    printf("%-28s %10.1f\n", "report_output", run(E_METHOD_OUTPUT));
+    printf("%-28s %10.1f\n", "append (baseline)", run(E_METHOD_APPEND));
+
+    return (E_TRUE == outputs_match()) ? 0 : 1;
+}
+
+/* Cost per report of formatting every context ROUNDS times */
+static double run(Method_t method)
+{
+    static char report[REPORT_MAX_LEN];
+    u64_t  start;
+    u64_t  ticks;
+    size_t r;
+    size_t i;
+
+    start = ticks_now();
+    for (r = 0; r < ROUNDS; r += 1) {
+        for (i = 0; i < NUM_CONTEXTS; i += 1) {
+            switch (method) {
+                case E_METHOD_FORMAT:
+                    (void)report_format(report, &contexts[i]);
+                    break;
+                case E_METHOD_OUTPUT:
+                    (void)report_output(&contexts[i]);
+                    break;
+                case E_METHOD_APPEND:
+                default:
+                    (void)format_context_append(report, &contexts[i]);
+                    break;
+            }
+        }
+
+        /* Keep the formatting from being optimized away */
+        __asm__ volatile("" : : "r"(report) : "memory");
+    }
+    ticks = ticks_now() - start;
+
+    return (double)ticks / ((double)ROUNDS * NUM_CONTEXTS);
+}
+
+static bool_t outputs_match(void)
+{
+    char   fmt_report[REPORT_MAX_LEN];
+    char   append_report[REPORT_MAX_LEN];
+    size_t fmt_len;
+    size_t append_len;
+    bool_t result = E_TRUE;
+    size_t i;
+
+    for (i = 0; i < NUM_CONTEXTS; i += 1) {
+        fmt_len    = (size_t)(report_format(fmt_report, &contexts[i]) - fmt_report);
+        append_len = (size_t)(format_context_append(append_report, &contexts[i]) - append_report);
+
+        if ((fmt_len != append_len) || (0 != memcmp(fmt_report, append_report, fmt_len))) {
+            printf("report %u differs from the baseline\n", (unsigned)i);
+            result = E_FALSE;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * The report formatter from before report.h. Same output as report_format.
+ * Returns the end of the report. No null terminator is written.
+ */
+static char* format_context_append(char *p_dst, const Context_t *p_ctx)
+{
+    p_dst = append_c_str(p_dst, "\n=================\n");
+    p_dst = append_c_str(p_dst, "Letters    : ");
+    p_dst = append_element(p_dst, &p_ctx->letters);
+    p_dst = append_c_str(p_dst, "\n");
+
+    p_dst = append_c_str(p_dst, "Vowels     : ");
+    p_dst = append_element(p_dst, &p_ctx->vowels);
+    p_dst = append_c_str(p_dst, "\n");
+
+    p_dst = append_c_str(p_dst, "Digits     : ");
+    p_dst = append_element(p_dst, &p_ctx->digits);
+    p_dst = append_c_str(p_dst, "\n");
+
+    p_dst = append_c_str(p_dst, "Whitespace : ");
+    p_dst = append_element(p_dst, &p_ctx->whitespace);
+    p_dst = append_c_str(p_dst, "\n");
+
+    p_dst = append_c_str(p_dst, "Punctuation: ");
+    p_dst = append_element(p_dst, &p_ctx->punctuation);
+    p_dst = append_c_str(p_dst, "\n\n");
+
+    return p_dst;
+}
+
+/*
+ * Append the element's count (and clamp marker) at p_dst. Returns the end of
+ * the appended text. No null terminator is written.
+ */
+static char* append_element(char *p_dst, const Element_t *p_elem)
+{
+    static const char * const clamp_str = "+";
+
+    /* Since the count is clamped to 255, we only need to handle 4 characters of
+       data (1 for each digit plus NULL) */
+    char c_str_buffer[4] = { 0 };
+
+    /* convert from integer to c string */
+    num_to_c_str(p_elem->count, c_str_buffer);
+
+    /* Output the numerical data */
+    p_dst = append_c_str(p_dst, c_str_buffer);
+    if (p_elem->clamped) {
+        p_dst = append_c_str(p_dst, clamp_str);
+    }
+
+    return p_dst;
+}
+
+/*
+ * Copy c_str (without its null terminator) to p_dst. Returns the end of the
+ * copied text.
+ */
+static char* append_c_str(char *p_dst, const char * const c_str)
+{
+    const char *curr;
+
+    for (curr = c_str; *curr != '\0'; curr += 1) {
+        *p_dst = *curr;
+        p_dst += 1;
+    }
+
+    return p_dst;
+}
+
+static void num_to_c_str(u8_t num, char * c_str)
+{
+    size_t len;
+    size_t i;
+    u8_t   n;
+    u8_t   digit;
+    char   temp;
+
+    if (0 == num) {
+        c_str[0] = '0';
+        c_str[1] = '\0';
+    } else {
+        /* Digits come out least significant first, then are reversed */
+        n   = num;
+        len = 0;
+        while(n != 0) {
+            digit = n % 10;
+            c_str[len] = ascii_char_digit_to_ascii(digit);
+            len++;
+            n /= 10;
+        }
+
+        for (i = 0; i < len/2; i += 1) {
+            temp = c_str[len - (i + 1)];
+            c_str[len - (i + 1)] = c_str[i];
+            c_str[i]             = temp;
+        }
+
+        c_str[len] = '\0';
+    }
+}
+
+static u64_t ticks_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64_t)ts.tv_sec * 1000000000u) + (u64_t)ts.tv_nsec;
+#endif
+}
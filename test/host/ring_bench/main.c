@@ -0,0 +1,160 @@
+/**
+ * @brief Ring throughput benchmark
+ *
+ * Moves bytes through a 256 byte private ring on one thread and reports the
+ * cost per byte of each way of getting them in and out:
+ *
+ *  - push and pop, one byte per call
+ *  - push_n and pop_n, in chunks of several sizes
+ *  - write_span/write_commit and read_span/read_commit with a memcpy
+ *
+ * Costs are in time stamp counter ticks on x86 (about CPU cycles) and in
+ * nanoseconds elsewhere. The numbers compare the operations with each other;
+ * they are not Cortex-M3 cycle counts.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_UNIT      "cycles"
+#else
+    #define BENCH_UNIT      "ns"
+#endif
+
+#include "types.h"
+#include "utils/private_ring.h"
+
+PRIVATE_RING_DECLARATIONS(bench_ring, u8_t) /* see rings.cpp */
+
+#define RING_BYTES      (256u)
+#define ROUNDS          (20000u)    /* ring fills per measurement */
+
+typedef enum method
+{
+    E_METHOD_SINGLE,
+    E_METHOD_BULK,
+    E_METHOD_SPAN,
+} Method_t;
+
+static u8_t src[RING_BYTES];
+static u8_t dst[RING_BYTES];
+
+static double run(Method_t method, size_t chunk);
+static void fill(Method_t method, size_t chunk);
+static void drain(Method_t method, size_t chunk);
+static u64_t ticks_now(void);
+
+int main(void)
+{
+    static const size_t CHUNKS[] = { 1u, 4u, 16u, 64u, 256u };
+    size_t i;
+
+    for (i = 0; i < RING_BYTES; i += 1) {
+        src[i] = (u8_t)i;
+    }
+
+    printf("%-28s %10s\n", "operation", BENCH_UNIT "/byte");
+    printf("%-28s %10.2f\n", "push/pop", run(E_METHOD_SINGLE, 1u));
+
+    for (i = 0; i < (sizeof(CHUNKS) / sizeof(CHUNKS[0])); i += 1) {
+        char name[32];
+
+        (void)snprintf(name, sizeof(name), "push_n/pop_n (%u)", (unsigned)CHUNKS[i]);
+        printf("%-28s %10.2f\n", name, run(E_METHOD_BULK, CHUNKS[i]));
+    }
+
+    printf("%-28s %10.2f\n", "write_span/read_span", run(E_METHOD_SPAN, RING_BYTES));
+
+    return 0;
+}
+
+/* Cost per byte of filling and draining the ring ROUNDS times. The ring is
+   started at an odd position, so the spans wrap like they do in use. */
+static double run(Method_t method, size_t chunk)
+{
+    u64_t  start;
+    u64_t  ticks;
+    size_t r;
+
+    bench_ring_init();
+    (void)bench_ring_push_n(src, 37u);
+    (void)bench_ring_pop_n(dst, 37u);
+
+    start = ticks_now();
+    for (r = 0; r < ROUNDS; r += 1) {
+        fill(method, chunk);
+        drain(method, chunk);
+    }
+    ticks = ticks_now() - start;
+
+    if ((E_TRUE != bench_ring_is_empty()) || (0 != memcmp(src, dst, RING_BYTES))) {
+        printf("data mismatch\n");
+    }
+
+    return (double)ticks / ((double)ROUNDS * RING_BYTES);
+}
+
+static void fill(Method_t method, size_t chunk)
+{
+    u8_t  *p_span;
+    size_t done = 0;
+    size_t n;
+
+    while (done < RING_BYTES) {
+        switch (method) {
+            case E_METHOD_SINGLE:
+                n = (E_TRUE == bench_ring_push(src[done])) ? 1u : 0u;
+                break;
+            case E_METHOD_BULK:
+                n = bench_ring_push_n(&src[done], chunk);
+                break;
+            case E_METHOD_SPAN:
+            default:
+                n = bench_ring_write_span(&p_span);
+                memcpy(p_span, &src[done], n);
+                bench_ring_write_commit(n);
+                break;
+        }
+        done += n;
+    }
+}
+
+static void drain(Method_t method, size_t chunk)
+{
+    u8_t  *p_span;
+    size_t done = 0;
+    size_t n;
+
+    while (done < RING_BYTES) {
+        switch (method) {
+            case E_METHOD_SINGLE:
+                dst[done] = bench_ring_pop();
+                n = 1u;
+                break;
+            case E_METHOD_BULK:
+                n = bench_ring_pop_n(&dst[done], chunk);
+                break;
+            case E_METHOD_SPAN:
+            default:
+                n = bench_ring_read_span(&p_span);
+                memcpy(&dst[done], p_span, n);
+                bench_ring_read_commit(n);
+                break;
+        }
+        done += n;
+    }
+}
+
+static u64_t ticks_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64_t)ts.tv_sec * 1000000000u) + (u64_t)ts.tv_nsec;
+#endif
+}
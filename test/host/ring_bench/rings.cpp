@@ -0,0 +1,4 @@
+#include "utils/private_ring.h"
+
+/* The size of the UART transmit ring */
+PRIVATE_RING_DEFINITIONS(bench_ring, u8_t, 256u)
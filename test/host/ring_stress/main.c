@@ -0,0 +1,167 @@
+/**
+ * @brief SPSC ring stress test
+ *
+ * One thread pushes a counting sequence into a private ring while another
+ * pops it, both without locks, the way an ISR and the main loop share a ring
+ * on the target. The consumer checks every value against the next one it
+ * expects, so a lost element shows up as a jump forward and a duplicated one
+ * as a step back. The single element and the bulk/span operations are run as
+ * separate passes.
+ *
+ * The small ring keeps the two threads on top of each other (the producer is
+ * full and the consumer empty most of the time), which is where a missing
+ * barrier or a torn index shows up.
+ *
+ * The threads only run at the same time on a machine with more than one core.
+ * On a single core they interleave only where the scheduler preempts them,
+ * which rarely lands inside a ring operation, so the run says so.
+ *
+ * Exits with 1 if any element was lost or duplicated.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "utils/private_ring.h"
+
+PRIVATE_RING_DECLARATIONS(stress_ring, u32_t) /* see rings.cpp */
+
+#define ELEMENTS        (20000000UL)    /* per pass */
+#define CHUNK           (13u)           /* bulk size, coprime to the capacity */
+
+typedef enum pass
+{
+    E_PASS_SINGLE,
+    E_PASS_BULK,
+} Pass_t;
+
+typedef struct result
+{
+    u32_t  lost;
+    u32_t  duplicated;
+    double seconds;
+} Result_t;
+
+static void *producer(void *p_arg);
+static Result_t run_pass(Pass_t pass);
+static double now_sec(void);
+
+int main(void)
+{
+    static const char * const NAMES[] = { "push/pop", "push_n/read_span" };
+    Result_t result;
+    int      status = EXIT_SUCCESS;
+    Pass_t   pass;
+
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("note: one CPU online, producer and consumer do not run in parallel\n");
+    }
+
+    for (pass = E_PASS_SINGLE; pass <= E_PASS_BULK; pass += 1) {
+        result = run_pass(pass);
+
+        printf("%-17s %lu elements  %6.1f M/s  lost %lu  duplicated %lu\n",
+            NAMES[pass], ELEMENTS, (double)ELEMENTS / result.seconds / 1e6,
+            (unsigned long)result.lost, (unsigned long)result.duplicated);
+
+        if ((0u != result.lost) || (0u != result.duplicated)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+static void *producer(void *p_arg)
+{
+    const Pass_t pass = *(const Pass_t *)p_arg;
+    u32_t        chunk[CHUNK];
+    u32_t        next = 0;
+    size_t       pushed;
+    size_t       n;
+    size_t       i;
+
+    while (next < ELEMENTS) {
+        if (E_PASS_SINGLE == pass) {
+            pushed = (E_TRUE == stress_ring_push(next)) ? 1u : 0u;
+        } else {
+            n = ((ELEMENTS - next) < CHUNK) ? (ELEMENTS - next) : CHUNK;
+            for (i = 0; i < n; i += 1) {
+                chunk[i] = next + (u32_t)i;
+            }
+            pushed = stress_ring_push_n(chunk, n);
+        }
+
+        next += (u32_t)pushed;
+        if (0u == pushed) {
+            sched_yield();
+        }
+    }
+
+    return NULL_PTR;
+}
+
+static Result_t run_pass(Pass_t pass)
+{
+    Result_t  result   = { 0u, 0u, 0.0 };
+    u32_t     expected = 0;
+    u32_t    *p_span   = NULL_PTR;
+    u32_t     popped;
+    size_t    n;
+    size_t    i;
+    pthread_t thread;
+    double    start;
+
+    stress_ring_init();
+    start = now_sec();
+    (void)pthread_create(&thread, NULL_PTR, producer, &pass);
+
+    while (expected < ELEMENTS) {
+        if (E_PASS_SINGLE == pass) {
+            /* A popped element is checked below like a span of 1 */
+            n = (E_TRUE == stress_ring_is_empty()) ? 0u : 1u;
+            if (0u != n) {
+                popped = stress_ring_pop();
+                p_span = &popped;
+            }
+        } else {
+            n = stress_ring_read_span(&p_span);
+        }
+
+        for (i = 0; i < n; i += 1) {
+            if (p_span[i] > expected) {
+                result.lost += p_span[i] - expected;
+                expected = p_span[i] + 1u;
+            } else if (p_span[i] < expected) {
+                result.duplicated += 1u;
+            } else {
+                expected += 1u;
+            }
+        }
+
+        if (E_PASS_BULK == pass) {
+            stress_ring_read_commit(n);
+        }
+
+        if (0u == n) {
+            sched_yield();
+        }
+    }
+
+    (void)pthread_join(thread, NULL_PTR);
+    result.seconds = now_sec() - start;
+
+    return result;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
@@ -0,0 +1,4 @@
+#include "utils/private_ring.h"
+
+/* Small on purpose, so the producer and consumer collide all the time */
+PRIVATE_RING_DEFINITIONS(stress_ring, u32_t, 16u)
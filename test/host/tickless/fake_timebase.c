@@ -0,0 +1,132 @@
+/**
+ * @brief Time base and core fakes for the tickless test
+ *
+ * The microsecond clock only moves in run_for (the core running with
+ * interrupts enabled) and in WFI (the core asleep). WFI sleeps until the
+ * compare or the other interrupt, whichever is first, plus wake_latency_us.
+ *
+ * Like TIM2's compare interrupt, the callback runs once the clock has reached
+ * the compare time and interrupts are enabled, and it disarms the compare.
+ * It runs when __set_PRIMASK lifts the mask, so a compare that matched while
+ * masked is taken late, as on the target.
+ */
+#include "fake_timebase.h"
+
+#include "bsp/private/timebase/timebase.h"
+#include "stm32f1xx.h"
+#include "types.h"
+
+u32_t  now_us;
+u32_t  compare_at_us;
+bool_t compare_on;
+u32_t  wake_latency_us;
+u32_t  other_irq_at_us;
+bool_t other_irq_on;
+u32_t  wfi_count;
+u32_t  wfi_unmasked;
+u32_t  wfi_stuck;
+
+static IsrCallback_t compare_cb;
+static u32_t         primask;
+static bool_t        in_isr;
+
+static void take_interrupts(void);
+static bool_t is_due(u32_t at, u32_t now);
+
+u32_t timebase_now(void)
+{
+    return now_us;
+}
+
+void timebase_set_alarm_callback(IsrCallback_t cb)
+{
+    compare_cb = cb;
+}
+
+void timebase_set_alarm(u32_t at)
+{
+    compare_at_us = at;
+    compare_on    = E_TRUE;
+    take_interrupts();
+}
+
+void timebase_cancel_alarm(void)
+{
+    compare_on = E_FALSE;
+}
+
+u32_t __get_PRIMASK(void)
+{
+    return primask;
+}
+
+void __set_PRIMASK(u32_t mask)
+{
+    primask = mask;
+    take_interrupts();
+}
+
+void __disable_irq(void)
+{
+    primask = 1u;
+}
+
+void __WFI(void)
+{
+    bool_t by_compare = compare_on;
+    u32_t  wake_at    = compare_at_us;
+
+    wfi_count += 1u;
+    if (0u == primask) {
+        wfi_unmasked += 1u;
+    }
+
+    if ((E_TRUE == other_irq_on)
+        && ((E_FALSE == by_compare) || ((s32_t)(other_irq_at_us - wake_at) < 0))) {
+        by_compare   = E_FALSE;
+        wake_at      = other_irq_at_us;
+        other_irq_on = E_FALSE;
+    } else if (E_FALSE == by_compare) {
+        /* Would sleep for good */
+        wfi_stuck += 1u;
+        wake_at    = now_us;
+    }
+
+    if ((s32_t)(wake_at - now_us) > 0) {
+        now_us = wake_at;
+    }
+    now_us += wake_latency_us;
+}
+
+void run_for(u32_t usec)
+{
+    const u32_t end = now_us + usec;
+
+    while ((E_TRUE == compare_on) && ((s32_t)(compare_at_us - now_us) > 0)
+           && ((s32_t)(end - compare_at_us) >= 0)) {
+        now_us = compare_at_us;
+        take_interrupts();
+    }
+
+    now_us = end;
+    take_interrupts();
+}
+
+/* Run the compare interrupt while it is due and not masked. The interrupt
+   does not preempt itself: a compare it sets runs after it returns. */
+static void take_interrupts(void)
+{
+    while ((0u == primask) && (E_FALSE == in_isr)
+           && (E_TRUE == compare_on) && (E_TRUE == is_due(compare_at_us, now_us))) {
+        compare_on = E_FALSE;
+
+        in_isr = E_TRUE;
+        compare_cb();
+        in_isr = E_FALSE;
+    }
+}
+
+static bool_t is_due(u32_t at, u32_t now)
+{
+    return ((s32_t)(now - at) >= 0) ? E_TRUE : E_FALSE;
+}
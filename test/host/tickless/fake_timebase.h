@@ -0,0 +1,21 @@
+/**
+ * @brief Clock, compare and sleep of the tickless test (see fake_timebase.c)
+ */
+#ifndef FAKE_TIMEBASE_H
+#define FAKE_TIMEBASE_H
+
+#include "types.h"
+
+extern u32_t  now_us;           /* timebase_now                              */
+extern u32_t  compare_at_us;    /* last timebase_set_alarm                   */
+extern bool_t compare_on;       /* set and neither fired nor cancelled       */
+extern u32_t  wake_latency_us;  /* from a wake up source to the end of WFI  */
+extern u32_t  other_irq_at_us;  /* another interrupt, ends WFI when on       */
+extern bool_t other_irq_on;
+extern u32_t  wfi_count;        /* WFI executed                              */
+extern u32_t  wfi_unmasked;     /* ... with interrupts enabled               */
+extern u32_t  wfi_stuck;        /* ... with nothing left to wake the core    */
+
+void run_for(u32_t usec);
+
+#endif /* FAKE_TIMEBASE_H */
@@ -0,0 +1,362 @@
+/**
+ * @brief Tickless idle test
+ *
+ * Runs the tickless module on a simulated microsecond clock, compare and WFI
+ * (see fake_timebase.c):
+ *
+ *  - the emulated tick runs on its grid across the 32 bit wrap of the clock,
+ *    one compare wake up per tick and no drift
+ *  - a compare interrupt held off for several periods runs every missed tick
+ *    and the next one stays on the grid
+ *  - the alarm fires once, when due, and not after it was cancelled or
+ *    replaced. One already due fires right away.
+ *  - tickless_idle wakes at its deadline or at the next tick, whichever is
+ *    first, and another interrupt ends the sleep
+ *  - tickless_wake keeps the next call from sleeping
+ *  - WFI always runs with interrupts masked and never without a wake up
+ *    source
+ *  - with random alarms, deadlines, run times and wake up latencies, the
+ *    compare is never later than the next tick or the alarm
+ *  - the sleep statistics
+ */
+#include <stdlib.h>
+
+#include "bsp/private/tickless/tickless.h"
+#include "check.h"
+#include "fake_timebase.h"
+#include "stm32f1xx.h"
+#include "types.h"
+
+#define PERIOD_US       (10000u)
+#define LATENCY_US      (40u)       /* largest random wake up latency */
+#define NEAR_WRAP_US    ((u32_t)(0xFFFFFFFFUL - (5u * PERIOD_US) + 123u))
+#define RANDOM_ROUNDS   (200000u)
+
+static void test_tick_grid(void);
+static void test_late_tick(void);
+static void test_alarm(void);
+static void test_idle_deadline(void);
+static void test_wake(void);
+static void test_other_interrupt(void);
+static void test_random(void);
+static void on_tick(void);
+static void on_alarm(void);
+static void setup(u32_t start_us);
+static void start_tick(void);
+static void set_alarm(u32_t at);
+static void check_compare(void);
+
+static u32_t  ticks;
+static u32_t  tick_base_us;     /* due time of tick 0                   */
+static u32_t  alarms;
+static u32_t  alarm_at_us;
+static bool_t alarm_set;
+static u32_t  max_late_us;      /* how late a callback may run          */
+
+int main(void)
+{
+    srand(3);
+
+    test_tick_grid();
+    test_late_tick();
+    test_alarm();
+    test_idle_deadline();
+    test_wake();
+    test_other_interrupt();
+    test_random();
+
+    CHECK_EQ(0u, wfi_unmasked);
+    CHECK_EQ(0u, wfi_stuck);
+
+    return check_status();
+}
+
+static void test_tick_grid(void)
+{
+    TicklessStats_t stats;
+    u32_t           i;
+
+    setup(NEAR_WRAP_US);
+    max_late_us = LATENCY_US;
+    start_tick();
+
+    for (i = 0; i < 1000u; i += 1) {
+        wake_latency_us = (u32_t)rand() % LATENCY_US;
+        tickless_idle(E_FALSE, 0u);
+        CHECK_EQ(i + 1u, ticks);
+    }
+
+    /* Only asleep, and woken once per tick */
+    tickless_take_stats(&stats);
+    CHECK_EQ(now_us - NEAR_WRAP_US, stats.elapsed_us);
+    CHECK_EQ(stats.elapsed_us, stats.asleep_us);
+    CHECK_EQ(1000u, stats.sleeps);
+    CHECK_EQ(1000u, stats.wakeups);
+
+    tickless_take_stats(&stats);
+    CHECK_EQ(0u, stats.elapsed_us);
+    CHECK_EQ(0u, stats.sleeps);
+    CHECK_EQ(0u, stats.wakeups);
+
+    /* Period 0 stops the tick and the compare */
+    CHECK_EQ(E_FALSE, tickless_set_tick_period(TICKLESS_MAX_WAIT_US + 1u));
+    CHECK_EQ(E_TRUE, tickless_set_tick_period(0u));
+    CHECK_EQ(E_FALSE, compare_on);
+    run_for(5u * PERIOD_US);
+    CHECK_EQ(1000u, ticks);
+}
+
+static void test_late_tick(void)
+{
+    TicklessStats_t stats;
+
+    setup(NEAR_WRAP_US);
+    start_tick();
+
+    /* Held off by a higher priority interrupt for 3.5 periods */
+    max_late_us = 3u * PERIOD_US;
+    __disable_irq();
+    run_for((3u * PERIOD_US) + (PERIOD_US / 2u));
+    CHECK_EQ(0u, ticks);
+    __set_PRIMASK(0u);
+    CHECK_EQ(3u, ticks);
+
+    tickless_take_stats(&stats);
+    CHECK_EQ(1u, stats.wakeups);
+
+    /* Back on the grid */
+    max_late_us = 0u;
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(4u, ticks);
+    CHECK_EQ(tick_base_us + (3u * PERIOD_US), now_us);
+}
+
+static void test_alarm(void)
+{
+    u32_t start;
+
+    setup(NEAR_WRAP_US);
+
+    start = now_us;
+    set_alarm(start + 2500u);
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(1u, alarms);
+    CHECK_EQ(start + 2500u, now_us);
+    CHECK_EQ(E_FALSE, compare_on);
+
+    /* Cancelled */
+    start = now_us;
+    set_alarm(start + 1000u);
+    tickless_cancel_alarm();
+    alarm_set = E_FALSE;
+    tickless_idle(E_TRUE, start + 5000u);
+    CHECK_EQ(start + 5000u, now_us);
+    CHECK_EQ(1u, alarms);
+
+    /* Replaced */
+    start = now_us;
+    set_alarm(start + 1000u);
+    set_alarm(start + 3000u);
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(start + 3000u, now_us);
+    CHECK_EQ(2u, alarms);
+
+    /* Already due */
+    max_late_us = 5u;
+    set_alarm(now_us - 5u);
+    CHECK_EQ(3u, alarms);
+    set_alarm(now_us);
+    CHECK_EQ(4u, alarms);
+
+    /* Between ticks */
+    max_late_us = 0u;
+    start_tick();
+    set_alarm(now_us + 2345u);
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(5u, alarms);
+    CHECK_EQ(0u, ticks);
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(1u, ticks);
+    CHECK_EQ(tick_base_us, now_us);
+}
+
+static void test_idle_deadline(void)
+{
+    u32_t start;
+
+    setup(NEAR_WRAP_US);
+    start_tick();
+
+    /* Before the tick */
+    start = now_us;
+    tickless_idle(E_TRUE, start + 3000u);
+    CHECK_EQ(start + 3000u, now_us);
+    CHECK_EQ(0u, ticks);
+
+    /* After the tick: the tick wakes first */
+    tickless_idle(E_TRUE, tick_base_us + 4000u);
+    CHECK_EQ(tick_base_us, now_us);
+    CHECK_EQ(1u, ticks);
+
+    /* That deadline is gone with the call, so the next tick is the next
+       wake up */
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(tick_base_us + PERIOD_US, now_us);
+    CHECK_EQ(2u, ticks);
+
+    /* Already passed */
+    start = now_us;
+    tickless_idle(E_TRUE, start - 1u);
+    CHECK_EQ(start, now_us);
+    CHECK_EQ(2u, ticks);
+}
+
+static void test_wake(void)
+{
+    TicklessStats_t stats;
+    u32_t           start;
+    u32_t           wfis;
+
+    setup(NEAR_WRAP_US);
+
+    start = now_us;
+    wfis  = wfi_count;
+    tickless_wake();
+    tickless_idle(E_TRUE, start + 1000u);
+    CHECK_EQ(start, now_us);
+    CHECK_EQ(wfis, wfi_count);
+
+    /* Only the next call */
+    tickless_idle(E_TRUE, start + 1000u);
+    CHECK_EQ(start + 1000u, now_us);
+    CHECK_EQ(wfis + 1u, wfi_count);
+
+    tickless_take_stats(&stats);
+    CHECK_EQ(1u, stats.sleeps);
+}
+
+static void test_other_interrupt(void)
+{
+    TicklessStats_t stats;
+    u32_t           start;
+
+    setup(NEAR_WRAP_US);
+    start_tick();
+
+    start           = now_us;
+    other_irq_at_us = start + 1234u;
+    other_irq_on    = E_TRUE;
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(start + 1234u, now_us);
+    CHECK_EQ(0u, ticks);
+
+    tickless_idle(E_FALSE, 0u);
+    CHECK_EQ(tick_base_us, now_us);
+    CHECK_EQ(1u, ticks);
+
+    tickless_take_stats(&stats);
+    CHECK_EQ(2u, stats.sleeps);
+    CHECK_EQ(1u, stats.wakeups);
+    CHECK_EQ(stats.elapsed_us, stats.asleep_us);
+}
+
+static void test_random(void)
+{
+    u32_t round;
+    u32_t deadline;
+    u32_t before;
+    u32_t events;
+
+    setup(0xFFFFFFFFUL - 1000000UL);
+    max_late_us = LATENCY_US;
+    start_tick();
+
+    /* About 30 s, across the wrap */
+    for (round = 0; round < RANDOM_ROUNDS; round += 1) {
+        wake_latency_us = (u32_t)rand() % LATENCY_US;
+
+        if ((E_FALSE == alarm_set) && (0 == (rand() % 4))) {
+            set_alarm(now_us + 1u + ((u32_t)rand() % (3u * PERIOD_US)));
+        }
+
+        run_for((u32_t)rand() % 200u);
+
+        before   = now_us;
+        events   = ticks + alarms;
+        deadline = now_us + 1u + ((u32_t)rand() % (2u * PERIOD_US));
+        if (0 == (rand() % 2)) {
+            /* Woken by a tick or the alarm, or at the deadline */
+            tickless_idle(E_TRUE, deadline);
+            CHECK(((ticks + alarms) != events) || ((s32_t)(now_us - deadline) >= 0));
+            CHECK((s32_t)(now_us - deadline) < (s32_t)LATENCY_US);
+        } else {
+            tickless_idle(E_FALSE, 0u);
+        }
+        CHECK((s32_t)(now_us - before) >= 0);
+
+        check_compare();
+    }
+
+    /* No tick was missed */
+    CHECK_EQ(((now_us - tick_base_us) / PERIOD_US) + 1u, ticks);
+    CHECK(0u != alarms);
+}
+
+static void on_tick(void)
+{
+    const u32_t due = tick_base_us + (ticks * PERIOD_US);
+
+    CHECK((s32_t)(now_us - due) >= 0);
+    CHECK((now_us - due) <= max_late_us);
+    ticks += 1u;
+}
+
+static void on_alarm(void)
+{
+    CHECK_EQ(E_TRUE, alarm_set);
+    CHECK((s32_t)(now_us - alarm_at_us) >= 0);
+    CHECK((now_us - alarm_at_us) <= max_late_us);
+
+    alarm_set  = E_FALSE;
+    alarms    += 1u;
+}
+
+static void setup(u32_t start_us)
+{
+    now_us          = start_us;
+    compare_on      = E_FALSE;
+    wake_latency_us = 0u;
+    other_irq_on    = E_FALSE;
+
+    ticks       = 0u;
+    alarms      = 0u;
+    alarm_set   = E_FALSE;
+    max_late_us = 0u;
+
+    tickless_init(on_alarm, on_tick);
+}
+
+static void start_tick(void)
+{
+    ticks        = 0u;
+    tick_base_us = now_us + PERIOD_US;
+    CHECK_EQ(E_TRUE, tickless_set_tick_period(PERIOD_US));
+}
+
+static void set_alarm(u32_t at)
+{
+    alarm_at_us = at;
+    alarm_set   = E_TRUE;
+    tickless_set_alarm(at);
+}
+
+/* The compare is set, and for no later than the next tick and the alarm */
+static void check_compare(void)
+{
+    CHECK_EQ(E_TRUE, compare_on);
+    CHECK((s32_t)(compare_at_us - now_us) > 0);
+    CHECK((s32_t)((tick_base_us + (ticks * PERIOD_US)) - compare_at_us) >= 0);
+    if (E_TRUE == alarm_set) {
+        CHECK((s32_t)(alarm_at_us - compare_at_us) >= 0);
+    }
+}
@@ -0,0 +1,19 @@
+/**
+ * @brief Core intrinsics of the tickless test (see fake_timebase.c)
+ *
+ * Stands in for the device header. PRIMASK is a variable, and WFI sleeps on
+ * the simulated clock.
+ */
+#ifndef STM32F1XX_H
+#define STM32F1XX_H
+
+#include "types.h"
+
+u32_t __get_PRIMASK(void);
+void __set_PRIMASK(u32_t primask);
+void __disable_irq(void);
+void __WFI(void);
+
+#define __DSB()
+
+#endif /* STM32F1XX_H */
@@ -0,0 +1,62 @@
+/**
+ * @brief Microsecond clock and alarm fakes for the timer test
+ *
+ * The test moves the clock. alarm_fire runs the alarm callback the way the
+ * deferred work handler does, once the alarm time has been reached.
+ */
+#include "fake_bsp.h"
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+u32_t  now_us;
+u32_t  alarm_at_us;
+bool_t alarm_on;
+
+static IsrCallback_t alarm_cb;
+
+u32_t bsp_time_us(void)
+{
+    return now_us;
+}
+
+void bsp_set_alarm(u32_t at_us)
+{
+    alarm_at_us = at_us;
+    alarm_on    = E_TRUE;
+}
+
+void bsp_cancel_alarm(void)
+{
+    alarm_on = E_FALSE;
+}
+
+void bsp_register_alarm_callback(IsrCallback_t cb)
+{
+    alarm_cb = cb;
+}
+
+u32_t bsp_irq_save(void)
+{
+    return 0u;
+}
+
+void bsp_irq_restore(u32_t state)
+{
+}
+
+u32_t bsp_cycles_now(void)
+{
+    static u32_t cycles;
+
+    cycles += 7u;
+    return cycles;
+}
+
+void alarm_fire(void)
+{
+    if ((E_FALSE != alarm_on) && ((s32_t)(now_us - alarm_at_us) >= 0)) {
+        alarm_on = E_FALSE;
+        alarm_cb();
+    }
+}
@@ -0,0 +1,15 @@
+/**
+ * @brief Clock and alarm of the timer test (see fake_bsp.c)
+ */
+#ifndef FAKE_BSP_H
+#define FAKE_BSP_H
+
+#include "types.h"
+
+extern u32_t  now_us;       /* bsp_time_us                      */
+extern u32_t  alarm_at_us;  /* last bsp_set_alarm               */
+extern bool_t alarm_on;     /* set and neither fired nor cancelled */
+
+void alarm_fire(void);
+
+#endif /* FAKE_BSP_H */
@@ -0,0 +1,367 @@
+/**
+ * @brief Timer wheel test
+ *
+ * Drives the timers through a fake microsecond clock and alarm (see
+ * fake_bsp.c) and works out independently when each timer is due:
+ *
+ *  - one-shot and periodic timers fire on the tick they are due, never early
+ *  - timers spread over every wheel level, stopped and restarted at random
+ *    from their callbacks, still fire exactly on time (the clock wraps
+ *    around during the run)
+ *  - a late alarm catches up on every missed tick in order, so periodic
+ *    timers do not drift
+ *  - the pool, the argument checks, and the alarm being off exactly when no
+ *    timer runs
+ *  - the built in benchmark
+ */
+#include <stdlib.h>
+
+#include "check.h"
+#include "fake_bsp.h"
+#include "timer/timer.h"
+#include "types.h"
+
+#define TICK            (TIMER_TICK_USEC)
+#define NUM_TIMERS      (TIMER_MAX_TIMERS)
+#define NOT_DUE         (0xFFFFFFFFUL)
+#define RANDOM_TICKS    (3000000UL)
+
+typedef struct expected
+{
+    TimerHandle_t t;
+    u32_t         due_us;   /* time of the tick it is due in, or NOT_DUE */
+    u32_t         period;   /* in ticks, 0 for one-shot                  */
+    u32_t         fires;
+} Expected_t;
+
+typedef enum mode
+{
+    MODE_EXACT,     /* alarms on time, callbacks must be on their tick        */
+    MODE_RANDOM,    /* as exact, and callbacks stop and start other timers    */
+    MODE_LATE,      /* alarms late, callbacks must be due since the last one */
+} Mode_t;
+
+static void test_basic(void);
+static void test_random(void);
+static void test_late_alarm(void);
+static void test_pool(void);
+static void test_benchmark(void);
+static void expired(TimerHandle_t t, void *p_arg);
+static void start(size_t i, u32_t delay, u32_t period);
+static void stop(size_t i);
+static void step_tick(void);
+static void check_running(void);
+static void setup(u32_t count);
+static void teardown(void);
+
+static Expected_t timers[NUM_TIMERS];
+static size_t     num_timers;
+static Mode_t     mode;
+static bool_t     in_callback;
+static u32_t      last_fire_us;     /* previous alarm delivery (MODE_LATE) */
+static u32_t      last_due_us;      /* due time of the last callback       */
+
+int main(void)
+{
+    srand(7);
+
+    test_basic();
+    test_random();
+    test_late_alarm();
+    test_pool();
+    test_benchmark();
+
+    return check_status();
+}
+
+static void test_basic(void)
+{
+    u32_t i;
+
+    setup(2u);
+    CHECK_EQ(E_FALSE, alarm_on);
+
+    start(0u, 5u, 0u);
+    CHECK_EQ(E_TRUE, alarm_on);
+    CHECK_EQ(now_us + TICK, alarm_at_us);
+    start(1u, 2u, 3u);
+
+    for (i = 0; i < 20u; i += 1) {
+        step_tick();
+    }
+
+    CHECK_EQ(1u, timers[0].fires);
+    CHECK_EQ(E_FALSE, timer_is_running(timers[0].t));
+    CHECK_EQ(6u, timers[1].fires);      /* ticks 2, 5, ... 17 */
+    CHECK_EQ(E_TRUE, timer_is_running(timers[1].t));
+
+    /* A delay of 0 is the next tick */
+    start(0u, 0u, 0u);
+    step_tick();
+    CHECK_EQ(2u, timers[0].fires);
+
+    /* Stopping the last running timer turns the alarm off */
+    stop(1u);
+    CHECK_EQ(E_FALSE, alarm_on);
+    stop(1u);
+
+    teardown();
+}
+
+static void test_random(void)
+{
+    u32_t  tick;
+    size_t i;
+
+    setup(NUM_TIMERS);
+    mode = MODE_RANDOM;
+
+    /* Across the 32 bit wrap of the clock */
+    now_us = 0xFFFFFFFFUL - (1000u * TICK);
+
+    /* Delays for every level, up to level 4 (over 2^20 ticks) */
+    start(0u, 1500000u, 0u);
+    start(1u, 200000u, 300000u);
+    for (i = 2u; i < num_timers; i += 1) {
+        start(i, (u32_t)rand() % ((i < 8u) ? 40000u : 3000u),
+              (0u != (i % 3u)) ? (1u + ((u32_t)rand() % ((i < 8u) ? 100000u : 3000u))) : 0u);
+    }
+
+    for (tick = 0; tick < RANDOM_TICKS; tick += 1) {
+        if (E_FALSE == alarm_on) {
+            /* Everything ran out. Start over. */
+            for (i = 0; i < num_timers; i += 1) {
+                start(i, (u32_t)rand() % 5000u, (0u != (rand() % 2)) ? (1u + ((u32_t)rand() % 300u)) : 0u);
+            }
+        }
+
+        step_tick();
+    }
+
+    CHECK_EQ(1u, timers[0].fires);
+    CHECK(0u != timers[1].fires);
+
+    teardown();
+}
+
+static void test_late_alarm(void)
+{
+    u32_t round;
+
+    setup(3u);
+    mode = MODE_LATE;
+
+    start(0u, 0u, 1u);
+    start(1u, 3u, 7u);
+    start(2u, 30u, 0u);
+
+    /* Each alarm is delivered 50.3 ticks after the last */
+    for (round = 0; round < 200u; round += 1) {
+        last_fire_us = now_us;
+        now_us      += (50u * TICK) + 300u;
+        alarm_fire();
+        check_running();
+    }
+
+    /* Every tick ran */
+    CHECK_EQ(((200u * ((50u * TICK) + 300u)) / TICK), timers[0].fires);
+    CHECK_EQ(1u, timers[2].fires);
+
+    teardown();
+}
+
+static void test_pool(void)
+{
+    TimerHandle_t handles[NUM_TIMERS + 1u];
+    size_t        n;
+
+    timer_init();
+
+    CHECK(TIMER_NO_TIMER == timer_alloc(NULL_PTR, NULL_PTR));
+
+    for (n = 0; n < (NUM_TIMERS + 1u); n += 1) {
+        handles[n] = timer_alloc(expired, NULL_PTR);
+    }
+    CHECK(TIMER_NO_TIMER != handles[NUM_TIMERS - 1u]);
+    CHECK(TIMER_NO_TIMER == handles[NUM_TIMERS]);
+
+    CHECK_EQ(E_FALSE, timer_start(handles[0], TIMER_MAX_MSEC + 1u, 0u));
+    CHECK_EQ(E_FALSE, timer_start(handles[0], 0u, TIMER_MAX_MSEC + 1u));
+    CHECK_EQ(E_FALSE, timer_start(TIMER_NO_TIMER, 1u, 0u));
+    CHECK_EQ(E_FALSE, alarm_on);
+    CHECK_EQ(E_FALSE, timer_is_running(TIMER_NO_TIMER));
+
+    CHECK_EQ(E_TRUE, timer_start(handles[0], TIMER_MAX_MSEC, TIMER_MAX_MSEC));
+    CHECK_EQ(E_TRUE, timer_is_running(handles[0]));
+    CHECK_EQ(E_TRUE, alarm_on);
+
+    /* Freeing stops the timer and gives it back */
+    timer_free(handles[0]);
+    CHECK_EQ(E_FALSE, timer_is_running(handles[0]));
+    CHECK_EQ(E_FALSE, alarm_on);
+    CHECK_EQ(E_FALSE, timer_start(handles[0], 1u, 0u));
+    CHECK(handles[0] == timer_alloc(expired, NULL_PTR));
+
+    for (n = 0; n < NUM_TIMERS; n += 1) {
+        timer_free(handles[n]);
+    }
+}
+
+static void test_benchmark(void)
+{
+    TimerBench_t  bench;
+    TimerHandle_t t;
+    size_t        i;
+
+    timer_init();
+
+    CHECK_EQ(E_TRUE, timer_benchmark(&bench));
+    for (i = 0; i < TIMER_BENCH_POINTS; i += 1) {
+        if ((4u << (2u * i)) <= NUM_TIMERS) {
+            CHECK_EQ(4u << (2u * i), bench.points[i].timers);
+            CHECK(0u != bench.points[i].cycles_per_tick);
+            CHECK(bench.points[i].max_cycles >= bench.points[i].cycles_per_tick);
+        } else {
+            CHECK_EQ(0u, bench.points[i].timers);
+        }
+    }
+
+    /* The benchmark gave all its timers back and left the alarm alone */
+    CHECK_EQ(E_FALSE, alarm_on);
+    for (i = 0; i < NUM_TIMERS; i += 1) {
+        CHECK(TIMER_NO_TIMER != timer_alloc(expired, NULL_PTR));
+    }
+
+    /* Not with timers running */
+    timer_init();
+    t = timer_alloc(expired, NULL_PTR);
+    (void)timer_start(t, 10u, 0u);
+    CHECK_EQ(E_FALSE, timer_benchmark(&bench));
+    CHECK_EQ(0u, bench.points[0].timers);
+}
+
+static void expired(TimerHandle_t t, void *p_arg)
+{
+    Expected_t * const p_exp = (Expected_t*)p_arg;
+    size_t j;
+
+    if (NULL_PTR != p_exp) {
+        CHECK(t == p_exp->t);
+        CHECK(NOT_DUE != p_exp->due_us);
+
+        if (MODE_LATE == mode) {
+            /* Due since the last delivery, in order */
+            CHECK((s32_t)(now_us - p_exp->due_us) >= 0);
+            CHECK((s32_t)(p_exp->due_us - last_fire_us) > 0);
+            CHECK((s32_t)(p_exp->due_us - last_due_us) >= 0);
+            last_due_us = p_exp->due_us;
+        } else {
+            CHECK_EQ(now_us, p_exp->due_us);
+        }
+
+        p_exp->fires  += 1u;
+        p_exp->due_us  = (0u != p_exp->period) ? (p_exp->due_us + (p_exp->period * TICK)) : NOT_DUE;
+        CHECK_EQ((0u != p_exp->period) ? E_TRUE : E_FALSE, timer_is_running(t));
+
+        if ((MODE_RANDOM == mode) && (0 == (rand() % 50))) {
+            /* Not the first two, which cover the long delays */
+            in_callback = E_TRUE;
+            j = 2u + ((size_t)rand() % (num_timers - 2u));
+            if (0 == (rand() % 2)) {
+                stop(j);
+            } else {
+                start(j, (u32_t)rand() % 3000u, (0 == (rand() % 2)) ? (1u + ((u32_t)rand() % 5000u)) : 0u);
+            }
+            in_callback = E_FALSE;
+        }
+    }
+}
+
+/* Start timer i, and work out the time of the tick it is due in */
+static void start(size_t i, u32_t delay, u32_t period)
+{
+    Expected_t * const p_exp = &timers[i];
+    u32_t next_tick_us;
+
+    /* The next tick: the one after the tick being run, the one the alarm is
+       set for, or one tick from now on an idle wheel */
+    if (E_FALSE != in_callback) {
+        next_tick_us = now_us + TICK;
+    } else if (E_FALSE != alarm_on) {
+        next_tick_us = alarm_at_us;
+    } else {
+        next_tick_us = now_us + TICK;
+    }
+
+    CHECK_EQ(E_TRUE, timer_start(p_exp->t, delay, period));
+    p_exp->due_us = next_tick_us + (delay * TICK);
+    p_exp->period = period;
+}
+
+static void stop(size_t i)
+{
+    timer_stop(timers[i].t);
+    timers[i].due_us = NOT_DUE;
+}
+
+/* Move the clock to the alarm and let it fire */
+static void step_tick(void)
+{
+    if (E_FALSE != alarm_on) {
+        now_us = alarm_at_us;
+        alarm_fire();
+    }
+
+    check_running();
+}
+
+/* Timers due later run, the rest do not, and the alarm is on if any runs */
+static void check_running(void)
+{
+    bool_t any = E_FALSE;
+    size_t i;
+
+    for (i = 0; i < num_timers; i += 1) {
+        if (NOT_DUE == timers[i].due_us) {
+            CHECK_EQ(E_FALSE, timer_is_running(timers[i].t));
+        } else {
+            CHECK_EQ(E_TRUE, timer_is_running(timers[i].t));
+            CHECK((s32_t)(timers[i].due_us - now_us) > 0);
+            any = E_TRUE;
+        }
+    }
+
+    CHECK_EQ(any, alarm_on);
+    if (E_FALSE != any) {
+        CHECK((s32_t)(alarm_at_us - now_us) > 0);
+    }
+}
+
+static void setup(u32_t count)
+{
+    size_t i;
+
+    timer_init();
+
+    num_timers   = count;
+    mode         = MODE_EXACT;
+    in_callback  = E_FALSE;
+    last_due_us  = now_us;
+    for (i = 0; i < count; i += 1) {
+        timers[i].t      = timer_alloc(expired, &timers[i]);
+        timers[i].due_us = NOT_DUE;
+        timers[i].period = 0u;
+        timers[i].fires  = 0u;
+        CHECK(TIMER_NO_TIMER != timers[i].t);
+    }
+}
+
+static void teardown(void)
+{
+    size_t i;
+
+    for (i = 0; i < num_timers; i += 1) {
+        timer_free(timers[i].t);
+    }
+    num_timers = 0;
+}
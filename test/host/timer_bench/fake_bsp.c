@@ -0,0 +1,53 @@
+/**
+ * @brief Clock, alarm and cycle counter stubs for the timer benchmark
+ *
+ * timer_benchmark runs the wheel straight through, without the alarm, so the
+ * clock and the alarm are never used. The cycle counter is the time stamp
+ * counter on x86 and nanoseconds elsewhere (see main.c).
+ */
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+#include "bsp/bsp.h"
+#include "types.h"
+
+u32_t bsp_time_us(void)
+{
+    return 0u;
+}
+
+void bsp_set_alarm(u32_t at_us)
+{
+}
+
+void bsp_cancel_alarm(void)
+{
+}
+
+void bsp_register_alarm_callback(IsrCallback_t cb)
+{
+}
+
+u32_t bsp_irq_save(void)
+{
+    return 0u;
+}
+
+void bsp_irq_restore(u32_t state)
+{
+}
+
+u32_t bsp_cycles_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (u32_t)__rdtsc();
+#else
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u32_t)(((u64_t)ts.tv_sec * 1000000000u) + (u64_t)ts.tv_nsec);
+#endif
+}
@@ -0,0 +1,42 @@
+/**
+ * @brief Timer wheel benchmark
+ *
+ * Runs timer_benchmark (see timer/timer.h), the timer service's own
+ * measurement of the cost of a tick, with a pool of 256 timers so that every
+ * point (4, 16, 64 and 256 running timers) is measured. The cost of a tick
+ * should not grow with the number of timers.
+ *
+ * Costs are in time stamp counter ticks on x86 (about CPU cycles) and in
+ * nanoseconds elsewhere. The numbers compare the points with each other;
+ * they are not Cortex-M3 cycle counts.
+ */
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define BENCH_UNIT      "cycles"
+#else
+    #define BENCH_UNIT      "ns"
+#endif
+
+#include "timer/timer.h"
+#include "types.h"
+
+int main(void)
+{
+    TimerBench_t bench;
+    bool_t       ok;
+    size_t       i;
+
+    timer_init();
+    ok = timer_benchmark(&bench);
+
+    printf("%-10s %14s %14s %10s\n", "timers", BENCH_UNIT "/tick", "max " BENCH_UNIT, "expiries");
+    for (i = 0; i < TIMER_BENCH_POINTS; i += 1) {
+        printf("%-10lu %14lu %14lu %10lu\n", (unsigned long)bench.points[i].timers,
+            (unsigned long)bench.points[i].cycles_per_tick,
+            (unsigned long)bench.points[i].max_cycles,
+            (unsigned long)bench.points[i].expiries);
+    }
+
+    return (E_TRUE == ok) ? 0 : 1;
+}